@@ -39,10 +39,14 @@
 #include "gstomxcamera.h"
 #include "gstomxrrparser.h"
 #include "gstomxnoisefilter.h"
+#ifndef GST_OMX_MOCK
 #include "gstomxbufferalloc.h"
+#endif
 #include "gstomxvideomixer.h"
 #include "gstomxjpegdec.h"
 
+GMutex _omx_mutex;
+
 /* entry point to initialize the plug-in
  * initialize the plug-in itself
  * register the element factories and other features
@@ -122,9 +126,11 @@ omx_init (GstPlugin * omx)
 			     GST_TYPE_OMX_NOISE_FILTER))
     return FALSE;
   
+#ifndef GST_OMX_MOCK
   if (!gst_element_register (omx, "omxbufferalloc", GST_RANK_NONE,
           GST_TYPE_OMXBUFFERALLOC))
     return FALSE;
+#endif
 
   if (!gst_element_register (omx, "omx_videomixer", GST_RANK_NONE,
           GST_TYPE_OMX_VIDEO_MIXER))
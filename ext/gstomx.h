@@ -36,6 +36,7 @@
 
 #include "gstomxbuftab.h"
 #include "gstomxbufqueue.h"
+#include "gstomxstats.h"
 #include "gstomxpad.h"
 #include "gstomxerror.h"
 
@@ -74,9 +75,15 @@ struct _GstOmxBufferData
 {
   GstBuffer *buffer;
   GstOmxPad *pad;
-  guint8 id;                    /*  ID of the buffer used by the buftab  */
+  guint id;                     /*  ID of the buffer used by the buftab  */
+  gint64 stamp;                 /*  Monotonic time of the last fill, for stats */
 };
 
+/* Buffer ids are indexes into the buftab, and must stay below this limit.
+ * Interlaced sink ports use the ids past nBufferCountActual for the bottom
+ * fields, so they can hold half as many buffers */
+#define GST_OMX_BUFFER_ID_MAX 4096
+
 #define GST_OMX_INIT_STRUCT(_s_, _name_)	\
   memset((_s_), 0x0, sizeof(_name_));		\
   (_s_)->nSize = sizeof(_name_);		\
@@ -91,7 +98,17 @@ struct _GstOmxBufferData
 #define GST_OMX_IS_OMX_BUFFER(buffer) \
   (GST_BUFFER_FLAGS(buffer) & GST_OMX_BUFFER_FLAG)
 
-GMutex _omx_mutex;
+/* Process wide lock, it serializes the OMX core calls (OMX_GetHandle,
+ * OMX_FreeHandle) and, when global locking is selected, every call into
+ * the components. Otherwise each element serializes the calls into its own
+ * component with its private lock. */
+extern GMutex _omx_mutex;
+
+#ifdef GST_OMX_GLOBAL_LOCK
+#define GST_OMX_GLOBAL_LOCK_DEFAULT TRUE
+#else
+#define GST_OMX_GLOBAL_LOCK_DEFAULT FALSE
+#endif
 
 G_END_DECLS
 #endif // __GST_OMX_H__
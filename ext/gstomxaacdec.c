@@ -62,6 +62,18 @@ enum
 
 #define GST_OMX_AAC_DEC_FRAMEMODE_DEFAULT FALSE
 
+/* ADTS fixed and variable header, plus the CRC when present */
+#define GST_OMX_AAC_DEC_ADTS_HEADER_SIZE 7
+#define GST_OMX_AAC_DEC_ADTS_CRC_SIZE 2
+/* Raw data blocks an ADTS frame may carry */
+#define GST_OMX_AAC_DEC_ADTS_MAX_BLOCKS 4
+#define GST_OMX_AAC_DEC_FRAME_SAMPLES 1024
+
+static const gint gst_omx_aac_dec_rates[] =
+    { 96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000,
+  11025, 8000, 7350
+};
+
 #define gst_omx_aac_dec_parent_class parent_class
 G_DEFINE_TYPE (GstOmxAACDec, gst_omx_aac_dec, GST_TYPE_OMX_BASE);
 
@@ -77,6 +89,12 @@ static GstFlowReturn gst_omx_aac_dec_fill_callback (GstOmxBase * base,
 static OMX_ERRORTYPE gst_omx_aac_dec_parameters (GstOmxAACDec * this,
     GstOmxFormat * format);
 static OMX_ERRORTYPE gst_omx_aac_dec_init_pads (GstOmxBase * base);
+static void gst_omx_aac_dec_finalize (GObject * object);
+static GstFlowReturn gst_omx_aac_dec_chain (GstPad * pad, GstBuffer * buf);
+static gboolean gst_omx_aac_dec_event (GstPad * pad, GstEvent * event);
+static GstFlowReturn gst_omx_aac_dec_alloc_buffer (GstPad * pad,
+    guint64 offset, guint size, GstCaps * caps, GstBuffer ** buf);
+static GstFlowReturn gst_omx_aac_dec_push_frames (GstOmxAACDec * this);
 
 /* initialize the omx's class */
 static void
@@ -103,11 +121,13 @@ gst_omx_aac_dec_class_init (GstOmxAACDecClass * klass)
 
   gobject_class->set_property = gst_omx_aac_dec_set_property;
   gobject_class->get_property = gst_omx_aac_dec_get_property;
+  gobject_class->finalize = gst_omx_aac_dec_finalize;
 
 
   g_object_class_install_property (gobject_class, PROP_FRAMEMODE,
       g_param_spec_boolean ("framemode", "Frame Mode",
-          "Frame Mode", GST_OMX_AAC_DEC_FRAMEMODE_DEFAULT, G_PARAM_READWRITE));
+          "Split unframed ADTS input into raw access units before decoding",
+          GST_OMX_AAC_DEC_FRAMEMODE_DEFAULT, G_PARAM_READWRITE));
 
 
   gstomxbase_class->omx_fill_buffer =
@@ -133,6 +153,11 @@ gst_omx_aac_dec_init (GstOmxAACDec * this)
 
   /* Initialize properties */
   this->framemode = GST_OMX_AAC_DEC_FRAMEMODE_DEFAULT;
+
+  this->adapter = gst_adapter_new ();
+  this->timestamp = GST_CLOCK_TIME_NONE;
+  this->upstream = GST_CLOCK_TIME_NONE;
+  this->samples = 0;
   /*Set Audio flag */
   base->output_buffers = 1;
   base->input_buffers = 1;
@@ -142,6 +167,17 @@ gst_omx_aac_dec_init (GstOmxAACDec * this)
           (&sink_template), "sink"));
   gst_pad_set_active (this->sinkpad, TRUE);
   gst_omx_base_add_pad (GST_OMX_BASE (this), this->sinkpad);
+  /* Unframed input goes through the ADTS framer first */
+  this->base_chain = GST_PAD_CHAINFUNC (this->sinkpad);
+  this->base_event = GST_PAD_EVENTFUNC (this->sinkpad);
+  this->base_alloc = GST_PAD_BUFFERALLOCFUNC (this->sinkpad);
+  gst_pad_set_chain_function (this->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_omx_aac_dec_chain));
+  gst_pad_set_chain_list_function (this->sinkpad, NULL);
+  gst_pad_set_event_function (this->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_omx_aac_dec_event));
+  gst_pad_set_bufferalloc_function (this->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_omx_aac_dec_alloc_buffer));
   gst_element_add_pad (GST_ELEMENT (this), this->sinkpad);
 
   this->srcpad =
@@ -224,6 +260,12 @@ gst_omx_aac_dec_set_caps (GstPad * pad, GstCaps * caps)
 
   this->framed = gst_structure_has_field (structure, "framed");
 
+  /* Data gathered so far belongs to the previous stream */
+  gst_adapter_clear (this->adapter);
+  this->timestamp = GST_CLOCK_TIME_NONE;
+  this->upstream = GST_CLOCK_TIME_NONE;
+  this->samples = 0;
+
   GST_INFO_OBJECT (this, "Parsed for input caps:\n"
       "\tRate:  %u\n"
       "\tChannels %u\n"
@@ -279,10 +321,10 @@ gst_omx_aac_dec_init_pads (GstOmxBase * base)
   GST_DEBUG_OBJECT (this, "Initializing sink pad port");
   port = GST_OMX_PAD_PORT (GST_OMX_PAD (this->sinkpad));
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_GetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "input";
     goto noport;
@@ -304,11 +346,11 @@ gst_omx_aac_dec_init_pads (GstOmxBase * base)
   port->format.audio.cMIMEType = "ADEC";
   port->format.audio.pNativeRender = NULL;
   port->format.audio.bFlagErrorConcealment = OMX_FALSE;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   if (error != OMX_ErrorNone) {
     portname = "input";
@@ -319,10 +361,10 @@ gst_omx_aac_dec_init_pads (GstOmxBase * base)
   GST_DEBUG_OBJECT (this, "Initializing src pad port");
   port = GST_OMX_PAD_PORT (GST_OMX_PAD (this->srcpad));
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_GetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "output";
     goto noport;
@@ -342,10 +384,10 @@ gst_omx_aac_dec_init_pads (GstOmxBase * base)
   port->format.audio.cMIMEType = "PCM";
   port->format.audio.pNativeRender = NULL;
   port->format.audio.bFlagErrorConcealment = OMX_FALSE;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "output";
     goto noport;
@@ -358,9 +400,9 @@ gst_omx_aac_dec_init_pads (GstOmxBase * base)
 
 
   GST_INFO_OBJECT (this, "Enabling input port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable, 0, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
 
   GST_INFO_OBJECT (this, "Waiting for input port to enable");
@@ -371,9 +413,9 @@ gst_omx_aac_dec_init_pads (GstOmxBase * base)
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling output port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable, 1, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for output port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -420,9 +462,9 @@ gst_omx_aac_dec_parameters (GstOmxAACDec * this, GstOmxFormat * format)
   GST_OMX_INIT_STRUCT (&aac_param, OMX_AUDIO_PARAM_AACPROFILETYPE);
   aac_param.nPortIndex = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle, OMX_IndexParamAudioAac, &aac_param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   aac_param.nSampleRate = format->rate;
   aac_param.nChannels = format->channels;
@@ -442,7 +484,8 @@ gst_omx_aac_dec_parameters (GstOmxAACDec * this, GstOmxFormat * format)
       break;
   }
 
-  if (this->framed) {
+  /* The framer strips the ADTS headers */
+  if (this->framed || this->framemode) {
     aac_param.eAACStreamFormat = OMX_AUDIO_AACStreamFormatRAW;
     GST_DEBUG_OBJECT (this, "Format: Raw");
   } else {
@@ -450,9 +493,9 @@ gst_omx_aac_dec_parameters (GstOmxAACDec * this, GstOmxFormat * format)
     GST_DEBUG_OBJECT (this, "Format: Max");
   }
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (base->handle, OMX_IndexParamAudioAac, &aac_param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noAACParams;
 
@@ -468,18 +511,18 @@ gst_omx_aac_dec_parameters (GstOmxAACDec * this, GstOmxFormat * format)
      GST_OMX_INIT_STRUCT (&pcm_param, OMX_AUDIO_PARAM_PCMMODETYPE);
 
      pcm_param.nPortIndex=1;  
-     g_mutex_lock (&_omx_mutex);
+     g_mutex_lock (base->omx_lock);
      OMX_GetParameter (base->handle, OMX_IndexParamAudioPcm,
      &pcm_param);
-     g_mutex_unlock (&_omx_mutex);
+     g_mutex_unlock (base->omx_lock);
 
      pcm_param.nSamplingRate = format->rate;
      pcm_param.nChannels = format->channels;
 
-     g_mutex_lock (&_omx_mutex);
+     g_mutex_lock (base->omx_lock);
      error = OMX_SetParameter (base->handle, OMX_IndexParamAudioPcm,
      &pcm_param);
-     g_mutex_unlock (&_omx_mutex);
+     g_mutex_unlock (base->omx_lock);
      if (GST_OMX_FAIL (error))
      goto noPCMParams;
 
@@ -513,19 +556,10 @@ gst_omx_aac_dec_fill_callback (GstOmxBase * base, OMX_BUFFERHEADERTYPE * outbuf)
 
   GST_LOG_OBJECT (this, "AAC Decoder Fill buffer callback");
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
   if (!buffer)
-    goto noalloc;
-
-  GST_BUFFER_SIZE (buffer) = outbuf->nFilledLen;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
+    goto nocaps;
 
   /* Make buffer fields GStreamer friendly */
   GST_BUFFER_TIMESTAMP (buffer) = outbuf->nTimeStamp;
@@ -547,12 +581,6 @@ gst_omx_aac_dec_fill_callback (GstOmxBase * base, OMX_BUFFERHEADERTYPE * outbuf)
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
@@ -564,3 +592,242 @@ nopush:
     return ret;
   }
 }
+
+static void
+gst_omx_aac_dec_finalize (GObject * object)
+{
+  GstOmxAACDec *this = GST_OMX_AAC_DEC (object);
+
+  g_object_unref (this->adapter);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* Sends a raw data block to the base class, placed after the samples
+ * sent since the last resync */
+static GstFlowReturn
+gst_omx_aac_dec_send_block (GstOmxAACDec * this, GstBuffer * buf,
+    guint rateidx)
+{
+  gst_buffer_set_caps (buf, GST_PAD_CAPS (this->sinkpad));
+
+  if (GST_CLOCK_TIME_IS_VALID (this->timestamp)) {
+    GST_BUFFER_TIMESTAMP (buf) = this->timestamp +
+        gst_util_uint64_scale_int (this->samples, GST_SECOND,
+        gst_omx_aac_dec_rates[rateidx]);
+    GST_BUFFER_DURATION (buf) =
+        gst_util_uint64_scale_int (GST_OMX_AAC_DEC_FRAME_SAMPLES,
+        GST_SECOND, gst_omx_aac_dec_rates[rateidx]);
+  }
+  this->samples += GST_OMX_AAC_DEC_FRAME_SAMPLES;
+
+  GST_LOG_OBJECT (this, "Sending frame of %u bytes at %" GST_TIME_FORMAT,
+      GST_BUFFER_SIZE (buf), GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
+
+  return this->base_chain (this->sinkpad, buf);
+}
+
+/* Splits a frame of several raw data blocks protected by CRC. The header
+ * CRC is preceded by the position of every block but the first, counted
+ * from the start of the first one, and each block is followed by its own
+ * CRC */
+static GstFlowReturn
+gst_omx_aac_dec_send_blocks (GstOmxAACDec * this, guint framelen,
+    guint blocks, guint rateidx)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint starts[GST_OMX_AAC_DEC_ADTS_MAX_BLOCKS + 1];
+  const guint8 *positions;
+  GstBuffer *frame, *buf;
+  guint i, first;
+
+  first = GST_OMX_AAC_DEC_ADTS_HEADER_SIZE +
+      blocks * GST_OMX_AAC_DEC_ADTS_CRC_SIZE;
+  if (framelen <= first)
+    goto badpositions;
+
+  positions = gst_adapter_peek (this->adapter, first) +
+      GST_OMX_AAC_DEC_ADTS_HEADER_SIZE;
+  starts[0] = first;
+  for (i = 1; i < blocks; i++)
+    starts[i] = first + GST_READ_UINT16_BE (positions + 2 * (i - 1));
+  /* Where the block after the last one would start */
+  starts[blocks] = framelen + GST_OMX_AAC_DEC_ADTS_CRC_SIZE;
+
+  for (i = 0; i < blocks; i++)
+    if (starts[i + 1] <= starts[i] + GST_OMX_AAC_DEC_ADTS_CRC_SIZE)
+      goto badpositions;
+
+  frame = gst_adapter_take_buffer (this->adapter, framelen);
+  for (i = 0; i < blocks && GST_FLOW_OK == ret; i++) {
+    buf = gst_buffer_create_sub (frame, starts[i],
+        starts[i + 1] - starts[i] - GST_OMX_AAC_DEC_ADTS_CRC_SIZE);
+    ret = gst_omx_aac_dec_send_block (this, buf, rateidx);
+  }
+  gst_buffer_unref (frame);
+
+  return ret;
+
+badpositions:
+  {
+    GST_WARNING_OBJECT (this, "Dropping frame of %u raw data blocks with "
+        "bad block positions", blocks);
+    gst_adapter_flush (this->adapter, framelen);
+    this->samples += blocks * GST_OMX_AAC_DEC_FRAME_SAMPLES;
+    return GST_FLOW_OK;
+  }
+}
+
+/* Sends every whole ADTS frame in the adapter to the base class without
+ * its header, one buffer per raw data block. Frames within a single input
+ * buffer are sent as subbuffers of it, only frames split across buffers
+ * are copied */
+static GstFlowReturn
+gst_omx_aac_dec_push_frames (GstOmxAACDec * this)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstClockTime timestamp;
+  const guint8 *header;
+  GstBuffer *buf;
+  guint avail, framelen, headerlen, blocks, rateidx;
+  guint64 distance;
+  gboolean crc;
+  gint offset;
+
+  while (GST_FLOW_OK == ret) {
+    avail = gst_adapter_available (this->adapter);
+    if (avail < GST_OMX_AAC_DEC_ADTS_HEADER_SIZE)
+      break;
+
+    /* 12 bit sync word and layer 0 */
+    offset = gst_adapter_masked_scan_uint32 (this->adapter, 0xfff60000,
+        0xfff00000, 0, avail);
+    if (offset < 0) {
+      /* The last bytes might be the start of a sync word */
+      GST_WARNING_OBJECT (this, "No ADTS sync word in %u bytes", avail);
+      gst_adapter_flush (this->adapter, avail - 3);
+      break;
+    }
+    if (offset > 0) {
+      GST_DEBUG_OBJECT (this, "Skipping %d bytes to the next sync word",
+          offset);
+      gst_adapter_flush (this->adapter, offset);
+      continue;
+    }
+
+    header = gst_adapter_peek (this->adapter, GST_OMX_AAC_DEC_ADTS_HEADER_SIZE);
+    crc = !(header[1] & 0x01);
+    headerlen = GST_OMX_AAC_DEC_ADTS_HEADER_SIZE +
+        (crc ? GST_OMX_AAC_DEC_ADTS_CRC_SIZE : 0);
+    rateidx = (header[2] >> 2) & 0x0f;
+    framelen = ((header[3] & 0x03) << 11) | (header[4] << 3) | (header[5] >> 5);
+    blocks = (header[6] & 0x03) + 1;
+
+    /* Not a real header, look for the next sync word */
+    if (rateidx >= G_N_ELEMENTS (gst_omx_aac_dec_rates)
+        || framelen <= headerlen) {
+      gst_adapter_flush (this->adapter, 1);
+      continue;
+    }
+
+    if (avail < framelen)
+      break;
+
+    /* Frames are interpolated from the last input timestamp synced to.
+     * Resync on every new one, a frame starting inside the buffer is
+     * placed by its byte offset at the bitrate of the frame */
+    timestamp = gst_adapter_prev_timestamp (this->adapter, &distance);
+    if (GST_CLOCK_TIME_IS_VALID (timestamp) && timestamp != this->upstream) {
+      this->upstream = timestamp;
+      this->timestamp = timestamp + gst_util_uint64_scale (distance,
+          (guint64) blocks * GST_OMX_AAC_DEC_FRAME_SAMPLES * GST_SECOND,
+          (guint64) framelen * gst_omx_aac_dec_rates[rateidx]);
+      this->samples = 0;
+    }
+
+    if (1 == blocks) {
+      gst_adapter_flush (this->adapter, headerlen);
+      buf = gst_adapter_take_buffer (this->adapter, framelen - headerlen);
+      ret = gst_omx_aac_dec_send_block (this, buf, rateidx);
+    } else if (crc) {
+      ret = gst_omx_aac_dec_send_blocks (this, framelen, blocks, rateidx);
+    } else {
+      /* Without the CRC there are no block positions to split at */
+      GST_WARNING_OBJECT (this, "Dropping frame of %u raw data blocks "
+          "without CRC", blocks);
+      gst_adapter_flush (this->adapter, framelen);
+      this->samples += blocks * GST_OMX_AAC_DEC_FRAME_SAMPLES;
+    }
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_omx_aac_dec_chain (GstPad * pad, GstBuffer * buf)
+{
+  GstOmxAACDec *this = GST_OMX_AAC_DEC (GST_OBJECT_PARENT (pad));
+
+  if (!this->framemode || this->framed)
+    return this->base_chain (pad, buf);
+
+  /* Partial frames before a gap can't be completed */
+  if (GST_BUFFER_IS_DISCONT (buf)) {
+    gst_adapter_clear (this->adapter);
+    this->timestamp = GST_CLOCK_TIME_NONE;
+    this->upstream = GST_CLOCK_TIME_NONE;
+  }
+
+  gst_adapter_push (this->adapter, buf);
+
+  return gst_omx_aac_dec_push_frames (this);
+}
+
+/* The framer may hold on to the only input buffer while waiting for the
+ * rest of a frame, so upstream is only lent the port buffers when the
+ * input goes straight to the component. Otherwise no buffer is returned
+ * and the core allocates a regular one */
+static GstFlowReturn
+gst_omx_aac_dec_alloc_buffer (GstPad * pad, guint64 offset, guint size,
+    GstCaps * caps, GstBuffer ** buf)
+{
+  GstOmxAACDec *this = GST_OMX_AAC_DEC (GST_OBJECT_PARENT (pad));
+  gboolean framed = this->framed;
+
+  /* Caps set along with the allocation aren't applied to the pad yet */
+  if (caps && !gst_caps_is_empty (caps))
+    framed = gst_structure_has_field (gst_caps_get_structure (caps, 0),
+        "framed");
+
+  if (this->framemode && !framed) {
+    *buf = NULL;
+    return GST_FLOW_OK;
+  }
+
+  return this->base_alloc (pad, offset, size, caps, buf);
+}
+
+static gboolean
+gst_omx_aac_dec_event (GstPad * pad, GstEvent * event)
+{
+  GstOmxAACDec *this = GST_OMX_AAC_DEC (GST_OBJECT_PARENT (pad));
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      if (gst_adapter_available (this->adapter))
+        GST_DEBUG_OBJECT (this, "Dropping %u bytes of an incomplete frame",
+            gst_adapter_available (this->adapter));
+      gst_adapter_clear (this->adapter);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_adapter_clear (this->adapter);
+      this->timestamp = GST_CLOCK_TIME_NONE;
+      this->upstream = GST_CLOCK_TIME_NONE;
+      this->samples = 0;
+      break;
+    default:
+      break;
+  }
+
+  return this->base_event (pad, event);
+}
@@ -22,6 +22,7 @@
 #define __GST_OMX_AAC_DEC_H__
 
 #include <gst/gst.h>
+#include <gst/base/gstadapter.h>
 #include "gstomxpad.h"
 #include "gstomxbase.h"
 
@@ -51,6 +52,17 @@ struct _GstOmxAACDec
 
   /* Properties */
   gboolean framemode;
+
+  /* ADTS framer, see framemode. The timestamp is the one of the first
+   * frame after the last resync, upstream the last input timestamp it
+   * was synced to */
+  GstAdapter *adapter;
+  GstClockTime timestamp;
+  GstClockTime upstream;
+  guint64 samples;
+  GstPadChainFunction base_chain;
+  GstPadEventFunction base_event;
+  GstPadBufferAllocFunction base_alloc;
 };
 
 struct _GstOmxAACDecClass
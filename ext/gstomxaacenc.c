@@ -48,12 +48,18 @@ enum
   PROP_0,
   PROP_BITRATE,
   PROP_PROFILE,
-  PROP_OUTPUT_FORMAT
+  PROP_OUTPUT_FORMAT,
+  PROP_FRAMES_PER_BUFFER
 };
 
 #define GST_OMX_AAC_ENC_BITRATE_DEFAULT 128000
 #define GST_OMX_AAC_ENC_PROFILE_DEFAULT OMX_AUDIO_AACObjectLC
 #define GST_OMX_AAC_ENC_OUTPUT_FORMAT_DEFAULT OMX_AUDIO_AACStreamFormatRAW
+#define GST_OMX_AAC_ENC_FRAMES_PER_BUFFER_DEFAULT 1
+
+/* Samples per channel in an AAC frame, of 16 bit each */
+#define GST_OMX_AAC_ENC_FRAME_SAMPLES 1024
+#define GST_OMX_AAC_ENC_SAMPLE_SIZE 2
 
 
 gint gst_omx_aac_rateIdx[] =
@@ -141,6 +147,14 @@ static GstFlowReturn gst_omx_aac_enc_fill_callback (GstOmxBase * base,
     OMX_BUFFERHEADERTYPE * outbuf);
 static gint gst_omx_aac_enc_get_rateIdx (guint rate);
 static GstBuffer *gst_omx_aac_enc_generate_codec_data (GstOmxBase * base);
+static void gst_omx_aac_enc_finalize (GObject * object);
+static GstFlowReturn gst_omx_aac_enc_chain (GstPad * pad, GstBuffer * buf);
+static GstFlowReturn gst_omx_aac_enc_chain_list (GstPad * pad,
+    GstBufferList * list);
+static gboolean gst_omx_aac_enc_event (GstPad * pad, GstEvent * event);
+static GstFlowReturn gst_omx_aac_enc_push_frames (GstOmxAACEnc * this,
+    gboolean drain);
+static guint gst_omx_aac_enc_chunk_size (GstOmxAACEnc * this);
 
 /* initialize the omx's class */
 static void
@@ -167,22 +181,30 @@ gst_omx_aac_enc_class_init (GstOmxAACEncClass * klass)
 
   gobject_class->set_property = gst_omx_aac_enc_set_property;
   gobject_class->get_property = gst_omx_aac_enc_get_property;
+  gobject_class->finalize = gst_omx_aac_enc_finalize;
 
   g_object_class_install_property (gobject_class, PROP_BITRATE,
       g_param_spec_uint ("bitrate", "Encoding bitrate",
           "Sets the encoder bitrate",
-          0, 256000, GST_OMX_AAC_ENC_BITRATE_DEFAULT, G_PARAM_READWRITE));
+          0, 256000, GST_OMX_AAC_ENC_BITRATE_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_PROFILE,
       g_param_spec_enum ("profile", "Encoding AAC profile",
           "Sets the AAC profile",
           GST_TYPE_OMX_AAC_ENC_PROFILE, GST_OMX_AAC_ENC_PROFILE_DEFAULT,
-          G_PARAM_READWRITE));
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_OUTPUT_FORMAT,
       g_param_spec_enum ("output-format", "Output Format",
           "Sets the AAC output format",
           GST_TYPE_OMX_AAC_ENC_OUTPUT_FORMAT,
-          GST_OMX_AAC_ENC_OUTPUT_FORMAT_DEFAULT, G_PARAM_READWRITE));
-
+          GST_OMX_AAC_ENC_OUTPUT_FORMAT_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
+  g_object_class_install_property (gobject_class, PROP_FRAMES_PER_BUFFER,
+      g_param_spec_uint ("frames-per-buffer", "Frames per buffer",
+          "Number of AAC frames of 1024 samples per channel gathered in each "
+          "input buffer sent to the encoder",
+          1, 16, GST_OMX_AAC_ENC_FRAMES_PER_BUFFER_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
 
   gstomxbase_class->parse_caps = GST_DEBUG_FUNCPTR (gst_omx_aac_enc_set_caps);
   gstomxbase_class->omx_fill_buffer =
@@ -209,6 +231,12 @@ gst_omx_aac_enc_init (GstOmxAACEnc * this)
   this->bitrate = GST_OMX_AAC_ENC_BITRATE_DEFAULT;
   this->profile = GST_OMX_AAC_ENC_PROFILE_DEFAULT;
   this->output_format = GST_OMX_AAC_ENC_OUTPUT_FORMAT_DEFAULT;
+  this->frames_per_buffer = GST_OMX_AAC_ENC_FRAMES_PER_BUFFER_DEFAULT;
+
+  this->adapter = gst_adapter_new ();
+  this->timestamp = GST_CLOCK_TIME_NONE;
+  this->samples = 0;
+  this->chunk = gst_omx_aac_enc_chunk_size (this);
   /*Set Audio flag */
   base->output_buffers = 1;
   base->input_buffers = 1;
@@ -218,6 +246,18 @@ gst_omx_aac_enc_init (GstOmxAACEnc * this)
           (&sink_template), "sink"));
   gst_pad_set_active (this->sinkpad, TRUE);
   gst_omx_base_add_pad (GST_OMX_BASE (this), this->sinkpad);
+  /* Input is gathered into whole frames before reaching the base class */
+  this->base_chain = GST_PAD_CHAINFUNC (this->sinkpad);
+  this->base_event = GST_PAD_EVENTFUNC (this->sinkpad);
+  gst_pad_set_chain_function (this->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_omx_aac_enc_chain));
+  gst_pad_set_chain_list_function (this->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_omx_aac_enc_chain_list));
+  gst_pad_set_event_function (this->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_omx_aac_enc_event));
+  /* The adapter may hold on to the only input buffer while waiting for a
+   * whole frame, so upstream can't be lent the port buffers */
+  gst_pad_set_bufferalloc_function (this->sinkpad, NULL);
   gst_element_add_pad (GST_ELEMENT (this), this->sinkpad);
 
   this->srcpad =
@@ -248,6 +288,11 @@ gst_omx_aac_enc_set_property (GObject * object, guint prop_id,
       GST_INFO_OBJECT (this, "Setting output format to %d",
           this->output_format);
       break;
+    case PROP_FRAMES_PER_BUFFER:
+      this->frames_per_buffer = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting frames per buffer to %u",
+          this->frames_per_buffer);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -271,6 +316,9 @@ gst_omx_aac_enc_get_property (GObject * object, guint prop_id,
     case PROP_OUTPUT_FORMAT:
       g_value_set_enum (value, this->output_format);
       break;
+    case PROP_FRAMES_PER_BUFFER:
+      g_value_set_uint (value, this->frames_per_buffer);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -319,6 +367,11 @@ gst_omx_aac_enc_set_caps (GstPad * pad, GstCaps * caps)
       "\tRate:  %u\n"
       "\tChannels %u\n", this->format.rate, this->format.channels);
 
+  /* Samples gathered so far belong to the previous format */
+  gst_adapter_clear (this->adapter);
+  this->timestamp = GST_CLOCK_TIME_NONE;
+  this->samples = 0;
+
   /* Ask for the output caps, if not fixed then try the biggest frame */
   allowedcaps = gst_pad_get_allowed_caps (this->srcpad);
   newcaps = gst_caps_make_writable (gst_caps_copy_nth (allowedcaps, 0));
@@ -445,22 +498,25 @@ gst_omx_aac_enc_init_pads (GstOmxBase * base)
 
   port->nPortIndex = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_GetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "input";
     goto noport;
   }
 
   port->nBufferCountActual = base->input_buffers;
-  port->nBufferSize = 4096;     /*  4096 Recommended buffer size */
+  /* 4096 Recommended buffer size, or as much as the gathered frames. The
+   * chunk is kept so later frames-per-buffer changes can't overflow it */
+  this->chunk = gst_omx_aac_enc_chunk_size (this);
+  port->nBufferSize = MAX (4096, this->chunk);
   port->format.audio.eEncoding = OMX_AUDIO_CodingPCM;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "input";
     goto noport;
@@ -477,10 +533,10 @@ gst_omx_aac_enc_init_pads (GstOmxBase * base)
 
   port->nPortIndex = 1;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_GetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "output";
     goto noport;
@@ -489,11 +545,11 @@ gst_omx_aac_enc_init_pads (GstOmxBase * base)
   port->nBufferCountActual = base->output_buffers;
   port->nBufferSize = 4608;     /* 4608 Recommended buffer size */
   port->format.audio.eEncoding = OMX_AUDIO_CodingAAC;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   if (error != OMX_ErrorNone) {
     portname = "output";
@@ -513,9 +569,9 @@ gst_omx_aac_enc_init_pads (GstOmxBase * base)
     goto noconfiguration;
 
   GST_INFO_OBJECT (this, "Enabling input port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable, 0, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
 
   GST_INFO_OBJECT (this, "Waiting for input port to enable");
@@ -526,9 +582,9 @@ gst_omx_aac_enc_init_pads (GstOmxBase * base)
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling output port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable, 1, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for output port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -579,18 +635,18 @@ gst_omx_aac_enc_parameters (GstOmxAACEnc * this, GstOmxFormat * format)
   GST_OMX_INIT_STRUCT (&pcm_param, OMX_AUDIO_PARAM_PCMMODETYPE);
   pcm_param.nPortIndex = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle, (OMX_INDEXTYPE) OMX_IndexParamAudioPcm,
       &pcm_param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
 
   pcm_param.nSamplingRate = this->rate;
   pcm_param.nChannels = this->channels;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (base->handle, OMX_IndexParamAudioPcm, &pcm_param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noPCMParams;
 
@@ -604,9 +660,9 @@ gst_omx_aac_enc_parameters (GstOmxAACEnc * this, GstOmxFormat * format)
 
   GST_OMX_INIT_STRUCT (&aac_param, OMX_AUDIO_PARAM_AACPROFILETYPE);
   aac_param.nPortIndex = 1;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle, OMX_IndexParamAudioAac, &aac_param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   aac_param.nSampleRate = this->rate;
   aac_param.nChannels = this->channels;
@@ -615,9 +671,9 @@ gst_omx_aac_enc_parameters (GstOmxAACEnc * this, GstOmxFormat * format)
   aac_param.eAACStreamFormat = this->output_format;
 
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (base->handle, OMX_IndexParamAudioAac, &aac_param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noAACParams;
 
@@ -649,20 +705,10 @@ gst_omx_aac_enc_fill_callback (GstOmxBase * base, OMX_BUFFERHEADERTYPE * outbuf)
 
   GST_LOG_OBJECT (this, "AAC Encoder Fill buffer callback");
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
   if (!buffer)
-    goto noalloc;
-
-  GST_BUFFER_SIZE (buffer) = outbuf->nFilledLen;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
+    goto nocaps;
 
   /* Make buffer fields GStreamer friendly */
   GST_BUFFER_TIMESTAMP (buffer) = outbuf->nTimeStamp;
@@ -684,12 +730,6 @@ gst_omx_aac_enc_fill_callback (GstOmxBase * base, OMX_BUFFERHEADERTYPE * outbuf)
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
@@ -701,3 +741,127 @@ nopush:
     return ret;
   }
 }
+
+static void
+gst_omx_aac_enc_finalize (GObject * object)
+{
+  GstOmxAACEnc *this = GST_OMX_AAC_ENC (object);
+
+  g_object_unref (this->adapter);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* Bytes of PCM sent to the encoder on each input buffer */
+static guint
+gst_omx_aac_enc_chunk_size (GstOmxAACEnc * this)
+{
+  return this->frames_per_buffer * GST_OMX_AAC_ENC_FRAME_SAMPLES *
+      MAX (this->channels, 1) * GST_OMX_AAC_ENC_SAMPLE_SIZE;
+}
+
+/* Sends every whole chunk in the adapter to the base class, and the
+ * remaining samples too when draining. The timestamps are interpolated
+ * from the first sample gathered */
+static GstFlowReturn
+gst_omx_aac_enc_push_frames (GstOmxAACEnc * this, gboolean drain)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *buf;
+  guint chunk, size, bpf;
+  guint64 samples;
+
+  chunk = this->chunk;
+  bpf = MAX (this->channels, 1) * GST_OMX_AAC_ENC_SAMPLE_SIZE;
+
+  while (GST_FLOW_OK == ret) {
+    size = gst_adapter_available (this->adapter);
+    if (size < chunk && (!drain || !size))
+      break;
+
+    size = MIN (size, chunk);
+    samples = size / bpf;
+    buf = gst_adapter_take_buffer (this->adapter, size);
+    gst_buffer_set_caps (buf, GST_PAD_CAPS (this->sinkpad));
+
+    if (GST_CLOCK_TIME_IS_VALID (this->timestamp) && this->rate > 0) {
+      GST_BUFFER_TIMESTAMP (buf) = this->timestamp +
+          gst_util_uint64_scale_int (this->samples, GST_SECOND, this->rate);
+      GST_BUFFER_DURATION (buf) =
+          gst_util_uint64_scale_int (samples, GST_SECOND, this->rate);
+    }
+    this->samples += samples;
+
+    GST_LOG_OBJECT (this, "Sending %u bytes at %" GST_TIME_FORMAT, size,
+        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
+    ret = this->base_chain (this->sinkpad, buf);
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_omx_aac_enc_chain (GstPad * pad, GstBuffer * buf)
+{
+  GstOmxAACEnc *this = GST_OMX_AAC_ENC (GST_OBJECT_PARENT (pad));
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  /* A gap in the input restarts the interpolation */
+  if (GST_BUFFER_IS_DISCONT (buf) && gst_adapter_available (this->adapter)) {
+    GST_DEBUG_OBJECT (this, "Discontinuity, draining gathered samples");
+    ret = gst_omx_aac_enc_push_frames (this, TRUE);
+  }
+
+  if (!gst_adapter_available (this->adapter)) {
+    this->timestamp = GST_BUFFER_TIMESTAMP (buf);
+    this->samples = 0;
+  }
+
+  gst_adapter_push (this->adapter, buf);
+
+  if (GST_FLOW_OK != ret)
+    return ret;
+
+  return gst_omx_aac_enc_push_frames (this, FALSE);
+}
+
+static GstFlowReturn
+gst_omx_aac_enc_chain_list (GstPad * pad, GstBufferList * list)
+{
+  GstBufferListIterator *it;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *buf;
+
+  it = gst_buffer_list_iterate (list);
+  while (GST_FLOW_OK == ret && gst_buffer_list_iterator_next_group (it)) {
+    while (GST_FLOW_OK == ret && (buf = gst_buffer_list_iterator_next (it)))
+      ret = gst_omx_aac_enc_chain (pad, gst_buffer_ref (buf));
+  }
+  gst_buffer_list_iterator_free (it);
+  gst_buffer_list_unref (list);
+
+  return ret;
+}
+
+static gboolean
+gst_omx_aac_enc_event (GstPad * pad, GstEvent * event)
+{
+  GstOmxAACEnc *this = GST_OMX_AAC_ENC (GST_OBJECT_PARENT (pad));
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      GST_DEBUG_OBJECT (this, "Draining %u gathered bytes",
+          gst_adapter_available (this->adapter));
+      gst_omx_aac_enc_push_frames (this, TRUE);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_adapter_clear (this->adapter);
+      this->timestamp = GST_CLOCK_TIME_NONE;
+      this->samples = 0;
+      break;
+    default:
+      break;
+  }
+
+  return this->base_event (pad, event);
+}
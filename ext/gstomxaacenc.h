@@ -22,6 +22,7 @@
 #define __GST_OMX_AAC_ENC_H__
 
 #include <gst/gst.h>
+#include <gst/base/gstadapter.h>
 #include "gstomxpad.h"
 #include "gstomxbase.h"
 
@@ -52,6 +53,18 @@ struct _GstOmxAACEnc
   guint bitrate;
   gint profile;
   gint output_format;
+  guint frames_per_buffer;
+
+  /* Input gathered into whole AAC frames, see frames-per-buffer. The
+   * chunk is the size sent on each input buffer, fixed when the port is
+   * configured. The timestamp is the one of the first sample in the
+   * adapter */
+  GstAdapter *adapter;
+  guint chunk;
+  GstClockTime timestamp;
+  guint64 samples;
+  GstPadChainFunction base_chain;
+  GstPadEventFunction base_event;
 };
 
 struct _GstOmxAACEncClass
@@ -38,6 +38,8 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <gst/gst.h>
 #include <gst/controller/gstcontroller.h>
 #include <gst/video/video.h>
@@ -45,6 +47,7 @@
 #include "timm_osal_interfaces.h"
 
 #include "gstomxbase.h"
+#include "gstomxutils.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_omx_base_debug);
 #define GST_CAT_DEFAULT gst_omx_base_debug
@@ -62,12 +65,79 @@ enum
   PROP_PEER_ALLOC,
   PROP_NUM_INPUT_BUFFERS,
   PROP_NUM_OUTPUT_BUFFERS,
-  PROP_NUM_BUFFERS
+  PROP_NUM_BUFFERS,
+  PROP_GLOBAL_LOCK,
+  PROP_PUSH_MODE,
+  PROP_QUEUE_DEPTH,
+  PROP_LEAKY,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
+  PROP_LOW_WATERMARK,
+  PROP_COPY_THREADS,
+  PROP_ASYNC_START,
+  PROP_CACHE,
+  PROP_QOS
 };
 
 #define GST_OMX_BASE_NUM_INPUT_BUFFERS_DEFAULT    8
 #define GST_OMX_BASE_NUM_OUTPUT_BUFFERS_DEFAULT   8
 #define GST_OMX_BASE_NUM_BUFFERS_DEFAULT   	      0
+#define GST_OMX_BASE_PUSH_MODE_DEFAULT            GST_OMX_BASE_PUSH_MODE_CALLBACK
+#define GST_OMX_BASE_QUEUE_DEPTH_DEFAULT          0
+#define GST_OMX_BASE_LEAKY_DEFAULT                GST_OMX_BASE_LEAKY_NO
+#define GST_OMX_BASE_STATS_INTERVAL_DEFAULT       0
+#define GST_OMX_BASE_LOW_WATERMARK_DEFAULT        0
+#define GST_OMX_BASE_COPY_THREADS_DEFAULT         1
+#define GST_OMX_BASE_ASYNC_START_DEFAULT          FALSE
+#define GST_OMX_BASE_CACHE_DEFAULT                FALSE
+#define GST_OMX_BASE_QOS_DEFAULT                  TRUE
+
+/* A sink port grows when more than GROW_THRESHOLD out of GROW_PERIOD
+ * buffers had to wait for a free buffer */
+#define GST_OMX_BASE_GROW_PERIOD     32
+#define GST_OMX_BASE_GROW_THRESHOLD  8
+
+#define GST_TYPE_OMX_BASE_PUSH_MODE (gst_omx_base_push_mode_get_type ())
+static GType
+gst_omx_base_push_mode_get_type ()
+{
+  static GType type = 0;
+
+  if (!type) {
+    static const GEnumValue vals[] = {
+      {GST_OMX_BASE_PUSH_MODE_CALLBACK, "Push from the OMX callback",
+          "callback"},
+      {GST_OMX_BASE_PUSH_MODE_TASK, "Push from a task per src pad", "task"},
+      {0, NULL, NULL},
+    };
+
+    type = g_enum_register_static ("RRGstOmxBasePushMode", vals);
+  }
+
+  return type;
+}
+
+#define GST_TYPE_OMX_BASE_LEAKY (gst_omx_base_leaky_get_type ())
+static GType
+gst_omx_base_leaky_get_type ()
+{
+  static GType type = 0;
+
+  if (!type) {
+    static const GEnumValue vals[] = {
+      {GST_OMX_BASE_LEAKY_NO, "Not Leaky", "no"},
+      {GST_OMX_BASE_LEAKY_UPSTREAM, "Leaky on upstream (new buffers)",
+          "upstream"},
+      {GST_OMX_BASE_LEAKY_DOWNSTREAM, "Leaky on downstream (old buffers)",
+          "downstream"},
+      {0, NULL, NULL},
+    };
+
+    type = g_enum_register_static ("RRGstOmxBaseLeaky", vals);
+  }
+
+  return type;
+}
 
 #define gst_omx_base_parent_class parent_class
 static GstElementClass *parent_class = NULL;
@@ -114,6 +184,14 @@ static OMX_ERRORTYPE gst_omx_base_free_omx (GstOmxBase * this);
 static OMX_ERRORTYPE gst_omx_base_start (GstOmxBase * this,
     OMX_BUFFERHEADERTYPE * omxpeerbuf);
 static OMX_ERRORTYPE gst_omx_base_stop (GstOmxBase * this);
+static OMX_ERRORTYPE gst_omx_base_park (GstOmxBase * this);
+static OMX_ERRORTYPE gst_omx_base_cool (GstOmxBase * this);
+static gboolean gst_omx_base_resume (GstOmxBase * this, const gchar * key);
+static gchar *gst_omx_base_cache_key (GstOmxBase * this, GstCaps * caps);
+static void gst_omx_base_start_async (GstOmxBase * this);
+static OMX_ERRORTYPE gst_omx_base_wait_start (GstOmxBase * this);
+static OMX_ERRORTYPE gst_omx_base_announce_caps (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
 static OMX_ERRORTYPE gst_omx_base_alloc_buffers (GstOmxBase * this,
     GstOmxPad * pad, gpointer data);
 static OMX_ERRORTYPE gst_omx_base_free_buffers (GstOmxBase * this,
@@ -132,16 +210,71 @@ static OMX_ERRORTYPE gst_omx_base_push_buffers (GstOmxBase * this,
 static GstStateChangeReturn gst_omx_base_change_state (GstElement * element,
     GstStateChange transition);
 static GstFlowReturn gst_omx_base_chain (GstPad * pad, GstBuffer * buf);
+static GstFlowReturn gst_omx_base_chain_list (GstPad * pad,
+    GstBufferList * list);
 static gboolean gst_omx_base_event_handler (GstPad * pad, GstEvent * event);
+static gboolean gst_omx_base_src_event (GstPad * pad, GstEvent * event);
+static gboolean gst_omx_base_src_query (GstPad * pad, GstQuery * query);
+static gboolean gst_omx_base_is_late (GstOmxBase * this, GstBuffer * buf);
 static gboolean gst_omx_base_set_caps (GstPad * pad, GstCaps * caps);
 
-static gboolean gst_omx_base_alloc_buffer (GstPad * pad, guint64 offset,
+static GstFlowReturn gst_omx_base_alloc_buffer (GstPad * pad, guint64 offset,
     guint size, GstCaps * caps, GstBuffer ** buffer);
+static void gst_omx_base_alloc_free (gpointer data);
+
+/* Buffers handed out by gst_omx_base_alloc_buffer, upstream wrote the data
+ * straight into one of our port buffers */
+#define GST_OMX_BASE_IS_OWN_BUFFER(buf) \
+  (GST_BUFFER_FREE_FUNC (buf) == gst_omx_base_alloc_free)
+static void gst_omx_base_orphan_pad (GstOmxBase * this, GstOmxPad * pad);
+
+/* Port buffers lent to upstream, from the header to the GstBuffer holding
+ * it. Outlives the elements, upstream may release a buffer after the port
+ * it came from was freed */
+static GMutex gst_omx_base_lent_lock;
+static GHashTable *gst_omx_base_lent;
+static void gst_omx_base_publish_buffer (GstOmxBase * this,
+    GstOmxBufferData * bufdata, GstBuffer * buffer);
+static GstBuffer *gst_omx_base_wait_buffer (GstOmxBase * this,
+    GstOmxBufferData * bufdata);
 static OMX_ERRORTYPE
 gst_omx_base_flush_ports (GstOmxBase * this, GstOmxPad * pad, gpointer data);
 static OMX_ERRORTYPE
 gst_omx_base_set_flushing_pad (GstOmxBase * this, GstOmxPad * pad,
     gpointer data);
+static GstFlowReturn gst_omx_base_process_buffer (GstOmxBase * this,
+    OMX_BUFFERHEADERTYPE * outbuf);
+static void gst_omx_base_queue_buffer (GstOmxBase * this, GstOmxPad * pad,
+    OMX_BUFFERHEADERTYPE * outbuf);
+static void gst_omx_base_push_loop (gpointer data);
+static OMX_ERRORTYPE gst_omx_base_create_push_task (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_start_push_task (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_stop_push_task (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_destroy_push_task (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_drain_push_task (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static void gst_omx_base_push_done (GstOmxBase * this, GstOmxPad * pad);
+static OMX_ERRORTYPE gst_omx_base_disable_pad (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_size_pad (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_reset_copy (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_check_growth (GstOmxBase * this,
+    GstOmxPad * pad);
+static OMX_ERRORTYPE gst_omx_base_grow_pad (GstOmxBase * this,
+    GstOmxPad * pad, guint count);
+static OMX_ERRORTYPE gst_omx_base_flush_start (GstOmxBase * this);
+static OMX_ERRORTYPE gst_omx_base_flush_stop (GstOmxBase * this);
+static OMX_ERRORTYPE gst_omx_base_reconfigure (GstOmxBase * this);
+static OMX_ERRORTYPE gst_omx_base_mark_settings (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_apply_settings (GstOmxBase * this,
+    GstOmxPad * pad, gpointer data);
 
 /* GObject vmethod implementations */
 
@@ -167,6 +300,8 @@ gst_omx_base_class_init (GstOmxBaseClass * klass)
   klass->parse_caps = NULL;
   klass->parse_buffer = NULL;
   klass->init_ports = NULL;
+  klass->update_ports = NULL;
+  klass->port_changed = NULL;
 
   klass->handle_name = NULL;
 
@@ -196,16 +331,80 @@ gst_omx_base_class_init (GstOmxBaseClass * klass)
   g_object_class_install_property (gobject_class, PROP_NUM_INPUT_BUFFERS,
       g_param_spec_uint ("input-buffers", "Input buffers",
           "OMX input buffers number",
-          1, 10, GST_OMX_BASE_NUM_INPUT_BUFFERS_DEFAULT, G_PARAM_READWRITE));
+          1, 10, GST_OMX_BASE_NUM_INPUT_BUFFERS_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
 
   g_object_class_install_property (gobject_class, PROP_NUM_OUTPUT_BUFFERS,
       g_param_spec_uint ("output-buffers", "Output buffers",
           "OMX output buffers number",
-          1, 16, GST_OMX_BASE_NUM_OUTPUT_BUFFERS_DEFAULT, G_PARAM_READWRITE));
+          1, 16, GST_OMX_BASE_NUM_OUTPUT_BUFFERS_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_NUM_BUFFERS,
       g_param_spec_int ("num-buffers", "Number of buffers",
           "The number of Buffers to be processed (0 : process all buffers)",
           0, G_MAXINT, GST_OMX_BASE_NUM_BUFFERS_DEFAULT, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_GLOBAL_LOCK,
+      g_param_spec_boolean ("global-lock", "Global lock",
+          "Serialize the calls to the component with the process wide lock, "
+          "for components that are not reentrant",
+          GST_OMX_GLOBAL_LOCK_DEFAULT, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_PUSH_MODE,
+      g_param_spec_enum ("push-mode", "Push mode",
+          "Thread that pushes the output buffers downstream",
+          GST_TYPE_OMX_BASE_PUSH_MODE, GST_OMX_BASE_PUSH_MODE_DEFAULT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_uint ("queue-depth", "Queue depth",
+          "Output buffers queued per src pad in task push mode "
+          "(0 : as many as output buffers)",
+          0, G_MAXUINT, GST_OMX_BASE_QUEUE_DEPTH_DEFAULT, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_LEAKY,
+      g_param_spec_enum ("leaky", "Leaky",
+          "Where to drop buffers when the output queue is full, "
+          "no leaking blocks the component",
+          GST_TYPE_OMX_BASE_LEAKY, GST_OMX_BASE_LEAKY_DEFAULT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Frame counters, startup time and latency, input wait and output "
+          "wait min/avg/p99 in nanoseconds over the last frames",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Statistics interval",
+          "Milliseconds between element messages with the statistics "
+          "(0 : no messages)",
+          0, G_MAXUINT, GST_OMX_BASE_STATS_INTERVAL_DEFAULT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_LOW_WATERMARK,
+      g_param_spec_uint ("low-watermark", "Low watermark",
+          "Post a warning when less than this many buffers of a port are "
+          "free (0 : disabled)",
+          0, G_MAXUINT, GST_OMX_BASE_LOW_WATERMARK_DEFAULT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_COPY_THREADS,
+      g_param_spec_uint ("copy-threads", "Copy threads",
+          "Threads used to copy large non OMX input buffers, including the "
+          "streaming thread",
+          1, GST_OMX_COPY_MAX_THREADS, GST_OMX_BASE_COPY_THREADS_DEFAULT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_ASYNC_START,
+      g_param_spec_boolean ("async-start", "Asynchronous start",
+          "Start the component in the background as soon as the caps are "
+          "set, and check right away that downstream accepts the output "
+          "caps. Upstream OMX buffers are copied instead of shared",
+          GST_OMX_BASE_ASYNC_START_DEFAULT, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_CACHE,
+      g_param_spec_boolean ("cache", "Component cache",
+          "Keep the component when going to NULL and hand it to the next "
+          "element of the same kind. If the caps and properties match, it "
+          "is kept Idle with its buffers and restarts without reallocating",
+          GST_OMX_BASE_CACHE_DEFAULT, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_QOS,
+      g_param_spec_boolean ("qos", "QoS",
+          "Drop input frames that downstream QoS reports as late before "
+          "they reach the component. Only raw video and JPEG input is "
+          "dropped, other frames may be referenced by the next ones",
+          GST_OMX_BASE_QOS_DEFAULT, G_PARAM_READWRITE));
 }
 
 static OMX_ERRORTYPE
@@ -213,44 +412,52 @@ gst_omx_base_allocate_omx (GstOmxBase * this, gchar * handle_name)
 {
   OMX_ERRORTYPE error = OMX_ErrorNone;
   OMX_PORT_PARAM_TYPE init;
+  OMX_CALLBACKTYPE callbacks;
+  gboolean cached;
 
   GST_INFO_OBJECT (this, "Allocating OMX resources for %s", handle_name);
 
-  this->callbacks = TIMM_OSAL_Malloc (sizeof (OMX_CALLBACKTYPE),
-      TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_EXT);
-  if (!this->callbacks) {
-    error = OMX_ErrorInsufficientResources;
-    goto noresources;
-  }
-
-  this->callbacks->EventHandler =
-      (GstOmxEventHandler) gst_omx_base_event_callback;
-  this->callbacks->EmptyBufferDone =
+  callbacks.EventHandler = (GstOmxEventHandler) gst_omx_base_event_callback;
+  callbacks.EmptyBufferDone =
       (GstOmxEmptyBufferDone) gst_omx_base_empty_callback;
-  this->callbacks->FillBufferDone =
-      (GstOmxFillBufferDone) gst_omx_base_fill_callback;
+  callbacks.FillBufferDone = (GstOmxFillBufferDone) gst_omx_base_fill_callback;
 
   if (!handle_name) {
     error = OMX_ErrorInvalidComponentName;
     goto nohandlename;
   }
 
-  g_mutex_lock (&_omx_mutex);
-  error = OMX_GetHandle (&this->handle, handle_name, this, this->callbacks);
-  g_mutex_unlock (&_omx_mutex);
-  if ((error != OMX_ErrorNone) || (!this->handle))
+  /* Only elements that park their component take a parked one */
+  cached = FALSE;
+  if (this->cache)
+    this->entry = gst_omx_cache_get (handle_name, &callbacks, this, &cached,
+        &error);
+  else
+    this->entry = gst_omx_cache_new (handle_name, &callbacks, this, &error);
+  if (!this->entry)
     goto nohandle;
 
+  this->handle = this->entry->handle;
+  this->callbacks = &this->entry->callbacks;
   this->component = (OMX_COMPONENTTYPE *) this->handle;
 
-  if (!strstr (handle_name, "DSP")) {
+  if (strstr (handle_name, "DSP"))
+    this->audio_component = TRUE;
+
+  /* A cached component has its ports initialized already */
+  if (cached) {
+    this->state = this->entry->key ? OMX_StateIdle : OMX_StateLoaded;
+    return error;
+  }
+
+  if (!this->audio_component) {
     GST_INFO ("Video component");
     GST_OMX_INIT_STRUCT (&init, OMX_PORT_PARAM_TYPE);
     init.nPorts = 2;
     init.nStartPortNumber = 0;
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (this->omx_lock);
     error = OMX_SetParameter (this->handle, OMX_IndexParamVideoInit, &init);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (this->omx_lock);
     if (error != OMX_ErrorNone)
       goto initport;
   } else {
@@ -258,20 +465,14 @@ gst_omx_base_allocate_omx (GstOmxBase * this, gchar * handle_name)
     GST_OMX_INIT_STRUCT (&init, OMX_PORT_PARAM_TYPE);
     init.nPorts = 2;
     init.nStartPortNumber = 0;
-    this->audio_component = TRUE;
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (this->omx_lock);
     error = OMX_SetParameter (this->handle, OMX_IndexParamAudioInit, &init);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (this->omx_lock);
     if (error != OMX_ErrorNone)
       goto initport;
   }
   return error;
 
-noresources:
-  {
-    GST_ERROR_OBJECT (this, "Insufficient OMX memory resources");
-    return error;
-  }
 nohandlename:
   {
     GST_ERROR_OBJECT (this, "The component name has not been defined");
@@ -292,6 +493,8 @@ initport:
   }
 }
 
+/* Parks the component in the cache if enabled, warm if it was stopped
+ * with its buffers, or frees it */
 static OMX_ERRORTYPE
 gst_omx_base_free_omx (GstOmxBase * this)
 {
@@ -299,16 +502,32 @@ gst_omx_base_free_omx (GstOmxBase * this)
 
   GST_INFO_OBJECT (this, "Freeing OMX resources");
 
-  TIMM_OSAL_Free (this->callbacks);
+  if (!this->entry)
+    return error;
+
+  if (this->cache && (OMX_StateIdle > this->state || this->entry->key)
+      && gst_omx_cache_put (this->entry))
+    goto parked;
+
+  if (this->entry->key) {
+    error = gst_omx_base_cool (this);
+    if (GST_OMX_FAIL (error))
+      goto freehandle;
+  }
 
-  g_mutex_lock (&_omx_mutex);
-  error = OMX_FreeHandle (this->handle);
-  g_mutex_unlock (&_omx_mutex);
+  error = gst_omx_cache_free (this->entry);
+  this->entry = NULL;
   if (error != OMX_ErrorNone)
     goto freehandle;
 
   return error;
 
+parked:
+  {
+    GST_INFO_OBJECT (this, "Component kept in the cache");
+    this->entry = NULL;
+    return error;
+  }
 freehandle:
   {
     GST_ERROR_OBJECT (this, "Unable to free OMX handle: %s",
@@ -332,8 +551,9 @@ gst_omx_base_init (GstOmxBase * this, gpointer g_class)
   this->audio_component = FALSE;
   this->peer_alloc = FALSE;
   this->flushing = FALSE;
+  this->flush_emulated = FALSE;
   this->started = FALSE;
-  this->first_buffer = TRUE;
+  this->shared = FALSE;
   this->interlaced = FALSE;
 
   this->input_buffers = GST_OMX_BASE_NUM_INPUT_BUFFERS_DEFAULT;
@@ -342,12 +562,42 @@ gst_omx_base_init (GstOmxBase * this, gpointer g_class)
   this->pads = NULL;
   this->fill_ret = GST_FLOW_OK;
   this->state = OMX_StateInvalid;
+  this->empty_waiters = 0;
   g_mutex_init (&this->waitmutex);
   g_cond_init (&this->waitcond);
 
+  this->push_mode = GST_OMX_BASE_PUSH_MODE_DEFAULT;
+  this->queue_depth = GST_OMX_BASE_QUEUE_DEPTH_DEFAULT;
+  this->leaky = GST_OMX_BASE_LEAKY_DEFAULT;
+  this->push_waiters = 0;
+  g_mutex_init (&this->pushmutex);
+  g_cond_init (&this->pushcond);
+
+  this->async_start = GST_OMX_BASE_ASYNC_START_DEFAULT;
+  this->cache = GST_OMX_BASE_CACHE_DEFAULT;
+  this->qos = GST_OMX_BASE_QOS_DEFAULT;
+  this->qos_droppable = FALSE;
+  this->coalesce = GST_OMX_BASE_COALESCE_NONE;
+  this->earliest_time = GST_CLOCK_TIME_NONE;
+  gst_segment_init (&this->segment, GST_FORMAT_TIME);
+  this->cachekey = NULL;
+  this->starting = FALSE;
+  this->start_error = OMX_ErrorNone;
+  g_mutex_init (&this->startmutex);
+  g_cond_init (&this->startcond);
+
+  gst_omx_stats_init (&this->stats);
+  this->stats.interval = GST_OMX_BASE_STATS_INTERVAL_DEFAULT;
+  this->low_watermark = GST_OMX_BASE_LOW_WATERMARK_DEFAULT;
+  this->copy_threads = GST_OMX_BASE_COPY_THREADS_DEFAULT;
+
   this->num_buffers = 0;
   this->cont = 0;
 
+  this->global_lock = GST_OMX_GLOBAL_LOCK_DEFAULT;
+  g_mutex_init (&this->omx_mutex);
+  this->omx_lock = this->global_lock ? &_omx_mutex : &this->omx_mutex;
+
   g_mutex_init  (&this->num_buffers_mutex);
   g_cond_init (&this->num_buffers_cond);
 
@@ -384,6 +634,60 @@ gst_omx_base_set_property (GObject * object, guint prop_id,
       GST_INFO_OBJECT (this, "Setting num-buffers to %d",
           this->num_buffers);
       break;
+    case PROP_GLOBAL_LOCK:
+      if (this->started) {
+        GST_WARNING_OBJECT (this, "Unable to change the lock while running");
+        break;
+      }
+      this->global_lock = g_value_get_boolean (value);
+      this->omx_lock = this->global_lock ? &_omx_mutex : &this->omx_mutex;
+      GST_INFO_OBJECT (this, "Setting global-lock to %d", this->global_lock);
+      break;
+    case PROP_PUSH_MODE:
+      if (this->started) {
+        GST_WARNING_OBJECT (this, "Unable to change push-mode while running");
+        break;
+      }
+      this->push_mode = g_value_get_enum (value);
+      GST_INFO_OBJECT (this, "Setting push-mode to %d", this->push_mode);
+      break;
+    case PROP_QUEUE_DEPTH:
+      this->queue_depth = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting queue-depth to %d", this->queue_depth);
+      break;
+    case PROP_LEAKY:
+      this->leaky = g_value_get_enum (value);
+      GST_INFO_OBJECT (this, "Setting leaky to %d", this->leaky);
+      break;
+    case PROP_STATS_INTERVAL:
+      this->stats.interval = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting stats-interval to %d",
+          this->stats.interval);
+      break;
+    case PROP_LOW_WATERMARK:
+      this->low_watermark = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting low-watermark to %d",
+          this->low_watermark);
+      break;
+    case PROP_COPY_THREADS:
+      this->copy_threads = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting copy-threads to %d",
+          this->copy_threads);
+      break;
+    case PROP_ASYNC_START:
+      this->async_start = g_value_get_boolean (value);
+      GST_INFO_OBJECT (this, "Setting async-start to %d", this->async_start);
+      break;
+    case PROP_CACHE:
+      this->cache = g_value_get_boolean (value);
+      GST_INFO_OBJECT (this, "Setting cache to %d", this->cache);
+      break;
+    case PROP_QOS:
+      GST_OBJECT_LOCK (this);
+      this->qos = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (this);
+      GST_INFO_OBJECT (this, "Setting qos to %d", this->qos);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -395,6 +699,7 @@ gst_omx_base_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
   GstOmxBase *this = GST_OMX_BASE (object);
+  GstStructure *structure;
 
   switch (prop_id) {
     case PROP_PEER_ALLOC:
@@ -409,22 +714,47 @@ gst_omx_base_get_property (GObject * object, guint prop_id,
     case PROP_NUM_BUFFERS:
       g_value_set_int (value, this->num_buffers);
       break;
+    case PROP_GLOBAL_LOCK:
+      g_value_set_boolean (value, this->global_lock);
+      break;
+    case PROP_PUSH_MODE:
+      g_value_set_enum (value, this->push_mode);
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint (value, this->queue_depth);
+      break;
+    case PROP_LEAKY:
+      g_value_set_enum (value, this->leaky);
+      break;
+    case PROP_STATS:
+      structure = gst_omx_stats_get_structure (&this->stats);
+      g_list_foreach (this->pads, gst_omx_pad_append_stats, structure);
+      g_value_take_boxed (value, structure);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, this->stats.interval);
+      break;
+    case PROP_LOW_WATERMARK:
+      g_value_set_uint (value, this->low_watermark);
+      break;
+    case PROP_COPY_THREADS:
+      g_value_set_uint (value, this->copy_threads);
+      break;
+    case PROP_ASYNC_START:
+      g_value_set_boolean (value, this->async_start);
+      break;
+    case PROP_CACHE:
+      g_value_set_boolean (value, this->cache);
+      break;
+    case PROP_QOS:
+      g_value_set_boolean (value, this->qos);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
-static void
-gst_omx_base_mark_free (gpointer data, gpointer user_data)
-{
-  GstOmxBufTab *buftab = (GstOmxBufTab *) user_data;
-  GstOmxBufTabNode *node = (GstOmxBufTabNode *) data;
-
-  GST_DEBUG ("Marking %p as free ", node->buffer);
-  gst_omx_buf_tab_return_buffer (buftab, node->buffer);
-}
-
 static GstFlowReturn
 gst_omx_base_chain (GstPad * pad, GstBuffer * buf)
 {
@@ -436,6 +766,8 @@ gst_omx_base_chain (GstPad * pad, GstBuffer * buf)
   GstOmxPad *omxpad = GST_OMX_PAD (pad);
   GstOmxBufferData *bufdata = NULL;
   gboolean flushing;
+  gint64 entry;
+  guint filled = 0;
 
   GST_OBJECT_LOCK (this);
   flushing = this->flushing;
@@ -448,7 +780,13 @@ gst_omx_base_chain (GstPad * pad, GstBuffer * buf)
     goto pusherror;
 
   if (!this->started) {
-    if (GST_OMX_IS_OMX_BUFFER (buf)) {
+    error = gst_omx_base_wait_start (this);
+    if (GST_OMX_FAIL (error))
+      goto nostart;
+  }
+
+  if (!this->started) {
+    if (GST_OMX_IS_OMX_BUFFER (buf) && !GST_OMX_BASE_IS_OWN_BUFFER (buf)) {
       GST_INFO_OBJECT (this, "Sharing upstream peer buffers");
       if (buf->parent != NULL) {
 		omxpeerbuf = (OMX_BUFFERHEADERTYPE *) GST_BUFFER_MALLOCDATA (buf->parent);
@@ -463,16 +801,25 @@ gst_omx_base_chain (GstPad * pad, GstBuffer * buf)
       goto nostart;
   }
 
-  /* If an upstream asked for buffer allocations, we may have buffers
-     marked as busy even though no buffers have been processed yet. This
-     is the time to mark them as free and start the steady state */
-  if (this->first_buffer) {
-    g_list_foreach (omxpad->buffers->table, gst_omx_base_mark_free,
-        omxpad->buffers);
-    this->first_buffer = FALSE;
-  }
+  /* Ports whose settings the component changed, if any */
+  error = gst_omx_base_for_each_pad (this, gst_omx_base_apply_settings,
+      GST_PAD_UNKNOWN, NULL);
+  if (GST_OMX_FAIL (error))
+    goto nosettings;
+
+  /* Before the input is copied or reaches the component */
+  if (gst_omx_base_is_late (this, buf))
+    goto late;
 
-  if (GST_OMX_IS_OMX_BUFFER (buf)) {
+  entry = g_get_monotonic_time ();
+
+  if (GST_OMX_BASE_IS_OWN_BUFFER (buf)) {
+    /* Already marked as used when it was allocated */
+    omxbuf = (OMX_BUFFERHEADERTYPE *) GST_BUFFER_MALLOCDATA (buf);
+    GST_LOG_OBJECT (this, "Received one of our buffers %p->%p", omxbuf,
+        omxbuf->pBuffer);
+    filled = GST_BUFFER_SIZE (buf);
+  } else if (GST_OMX_IS_OMX_BUFFER (buf) && this->shared) {
 
     if (buf->parent != NULL) {
       omxpeerbuf = (OMX_BUFFERHEADERTYPE *) GST_BUFFER_MALLOCDATA (buf->parent);
@@ -494,28 +841,39 @@ gst_omx_base_chain (GstPad * pad, GstBuffer * buf)
     gst_omx_buf_tab_use_buffer (omxpad->buffers, omxbuf);
   } else {
 
-    GST_LOG_OBJECT (this, "Not an OMX buffer, requesting a free buffer");
+    GST_LOG_OBJECT (this, "Not a shared buffer, requesting a free buffer");
+    error = gst_omx_base_check_growth (this, omxpad);
+    if (GST_OMX_FAIL (error))
+      goto nogrow;
     error = gst_omx_buf_tab_get_free_buffer (omxpad->buffers, &omxbuf);
+    if (OMX_ErrorNotReady == error)
+      goto cancelled;
     if (GST_OMX_FAIL (error))
       goto nofreebuffer;
     gst_omx_buf_tab_use_buffer (omxpad->buffers, omxbuf);
     GST_LOG_OBJECT (this, "Received buffer %p, copying data", omxbuf);
-    memcpy (omxbuf->pBuffer, GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf));
+    /* Fields are split by the component, keep interlaced frames as is */
+    if (!omxpad->copy.configured && !this->interlaced)
+      gst_omx_copy_configure (&omxpad->copy, GST_PAD_CAPS (pad),
+          GST_OMX_PAD_PORT (omxpad));
+    filled = gst_omx_copy_buffer (&omxpad->copy, omxbuf, buf,
+        this->copy_threads);
   }
 
   if (omxpeerbuf != NULL) {
     omxbuf->nFilledLen = omxpeerbuf->nFilledLen;
     omxbuf->nOffset = omxpeerbuf->nOffset;
   } else {
-    omxbuf->nFilledLen = GST_BUFFER_SIZE (buf);
+    omxbuf->nFilledLen = filled;
     omxbuf->nOffset = 0;
   }
   omxbuf->nTimeStamp = GST_BUFFER_TIMESTAMP (buf);
 
   bufdata = (GstOmxBufferData *) omxbuf->pAppPrivate;
-/* We need to grab a reference for the buffer since EmptyThisBuffer callback might 
-return before we check if the buffer is interlaced */
-  bufdata->buffer = gst_buffer_ref (buf);
+  /* We need to grab a reference for the buffer since EmptyThisBuffer callback
+   * might return before we check if the buffer is interlaced. It must be
+   * published before EmptyThisBuffer so the callback can release it. */
+  gst_omx_base_publish_buffer (this, bufdata, gst_buffer_ref (buf));
 
   if (this->interlaced)
     omxbuf->nFlags = OMX_TI_BUFFERFLAG_VIDEO_FRAME_TYPE_INTERLACE;
@@ -523,16 +881,17 @@ return before we check if the buffer is interlaced */
 
   GST_LOG_OBJECT (this, "Emptying buffer %d %p %p->%p", bufdata->id, bufdata,
       omxbuf, omxbuf->pBuffer);
-  g_mutex_lock (&_omx_mutex);
+  gst_omx_stats_frame_in (&this->stats, omxbuf, entry);
+  g_mutex_lock (this->omx_lock);
   error = this->component->EmptyThisBuffer (this->handle, omxbuf);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error)) {
     goto noempty;
   }
 
   if (this->interlaced && GST_OMX_IS_OMX_BUFFER (buf)) {
     OMX_BUFFERHEADERTYPE tmpbuf;
-    gint tmpid;
+    guint tmpid;
     tmpbuf.pBuffer = omxbuf->pBuffer + this->field_offset;
 
     GST_LOG_OBJECT (this, "Getting bottom field buffer  %p->%p", &tmpbuf,
@@ -568,15 +927,14 @@ return before we check if the buffer is interlaced */
     omxbuf->nFlags = OMX_TI_BUFFERFLAG_VIDEO_FRAME_TYPE_INTERLACE |
         OMX_TI_BUFFERFLAG_VIDEO_FRAME_TYPE_INTERLACE_BOTTOM;
     bufdata = (GstOmxBufferData *) omxbuf->pAppPrivate;
-    bufdata->buffer = gst_buffer_ref (buf);
+    gst_omx_base_publish_buffer (this, bufdata, gst_buffer_ref (buf));
 
     GST_LOG_OBJECT (this, "Emptying buffer %d %p %p->%p", bufdata->id, bufdata,
         omxbuf, omxbuf->pBuffer);
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (this->omx_lock);
     error = this->component->EmptyThisBuffer (this->handle, omxbuf);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (this->omx_lock);
     if (GST_OMX_FAIL (error)) {
-      gst_buffer_unref (buf);
       goto noempty;
     }
   }
@@ -606,6 +964,27 @@ nostart:
     gst_buffer_unref (buf);
     return GST_FLOW_ERROR;
   }
+late:
+  {
+    GST_LOG_OBJECT (this, "Dropping late buffer %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
+    gst_omx_stats_frame_late (&this->stats);
+    gst_buffer_unref (buf);
+    return GST_FLOW_OK;
+  }
+cancelled:
+  {
+    GST_DEBUG_OBJECT (this, "Flushing while waiting for a free buffer");
+    gst_buffer_unref (buf);
+    return GST_FLOW_WRONG_STATE;
+  }
+nosettings:
+  {
+    GST_ERROR_OBJECT (this, "Unable to apply new port settings: %s",
+        gst_omx_error_to_str (error));
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
 notfound:
   {
     GST_ERROR_OBJECT (this,
@@ -621,8 +1000,17 @@ nofreebuffer:
     GList *buffers;
     OMX_BUFFERHEADERTYPE *buffer;
     GstOmxBufTabNode *node;
+    GstStructure *padstats;
+    gchar *padstring;
     gint j = 0;
 
+    padstats = gst_omx_buf_tab_get_structure (omxpad->buffers);
+    padstring = gst_structure_to_string (padstats);
+    GST_ERROR_OBJECT (this, "Buffer usage of %s:%s: %s",
+        GST_DEBUG_PAD_NAME (omxpad), padstring);
+    g_free (padstring);
+    gst_structure_free (padstats);
+
     buffers = omxpad->buffers->table;
     GST_ERROR_OBJECT (this, "Printing list of buffers");
     while (buffers) {
@@ -638,16 +1026,312 @@ nofreebuffer:
     gst_buffer_unref (buf);
     return GST_FLOW_WRONG_STATE;
   }
+nogrow:
+  {
+    GST_ELEMENT_ERROR (this, LIBRARY, SETTINGS,
+        ("Unable to grow %s:%s buffers: %s", GST_DEBUG_PAD_NAME (omxpad),
+            gst_omx_error_to_str (error)), (NULL));
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
 noempty:
   {
     GST_ELEMENT_ERROR (this, LIBRARY, ENCODE, (gst_omx_error_to_str (error)),
         (NULL));
+    g_atomic_pointer_set (&bufdata->buffer, NULL);
+    gst_omx_buf_tab_return_buffer (omxpad->buffers, omxbuf);
     gst_buffer_unref (buf);
     gst_buffer_unref (buf);     /*If Empty this buffer is not successful we have to unref the buffer manually */
     return GST_FLOW_ERROR;
   }
 }
 
+/* Consecutive buffers of a chained list, packed into one input buffer */
+typedef struct
+{
+  guint first;
+  guint count;
+  guint size;
+} GstOmxBaseRun;
+
+typedef struct
+{
+  GPtrArray *buffers;
+  GArray *groups;
+  gboolean shared;
+} GstOmxBaseListData;
+
+static GstBufferListItem
+gst_omx_base_collect_group (GstBuffer ** buffer, guint group, guint idx,
+    gpointer user_data)
+{
+  GstOmxBaseListData *data = (GstOmxBaseListData *) user_data;
+  GstOmxBaseRun *run;
+
+  if (0 == idx) {
+    g_array_set_size (data->groups, data->groups->len + 1);
+    run = &g_array_index (data->groups, GstOmxBaseRun, data->groups->len - 1);
+    run->first = data->buffers->len;
+  }
+
+  run = &g_array_index (data->groups, GstOmxBaseRun, data->groups->len - 1);
+  run->count++;
+  run->size += GST_BUFFER_SIZE (*buffer);
+
+  if (GST_OMX_IS_OMX_BUFFER (*buffer) || GST_OMX_BASE_IS_OWN_BUFFER (*buffer))
+    data->shared = TRUE;
+  g_ptr_array_add (data->buffers, *buffer);
+
+  return GST_BUFFER_LIST_CONTINUE;
+}
+
+static gboolean
+gst_omx_base_can_coalesce (GstOmxBase * this, GPtrArray * buffers,
+    GstOmxBaseRun * run, GstOmxBaseRun * group, guint maxsize)
+{
+  GstClockTime runtime, grouptime;
+
+  if (run->size + group->size > maxsize)
+    return FALSE;
+
+  if (GST_OMX_BASE_COALESCE_STREAM == this->coalesce)
+    return TRUE;
+
+  runtime = GST_BUFFER_TIMESTAMP (g_ptr_array_index (buffers, run->first));
+  grouptime = GST_BUFFER_TIMESTAMP (g_ptr_array_index (buffers, group->first));
+
+  return GST_CLOCK_TIME_IS_VALID (runtime) && runtime == grouptime;
+}
+
+/* Hands every group of the list to the chain function as a single buffer */
+static GstFlowReturn
+gst_omx_base_chain_groups (GstPad * pad, GstBufferList * list)
+{
+  GstBufferListIterator *it;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *buf;
+
+  it = gst_buffer_list_iterate (list);
+  while (GST_FLOW_OK == ret && gst_buffer_list_iterator_next_group (it)) {
+    if (1 == gst_buffer_list_iterator_n_buffers (it))
+      buf = gst_buffer_ref (gst_buffer_list_iterator_next (it));
+    else
+      buf = gst_buffer_list_iterator_merge_group (it);
+    if (buf)
+      ret = gst_omx_base_chain (pad, buf);
+  }
+  gst_buffer_list_iterator_free (it);
+  gst_buffer_list_unref (list);
+
+  return ret;
+}
+
+/* Takes the locks and the free buffers once per list instead of once per
+ * buffer, packing consecutive groups into a port buffer when the sink caps
+ * allow it. Everything else goes group by group through the chain function */
+static GstFlowReturn
+gst_omx_base_chain_list (GstPad * pad, GstBufferList * list)
+{
+  GstOmxBase *this = GST_OMX_BASE (GST_OBJECT_PARENT (pad));
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_BUFFERHEADERTYPE **omxbufs = NULL;
+  GstOmxPad *omxpad = GST_OMX_PAD (pad);
+  GstOmxBufferData *bufdata;
+  GstOmxBaseListData data;
+  GstOmxBaseRun *runs, *run;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *buf;
+  gboolean flushing;
+  guint i, j, k, taken = 0, numruns, maxsize, filled, size;
+  gint64 entry;
+
+  GST_OBJECT_LOCK (this);
+  flushing = this->flushing;
+  GST_OBJECT_UNLOCK (this);
+
+  if (flushing)
+    goto flushing;
+
+  if (this->fill_ret)
+    goto pusherror;
+
+  if (!this->started) {
+    error = gst_omx_base_wait_start (this);
+    if (GST_OMX_FAIL (error))
+      goto nostart;
+  }
+
+  /* The first buffer starts the component, frames are never packed */
+  if (!this->started || this->shared
+      || GST_OMX_BASE_COALESCE_NONE == this->coalesce)
+    return gst_omx_base_chain_groups (pad, list);
+
+  data.buffers = g_ptr_array_new ();
+  data.groups = g_array_new (FALSE, TRUE, sizeof (GstOmxBaseRun));
+  data.shared = FALSE;
+  gst_buffer_list_foreach (list, gst_omx_base_collect_group, &data);
+
+  if (data.shared)
+    goto unpacked;
+
+  error = gst_omx_base_for_each_pad (this, gst_omx_base_apply_settings,
+      GST_PAD_UNKNOWN, NULL);
+  if (GST_OMX_FAIL (error))
+    goto nosettings;
+
+  /* Merge the groups into runs in place, runs never outgrow the groups */
+  maxsize = GST_OMX_PAD_PORT (omxpad)->nBufferSize;
+  runs = (GstOmxBaseRun *) data.groups->data;
+  numruns = 0;
+  for (i = 0; i < data.groups->len; ++i) {
+    if (numruns && gst_omx_base_can_coalesce (this, data.buffers,
+            &runs[numruns - 1], &runs[i], maxsize)) {
+      runs[numruns - 1].count += runs[i].count;
+      runs[numruns - 1].size += runs[i].size;
+    } else {
+      runs[numruns++] = runs[i];
+    }
+  }
+
+  GST_LOG_OBJECT (this, "Packing %u buffers in %u groups into %u buffers",
+      data.buffers->len, data.groups->len, numruns);
+
+  omxbufs = g_new (OMX_BUFFERHEADERTYPE *, MAX (numruns, 1));
+  for (i = 0; i < numruns; i += taken) {
+    error = gst_omx_base_check_growth (this, omxpad);
+    if (GST_OMX_FAIL (error))
+      goto nogrow;
+
+    taken = gst_omx_buf_tab_use_free_buffers (omxpad->buffers, omxbufs,
+        numruns - i);
+    if (!taken) {
+      error = gst_omx_buf_tab_get_free_buffer (omxpad->buffers, &omxbufs[0]);
+      if (OMX_ErrorNotReady == error)
+        goto cancelled;
+      if (GST_OMX_FAIL (error))
+        goto nofreebuffer;
+      gst_omx_buf_tab_use_buffer (omxpad->buffers, omxbufs[0]);
+      taken = 1;
+    }
+
+    entry = g_get_monotonic_time ();
+    for (j = 0; j < taken; ++j) {
+      run = &runs[i + j];
+      if (run->size > omxbufs[j]->nAllocLen)
+        GST_WARNING_OBJECT (this, "Truncating group of %u bytes to %u",
+            run->size, (guint) omxbufs[j]->nAllocLen);
+
+      filled = 0;
+      for (k = 0; k < run->count; ++k) {
+        buf = g_ptr_array_index (data.buffers, run->first + k);
+        size = MIN (GST_BUFFER_SIZE (buf), omxbufs[j]->nAllocLen - filled);
+        memcpy (omxbufs[j]->pBuffer + filled, GST_BUFFER_DATA (buf), size);
+        filled += size;
+      }
+
+      buf = g_ptr_array_index (data.buffers, run->first);
+      omxbufs[j]->nFilledLen = filled;
+      omxbufs[j]->nOffset = 0;
+      omxbufs[j]->nTimeStamp = GST_BUFFER_TIMESTAMP (buf);
+
+      /* The data was copied, the first buffer only keeps the slot busy
+       * until the component is done with it */
+      bufdata = (GstOmxBufferData *) omxbufs[j]->pAppPrivate;
+      gst_omx_base_publish_buffer (this, bufdata, gst_buffer_ref (buf));
+      gst_omx_stats_frame_in (&this->stats, omxbufs[j], entry);
+    }
+
+    g_mutex_lock (this->omx_lock);
+    for (j = 0; j < taken && !GST_OMX_FAIL (error); ++j) {
+      GST_LOG_OBJECT (this, "Emptying buffer %p->%p", omxbufs[j],
+          omxbufs[j]->pBuffer);
+      error = this->component->EmptyThisBuffer (this->handle, omxbufs[j]);
+    }
+    g_mutex_unlock (this->omx_lock);
+    if (GST_OMX_FAIL (error))
+      goto noempty;
+  }
+
+done:
+  g_free (omxbufs);
+  g_ptr_array_free (data.buffers, TRUE);
+  g_array_free (data.groups, TRUE);
+  gst_buffer_list_unref (list);
+  return ret;
+
+flushing:
+  {
+    GST_DEBUG_OBJECT (this, "Discarding buffer list while flushing");
+    gst_buffer_list_unref (list);
+    return GST_FLOW_OK;
+  }
+pusherror:
+  {
+    GST_LOG_OBJECT (this, "Dropping buffer list, push error %s",
+        gst_flow_get_name (this->fill_ret));
+    gst_buffer_list_unref (list);
+    return this->fill_ret;
+  }
+nostart:
+  {
+    GST_ERROR_OBJECT (this, "Unable to start component: %s",
+        gst_omx_error_to_str (error));
+    gst_buffer_list_unref (list);
+    return GST_FLOW_ERROR;
+  }
+unpacked:
+  {
+    GST_LOG_OBJECT (this, "List carries port buffers, not packing it");
+    g_ptr_array_free (data.buffers, TRUE);
+    g_array_free (data.groups, TRUE);
+    return gst_omx_base_chain_groups (pad, list);
+  }
+nosettings:
+  {
+    GST_ERROR_OBJECT (this, "Unable to apply new port settings: %s",
+        gst_omx_error_to_str (error));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+nogrow:
+  {
+    GST_ELEMENT_ERROR (this, LIBRARY, SETTINGS,
+        ("Unable to grow %s:%s buffers: %s", GST_DEBUG_PAD_NAME (omxpad),
+            gst_omx_error_to_str (error)), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+cancelled:
+  {
+    GST_DEBUG_OBJECT (this, "Flushing while waiting for a free buffer");
+    ret = GST_FLOW_WRONG_STATE;
+    goto done;
+  }
+nofreebuffer:
+  {
+    GST_ERROR_OBJECT (this, "Unable to get a free buffer: %s",
+        gst_omx_error_to_str (error));
+    ret = GST_FLOW_WRONG_STATE;
+    goto done;
+  }
+noempty:
+  {
+    GST_ELEMENT_ERROR (this, LIBRARY, ENCODE, (gst_omx_error_to_str (error)),
+        (NULL));
+    /* The failed buffer and the ones after it never reached the component */
+    for (k = j - 1; k < taken; ++k) {
+      bufdata = (GstOmxBufferData *) omxbufs[k]->pAppPrivate;
+      buf = g_atomic_pointer_get (&bufdata->buffer);
+      g_atomic_pointer_set (&bufdata->buffer, NULL);
+      gst_omx_buf_tab_return_buffer (omxpad->buffers, omxbufs[k]);
+      if (buf)
+        gst_buffer_unref (buf);
+    }
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+}
+
 static void
 gst_omx_base_finalize (GObject * object)
 {
@@ -655,8 +1339,10 @@ gst_omx_base_finalize (GObject * object)
 
   GST_INFO_OBJECT (this, "Finalizing %s", GST_OBJECT_NAME (this));
 
-  g_list_free_full (this->pads, gst_object_unref);
+  /* Unloading a cached component may still use the pads */
   gst_omx_base_free_omx (this);
+  g_list_free_full (this->pads, gst_object_unref);
+  g_free (this->cachekey);
 
   g_mutex_clear  (&this->num_buffers_mutex);
   g_cond_clear (&this->num_buffers_cond);
@@ -664,6 +1350,16 @@ gst_omx_base_finalize (GObject * object)
   g_mutex_clear (&this->waitmutex);
   g_cond_clear(&this->waitcond);
 
+  g_mutex_clear (&this->omx_mutex);
+
+  g_mutex_clear (&this->pushmutex);
+  g_cond_clear (&this->pushcond);
+
+  g_mutex_clear (&this->startmutex);
+  g_cond_clear (&this->startcond);
+
+  gst_omx_stats_clear (&this->stats);
+
   /* Chain up to the parent class */
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -677,6 +1373,8 @@ gst_omx_base_check_caps (GstPad * pad, GstCaps * newcaps)
   GstStructure *newstructure = NULL;
   gint width = 0, height = 0;
   gint newwidth = 0, newheight = 0;
+  gint fpsn = 0, fpsd = 1;
+  gint newfpsn = 0, newfpsd = 1;
 
   GST_LOG_OBJECT (this, "Check changes on new caps");
 
@@ -691,8 +1389,12 @@ gst_omx_base_check_caps (GstPad * pad, GstCaps * newcaps)
   gst_structure_get_int (structure, "height", &height);
   gst_structure_get_int (newstructure, "width", &newwidth);
   gst_structure_get_int (newstructure, "height", &newheight);
+  gst_structure_get_fraction (structure, "framerate", &fpsn, &fpsd);
+  gst_structure_get_fraction (newstructure, "framerate", &newfpsn, &newfpsd);
 
-  if (width != newwidth || height != newheight)
+  /* The ports carry the framerate as well */
+  if (width != newwidth || height != newheight
+      || (gint64) fpsn * newfpsd != (gint64) newfpsn * fpsd)
     goto initializeports;
   else
     goto notinitializeports;
@@ -704,7 +1406,8 @@ nocaps:
   }
 initializeports:
   {
-    GST_DEBUG_OBJECT (this, "There is a resolution change, initializing ports");
+    GST_DEBUG_OBJECT (this,
+        "There is a resolution or framerate change, initializing ports");
     return TRUE;
   }
 notinitializeports:
@@ -716,6 +1419,81 @@ notinitializeports:
 }
 
 /* vmethod implementations */
+/* Input frames nothing else depends on: raw video and JPEG. Encoders
+ * take raw video, so any of their input frames may go */
+static gboolean
+gst_omx_base_caps_droppable (GstOmxBase * this, GstCaps * caps)
+{
+  GstStructure *structure = gst_caps_get_structure (caps, 0);
+  const gchar *name = gst_structure_get_name (structure);
+
+  if (this->audio_component)
+    return FALSE;
+
+  return g_str_has_prefix (name, "video/x-raw")
+      || g_str_equal (name, "image/jpeg");
+}
+
+/* Raw PCM can be split anywhere, byte-stream video only between units of
+ * the same frame. Frames of raw video and JPEG are never packed */
+static GstOmxBaseCoalesce
+gst_omx_base_caps_coalesce (GstOmxBase * this, GstCaps * caps)
+{
+  GstStructure *structure = gst_caps_get_structure (caps, 0);
+  const gchar *name = gst_structure_get_name (structure);
+  const gchar *format;
+
+  if (g_str_has_prefix (name, "audio/x-raw"))
+    return GST_OMX_BASE_COALESCE_STREAM;
+
+  if (g_str_equal (name, "video/x-h264")) {
+    /* Without start codes the units can't be told apart once packed */
+    format = gst_structure_get_string (structure, "stream-format");
+    if (format && !g_str_equal (format, "byte-stream"))
+      return GST_OMX_BASE_COALESCE_NONE;
+    return GST_OMX_BASE_COALESCE_UNIT;
+  }
+
+  if (g_str_equal (name, "video/mpeg"))
+    return GST_OMX_BASE_COALESCE_UNIT;
+
+  return GST_OMX_BASE_COALESCE_NONE;
+}
+
+/* Identifies the port configuration the component is left with: the caps
+ * and the properties flagged GST_OMX_PARAM_PORT */
+static gchar *
+gst_omx_base_cache_key (GstOmxBase * this, GstCaps * caps)
+{
+  GString *key;
+  GParamSpec **specs;
+  GValue value = { 0, };
+  gchar *caps_str, *value_str;
+  guint i, nspecs;
+
+  caps_str = gst_caps_to_string (caps);
+  key = g_string_new (G_OBJECT_TYPE_NAME (this));
+  g_string_append_printf (key, " %s", caps_str);
+  g_free (caps_str);
+
+  specs = g_object_class_list_properties (G_OBJECT_GET_CLASS (this), &nspecs);
+  for (i = 0; i < nspecs; ++i) {
+    if (!(specs[i]->flags & GST_OMX_PARAM_PORT))
+      continue;
+
+    g_value_init (&value, specs[i]->value_type);
+    g_object_get_property (G_OBJECT (this), specs[i]->name, &value);
+    value_str = gst_value_serialize (&value);
+    g_string_append_printf (key, " %s=%s", specs[i]->name,
+        value_str ? value_str : "?");
+    g_free (value_str);
+    g_value_unset (&value);
+  }
+  g_free (specs);
+
+  return g_string_free (key, FALSE);
+}
+
 static gboolean
 gst_omx_base_set_caps (GstPad * pad, GstCaps * caps)
 {
@@ -729,12 +1507,34 @@ gst_omx_base_set_caps (GstPad * pad, GstCaps * caps)
   if (!klass->parse_caps (pad, caps))
     goto capsinvalid;
 
+  /* The copy layout is taken from the new caps on the next buffer */
+  gst_omx_copy_reset (&GST_OMX_PAD (pad)->copy);
+
+  this->qos_droppable = gst_omx_base_caps_droppable (this, caps);
+  this->coalesce = gst_omx_base_caps_coalesce (this, caps);
+
+  g_free (this->cachekey);
+  this->cachekey = gst_omx_base_cache_key (this, caps);
+  if (gst_omx_base_resume (this, this->cachekey))
+    goto ready;
+
   if (!gst_omx_base_check_caps (pad, caps))
     goto noresolutionchange;
 
   GST_INFO_OBJECT (this, "%s:%s resolution changed, calling port renegotiation",
       GST_DEBUG_PAD_NAME (pad));
-  if (OMX_StateLoaded < this->state) {
+
+  /* Let a bring-up in progress finish before touching the ports */
+  gst_omx_base_wait_start (this);
+
+  if (this->started && klass->update_ports) {
+    error = gst_omx_base_reconfigure (this);
+    if (GST_OMX_FAIL (error))
+      goto nostartstop;
+    goto ready;
+  }
+
+  if (OMX_StateLoaded < this->state) {
     GST_INFO_OBJECT (this, "Resetting component");
     error = gst_omx_base_stop (this);
     if (GST_OMX_FAIL (error))
@@ -748,6 +1548,21 @@ gst_omx_base_set_caps (GstPad * pad, GstCaps * caps)
   if (GST_OMX_FAIL (error))
     goto nopads;
 
+  error = gst_omx_base_for_each_pad (this, gst_omx_base_size_pad,
+      GST_PAD_UNKNOWN, NULL);
+  if (GST_OMX_FAIL (error))
+    goto nopads;
+
+ready:
+  gst_omx_base_for_each_pad (this, gst_omx_base_reset_copy,
+      GST_PAD_SINK, NULL);
+
+  if (this->async_start) {
+    gst_omx_base_start_async (this);
+    gst_omx_base_for_each_pad (this, gst_omx_base_announce_caps,
+        GST_PAD_SRC, NULL);
+  }
+
   GST_DEBUG_OBJECT (this, "Caps %s set successfully",
       gst_caps_to_string (caps));
   return TRUE;
@@ -793,44 +1608,55 @@ static OMX_ERRORTYPE
 gst_omx_base_start (GstOmxBase * this, OMX_BUFFERHEADERTYPE * omxpeerbuf)
 {
   OMX_ERRORTYPE error = OMX_ErrorNone;
+  gint64 begin;
 
   if (this->started)
     goto alreadystarted;
 
-  GST_INFO_OBJECT (this, "Sending handle to Idle");
-  g_mutex_lock (&_omx_mutex);
-  error = OMX_SendCommand (this->handle, OMX_CommandStateSet, OMX_StateIdle,
-      NULL);
-  g_mutex_unlock (&_omx_mutex);
-  if (GST_OMX_FAIL (error))
-    goto starthandle;
+  begin = g_get_monotonic_time ();
 
-  GST_INFO_OBJECT (this, "Allocating buffers for src ports");
-  error =
-      gst_omx_base_for_each_pad (this, gst_omx_base_alloc_buffers, GST_PAD_SRC,
-      NULL);
-  if (GST_OMX_FAIL (error))
-    goto noalloc;
+  /* A resumed component is Idle with its buffers already */
+  if (OMX_StateIdle == this->state) {
+    GST_INFO_OBJECT (this, "Handle is Idle already, using cached buffers");
+    this->shared = FALSE;
+  } else {
+    this->shared = (NULL != omxpeerbuf);
 
-  GST_INFO_OBJECT (this, "Allocating buffers for sink ports");
-  error =
-      gst_omx_base_for_each_pad (this, gst_omx_base_alloc_buffers, GST_PAD_SINK,
-      omxpeerbuf);
-  if (GST_OMX_FAIL (error))
-    goto noalloc;
+    GST_INFO_OBJECT (this, "Sending handle to Idle");
+    g_mutex_lock (this->omx_lock);
+    error = OMX_SendCommand (this->handle, OMX_CommandStateSet,
+        OMX_StateIdle, NULL);
+    g_mutex_unlock (this->omx_lock);
+    if (GST_OMX_FAIL (error))
+      goto starthandle;
 
-  GST_INFO_OBJECT (this, "Waiting for handle to become Idle");
-  error = gst_omx_base_wait_for_condition (this,
-      gst_omx_base_condition_state, (gpointer) OMX_StateIdle,
-      (gpointer) & this->state);
-  if (GST_OMX_FAIL (error))
-    goto starthandle;
+    GST_INFO_OBJECT (this, "Allocating buffers for src ports");
+    error =
+        gst_omx_base_for_each_pad (this, gst_omx_base_alloc_buffers,
+        GST_PAD_SRC, NULL);
+    if (GST_OMX_FAIL (error))
+      goto noalloc;
+
+    GST_INFO_OBJECT (this, "Allocating buffers for sink ports");
+    error =
+        gst_omx_base_for_each_pad (this, gst_omx_base_alloc_buffers,
+        GST_PAD_SINK, omxpeerbuf);
+    if (GST_OMX_FAIL (error))
+      goto noalloc;
+
+    GST_INFO_OBJECT (this, "Waiting for handle to become Idle");
+    error = gst_omx_base_wait_for_condition (this,
+        gst_omx_base_condition_state, (gpointer) OMX_StateIdle,
+        (gpointer) & this->state);
+    if (GST_OMX_FAIL (error))
+      goto starthandle;
+  }
 
   GST_INFO_OBJECT (this, "Sending handle to Executing");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   error = OMX_SendCommand (this->handle, OMX_CommandStateSet,
       OMX_StateExecuting, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto starthandle;
 
@@ -841,6 +1667,22 @@ gst_omx_base_start (GstOmxBase * this, OMX_BUFFERHEADERTYPE * omxpeerbuf)
   if (GST_OMX_FAIL (error))
     goto starthandle;
 
+  if (GST_OMX_BASE_PUSH_MODE_TASK == this->push_mode) {
+    GST_INFO_OBJECT (this, "Starting output tasks");
+    error =
+        gst_omx_base_for_each_pad (this, gst_omx_base_create_push_task,
+        GST_PAD_SRC, NULL);
+    if (GST_OMX_FAIL (error))
+      goto notask;
+    error =
+        gst_omx_base_for_each_pad (this, gst_omx_base_start_push_task,
+        GST_PAD_SRC, NULL);
+    if (GST_OMX_FAIL (error))
+      goto notask;
+  }
+
+  gst_omx_stats_reset (&this->stats);
+
   GST_INFO_OBJECT (this, "Pushing output buffers");
   error =
       gst_omx_base_for_each_pad (this, gst_omx_base_push_buffers,
@@ -848,6 +1690,10 @@ gst_omx_base_start (GstOmxBase * this, OMX_BUFFERHEADERTYPE * omxpeerbuf)
   if (GST_OMX_FAIL (error))
     goto nopush;
 
+  gst_omx_stats_set_startup (&this->stats, g_get_monotonic_time () - begin);
+  GST_INFO_OBJECT (this, "Component started in %" G_GINT64_FORMAT " us",
+      g_get_monotonic_time () - begin);
+
   this->started = TRUE;
 
   return error;
@@ -872,16 +1718,20 @@ nopush:
     GST_ERROR_OBJECT (this, "Unable to push buffer into the output port");
     return error;
   }
+notask:
+  {
+    GST_ERROR_OBJECT (this, "Unable to start the output tasks");
+    return error;
+  }
 }
 
+/* Flushes the ports and takes the component to Idle, the buffers stay
+ * allocated */
 static OMX_ERRORTYPE
-gst_omx_base_stop (GstOmxBase * this)
+gst_omx_base_idle (GstOmxBase * this)
 {
   OMX_ERRORTYPE error = OMX_ErrorNone;
 
-  if (!this->started)
-    goto alreadystopped;
-
   if (!this->flushing) {
     GST_OBJECT_LOCK (this);
     this->flushing = TRUE;
@@ -897,10 +1747,10 @@ gst_omx_base_stop (GstOmxBase * this)
     }
   }
   GST_INFO_OBJECT (this, "Sending handle to Idle");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   error = OMX_SendCommand (this->handle, OMX_CommandStateSet, OMX_StateIdle,
       NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto statechange;
 
@@ -911,11 +1761,33 @@ gst_omx_base_stop (GstOmxBase * this)
   if (GST_OMX_FAIL (error))
     goto statechange;
 
+  return error;
+
+noflush:
+  {
+    GST_ERROR_OBJECT (this, "Unable to flush port: %s",
+        gst_omx_error_to_str (error));
+    return error;
+  }
+statechange:
+  {
+    GST_ERROR_OBJECT (this, "Unable to set component state: %s",
+        gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+/* Takes an Idle component to Loaded, freeing the port buffers */
+static OMX_ERRORTYPE
+gst_omx_base_unload (GstOmxBase * this)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
   GST_INFO_OBJECT (this, "Sending handle to Loaded");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   error = OMX_SendCommand (this->handle, OMX_CommandStateSet, OMX_StateLoaded,
       NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto statechange;
 
@@ -936,30 +1808,17 @@ gst_omx_base_stop (GstOmxBase * this)
   GST_OBJECT_LOCK (this);
   this->flushing = FALSE;
   this->started = FALSE;
-  this->first_buffer = TRUE;
   this->fill_ret = FALSE;
   GST_OBJECT_UNLOCK (this);
 
   return error;
 
-alreadystopped:
-  {
-    GST_WARNING_OBJECT (this, "Component already stopped");
-    return error;
-  }
-noflush:
-  {
-    GST_ERROR_OBJECT (this, "Unable to flush port: %s",
-        gst_omx_error_to_str (error));
-    return error;
-  }
 statechange:
   {
     GST_ERROR_OBJECT (this, "Unable to set component state: %s",
         gst_omx_error_to_str (error));
     return error;
   }
-
 nofree:
   {
     GST_ERROR_OBJECT (this, "Unable to free buffers: %s",
@@ -968,160 +1827,507 @@ nofree:
   }
 }
 
-static GstStateChangeReturn
-gst_omx_base_change_state (GstElement * element, GstStateChange transition)
+static OMX_ERRORTYPE
+gst_omx_base_stop (GstOmxBase * this)
 {
-  GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
-  GstOmxBase *this = GST_OMX_BASE (element);
+  OMX_ERRORTYPE error = OMX_ErrorNone;
 
-  switch (transition) {
-    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
-      /*Start processing buffers for DSP components */
-      if (this->audio_component) {
-        GST_OBJECT_LOCK (this);
-        this->flushing = FALSE;
-        GST_OBJECT_UNLOCK (this);
-      }
-      break;
-    default:
-      break;
-  }
+  /* Let a bring-up in progress finish before tearing it down */
+  gst_omx_base_wait_start (this);
 
-  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
-  if (ret == GST_STATE_CHANGE_FAILURE)
-    return ret;
+  if (!this->started)
+    goto alreadystopped;
 
-  switch (transition) {
-    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
-      /*Dont try to push any more buffers for DSP components */
-      if (this->audio_component) {
-        GST_OBJECT_LOCK (this);
-        this->flushing = TRUE;
-        GST_OBJECT_UNLOCK (this);
-      }
-      break;
-    case GST_STATE_CHANGE_READY_TO_NULL:
-      gst_omx_base_stop (this);
-      break;
-    default:
-      break;
-  }
+  error = gst_omx_base_idle (this);
+  if (GST_OMX_FAIL (error))
+    return error;
 
-  return ret;
+  return gst_omx_base_unload (this);
+
+alreadystopped:
+  {
+    GST_WARNING_OBJECT (this, "Component already stopped");
+    return error;
+  }
 }
 
+/* Moves the buffers of an Idle component from the pads to the cache
+ * entry, so the next element with the same configuration can skip the
+ * Loaded to Idle transition */
 static OMX_ERRORTYPE
-gst_omx_base_for_each_pad (GstOmxBase * this, GstOmxBasePadFunc func,
-    GstPadDirection direction, gpointer data)
+gst_omx_base_park_buffers (GstOmxBase * this)
 {
   OMX_ERRORTYPE error = OMX_ErrorNone;
-  GstPad *pad;
+  GstOmxCacheEntry *entry = this->entry;
+  GstOmxCachePort *cport;
+  GstOmxBufTabNode *node;
+  OMX_BUFFERHEADERTYPE *buffer;
+  GstOmxPad *pad;
   GList *l;
 
+  /* Buffers still held downstream can't be handed over, the ones lent to
+   * upstream are let go */
   for (l = this->pads; l; l = l->next) {
-    pad = l->data;
-    if ((direction == GST_PAD_UNKNOWN)
-        || (direction == GST_PAD_DIRECTION (pad))) {
-      error = func (this, GST_OMX_PAD (pad), data);
-      if (GST_OMX_FAIL (error))
-        goto failed;
+    pad = GST_OMX_PAD (l->data);
+    gst_omx_base_orphan_pad (this, pad);
+    error = gst_omx_buf_tab_wait_free (pad->buffers);
+    if (GST_OMX_FAIL (error))
+      goto busy;
+  }
+
+  for (l = this->pads; l; l = l->next) {
+    pad = GST_OMX_PAD (l->data);
+
+    cport = g_new0 (GstOmxCachePort, 1);
+    cport->definition = *pad->port;
+
+    while (pad->buffers->table) {
+      node = (GstOmxBufTabNode *) pad->buffers->table->data;
+      buffer = node->buffer;
+      gst_omx_buf_tab_remove_buffer (pad->buffers, buffer);
+      cport->buffers = g_list_append (cport->buffers, buffer);
     }
+    entry->ports = g_list_append (entry->ports, cport);
+
+    GST_OBJECT_LOCK (pad);
+    pad->enabled = FALSE;
+    GST_OBJECT_UNLOCK (pad);
   }
+  entry->key = g_strdup (this->cachekey);
+
+  GST_OBJECT_LOCK (this);
+  this->flushing = FALSE;
+  this->started = FALSE;
+  this->fill_ret = FALSE;
+  GST_OBJECT_UNLOCK (this);
 
   return error;
 
-failed:
+busy:
   {
-    GST_ERROR_OBJECT (this, "Iterator failed on pad: %s:%s",
-        GST_DEBUG_PAD_NAME (pad));
+    GST_WARNING_OBJECT (this, "Buffers of %s:%s still in use: %s",
+        GST_DEBUG_PAD_NAME (GST_PAD (pad)), gst_omx_error_to_str (error));
     return error;
   }
 }
 
+/* Stop variant used when the component is going to be cached: keeps it
+ * Idle with its buffers whenever they are all owned by the element */
 static OMX_ERRORTYPE
-gst_omx_base_peer_alloc_buffer (GstOmxBase * this, GstOmxPad * pad,
-    gpointer * pbuffer, guint32 * size)
+gst_omx_base_park (GstOmxBase * this)
 {
   OMX_ERRORTYPE error = OMX_ErrorNone;
-  OMX_BUFFERHEADERTYPE *omxpeerbuffer = NULL;
 
-  GstBuffer *peerbuf = NULL;
-  GstFlowReturn ret;
+  gst_omx_base_wait_start (this);
 
-  ret =
-      gst_pad_alloc_buffer (GST_PAD (pad), 0,
-      GST_OMX_PAD_PORT (pad)->nBufferSize,
-      gst_pad_get_negotiated_caps (GST_PAD (pad)), &peerbuf);
+  if (!this->started)
+    return error;
 
-  if (GST_FLOW_OK != ret)
-    goto nodownstream;
+  error = gst_omx_base_idle (this);
+  if (GST_OMX_FAIL (error))
+    return error;
 
-  if (GST_OMX_IS_OMX_BUFFER (peerbuf)) {
-    omxpeerbuffer = (OMX_BUFFERHEADERTYPE *) GST_BUFFER_DATA (peerbuf);
-    *pbuffer = omxpeerbuffer->pBuffer;
-    *size = omxpeerbuffer->nAllocLen;
-  } else {
-    pbuffer = NULL;
-    *size = 0;
-  }
-  gst_buffer_unref (peerbuf);
+  if (this->shared || this->peer_alloc || !this->cachekey)
+    goto cold;
+
+  error = gst_omx_base_park_buffers (this);
+  if (GST_OMX_FAIL (error))
+    goto cold;
 
+  GST_INFO_OBJECT (this, "Component parked Idle with its buffers");
   return error;
 
-nodownstream:
+cold:
   {
-    GST_ERROR_OBJECT (this, "Downstream element was unable to provide buffers");
-    error = OMX_ErrorInsufficientResources;
-    return error;
+    GST_INFO_OBJECT (this, "Buffers can't be kept, unloading component");
+    return gst_omx_base_unload (this);
   }
 }
 
+/* Takes a parked entry back to Loaded, freeing the buffers it holds */
 static OMX_ERRORTYPE
-gst_omx_base_use_buffer (GstOmxBase * this, GList ** bufferlist,
-    gpointer * pbuffer, guint32 * size)
+gst_omx_base_cool (GstOmxBase * this)
 {
   OMX_ERRORTYPE error = OMX_ErrorNone;
-  OMX_BUFFERHEADERTYPE *omxpeerbuffer = NULL;
-  GList *node;
-  if (!bufferlist)
-    goto nobuffer;
+  GstOmxCacheEntry *entry = this->entry;
+  GstOmxCachePort *cport;
+  OMX_BUFFERHEADERTYPE *buffer;
+  GList *p, *b;
 
-  node = *bufferlist;
-  omxpeerbuffer = ((GstOmxBufTabNode *) node->data)->buffer;
-  *bufferlist = g_list_next (node);
-  *pbuffer = omxpeerbuffer->pBuffer;
-  *size = omxpeerbuffer->nAllocLen;
+  if (!entry->key)
+    return error;
+
+  GST_INFO_OBJECT (this, "Sending cached handle to Loaded");
+  g_mutex_lock (this->omx_lock);
+  error = OMX_SendCommand (this->handle, OMX_CommandStateSet, OMX_StateLoaded,
+      NULL);
+  g_mutex_unlock (this->omx_lock);
+  if (GST_OMX_FAIL (error))
+    goto statechange;
+
+  for (p = entry->ports; p; p = p->next) {
+    cport = (GstOmxCachePort *) p->data;
+    for (b = cport->buffers; b; b = b->next) {
+      buffer = (OMX_BUFFERHEADERTYPE *) b->data;
+      g_free (buffer->pAppPrivate);
+      g_mutex_lock (this->omx_lock);
+      error = OMX_FreeBuffer (this->handle, cport->definition.nPortIndex,
+          buffer);
+      g_mutex_unlock (this->omx_lock);
+      if (GST_OMX_FAIL (error))
+        goto nofree;
+    }
+  }
+
+  error = gst_omx_base_wait_for_condition (this,
+      gst_omx_base_condition_state, (gpointer) OMX_StateLoaded,
+      (gpointer) & this->state);
+  if (GST_OMX_FAIL (error))
+    goto statechange;
+
+  gst_omx_cache_clear_ports (entry);
 
-  GST_LOG_OBJECT (this, "Using buffer %p->%p", omxpeerbuffer, pbuffer);
   return error;
 
-nobuffer:
+statechange:
   {
-    GST_ERROR_OBJECT (this, "No buffer left on the list");
-    error = OMX_ErrorInsufficientResources;
+    GST_ERROR_OBJECT (this, "Unable to set component state: %s",
+        gst_omx_error_to_str (error));
+    return error;
+  }
+nofree:
+  {
+    GST_ERROR_OBJECT (this, "Unable to free cached buffers: %s",
+        gst_omx_error_to_str (error));
     return error;
   }
 }
 
-static OMX_ERRORTYPE
-gst_omx_base_init_use_buffer (GstOmxBase * this, GstOmxPad * pad,
-    GList ** bufferlist, OMX_BUFFERHEADERTYPE * omxpeerbuffer)
+/* Hands the parked buffers back to the pads if the entry was parked with
+ * the same configuration, otherwise unloads it so the regular bring-up
+ * can reconfigure the ports */
+static gboolean
+gst_omx_base_resume (GstOmxBase * this, const gchar * key)
 {
-  OMX_ERRORTYPE error = OMX_ErrorNone;
-  GstOmxBufferData *peerbufdata = NULL;
-  GstOmxPad *peerpad = NULL;
-  guint numbufs = pad->port->nBufferCountActual;
+  GstOmxCacheEntry *entry = this->entry;
+  GstOmxCachePort *cport;
+  GstOmxBufferData *bufdata;
+  OMX_BUFFERHEADERTYPE *buffer;
+  GstOmxPad *pad;
+  GList *l, *p, *b;
 
-  peerbufdata = (GstOmxBufferData *) omxpeerbuffer->pAppPrivate;
-  peerpad = peerbufdata->pad;
+  if (!entry->key)
+    return FALSE;
 
-  if (this->interlaced) {
-    numbufs = numbufs >> 1;
-    this->field_offset =
-        (omxpeerbuffer->nFilledLen + omxpeerbuffer->nOffset) / 3;
-  }
+  if (strcmp (entry->key, key)
+      || g_list_length (entry->ports) != g_list_length (this->pads))
+    goto mismatch;
 
-  if (numbufs > peerpad->port->nBufferCountActual) {
+  for (l = this->pads, p = entry->ports; l; l = l->next, p = p->next) {
+    pad = GST_OMX_PAD (l->data);
+    cport = (GstOmxCachePort *) p->data;
+
+    *pad->port = cport->definition;
+    gst_omx_buf_tab_set_low_watermark (pad->buffers, this->low_watermark,
+        gst_omx_pad_low_watermark, pad);
+
+    for (b = cport->buffers; b; b = b->next) {
+      buffer = (OMX_BUFFERHEADERTYPE *) b->data;
+      bufdata = (GstOmxBufferData *) buffer->pAppPrivate;
+      bufdata->pad = pad;
+      bufdata->buffer = NULL;
+      gst_omx_buf_tab_add_buffer (pad->buffers, buffer);
+    }
+
+    GST_OBJECT_LOCK (pad);
+    pad->enabled = TRUE;
+    GST_OBJECT_UNLOCK (pad);
+  }
+
+  /* The headers now belong to the pads */
+  gst_omx_cache_clear_ports (entry);
+
+  GST_INFO_OBJECT (this, "Resuming cached component");
+  return TRUE;
+
+mismatch:
+  {
+    GST_INFO_OBJECT (this, "Cached component configured differently");
+    gst_omx_base_cool (this);
+    return FALSE;
+  }
+}
+
+/* Shared by every element in the process, runs the asynchronous
+ * bring-ups so they overlap with each other */
+static GThreadPool *gst_omx_base_start_pool = NULL;
+
+/* GFunc of the start pool, data is the element with a reference taken by
+ * gst_omx_base_start_async */
+static void
+gst_omx_base_start_func (gpointer data, gpointer user_data)
+{
+  GstOmxBase *this = GST_OMX_BASE (data);
+  OMX_ERRORTYPE error;
+
+  GST_INFO_OBJECT (this, "Starting component in the background");
+  error = gst_omx_base_start (this, NULL);
+
+  g_mutex_lock (&this->startmutex);
+  this->starting = FALSE;
+  this->start_error = error;
+  g_cond_broadcast (&this->startcond);
+  g_mutex_unlock (&this->startmutex);
+
+  gst_object_unref (this);
+}
+
+static gpointer
+gst_omx_base_start_pool_init (gpointer data)
+{
+  gst_omx_base_start_pool = g_thread_pool_new (gst_omx_base_start_func,
+      NULL, -1, FALSE, NULL);
+
+  return NULL;
+}
+
+/* Brings the component up from the start pool. Upstream buffers can't be
+ * shared since they are not known yet. */
+static void
+gst_omx_base_start_async (GstOmxBase * this)
+{
+  static GOnce init = G_ONCE_INIT;
+
+  g_once (&init, gst_omx_base_start_pool_init, NULL);
+
+  g_mutex_lock (&this->startmutex);
+  if (this->started || this->starting) {
+    g_mutex_unlock (&this->startmutex);
+    return;
+  }
+  this->starting = TRUE;
+  this->start_error = OMX_ErrorNone;
+  g_mutex_unlock (&this->startmutex);
+
+  GST_INFO_OBJECT (this, "Queueing component start");
+  g_thread_pool_push (gst_omx_base_start_pool, gst_object_ref (this), NULL);
+}
+
+/* Waits for a start in the start pool, if any, and returns its result */
+static OMX_ERRORTYPE
+gst_omx_base_wait_start (GstOmxBase * this)
+{
+  OMX_ERRORTYPE error;
+
+  g_mutex_lock (&this->startmutex);
+  while (this->starting)
+    g_cond_wait (&this->startcond, &this->startmutex);
+  error = this->start_error;
+  this->start_error = OMX_ErrorNone;
+  g_mutex_unlock (&this->startmutex);
+
+  return error;
+}
+
+/* GstOmxBasePadFunc to check the src pad caps with the peer right away.
+ * Only our own pad holds them, the peer is configured from the caps of
+ * the first buffer pushed. Asking it now makes a refusal show up while
+ * the component starts instead of at the first push */
+static OMX_ERRORTYPE
+gst_omx_base_announce_caps (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
+{
+  GstCaps *caps;
+
+  caps = gst_pad_get_negotiated_caps (GST_PAD (pad));
+  if (!caps)
+    return OMX_ErrorNone;
+
+  if (gst_pad_peer_accept_caps (GST_PAD (pad), caps))
+    GST_DEBUG_OBJECT (this, "Peer of %s:%s accepts the caps",
+        GST_DEBUG_PAD_NAME (pad));
+  else
+    GST_WARNING_OBJECT (this, "Peer of %s:%s rejected the caps for now",
+        GST_DEBUG_PAD_NAME (pad));
+
+  gst_caps_unref (caps);
+
+  return OMX_ErrorNone;
+}
+
+static GstStateChangeReturn
+gst_omx_base_change_state (GstElement * element, GstStateChange transition)
+{
+  GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+  GstOmxBase *this = GST_OMX_BASE (element);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      /* Resume the output tasks of an already running component */
+      if (GST_OMX_FAIL (gst_omx_base_for_each_pad (this,
+                  gst_omx_base_start_push_task, GST_PAD_SRC, NULL)))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      /*Start processing buffers for DSP components */
+      if (this->audio_component) {
+        GST_OBJECT_LOCK (this);
+        this->flushing = FALSE;
+        GST_OBJECT_UNLOCK (this);
+      }
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      /*Dont try to push any more buffers for DSP components */
+      if (this->audio_component) {
+        GST_OBJECT_LOCK (this);
+        this->flushing = TRUE;
+        GST_OBJECT_UNLOCK (this);
+      }
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_omx_base_for_each_pad (this, gst_omx_base_stop_push_task,
+          GST_PAD_SRC, NULL);
+      GST_OBJECT_LOCK (this);
+      gst_segment_init (&this->segment, GST_FORMAT_TIME);
+      this->earliest_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (this);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      if (this->cache)
+        gst_omx_base_park (this);
+      else
+        gst_omx_base_stop (this);
+      gst_omx_base_for_each_pad (this, gst_omx_base_destroy_push_task,
+          GST_PAD_SRC, NULL);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_for_each_pad (GstOmxBase * this, GstOmxBasePadFunc func,
+    GstPadDirection direction, gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  GstPad *pad;
+  GList *l;
+
+  for (l = this->pads; l; l = l->next) {
+    pad = l->data;
+    if ((direction == GST_PAD_UNKNOWN)
+        || (direction == GST_PAD_DIRECTION (pad))) {
+      error = func (this, GST_OMX_PAD (pad), data);
+      if (GST_OMX_FAIL (error))
+        goto failed;
+    }
+  }
+
+  return error;
+
+failed:
+  {
+    GST_ERROR_OBJECT (this, "Iterator failed on pad: %s:%s",
+        GST_DEBUG_PAD_NAME (pad));
+    return error;
+  }
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_peer_alloc_buffer (GstOmxBase * this, GstOmxPad * pad,
+    gpointer * pbuffer, guint32 * size)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_BUFFERHEADERTYPE *omxpeerbuffer = NULL;
+
+  GstBuffer *peerbuf = NULL;
+  GstFlowReturn ret;
+
+  ret =
+      gst_pad_alloc_buffer (GST_PAD (pad), 0,
+      GST_OMX_PAD_PORT (pad)->nBufferSize,
+      gst_pad_get_negotiated_caps (GST_PAD (pad)), &peerbuf);
+
+  if (GST_FLOW_OK != ret)
+    goto nodownstream;
+
+  if (GST_OMX_IS_OMX_BUFFER (peerbuf)) {
+    omxpeerbuffer = (OMX_BUFFERHEADERTYPE *) GST_BUFFER_DATA (peerbuf);
+    *pbuffer = omxpeerbuffer->pBuffer;
+    *size = omxpeerbuffer->nAllocLen;
+  } else {
+    pbuffer = NULL;
+    *size = 0;
+  }
+  gst_buffer_unref (peerbuf);
+
+  return error;
+
+nodownstream:
+  {
+    GST_ERROR_OBJECT (this, "Downstream element was unable to provide buffers");
+    error = OMX_ErrorInsufficientResources;
+    return error;
+  }
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_use_buffer (GstOmxBase * this, GList ** bufferlist,
+    gpointer * pbuffer, guint32 * size)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_BUFFERHEADERTYPE *omxpeerbuffer = NULL;
+  GList *node;
+  if (!bufferlist)
+    goto nobuffer;
+
+  node = *bufferlist;
+  omxpeerbuffer = ((GstOmxBufTabNode *) node->data)->buffer;
+  *bufferlist = g_list_next (node);
+  *pbuffer = omxpeerbuffer->pBuffer;
+  *size = omxpeerbuffer->nAllocLen;
+
+  GST_LOG_OBJECT (this, "Using buffer %p->%p", omxpeerbuffer, pbuffer);
+  return error;
+
+nobuffer:
+  {
+    GST_ERROR_OBJECT (this, "No buffer left on the list");
+    error = OMX_ErrorInsufficientResources;
+    return error;
+  }
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_init_use_buffer (GstOmxBase * this, GstOmxPad * pad,
+    GList ** bufferlist, OMX_BUFFERHEADERTYPE * omxpeerbuffer)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  GstOmxBufferData *peerbufdata = NULL;
+  GstOmxPad *peerpad = NULL;
+  guint numbufs = pad->port->nBufferCountActual;
+
+  peerbufdata = (GstOmxBufferData *) omxpeerbuffer->pAppPrivate;
+  peerpad = peerbufdata->pad;
+
+  if (this->interlaced) {
+    numbufs = numbufs >> 1;
+    this->field_offset =
+        (omxpeerbuffer->nFilledLen + omxpeerbuffer->nOffset) / 3;
+  }
+
+  if (numbufs > peerpad->port->nBufferCountActual) {
     error = OMX_ErrorInsufficientResources;
     goto nouse;
   }
@@ -1160,6 +2366,11 @@ gst_omx_base_alloc_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
     return error;
   }
 
+  /* Bottom fields are addressed past the top field ids */
+  if (pad->port->nBufferCountActual >
+      GST_OMX_BUFFER_ID_MAX / (this->interlaced ? 2 : 1))
+    goto toomany;
+
   if (data) {
     OMX_BUFFERHEADERTYPE *omxpeerbuffer = (OMX_BUFFERHEADERTYPE *) data;
     error =
@@ -1174,6 +2385,9 @@ gst_omx_base_alloc_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
   GST_DEBUG_OBJECT (this, "Allocating buffers for %s:%s",
       GST_DEBUG_PAD_NAME (GST_PAD (pad)));
 
+  gst_omx_buf_tab_set_low_watermark (pad->buffers, this->low_watermark,
+      gst_omx_pad_low_watermark, pad);
+
   for (i = 0; i < pad->port->nBufferCountActual; ++i) {
 
     /* First we try to ask for downstream OMX buffers */
@@ -1192,7 +2406,7 @@ gst_omx_base_alloc_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
       goto noalloc;
 
 
-    bufdata = (GstOmxBufferData *) g_malloc (sizeof (GstOmxBufferData));
+    bufdata = (GstOmxBufferData *) g_malloc0 (sizeof (GstOmxBufferData));
     bufdata->pad = pad;
     bufdata->buffer = NULL;
 
@@ -1209,10 +2423,10 @@ gst_omx_base_alloc_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
       GST_DEBUG_OBJECT (this, "Received buffer number %u:"
           "%p of size %d", bufdata->id, pbuffer, size);
 
-      g_mutex_lock (&_omx_mutex);
+      g_mutex_lock (this->omx_lock);
       error = OMX_UseBuffer (this->handle, &buffer,
           GST_OMX_PAD_PORT (pad)->nPortIndex, bufdata, size, pbuffer);
-      g_mutex_unlock (&_omx_mutex);
+      g_mutex_unlock (this->omx_lock);
       if (GST_OMX_FAIL (error))
         goto nouse;
       GST_DEBUG_OBJECT (this, "Saved buffer number %u:"
@@ -1222,10 +2436,10 @@ gst_omx_base_alloc_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
       maxsize = GST_OMX_PAD_PORT (pad)->nBufferSize > this->requested_size ?
           GST_OMX_PAD_PORT (pad)->nBufferSize : this->requested_size;
 
-      g_mutex_lock (&_omx_mutex);
+      g_mutex_lock (this->omx_lock);
       error = OMX_AllocateBuffer (this->handle, &buffer,
           GST_OMX_PAD_PORT (pad)->nPortIndex, bufdata, maxsize);
-      g_mutex_unlock (&_omx_mutex);
+      g_mutex_unlock (this->omx_lock);
       if (GST_OMX_FAIL (error))
         goto noalloc;
       GST_DEBUG_OBJECT (this, "Allocated buffer number %u: %p->%p", i, buffer,
@@ -1240,6 +2454,12 @@ gst_omx_base_alloc_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
 out:
   return error;
 
+toomany:
+  {
+    GST_ERROR_OBJECT (this, "Too many buffers for %s:%s: %u",
+        GST_DEBUG_PAD_NAME (pad), (guint) pad->port->nBufferCountActual);
+    return OMX_ErrorBadParameter;
+  }
 nouse:
   {
     GST_ERROR_OBJECT (this, "Unable to use buffer provided by downstream: %s",
@@ -1279,6 +2499,9 @@ gst_omx_base_free_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
   if (!buffers)
     return error;
 
+  /* Don't wait for upstream to release the buffers it was lent */
+  gst_omx_base_orphan_pad (this, pad);
+
   for (i = 0; i < pad->port->nBufferCountActual; ++i) {
 
     if (!buffers)
@@ -1298,17 +2521,20 @@ gst_omx_base_free_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
     buffers = pad->buffers->table;
 
     g_free (buffer->pAppPrivate);
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (this->omx_lock);
     error = OMX_FreeBuffer (this->handle, GST_OMX_PAD_PORT (pad)->nPortIndex,
         buffer);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (this->omx_lock);
     if (GST_OMX_FAIL (error))
       goto nofree;
   }
 
-  GST_OBJECT_LOCK (pad);
-  pad->enabled = FALSE;
-  GST_OBJECT_UNLOCK (pad);
+  /* A port being disabled is flagged by its PortDisable completion */
+  if (!data) {
+    GST_OBJECT_LOCK (pad);
+    pad->enabled = FALSE;
+    GST_OBJECT_UNLOCK (pad);
+  }
 
   return error;
 
@@ -1357,9 +2583,9 @@ gst_omx_base_push_buffers (GstOmxBase * this, GstOmxPad * pad, gpointer data)
     GST_DEBUG_OBJECT (this, "Pushing buffer number %u: %p of size %d", i,
         buffer, (int) buffer->nAllocLen);
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (this->omx_lock);
     error = this->component->FillThisBuffer (this->handle, buffer);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (this->omx_lock);
     if (GST_OMX_FAIL (error))
       goto nopush;
 
@@ -1405,9 +2631,9 @@ gst_omx_base_flush_ports (GstOmxBase * this, GstOmxPad * pad, gpointer data)
   if (GST_PAD_IS_SRC (pad))
     return error;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   error = OMX_SendCommand (this->handle, OMX_CommandFlush, -1, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
 
   GST_DEBUG_OBJECT (this, "Waiting for port to flush");
   error = gst_omx_base_wait_for_condition (this,
@@ -1425,46 +2651,524 @@ noflush:
 
 }
 
+/* Wakes up or releases the streaming thread waiting for a free buffer
+ * of a sink pad, data tells whether to cancel */
 static OMX_ERRORTYPE
-gst_omx_base_enable_pad (GstOmxBase * this, GstOmxPad * pad, gpointer data)
+gst_omx_base_cancel_pad (GstOmxBase * this, GstOmxPad * pad, gpointer data)
 {
-  OMX_ERRORTYPE error = OMX_ErrorNone;
-  guint32 padidx = (guint32) data;
+  gst_omx_buf_tab_cancel (pad->buffers, GPOINTER_TO_INT (data));
 
-  if (padidx == GST_OMX_PAD_PORT (pad)->nPortIndex) {
-    GST_INFO_OBJECT (this, "Enabling port %s:%s", GST_DEBUG_PAD_NAME (pad));
-    pad->enabled = TRUE;
-  }
-
-  return error;
+  return OMX_ErrorNone;
 }
 
+/* Emulated flush of the ports that can't be flushed: the output is
+ * recycled while the component consumes the input it holds */
 static OMX_ERRORTYPE
-gst_omx_base_set_flushing_pad (GstOmxBase * this, GstOmxPad * pad,
-    gpointer data)
+gst_omx_base_drain_pad (GstOmxBase * this, GstOmxPad * pad, gpointer data)
 {
   OMX_ERRORTYPE error = OMX_ErrorNone;
-  guint32 padidx = (guint32) data;
 
-  if (padidx == GST_OMX_PAD_PORT (pad)->nPortIndex) {
-    GST_INFO_OBJECT (this, "Finished flushing %s:%s", GST_DEBUG_PAD_NAME (pad));
-    GST_OBJECT_LOCK (pad);
-    pad->flushing = FALSE;
-    GST_OBJECT_UNLOCK (pad);
-  }
+  GST_DEBUG_OBJECT (this, "Waiting for %s:%s to be emptied",
+      GST_DEBUG_PAD_NAME (pad));
+
+  error = gst_omx_buf_tab_wait_free (pad->buffers);
+  if (GST_OMX_FAIL (error))
+    GST_WARNING_OBJECT (this, "%s:%s still has buffers in use: %s",
+        GST_DEBUG_PAD_NAME (pad), gst_omx_error_to_str (error));
 
   return error;
 }
 
+/* Hands every free buffer of a flushed src pad back to the component,
+ * looked up by id on the free stack of the table. The snapshot is taken
+ * under the omx lock, together with clearing the flushing flag, so a
+ * buffer released by downstream is either in it or refilled by
+ * gst_omx_base_release_buffer, never both nor neither */
 static OMX_ERRORTYPE
-gst_omx_base_event_callback (OMX_HANDLETYPE handle,
-    gpointer data,
-    OMX_EVENTTYPE event, guint32 nevent1, guint32 nevent2, gpointer eventdata)
+gst_omx_base_refill_pad (GstOmxBase * this, GstOmxPad * pad, gpointer data)
 {
-  GstOmxBase *this = GST_OMX_BASE (data);
   OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_BUFFERHEADERTYPE **buffers;
+  guint i, count;
 
-  switch (event) {
+  count = g_list_length (pad->buffers->table);
+  buffers = g_newa (OMX_BUFFERHEADERTYPE *, count);
+
+  g_mutex_lock (this->omx_lock);
+  GST_OBJECT_LOCK (this);
+  /* DSP components only process buffers while playing */
+  this->flushing = this->audio_component
+      && GST_STATE_PLAYING != GST_STATE (this);
+  GST_OBJECT_UNLOCK (this);
+  count = gst_omx_buf_tab_get_free_buffers (pad->buffers, buffers, count);
+  g_mutex_unlock (this->omx_lock);
+
+  GST_DEBUG_OBJECT (this, "Refilling %u buffers on %s:%s", count,
+      GST_DEBUG_PAD_NAME (pad));
+
+  for (i = 0; i < count; ++i) {
+    g_mutex_lock (this->omx_lock);
+    error = this->component->FillThisBuffer (this->handle, buffers[i]);
+    g_mutex_unlock (this->omx_lock);
+    if (GST_OMX_FAIL (error))
+      goto nofill;
+  }
+
+  return error;
+
+nofill:
+  {
+    GST_ERROR_OBJECT (this, "Unable to refill %s:%s: %s",
+        GST_DEBUG_PAD_NAME (pad), gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+/* FLUSH_START, called once the event went downstream. Drops everything
+ * in flight without leaving Executing */
+static OMX_ERRORTYPE
+gst_omx_base_flush_start (GstOmxBase * this)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  if (!this->started)
+    return error;
+
+  GST_INFO_OBJECT (this, "Flush start");
+
+  GST_OBJECT_LOCK (this);
+  this->flushing = TRUE;
+  /* DSP does not support flush ports */
+  this->flush_emulated = this->audio_component;
+  GST_OBJECT_UNLOCK (this);
+
+  gst_omx_base_for_each_pad (this, gst_omx_base_cancel_pad, GST_PAD_SINK,
+      GINT_TO_POINTER (TRUE));
+
+  /* Downstream is flushing, so the output tasks are not stuck pushing.
+   * What they had queued goes back to the table */
+  gst_omx_base_for_each_pad (this, gst_omx_base_stop_push_task, GST_PAD_SRC,
+      NULL);
+
+  if (this->flush_emulated)
+    return gst_omx_base_for_each_pad (this, gst_omx_base_drain_pad,
+        GST_PAD_SINK, NULL);
+
+  error = gst_omx_base_for_each_pad (this, gst_omx_base_flush_ports,
+      GST_PAD_UNKNOWN, NULL);
+  if (GST_OMX_FAIL (error))
+    goto noflush;
+
+  return error;
+
+noflush:
+  {
+    GST_ERROR_OBJECT (this, "Unable to flush ports: %s",
+        gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+/* FLUSH_STOP, serialized with the streaming thread so no input arrives
+ * before it returns */
+static OMX_ERRORTYPE
+gst_omx_base_flush_stop (GstOmxBase * this)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  if (!this->started)
+    return error;
+
+  GST_INFO_OBJECT (this, "Flush stop");
+
+  /* The buffers the component flushed are free, give them back. Refilling
+   * clears the flushing flag so later releases recycle their own buffer */
+  if (!this->flush_emulated) {
+    error = gst_omx_base_for_each_pad (this, gst_omx_base_refill_pad,
+        GST_PAD_SRC, NULL);
+    if (GST_OMX_FAIL (error))
+      return error;
+  }
+
+  error = gst_omx_base_for_each_pad (this, gst_omx_base_start_push_task,
+      GST_PAD_SRC, NULL);
+  if (GST_OMX_FAIL (error))
+    return error;
+
+  GST_OBJECT_LOCK (this);
+  /* DSP components only process buffers while playing */
+  this->flushing = this->audio_component
+      && GST_STATE_PLAYING != GST_STATE (this);
+  this->flush_emulated = FALSE;
+  this->fill_ret = GST_FLOW_OK;
+  GST_OBJECT_UNLOCK (this);
+
+  gst_omx_base_for_each_pad (this, gst_omx_base_cancel_pad, GST_PAD_SINK,
+      GINT_TO_POINTER (FALSE));
+
+  return error;
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_enable_pad (GstOmxBase * this, GstOmxPad * pad, gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  guint32 padidx = (guint32) data;
+
+  if (padidx == GST_OMX_PAD_PORT (pad)->nPortIndex) {
+    GST_INFO_OBJECT (this, "Enabling port %s:%s", GST_DEBUG_PAD_NAME (pad));
+    pad->enabled = TRUE;
+  }
+
+  return error;
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_disable_pad (GstOmxBase * this, GstOmxPad * pad, gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  guint32 padidx = (guint32) data;
+
+  if (padidx == GST_OMX_PAD_PORT (pad)->nPortIndex) {
+    GST_INFO_OBJECT (this, "Disabling port %s:%s", GST_DEBUG_PAD_NAME (pad));
+    pad->enabled = FALSE;
+  }
+
+  return error;
+}
+
+/* Applies the min-buffers of the pad, if any, on top of the port
+ * definition set by the subclass */
+static OMX_ERRORTYPE
+gst_omx_base_size_pad (GstOmxBase * this, GstOmxPad * pad, gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_PARAM_PORTDEFINITIONTYPE *port = GST_OMX_PAD_PORT (pad);
+
+  pad->chained = 0;
+  pad->lastwaits = pad->buffers->waits;
+
+  if (!pad->min_buffers)
+    return error;
+
+  port->nBufferCountActual = MAX (pad->min_buffers, port->nBufferCountMin);
+
+  GST_INFO_OBJECT (this, "Using %u buffers on %s:%s",
+      (guint) port->nBufferCountActual, GST_DEBUG_PAD_NAME (pad));
+
+  g_mutex_lock (this->omx_lock);
+  error = OMX_SetParameter (this->handle, OMX_IndexParamPortDefinition, port);
+  g_mutex_unlock (this->omx_lock);
+  if (GST_OMX_FAIL (error))
+    goto noport;
+
+  return error;
+
+noport:
+  {
+    GST_ERROR_OBJECT (this, "Unable to set %u buffers on %s:%s: %s",
+        (guint) port->nBufferCountActual, GST_DEBUG_PAD_NAME (pad),
+        gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+/* The port layouts may have changed, reconfigure the input copies */
+static OMX_ERRORTYPE
+gst_omx_base_reset_copy (GstOmxBase * this, GstOmxPad * pad, gpointer data)
+{
+  gst_omx_copy_reset (&pad->copy);
+
+  return OMX_ErrorNone;
+}
+
+/* Called from the chain function before waiting for a free buffer, grows
+ * the port by half its size when it starved over the last period */
+static OMX_ERRORTYPE
+gst_omx_base_check_growth (GstOmxBase * this, GstOmxPad * pad)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  guint count = GST_OMX_PAD_PORT (pad)->nBufferCountActual;
+  guint waits;
+
+  if (pad->max_buffers <= count)
+    return error;
+
+  if (++pad->chained < GST_OMX_BASE_GROW_PERIOD)
+    return error;
+
+  /* Only the chain function waits for free buffers on the sink pads */
+  waits = pad->buffers->waits - pad->lastwaits;
+  pad->lastwaits = pad->buffers->waits;
+  pad->chained = 0;
+
+  if (waits <= GST_OMX_BASE_GROW_THRESHOLD)
+    return error;
+
+  GST_INFO_OBJECT (this, "%s:%s waited for %u of the last %u buffers",
+      GST_DEBUG_PAD_NAME (pad), waits, GST_OMX_BASE_GROW_PERIOD);
+
+  return gst_omx_base_grow_pad (this, pad,
+      MIN (count + (count + 1) / 2, pad->max_buffers));
+}
+
+/* Takes the port of a running pad down, the component hands back the
+ * buffers it holds and they are freed */
+static OMX_ERRORTYPE
+gst_omx_base_disable_port (GstOmxBase * this, GstOmxPad * pad, gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_PARAM_PORTDEFINITIONTYPE *port = GST_OMX_PAD_PORT (pad);
+
+  GST_INFO_OBJECT (this, "Disabling port %d of %s:%s",
+      (int) port->nPortIndex, GST_DEBUG_PAD_NAME (pad));
+
+  GST_OBJECT_LOCK (pad);
+  pad->reconfiguring = TRUE;
+  GST_OBJECT_UNLOCK (pad);
+
+  g_mutex_lock (this->omx_lock);
+  error = OMX_SendCommand (this->handle, OMX_CommandPortDisable,
+      port->nPortIndex, NULL);
+  g_mutex_unlock (this->omx_lock);
+  if (GST_OMX_FAIL (error))
+    goto nodisable;
+
+  /* Waits for the buffers held downstream to come back */
+  error = gst_omx_base_free_buffers (this, pad, GINT_TO_POINTER (TRUE));
+  if (GST_OMX_FAIL (error))
+    goto nodisable;
+
+  /* The component completes the disable once all the buffers are freed */
+  error = gst_omx_base_wait_for_condition (this,
+      gst_omx_base_condition_disabled, (gpointer) & pad->enabled, NULL);
+  if (GST_OMX_FAIL (error))
+    goto nodisable;
+
+  return error;
+
+nodisable:
+  {
+    GST_ERROR_OBJECT (this, "Unable to disable %s:%s: %s",
+        GST_DEBUG_PAD_NAME (pad), gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+/* Brings a disabled port back with buffers for its current definition
+ * and, on src pads, hands them to the component */
+static OMX_ERRORTYPE
+gst_omx_base_enable_port (GstOmxBase * this, GstOmxPad * pad, gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_PARAM_PORTDEFINITIONTYPE *port = GST_OMX_PAD_PORT (pad);
+
+  /* Commands are processed in order, so the enable completes after the
+   * disable */
+  g_mutex_lock (this->omx_lock);
+  error = OMX_SendCommand (this->handle, OMX_CommandPortEnable,
+      port->nPortIndex, NULL);
+  g_mutex_unlock (this->omx_lock);
+  if (GST_OMX_FAIL (error))
+    goto noenable;
+
+  error = gst_omx_base_alloc_buffers (this, pad, NULL);
+  if (GST_OMX_FAIL (error))
+    goto noenable;
+
+  error = gst_omx_base_wait_for_condition (this,
+      gst_omx_base_condition_enabled, (gpointer) & pad->enabled, NULL);
+  if (GST_OMX_FAIL (error))
+    goto noenable;
+
+  GST_OBJECT_LOCK (pad);
+  pad->reconfiguring = FALSE;
+  GST_OBJECT_UNLOCK (pad);
+
+  return gst_omx_base_push_buffers (this, pad, NULL);
+
+noenable:
+  {
+    GST_ERROR_OBJECT (this, "Unable to enable %s:%s: %s",
+        GST_DEBUG_PAD_NAME (pad), gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+/* Reallocates the buffers of a running sink port with a new count, the
+ * rest of the ports keep running */
+static OMX_ERRORTYPE
+gst_omx_base_grow_pad (GstOmxBase * this, GstOmxPad * pad, guint count)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_PARAM_PORTDEFINITIONTYPE *port = GST_OMX_PAD_PORT (pad);
+
+  GST_INFO_OBJECT (this, "Growing %s:%s from %u to %u buffers",
+      GST_DEBUG_PAD_NAME (pad), (guint) port->nBufferCountActual, count);
+
+  error = gst_omx_base_disable_port (this, pad, NULL);
+  if (GST_OMX_FAIL (error))
+    return error;
+
+  port->nBufferCountActual = count;
+  g_mutex_lock (this->omx_lock);
+  error = OMX_SetParameter (this->handle, OMX_IndexParamPortDefinition, port);
+  g_mutex_unlock (this->omx_lock);
+  if (GST_OMX_FAIL (error))
+    goto noport;
+
+  return gst_omx_base_enable_port (this, pad, NULL);
+
+noport:
+  {
+    GST_ERROR_OBJECT (this, "Unable to set %u buffers on %s:%s: %s", count,
+        GST_DEBUG_PAD_NAME (pad), gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+/* Applies new caps on a running component without leaving Executing: the
+ * ports are cycled around update_ports instead of going through Idle and
+ * Loaded, the handle and the output tasks are kept */
+static OMX_ERRORTYPE
+gst_omx_base_reconfigure (GstOmxBase * this)
+{
+  GstOmxBaseClass *klass = GST_OMX_BASE_GET_CLASS (this);
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  GST_INFO_OBJECT (this, "Reconfiguring ports in place");
+
+  error = gst_omx_base_for_each_pad (this, gst_omx_base_disable_port,
+      GST_PAD_UNKNOWN, NULL);
+  if (GST_OMX_FAIL (error))
+    return error;
+
+  error = klass->update_ports (this);
+  if (GST_OMX_FAIL (error))
+    goto noupdate;
+
+  error = gst_omx_base_for_each_pad (this, gst_omx_base_size_pad,
+      GST_PAD_UNKNOWN, NULL);
+  if (GST_OMX_FAIL (error))
+    goto noupdate;
+
+  /* The sink ports come back with their own buffers */
+  this->shared = FALSE;
+
+  return gst_omx_base_for_each_pad (this, gst_omx_base_enable_port,
+      GST_PAD_UNKNOWN, NULL);
+
+noupdate:
+  {
+    GST_ERROR_OBJECT (this, "Unable to update ports: %s",
+        gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+/* Flags the pad of a PortSettingsChanged event, data is the port index.
+ * Runs on the component thread, the port is cycled from the streaming
+ * thread by gst_omx_base_apply_settings */
+static OMX_ERRORTYPE
+gst_omx_base_mark_settings (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
+{
+  guint32 padidx = (guint32) data;
+
+  if (padidx == GST_OMX_PAD_PORT (pad)->nPortIndex)
+    g_atomic_int_set (&pad->settings_changed, TRUE);
+
+  return OMX_ErrorNone;
+}
+
+/* Cycles the port of a pad whose settings were changed by the component,
+ * with the definition the component reports. The other ports keep
+ * running */
+static OMX_ERRORTYPE
+gst_omx_base_apply_settings (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
+{
+  GstOmxBaseClass *klass = GST_OMX_BASE_GET_CLASS (this);
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_PARAM_PORTDEFINITIONTYPE *port = GST_OMX_PAD_PORT (pad);
+
+  if (!g_atomic_int_compare_and_exchange (&pad->settings_changed, TRUE,
+          FALSE))
+    return error;
+
+  GST_INFO_OBJECT (this, "Applying new settings of %s:%s",
+      GST_DEBUG_PAD_NAME (pad));
+
+  error = gst_omx_base_disable_port (this, pad, NULL);
+  if (GST_OMX_FAIL (error))
+    return error;
+
+  g_mutex_lock (this->omx_lock);
+  error = OMX_GetParameter (this->handle, OMX_IndexParamPortDefinition, port);
+  g_mutex_unlock (this->omx_lock);
+  if (GST_OMX_FAIL (error))
+    goto noport;
+
+  GST_INFO_OBJECT (this, "%s:%s now %ux%u, %u buffers of %u bytes",
+      GST_DEBUG_PAD_NAME (pad), (guint) port->format.video.nFrameWidth,
+      (guint) port->format.video.nFrameHeight,
+      (guint) port->nBufferCountActual, (guint) port->nBufferSize);
+
+  if (GST_PAD_IS_SINK (pad)) {
+    this->shared = FALSE;
+    gst_omx_copy_reset (&pad->copy);
+  }
+
+  /* No buffer is filled while the port is down, so new src caps are in
+   * place before the first one at the new size is pushed */
+  if (klass->port_changed) {
+    error = klass->port_changed (this, pad);
+    if (GST_OMX_FAIL (error))
+      goto noformat;
+  }
+
+  return gst_omx_base_enable_port (this, pad, NULL);
+
+noport:
+  {
+    GST_ERROR_OBJECT (this, "Unable to read %s:%s settings: %s",
+        GST_DEBUG_PAD_NAME (pad), gst_omx_error_to_str (error));
+    return error;
+  }
+noformat:
+  {
+    GST_ERROR_OBJECT (this, "Unable to apply %s:%s settings: %s",
+        GST_DEBUG_PAD_NAME (pad), gst_omx_error_to_str (error));
+    return error;
+  }
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_set_flushing_pad (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  guint32 padidx = (guint32) data;
+
+  if (padidx == GST_OMX_PAD_PORT (pad)->nPortIndex) {
+    GST_INFO_OBJECT (this, "Finished flushing %s:%s", GST_DEBUG_PAD_NAME (pad));
+    GST_OBJECT_LOCK (pad);
+    pad->flushing = FALSE;
+    GST_OBJECT_UNLOCK (pad);
+  }
+
+  return error;
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_event_callback (OMX_HANDLETYPE handle,
+    gpointer data,
+    OMX_EVENTTYPE event, guint32 nevent1, guint32 nevent2, gpointer eventdata)
+{
+  GstOmxBase *this = GST_OMX_BASE (data);
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  switch (event) {
     case OMX_EventCmdComplete:
       GST_INFO_OBJECT (this,
           "OMX command complete event received: %s (%s) (%d)",
@@ -1487,6 +3191,14 @@ gst_omx_base_event_callback (OMX_HANDLETYPE handle,
         g_mutex_unlock (&this->waitmutex);
       }
 
+      if (OMX_CommandPortDisable == nevent1) {
+        g_mutex_lock (&this->waitmutex);
+        gst_omx_base_for_each_pad (this, gst_omx_base_disable_pad,
+            GST_PAD_UNKNOWN, (gpointer) nevent2);
+        g_cond_signal (&this->waitcond);
+        g_mutex_unlock (&this->waitmutex);
+      }
+
       if (OMX_CommandFlush == nevent1) {
         g_mutex_lock (&this->waitmutex);
         gst_omx_base_for_each_pad (this, gst_omx_base_set_flushing_pad,
@@ -1510,6 +3222,8 @@ gst_omx_base_event_callback (OMX_HANDLETYPE handle,
       GST_INFO_OBJECT (this,
           "OMX port settings changed event received: Port %d: %d", nevent2,
           nevent1);
+      gst_omx_base_for_each_pad (this, gst_omx_base_mark_settings,
+          GST_PAD_UNKNOWN, (gpointer) nevent1);
       break;
     case OMX_EventBufferFlag:
       GST_INFO_OBJECT (this, "OMX buffer flag event received");
@@ -1535,96 +3249,444 @@ gst_omx_base_event_callback (OMX_HANDLETYPE handle,
 }
 
 static OMX_ERRORTYPE
-gst_omx_base_fill_callback (OMX_HANDLETYPE handle,
-    gpointer data, OMX_BUFFERHEADERTYPE * outbuf)
+gst_omx_base_fill_callback (OMX_HANDLETYPE handle,
+    gpointer data, OMX_BUFFERHEADERTYPE * outbuf)
+{
+  GstOmxBase *this = GST_OMX_BASE (data);
+  OMX_BUFFERHEADERTYPE *omxbuf;
+  gboolean busy;
+  GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  gboolean flushing, emulated;
+
+  GST_LOG_OBJECT (this, "Fill buffer callback for buffer %p->%p", outbuf,
+      outbuf->pBuffer);
+
+  GST_OBJECT_LOCK (this);
+  flushing = this->flushing;
+  emulated = this->flush_emulated;
+  GST_OBJECT_UNLOCK (this);
+
+  /* The port is being disabled, its buffers are about to be freed */
+  GST_OBJECT_LOCK (bufdata->pad);
+  flushing |= bufdata->pad->reconfiguring;
+  GST_OBJECT_UNLOCK (bufdata->pad);
+
+  gst_omx_buf_tab_find_buffer (bufdata->pad->buffers, outbuf, &omxbuf, &busy);
+
+  if (busy)
+    goto illegal;
+
+  /* Output of the data being flushed, handed straight back */
+  if (emulated)
+    goto drop;
+
+  if (flushing)
+    goto flushing;
+
+  if (this->fill_ret != GST_FLOW_OK)
+    goto drop;
+
+  GST_LOG_OBJECT (this, "Current %d Pending %d Target %d Next %d",
+      GST_STATE (this), GST_STATE_PENDING (this), GST_STATE_TARGET (this),
+      GST_STATE_NEXT (this));
+  if (GST_STATE_PAUSED > GST_STATE (this))
+    goto flushing;
+
+  gst_omx_buf_tab_use_buffer (bufdata->pad->buffers, outbuf);
+
+  bufdata->stamp = g_get_monotonic_time ();
+  gst_omx_stats_frame_filled (&this->stats, outbuf, bufdata->stamp);
+
+  /* Hand the buffer over to the output task, if any */
+  if (bufdata->pad->pushtask) {
+    gst_omx_base_queue_buffer (this, bufdata->pad, outbuf);
+    return error;
+  }
+
+  if (gst_omx_base_process_buffer (this, outbuf) != GST_FLOW_OK)
+    goto cbfailed;
+
+  return error;
+
+illegal:
+  {
+    GST_ERROR_OBJECT (this,
+        "Double fill callback for buffer %p->%p, this should not happen",
+        outbuf, outbuf->pBuffer);
+    /* g_mutex_lock (this->omx_lock); */
+    /* error = this->component->FillThisBuffer (this->handle, outbuf); */
+    /* g_mutex_unlock (this->omx_lock); */
+    return error;
+  }
+
+flushing:
+  {
+    GST_DEBUG_OBJECT (this, "Discarding buffer %d while flushing", bufdata->id);
+    return error;
+  }
+
+cbfailed:
+  {
+    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
+        ("Subclass failed to process buffer (id:%d): %s",
+            bufdata->id, gst_flow_get_name (this->fill_ret)), (NULL));
+
+    return error;
+  }
+drop:
+  {
+    GST_LOG_OBJECT (this, "Dropping buffer, push error %s",
+        gst_flow_get_name (this->fill_ret));
+    if (!emulated)
+      gst_omx_stats_frame_dropped (&this->stats);
+    g_mutex_lock (this->omx_lock);
+    error = this->component->FillThisBuffer (this->handle, outbuf);
+    g_mutex_unlock (this->omx_lock);
+    return error;
+  }
+}
+
+/* Lets the subclass push the filled buffer downstream, either from the
+ * FillBufferDone callback or from the output task of the pad */
+static GstFlowReturn
+gst_omx_base_process_buffer (GstOmxBase * this, OMX_BUFFERHEADERTYPE * outbuf)
+{
+  GstOmxBaseClass *klass = GST_OMX_BASE_GET_CLASS (this);
+  GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
+  GstMessage *message;
+
+  /* The subclass pushes the buffer, so this is as close as we get */
+  gst_omx_stats_frame_out (&this->stats, bufdata->stamp);
+
+  if (klass->omx_fill_buffer) {
+    this->fill_ret = klass->omx_fill_buffer (this, outbuf);
+    if (this->fill_ret != GST_FLOW_OK)
+      return this->fill_ret;
+  }
+
+  message = gst_omx_stats_poll_message (&this->stats, GST_OBJECT (this));
+  if (message)
+    gst_element_post_message (GST_ELEMENT (this), message);
+
+  /* In some cases the EoS event arrives before we encode the
+  *  desired amount of frames using the num_buffers property we
+  *  can be sure that we will encode this amount of frames (i.e.snapshots)
+  */
+
+  if(this->num_buffers) {
+	this->cont++;
+	if(this->cont >= this->num_buffers) {
+	    g_cond_signal(this->num_buffers_cond);
+	    this->cont = 0;
+	}
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* Queues a filled buffer for the output task, applying the leaky policy
+ * once queue-depth buffers are waiting to be pushed */
+static void
+gst_omx_base_queue_buffer (GstOmxBase * this, GstOmxPad * pad,
+    OMX_BUFFERHEADERTYPE * outbuf)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  guint depth = this->queue_depth;
+
+  if (g_atomic_int_get (&pad->queue->release))
+    goto drop;
+
+  if (depth && g_atomic_int_get (&pad->queued) >= depth) {
+    switch (this->leaky) {
+      case GST_OMX_BASE_LEAKY_UPSTREAM:
+        goto drop;
+      case GST_OMX_BASE_LEAKY_DOWNSTREAM:
+        /* The task drops the oldest buffers */
+        break;
+      default:
+        g_mutex_lock (&this->pushmutex);
+        g_atomic_int_inc (&this->push_waiters);
+        while (g_atomic_int_get (&pad->queued) >= depth
+            && !g_atomic_int_get (&pad->queue->release)
+            && GST_FLOW_OK == this->fill_ret)
+          g_cond_wait (&this->pushcond, &this->pushmutex);
+        g_atomic_int_add (&this->push_waiters, -1);
+        g_mutex_unlock (&this->pushmutex);
+
+        if (g_atomic_int_get (&pad->queue->release)
+            || GST_FLOW_OK != this->fill_ret)
+          goto drop;
+        break;
+    }
+  }
+
+  g_atomic_int_inc (&pad->queued);
+  error = gst_omx_buf_queue_push_buffer (pad->queue, outbuf);
+  if (GST_OMX_FAIL (error))
+    goto noqueue;
+
+  return;
+
+drop:
+  {
+    GST_LOG_OBJECT (this, "Dropping buffer %p on %s:%s", outbuf,
+        GST_DEBUG_PAD_NAME (pad));
+    gst_omx_stats_frame_dropped (&this->stats);
+    gst_omx_base_release_buffer (outbuf);
+    return;
+  }
+noqueue:
+  {
+    GST_WARNING_OBJECT (this, "Unable to queue buffer %p on %s:%s: %s",
+        outbuf, GST_DEBUG_PAD_NAME (pad), gst_omx_error_to_str (error));
+    g_atomic_int_add (&pad->queued, -1);
+    gst_omx_base_release_buffer (outbuf);
+    return;
+  }
+}
+
+/* Output task of a src pad, pushes the buffers the component filled */
+static void
+gst_omx_base_push_loop (gpointer data)
+{
+  GstOmxPad *pad = GST_OMX_PAD (data);
+  GstOmxBase *this = GST_OMX_BASE (GST_OBJECT_PARENT (pad));
+  OMX_BUFFERHEADERTYPE *omxbuf;
+  OMX_BUFFERHEADERTYPE *next;
+  GstFlowReturn ret;
+
+  omxbuf = gst_omx_buf_queue_pop_buffer_check_release (pad->queue);
+  if (!omxbuf)
+    return;
+
+  /* Keep only the newest queue-depth buffers */
+  if (GST_OMX_BASE_LEAKY_DOWNSTREAM == this->leaky && this->queue_depth) {
+    while (g_atomic_int_get (&pad->queued) > this->queue_depth
+        && (next = gst_omx_buf_queue_pop_buffer_no_wait (pad->queue))) {
+      GST_LOG_OBJECT (this, "Dropping old buffer %p on %s:%s", omxbuf,
+          GST_DEBUG_PAD_NAME (pad));
+      gst_omx_stats_frame_dropped (&this->stats);
+      gst_omx_base_release_buffer (omxbuf);
+      gst_omx_base_push_done (this, pad);
+      omxbuf = next;
+    }
+  }
+
+  ret = gst_omx_base_process_buffer (this, omxbuf);
+  gst_omx_base_push_done (this, pad);
+  if (GST_FLOW_OK != ret)
+    goto pushfailed;
+
+  return;
+
+pushfailed:
+  {
+    if (GST_FLOW_WRONG_STATE == ret)
+      GST_DEBUG_OBJECT (this, "Pad %s:%s is flushing, pausing task",
+          GST_DEBUG_PAD_NAME (pad));
+    else
+      GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
+          ("Subclass failed to process buffer: %s",
+              gst_flow_get_name (ret)), (NULL));
+    gst_task_pause (pad->pushtask);
+    return;
+  }
+}
+
+/* Accounts for a buffer leaving the queue, waking up whoever is waiting
+ * for room or for the queue to drain */
+static void
+gst_omx_base_push_done (GstOmxBase * this, GstOmxPad * pad)
+{
+  g_atomic_int_add (&pad->queued, -1);
+
+  if (G_UNLIKELY (g_atomic_int_get (&this->push_waiters))) {
+    g_mutex_lock (&this->pushmutex);
+    g_cond_broadcast (&this->pushcond);
+    g_mutex_unlock (&this->pushmutex);
+  }
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_create_push_task (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  GST_INFO_OBJECT (this, "Creating push task for %s:%s",
+      GST_DEBUG_PAD_NAME (pad));
+
+  if (!pad->queue) {
+    pad->queue = gst_omx_buf_queue_new ();
+    if (!pad->queue)
+      goto noqueue;
+  }
+
+  /* Room for every buffer of the port, so pushing never fails */
+  error = gst_omx_buf_queue_set_size (pad->queue,
+      pad->port->nBufferCountActual);
+  if (GST_OMX_FAIL (error))
+    goto noqueue;
+  g_atomic_int_set (&pad->queued, 0);
+
+  if (!pad->pushtask) {
+    pad->pushtask = gst_task_create (gst_omx_base_push_loop, (gpointer) pad);
+    if (!pad->pushtask)
+      goto notask;
+
+    g_static_rec_mutex_init (&pad->taskmutex);
+    gst_task_set_lock (pad->pushtask, &pad->taskmutex);
+  }
+
+  return error;
+
+noqueue:
+  {
+    GST_ERROR_OBJECT (this, "Unable to create the output queue for %s:%s",
+        GST_DEBUG_PAD_NAME (pad));
+    return OMX_ErrorInsufficientResources;
+  }
+notask:
+  {
+    GST_ERROR_OBJECT (this, "Failed to create push task for %s:%s",
+        GST_DEBUG_PAD_NAME (pad));
+    return OMX_ErrorInsufficientResources;
+  }
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_start_push_task (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  if (!pad->pushtask)
+    return error;
+
+  GST_INFO_OBJECT (this, "Starting push task for %s:%s",
+      GST_DEBUG_PAD_NAME (pad));
+
+  this->fill_ret = GST_FLOW_OK;
+  gst_omx_buf_queue_release (pad->queue, FALSE);
+
+  if (!gst_task_start (pad->pushtask))
+    goto nostart;
+
+  return error;
+
+nostart:
+  {
+    GST_ERROR_OBJECT (this, "Failed to start push task for %s:%s",
+        GST_DEBUG_PAD_NAME (pad));
+    return OMX_ErrorInsufficientResources;
+  }
+}
+
+static OMX_ERRORTYPE
+gst_omx_base_stop_push_task (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
 {
-  GstOmxBase *this = GST_OMX_BASE (data);
-  GstOmxBaseClass *klass = GST_OMX_BASE_GET_CLASS (this);
-  OMX_BUFFERHEADERTYPE *omxbuf;
-  gboolean busy;
-  GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
   OMX_ERRORTYPE error = OMX_ErrorNone;
-  gboolean flushing;
+  OMX_BUFFERHEADERTYPE *omxbuf;
 
-  GST_LOG_OBJECT (this, "Fill buffer callback for buffer %p->%p", outbuf,
-      outbuf->pBuffer);
+  if (!pad->pushtask)
+    return error;
 
-  GST_OBJECT_LOCK (this);
-  flushing = this->flushing;
-  GST_OBJECT_UNLOCK (this);
+  GST_INFO_OBJECT (this, "Stopping push task for %s:%s",
+      GST_DEBUG_PAD_NAME (pad));
 
-  gst_omx_buf_tab_find_buffer (bufdata->pad->buffers, outbuf, &omxbuf, &busy);
+  gst_omx_buf_queue_release (pad->queue, TRUE);
 
-  if (busy)
-    goto illegal;
+  /* Wake up a fill callback waiting for room in the queue */
+  g_mutex_lock (&this->pushmutex);
+  g_cond_broadcast (&this->pushcond);
+  g_mutex_unlock (&this->pushmutex);
 
-  if (flushing)
-    goto flushing;
+  if (!gst_task_join (pad->pushtask))
+    goto nojoin;
 
-  if (this->fill_ret != GST_FLOW_OK)
-    goto drop;
+  /* Give back to the component whatever was not pushed */
+  while ((omxbuf = gst_omx_buf_queue_pop_buffer_no_wait (pad->queue)))
+    gst_omx_base_release_buffer (omxbuf);
+  g_atomic_int_set (&pad->queued, 0);
 
-  GST_LOG_OBJECT (this, "Current %d Pending %d Target %d Next %d",
-      GST_STATE (this), GST_STATE_PENDING (this), GST_STATE_TARGET (this),
-      GST_STATE_NEXT (this));
-  if (GST_STATE_PAUSED > GST_STATE (this))
-    goto flushing;
+  return error;
 
-  gst_omx_buf_tab_use_buffer (bufdata->pad->buffers, outbuf);
+nojoin:
+  {
+    GST_WARNING_OBJECT (this, "Failed to stop push task for %s:%s",
+        GST_DEBUG_PAD_NAME (pad));
+    return OMX_ErrorIncorrectStateOperation;
+  }
+}
 
-  if (klass->omx_fill_buffer) {
-    this->fill_ret = klass->omx_fill_buffer (this, outbuf);
-    if (this->fill_ret != GST_FLOW_OK) {
-      goto cbfailed;
+static OMX_ERRORTYPE
+gst_omx_base_destroy_push_task (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  if (pad->pushtask) {
+    if (gst_task_get_state (pad->pushtask) != GST_TASK_STOPPED) {
+      error = gst_omx_base_stop_push_task (this, pad, data);
+      if (GST_OMX_FAIL (error))
+        return error;
     }
-  }
 
-  /* In some cases the EoS event arrives before we encode the
-  *  desired amount of frames using the num_buffers property we
-  *  can be sure that we will encode this amount of frames (i.e.snapshots)
-  */
+    GST_INFO_OBJECT (this, "Destroying push task for %s:%s",
+        GST_DEBUG_PAD_NAME (pad));
+    gst_object_unref (pad->pushtask);
+    pad->pushtask = NULL;
+  }
 
-  if(this->num_buffers) {
-	this->cont++;
-	if(this->cont >= this->num_buffers) {
-	    g_cond_signal(this->num_buffers_cond);
-	    this->cont = 0;
-	}
+  if (pad->queue) {
+    gst_omx_buf_queue_free (pad->queue);
+    pad->queue = NULL;
   }
+
   return error;
+}
 
-illegal:
-  {
-    GST_ERROR_OBJECT (this,
-        "Double fill callback for buffer %p->%p, this should not happen",
-        outbuf, outbuf->pBuffer);
-    /* g_mutex_lock (&_omx_mutex); */
-    /* error = this->component->FillThisBuffer (this->handle, outbuf); */
-    /* g_mutex_unlock (&_omx_mutex); */
-    return error;
-  }
+/* Waits for the output task to push every queued buffer */
+static OMX_ERRORTYPE
+gst_omx_base_drain_push_task (GstOmxBase * this, GstOmxPad * pad,
+    gpointer data)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  gint64 endtime;
 
-flushing:
-  {
-    GST_DEBUG_OBJECT (this, "Discarding buffer %d while flushing", bufdata->id);
+  if (!pad->pushtask)
     return error;
-  }
 
-cbfailed:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Subclass failed to process buffer (id:%d): %s",
-            bufdata->id, gst_flow_get_name (this->fill_ret)), (NULL));
+  GST_DEBUG_OBJECT (this, "Draining output queue of %s:%s",
+      GST_DEBUG_PAD_NAME (pad));
 
-    return error;
-  }
-drop:
+  endtime = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&this->pushmutex);
+  g_atomic_int_inc (&this->push_waiters);
+
+  while (g_atomic_int_get (&pad->queued)
+      && !g_atomic_int_get (&pad->queue->release)
+      && GST_FLOW_OK == this->fill_ret)
+    if (!g_cond_wait_until (&this->pushcond, &this->pushmutex, endtime)) {
+      error = OMX_ErrorTimeout;
+      break;
+    }
+
+  g_atomic_int_add (&this->push_waiters, -1);
+  g_mutex_unlock (&this->pushmutex);
+
+  if (GST_OMX_FAIL (error))
+    goto timeout;
+
+  return error;
+
+timeout:
   {
-    GST_LOG_OBJECT (this, "Dropping buffer, push error %s",
-        gst_flow_get_name (this->fill_ret));
-    g_mutex_lock (&_omx_mutex);
-    error = this->component->FillThisBuffer (this->handle, outbuf);
-    g_mutex_unlock (&_omx_mutex);
+    GST_WARNING_OBJECT (this, "Timed out draining the output queue of %s:%s",
+        GST_DEBUG_PAD_NAME (pad));
     return error;
   }
 }
@@ -1635,33 +3697,40 @@ gst_omx_base_empty_callback (OMX_HANDLETYPE handle,
 {
   GstOmxBase *this = GST_OMX_BASE (data);
   GstOmxBufferData *bufdata = (GstOmxBufferData *) buffer->pAppPrivate;
-  while (!bufdata->buffer) {
-  };
-  GstBuffer *gstbuf = bufdata->buffer;
+  GstBuffer *gstbuf = NULL;
   GstOmxPad *pad = bufdata->pad;
-  guint8 id = bufdata->id;
-
+  guint id = bufdata->id;
   OMX_ERRORTYPE error = OMX_ErrorNone;
 
-
   GST_LOG_OBJECT (this, "Empty buffer callback for buffer %d %p->%p->%p", id,
       buffer, buffer->pBuffer, bufdata);
 
-  bufdata->buffer = NULL;
-  /*We need to return the buffer first in order to avoid race condition */
-  error = gst_omx_buf_tab_return_buffer (pad->buffers, buffer);
-  if (GST_OMX_FAIL (error))
-    goto noreturn;
+  gstbuf = g_atomic_pointer_get (&bufdata->buffer);
+  if (G_UNLIKELY (!gstbuf))
+    gstbuf = gst_omx_base_wait_buffer (this, bufdata);
+  if (!gstbuf)
+    goto nobuffer;
+
+  g_atomic_pointer_set (&bufdata->buffer, NULL);
+  /* Our own buffers go back to the table when upstream drops them too */
+  if (!GST_OMX_BASE_IS_OWN_BUFFER (gstbuf)) {
+    /*We need to return the buffer first in order to avoid race condition */
+    error = gst_omx_buf_tab_return_buffer (pad->buffers, buffer);
+    if (GST_OMX_FAIL (error))
+      goto noreturn;
+  }
 
   gst_buffer_unref (gstbuf);
 
-/*
-  g_mutex_lock (&this->waitmutex);
-  g_cond_signal (&this->waitcond);
-  g_mutex_unlock (&this->waitmutex);
-*/
   return error;
 
+nobuffer:
+  {
+    GST_ELEMENT_ERROR (this, LIBRARY, ENCODE,
+        ("Buffer %d was emptied but never sent to the component", id), (NULL));
+    error = OMX_ErrorTimeout;
+    return error;
+  }
 noreturn:
   {
     GST_ELEMENT_ERROR (this, LIBRARY, ENCODE,
@@ -1672,6 +3741,47 @@ noreturn:
   }
 }
 
+/* Hands the GstBuffer being emptied over to the EmptyBufferDone callback,
+ * waking it up if it arrived before the buffer was published */
+static void
+gst_omx_base_publish_buffer (GstOmxBase * this, GstOmxBufferData * bufdata,
+    GstBuffer * buffer)
+{
+  g_atomic_pointer_set (&bufdata->buffer, buffer);
+
+  if (G_UNLIKELY (g_atomic_int_get (&this->empty_waiters))) {
+    g_mutex_lock (&this->waitmutex);
+    g_cond_broadcast (&this->waitcond);
+    g_mutex_unlock (&this->waitmutex);
+  }
+}
+
+/* Slow path of the EmptyBufferDone callback, blocks until the buffer that
+ * was emptied gets published or a timeout occurs */
+static GstBuffer *
+gst_omx_base_wait_buffer (GstOmxBase * this, GstOmxBufferData * bufdata)
+{
+  GstBuffer *buffer = NULL;
+  guint64 endtime;
+
+  GST_DEBUG_OBJECT (this, "Buffer %d emptied before being published, waiting",
+      bufdata->id);
+
+  endtime = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&this->waitmutex);
+  g_atomic_int_inc (&this->empty_waiters);
+
+  while (!(buffer = g_atomic_pointer_get (&bufdata->buffer)))
+    if (!g_cond_wait_until (&this->waitcond, &this->waitmutex, endtime))
+      break;
+
+  g_atomic_int_add (&this->empty_waiters, -1);
+  g_mutex_unlock (&this->waitmutex);
+
+  return buffer;
+}
+
 gboolean
 gst_omx_base_add_pad (GstOmxBase * this, GstPad * pad)
 {
@@ -1679,11 +3789,18 @@ gst_omx_base_add_pad (GstOmxBase * this, GstPad * pad)
 
   if (GST_PAD_SINK == GST_PAD_DIRECTION (pad)) {
     gst_pad_set_chain_function (pad, GST_DEBUG_FUNCPTR (gst_omx_base_chain));
+    gst_pad_set_chain_list_function (pad,
+        GST_DEBUG_FUNCPTR (gst_omx_base_chain_list));
     gst_pad_set_event_function (pad,
         GST_DEBUG_FUNCPTR (gst_omx_base_event_handler));
     gst_pad_set_setcaps_function (pad,
         GST_DEBUG_FUNCPTR (gst_omx_base_set_caps));
     gst_pad_set_bufferalloc_function (pad, gst_omx_base_alloc_buffer);
+  } else {
+    gst_pad_set_event_function (pad,
+        GST_DEBUG_FUNCPTR (gst_omx_base_src_event));
+    gst_pad_set_query_function (pad,
+        GST_DEBUG_FUNCPTR (gst_omx_base_src_query));
   }
 
   gst_object_ref (pad);
@@ -1741,6 +3858,9 @@ gst_omx_base_condition_disabled (gpointer enabled, gpointer dummy)
   return !*(gboolean *) enabled;
 }
 
+/* Lets upstream write straight into the input port buffers. Whenever the
+ * data would need repacking, or the port buffers are too small, no buffer
+ * is returned so the core falls back to a regular one that gets copied */
 static GstFlowReturn
 gst_omx_base_alloc_buffer (GstPad * pad, guint64 offset,
     guint size, GstCaps * caps, GstBuffer ** buffer)
@@ -1759,10 +3879,23 @@ gst_omx_base_alloc_buffer (GstPad * pad, guint64 offset,
       GST_DEBUG_PAD_NAME (pad), capsdesc, size);
   g_free (capsdesc);
 
+  if (!caps)
+    goto fallback;
+
   this->requested_size = size;
   if (!gst_pad_set_caps (pad, caps))
     goto invalidcaps;
 
+  /* The component splits the fields of shared buffers itself */
+  if (this->interlaced)
+    goto fallback;
+
+  if (!this->started) {
+    error = gst_omx_base_wait_start (this);
+    if (GST_OMX_FAIL (error))
+      goto nostart;
+  }
+
   if (!this->started) {
     GST_INFO_OBJECT (this, "Starting component");
     error = gst_omx_base_start (this, NULL);
@@ -1770,30 +3903,60 @@ gst_omx_base_alloc_buffer (GstPad * pad, guint64 offset,
       goto nostart;
   }
 
+  if (size > GST_OMX_PAD_PORT (omxpad)->nBufferSize)
+    goto fallback;
+
+  if (!omxpad->copy.configured)
+    gst_omx_copy_configure (&omxpad->copy, caps, GST_OMX_PAD_PORT (omxpad));
+  if (GST_OMX_COPY_FLAT != omxpad->copy.mode)
+    goto fallback;
+
   /* If we are here, buffers were successfully allocated */
   error = gst_omx_buf_tab_get_free_buffer (omxpad->buffers, &omxbuf);
+  if (OMX_ErrorNotReady == error)
+    goto cancelled;
   if (GST_OMX_FAIL (error))
     goto nofreebuf;
 
   gst_omx_buf_tab_use_buffer (omxpad->buffers, omxbuf);
 
-  GST_DEBUG_OBJECT (this, "Alloc buffer returned buffer with size %d",
-      (int) omxbuf->nAllocLen);
+  GST_LOG_OBJECT (this, "Alloc buffer returned buffer %p->%p with size %d",
+      omxbuf, omxbuf->pBuffer, (int) omxbuf->nAllocLen);
 
+  /* The buffer goes back to the table once the component emptied it and
+   * upstream dropped it, see gst_omx_base_alloc_free */
   *buffer = gst_buffer_new ();
-  GST_BUFFER_SIZE (*buffer) = omxbuf->nAllocLen;
-  GST_BUFFER_DATA (*buffer) = (guint8 *) omxbuf;
-  GST_BUFFER_MALLOCDATA (*buffer) = NULL;
+  GST_BUFFER_SIZE (*buffer) = size;
+  GST_BUFFER_DATA (*buffer) = omxbuf->pBuffer;
+  GST_BUFFER_MALLOCDATA (*buffer) = (guint8 *) omxbuf;
+  GST_BUFFER_FREE_FUNC (*buffer) = gst_omx_base_alloc_free;
   GST_BUFFER_CAPS (*buffer) = gst_caps_ref (caps);
   GST_BUFFER_FLAGS (*buffer) |= GST_OMX_BUFFER_FLAG;
 
+  g_mutex_lock (&gst_omx_base_lent_lock);
+  if (!gst_omx_base_lent)
+    gst_omx_base_lent = g_hash_table_new (NULL, NULL);
+  g_hash_table_insert (gst_omx_base_lent, omxbuf, *buffer);
+  g_mutex_unlock (&gst_omx_base_lent_lock);
+
   return GST_FLOW_OK;
 
+fallback:
+  {
+    GST_DEBUG_OBJECT (this, "Can't share the %s:%s buffers, upstream data "
+        "will be copied", GST_DEBUG_PAD_NAME (pad));
+    return GST_FLOW_OK;
+  }
 invalidcaps:
   {
     GST_ERROR_OBJECT (this, "The caps weren't accepted");
     return GST_FLOW_NOT_NEGOTIATED;
   }
+cancelled:
+  {
+    GST_DEBUG_OBJECT (this, "Flushing, no buffer allocated");
+    return GST_FLOW_WRONG_STATE;
+  }
 nofreebuf:
   {
     GST_ERROR_OBJECT (this, "Unable to get free buffer: %s",
@@ -1808,6 +3971,76 @@ nostart:
   }
 }
 
+static void
+gst_omx_base_alloc_free (gpointer data)
+{
+  OMX_BUFFERHEADERTYPE *buffer = (OMX_BUFFERHEADERTYPE *) data;
+  GstOmxBufferData *bufdata;
+  GstOmxPad *pad;
+
+  /* The port may be gone, don't look into the header before knowing */
+  g_mutex_lock (&gst_omx_base_lent_lock);
+  if (!g_hash_table_remove (gst_omx_base_lent, buffer))
+    goto orphaned;
+
+  bufdata = (GstOmxBufferData *) buffer->pAppPrivate;
+  pad = bufdata->pad;
+
+  GST_LOG_OBJECT (pad, "Upstream released buffer %d %p->%p", bufdata->id,
+      buffer, buffer->pBuffer);
+
+  gst_omx_buf_tab_return_buffer (pad->buffers, buffer);
+  g_mutex_unlock (&gst_omx_base_lent_lock);
+
+  return;
+
+orphaned:
+  {
+    g_mutex_unlock (&gst_omx_base_lent_lock);
+    GST_LOG ("Upstream released orphaned buffer %p", buffer);
+  }
+}
+
+/* Takes the buffers lent to upstream away from a port about to free them.
+ * Each one keeps a copy of its data and is freed as a regular buffer, the
+ * header goes back to the table so freeing it doesn't wait */
+static void
+gst_omx_base_orphan_pad (GstOmxBase * this, GstOmxPad * pad)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  OMX_BUFFERHEADERTYPE *buffer;
+  GstBuffer *gstbuf;
+  guint8 *data;
+
+  g_mutex_lock (&gst_omx_base_lent_lock);
+  if (!gst_omx_base_lent)
+    goto done;
+
+  g_hash_table_iter_init (&iter, gst_omx_base_lent);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    buffer = (OMX_BUFFERHEADERTYPE *) key;
+    gstbuf = GST_BUFFER (value);
+    if (((GstOmxBufferData *) buffer->pAppPrivate)->pad != pad)
+      continue;
+
+    GST_DEBUG_OBJECT (this, "Orphaning buffer %p->%p still held upstream of "
+        "%s:%s", buffer, buffer->pBuffer, GST_DEBUG_PAD_NAME (pad));
+
+    data = g_memdup (GST_BUFFER_DATA (gstbuf), GST_BUFFER_SIZE (gstbuf));
+    GST_BUFFER_DATA (gstbuf) = data;
+    GST_BUFFER_MALLOCDATA (gstbuf) = data;
+    GST_BUFFER_FREE_FUNC (gstbuf) = g_free;
+    GST_BUFFER_FLAG_UNSET (gstbuf, GST_OMX_BUFFER_FLAG);
+
+    gst_omx_buf_tab_return_buffer (pad->buffers, buffer);
+    g_hash_table_iter_remove (&iter);
+  }
+
+done:
+  g_mutex_unlock (&gst_omx_base_lent_lock);
+}
+
 
 void
 gst_omx_base_release_buffer (gpointer data)
@@ -1822,8 +4055,17 @@ gst_omx_base_release_buffer (gpointer data)
 
   GST_LOG_OBJECT (this, "Returning buffer %p to table", buffer);
 
+  GST_OBJECT_LOCK (pad);
+  flushing = pad->reconfiguring;
+  GST_OBJECT_UNLOCK (pad);
+
+  /* Checking the flag and returning the buffer must not interleave with
+   * the snapshot of gst_omx_base_refill_pad, see there */
+  g_mutex_lock (this->omx_lock);
+
+  /* An emulated flush keeps the component fed */
   GST_OBJECT_LOCK (this);
-  flushing = this->flushing;
+  flushing |= this->flushing && !this->flush_emulated;
   GST_OBJECT_UNLOCK (this);
 
   error = gst_omx_buf_tab_return_buffer (pad->buffers, buffer);
@@ -1833,9 +4075,8 @@ gst_omx_base_release_buffer (gpointer data)
   if (flushing)
     goto flushing;
 
-  g_mutex_lock (&_omx_mutex);
   error = this->component->FillThisBuffer (this->handle, buffer);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto nofill;
 
@@ -1843,12 +4084,14 @@ gst_omx_base_release_buffer (gpointer data)
 
 noreturn:
   {
+    g_mutex_unlock (this->omx_lock);
     GST_ELEMENT_ERROR (GST_ELEMENT (this), LIBRARY, ENCODE,
         ("Malformed buffer list"), (NULL));
     return;
   }
 flushing:
   {
+    g_mutex_unlock (this->omx_lock);
     GST_DEBUG_OBJECT (this,
         "Discarded buffer %p->%p due to flushing component", buffer,
         buffer->pBuffer);
@@ -1890,6 +4133,9 @@ gst_omx_base_event_handler (GstPad * pad, GstEvent * event)
 	    g_cond_wait(this->num_buffers_cond,this->num_buffers_mutex);
 	    g_mutex_unlock(this->num_buffers_mutex);
 	  }
+      /* Let the output tasks push what is already queued */
+      gst_omx_base_for_each_pad (this, gst_omx_base_drain_push_task,
+          GST_PAD_SRC, NULL);
       GST_INFO_OBJECT (this, "EOS received, flushing ports");
       GST_OBJECT_LOCK (this);
       this->flushing = TRUE;
@@ -1904,6 +4150,41 @@ gst_omx_base_event_handler (GstPad * pad, GstEvent * event)
       }
       break;
     }
+    case GST_EVENT_FLUSH_START:
+      /* Downstream first, so the output tasks stop pushing */
+      gst_pad_event_default (pad, event);
+      error = gst_omx_base_flush_start (this);
+      if (GST_OMX_FAIL (error))
+        goto noflush;
+      return TRUE;
+    case GST_EVENT_NEWSEGMENT:
+    {
+      gboolean update;
+      gdouble rate, applied_rate;
+      GstFormat format;
+      gint64 start, stop, position;
+
+      gst_event_parse_new_segment_full (event, &update, &rate, &applied_rate,
+          &format, &start, &stop, &position);
+      if (GST_FORMAT_TIME == format) {
+        GST_OBJECT_LOCK (this);
+        gst_segment_set_newsegment_full (&this->segment, update, rate,
+            applied_rate, format, start, stop, position);
+        GST_OBJECT_UNLOCK (this);
+      }
+      break;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      GST_OBJECT_LOCK (this);
+      gst_segment_init (&this->segment, GST_FORMAT_TIME);
+      this->earliest_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (this);
+      error = gst_omx_base_flush_stop (this);
+      if (GST_OMX_FAIL (error)) {
+        gst_event_unref (event);
+        goto noflush;
+      }
+      break;
     default:
       break;
   }
@@ -1916,4 +4197,98 @@ noflush_eos:
   GST_ERROR_OBJECT (this, "Unable to flush component after EOS: %s ",
       gst_omx_error_to_str (error));
   return FALSE;
+noflush:
+  GST_ERROR_OBJECT (this, "Unable to flush component: %s",
+      gst_omx_error_to_str (error));
+  return FALSE;
+}
+
+/* Upstream events on the src pads, QoS is kept for the chain function
+ * and forwarded */
+static gboolean
+gst_omx_base_src_event (GstPad * pad, GstEvent * event)
+{
+  GstOmxBase *this = GST_OMX_BASE (GST_OBJECT_PARENT (pad));
+  gdouble proportion;
+  GstClockTimeDiff diff;
+  GstClockTime timestamp;
+
+  if (GST_EVENT_QOS == GST_EVENT_TYPE (event)) {
+    gst_event_parse_qos (event, &proportion, &diff, &timestamp);
+
+    GST_OBJECT_LOCK (this);
+    if (GST_CLOCK_TIME_IS_VALID (timestamp))
+      this->earliest_time = timestamp + diff;
+    else
+      this->earliest_time = GST_CLOCK_TIME_NONE;
+    GST_OBJECT_UNLOCK (this);
+
+    GST_LOG_OBJECT (this, "QoS: proportion %g, diff %" G_GINT64_FORMAT
+        ", earliest %" GST_TIME_FORMAT, proportion, diff,
+        GST_TIME_ARGS (this->earliest_time));
+  }
+
+  return gst_pad_event_default (pad, event);
+}
+
+/* Answers the latency query with the upstream latency plus the delay
+ * measured on the component and the frames the output port can hold */
+static gboolean
+gst_omx_base_src_query (GstPad * pad, GstQuery * query)
+{
+  GstOmxBase *this = GST_OMX_BASE (GST_OBJECT_PARENT (pad));
+  GstClockTime min, max, ownmin, ownmax;
+  GstPad *sinkpad = NULL;
+  gboolean live;
+  GList *l;
+
+  if (GST_QUERY_LATENCY != GST_QUERY_TYPE (query))
+    return gst_pad_query_default (pad, query);
+
+  for (l = this->pads; l && !sinkpad; l = l->next)
+    if (GST_PAD_IS_SINK (l->data))
+      sinkpad = GST_PAD (l->data);
+
+  if (!sinkpad || !gst_pad_peer_query (sinkpad, query))
+    return FALSE;
+
+  gst_query_parse_latency (query, &live, &min, &max);
+
+  gst_omx_compute_latency (gst_omx_stats_get_latency (&this->stats),
+      GST_PAD_CAPS (pad),
+      GST_OMX_PAD_PORT (GST_OMX_PAD (pad))->nBufferCountActual, &ownmin,
+      &ownmax);
+
+  GST_DEBUG_OBJECT (this, "Own latency min %" GST_TIME_FORMAT " max %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (ownmin), GST_TIME_ARGS (ownmax));
+
+  min += ownmin;
+  if (GST_CLOCK_TIME_IS_VALID (max))
+    max += ownmax;
+  gst_query_set_latency (query, live, min, max);
+
+  return TRUE;
+}
+
+/* Whether the buffer would reach downstream after the earliest time the
+ * last QoS event allows */
+static gboolean
+gst_omx_base_is_late (GstOmxBase * this, GstBuffer * buf)
+{
+  GstClockTime timestamp = GST_BUFFER_TIMESTAMP (buf);
+  GstClockTime qostime, earliest;
+  gboolean qos;
+
+  if (!this->qos_droppable || !GST_CLOCK_TIME_IS_VALID (timestamp))
+    return FALSE;
+
+  GST_OBJECT_LOCK (this);
+  qos = this->qos;
+  earliest = this->earliest_time;
+  qostime = gst_segment_to_running_time (&this->segment, GST_FORMAT_TIME,
+      timestamp);
+  GST_OBJECT_UNLOCK (this);
+
+  return qos && GST_CLOCK_TIME_IS_VALID (earliest)
+      && GST_CLOCK_TIME_IS_VALID (qostime) && qostime <= earliest;
 }
@@ -23,6 +23,7 @@
 #define __GST_OMX_BASE_H__
 
 #include "gstomx.h"
+#include "gstomxcache.h"
 
 G_BEGIN_DECLS
 #define GST_TYPE_OMX_BASE			\
@@ -40,6 +41,31 @@ G_BEGIN_DECLS
 typedef struct _GstOmxBase GstOmxBase;
 typedef struct _GstOmxBaseClass GstOmxBaseClass;
 
+/* Flags the properties that end up in the component configuration, a
+ * cached component is only reused with the same values */
+#define GST_OMX_PARAM_PORT GST_PARAM_USER_SHIFT
+
+typedef enum
+{
+  GST_OMX_BASE_PUSH_MODE_CALLBACK,
+  GST_OMX_BASE_PUSH_MODE_TASK
+} GstOmxBasePushMode;
+
+typedef enum
+{
+  GST_OMX_BASE_LEAKY_NO,
+  GST_OMX_BASE_LEAKY_UPSTREAM,
+  GST_OMX_BASE_LEAKY_DOWNSTREAM
+} GstOmxBaseLeaky;
+
+/* How chained buffer lists may be packed into a single input buffer */
+typedef enum
+{
+  GST_OMX_BASE_COALESCE_NONE,   /* One input buffer per group */
+  GST_OMX_BASE_COALESCE_UNIT,   /* Groups sharing a timestamp, e.g. NALs */
+  GST_OMX_BASE_COALESCE_STREAM  /* Any groups, e.g. PCM samples */
+} GstOmxBaseCoalesce;
+
 typedef OMX_ERRORTYPE (*GstOmxBasePadFunc) (GstOmxBase *, GstOmxPad *,
     gpointer);
 
@@ -51,6 +77,17 @@ struct _GstOmxBase
   OMX_COMPONENTTYPE *component;
   OMX_CALLBACKTYPE *callbacks;
 
+  /* Handle owned through the component cache, see the cache property */
+  GstOmxCacheEntry *entry;
+  gboolean cache;
+  gchar *cachekey;
+
+  /* Serializes the calls into the component, points either to
+   * omx_mutex or to the process wide _omx_mutex */
+  GMutex *omx_lock;
+  GMutex omx_mutex;
+  gboolean global_lock;
+
   guint32 requested_size;
   guint32 field_offset;
 
@@ -64,8 +101,9 @@ struct _GstOmxBase
 
   gboolean peer_alloc;
   gboolean flushing;
+  gboolean flush_emulated;      /* Flushing by recycling, see audio_component */
   gboolean started;
-  gboolean first_buffer;
+  gboolean shared;              /* Sink ports use the upstream buffers */
   gboolean interlaced;
   gboolean audio_component;
 
@@ -73,6 +111,38 @@ struct _GstOmxBase
   GMutex waitmutex;
   GCond waitcond;
 
+  /* EmptyBufferDone callbacks waiting for their buffer to be published */
+  volatile gint empty_waiters;
+
+  /* Output tasks, see the push-mode property */
+  GstOmxBasePushMode push_mode;
+  guint queue_depth;
+  GstOmxBaseLeaky leaky;
+  GMutex pushmutex;
+  GCond pushcond;
+  volatile gint push_waiters;
+
+  /* Bring-up in the start pool, see the async-start property */
+  gboolean async_start;
+  gboolean starting;
+  OMX_ERRORTYPE start_error;
+  GMutex startmutex;
+  GCond startcond;
+
+  /* Late input dropping, see the qos property. The segment and the
+   * earliest time are protected by the object lock */
+  gboolean qos;
+  gboolean qos_droppable;
+  GstSegment segment;
+  GstClockTime earliest_time;
+
+  /* Packing of chained buffer lists, derived from the sink caps */
+  GstOmxBaseCoalesce coalesce;
+
+  GstOmxStats stats;
+  guint low_watermark;
+  guint copy_threads;
+
   GstFlowReturn fill_ret;
 
   GList *pads;
@@ -89,6 +159,13 @@ struct _GstOmxBaseClass
     GstFlowReturn (*omx_fill_buffer) (GstOmxBase *, OMX_BUFFERHEADERTYPE *);
     GstFlowReturn (*omx_empty_buffer) (GstOmxBase *, OMX_BUFFERHEADERTYPE *);
     OMX_ERRORTYPE (*init_ports) (GstOmxBase *);
+  /* Optional, rewrites the port definitions of a running component whose
+   * ports are disabled. Without it new caps restart the component */
+    OMX_ERRORTYPE (*update_ports) (GstOmxBase *);
+  /* Optional, rebuilds the format of a pad from the definition the
+   * component reported on PortSettingsChanged, before the port is enabled
+   * back. Src pads set their new caps here */
+    OMX_ERRORTYPE (*port_changed) (GstOmxBase *, GstOmxPad *);
     gboolean (*parse_caps) (GstPad *, GstCaps *);
   GstCaps *(*parse_buffer) (GstOmxBase *, GstBuffer *);
 
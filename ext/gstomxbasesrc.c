@@ -45,6 +45,7 @@
 #include "timm_osal_interfaces.h"
 
 #include "gstomxbasesrc.h"
+#include "gstomxutils.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_omx_base_src_debug);
 #define GST_CAT_DEFAULT gst_omx_base_src_debug
@@ -52,6 +53,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_omx_base_src_debug);
 
 #define GST_OMX_BASE_SRC_NUM_OUTPUT_BUFFERS_DEFAULT    8
 #define PROP_ALWAYS_COPY_DEFAULT          FALSE
+#define GST_OMX_BASE_SRC_STATS_INTERVAL_DEFAULT        0
+#define GST_OMX_BASE_SRC_LOW_WATERMARK_DEFAULT         0
 
 enum
 {
@@ -59,6 +62,10 @@ enum
   PROP_ALWAYS_COPY,
   PROP_PEER_ALLOC,
   PROP_NUM_OUTPUT_BUFFERS,
+  PROP_GLOBAL_LOCK,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
+  PROP_LOW_WATERMARK,
 };
 
 
@@ -117,6 +124,8 @@ static OMX_ERRORTYPE gst_omx_base_src_push_buffers (GstOmxBaseSrc * this,
     GstOmxPad * pad, gpointer data);
 static OMX_ERRORTYPE gst_omx_base_src_alloc_buffers (GstOmxBaseSrc * this,
     GstOmxPad * pad, gpointer data);
+static OMX_ERRORTYPE gst_omx_base_src_count_buffers (GstOmxBaseSrc * this,
+    GstOmxPad * pad, gpointer data);
 static OMX_ERRORTYPE gst_omx_base_src_for_each_pad (GstOmxBaseSrc * this,
     GstOmxBaseSrcPadFunc func, GstPadDirection direction, gpointer data);
 static OMX_ERRORTYPE gst_omx_base_src_event_callback (OMX_HANDLETYPE handle,
@@ -133,6 +142,7 @@ static OMX_ERRORTYPE gst_omx_base_src_set_flushing_pad (GstOmxBaseSrc * this,
 static OMX_ERRORTYPE gst_omx_base_src_peer_alloc_buffer (GstOmxBaseSrc * this,
     GstOmxPad * pad, gpointer * pbuffer, guint32 * size);
 static gboolean gst_omx_base_src_event (GstBaseSrc * src, GstEvent * event);
+static gboolean gst_omx_base_src_query (GstBaseSrc * src, GstQuery * query);
 static GstFlowReturn
 gst_omx_base_src_get_buffer (GstOmxBaseSrc * this, GstBuffer ** buffer);
 static gboolean gst_omx_base_src_check_caps (GstPad * pad, GstCaps * newcaps);
@@ -178,6 +188,14 @@ gst_omx_base_src_init (GstOmxBaseSrc * this, gpointer g_class)
   g_cond_init (&this->waitcond);
   this->pending_buffers = gst_omx_buf_queue_new ();
 
+  gst_omx_stats_init (&this->stats);
+  this->stats.interval = GST_OMX_BASE_SRC_STATS_INTERVAL_DEFAULT;
+  this->low_watermark = GST_OMX_BASE_SRC_LOW_WATERMARK_DEFAULT;
+
+  this->global_lock = GST_OMX_GLOBAL_LOCK_DEFAULT;
+  g_mutex_init (&this->omx_mutex);
+  this->omx_lock = this->global_lock ? &_omx_mutex : &this->omx_mutex;
+
   error = gst_omx_base_src_allocate_omx (this, klass->handle_name);
 
   if (GST_OMX_FAIL (error)) {
@@ -237,9 +255,36 @@ gst_omx_base_src_class_init (GstOmxBaseSrcClass * klass)
           "If the output buffer should be copied or should use the OpenMax buffer",
           PROP_ALWAYS_COPY_DEFAULT, G_PARAM_WRITABLE));
 
+  g_object_class_install_property (gobject_class, PROP_GLOBAL_LOCK,
+      g_param_spec_boolean ("global-lock", "Global lock",
+          "Serialize the calls to the component with the process wide lock, "
+          "for components that are not reentrant",
+          GST_OMX_GLOBAL_LOCK_DEFAULT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Frame counters, startup time and latency and output wait "
+          "min/avg/p99 in nanoseconds over the last frames",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Statistics interval",
+          "Milliseconds between element messages with the statistics "
+          "(0 : no messages)",
+          0, G_MAXUINT, GST_OMX_BASE_SRC_STATS_INTERVAL_DEFAULT,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_LOW_WATERMARK,
+      g_param_spec_uint ("low-watermark", "Low watermark",
+          "Post a warning when less than this many buffers of a port are "
+          "free (0 : disabled)",
+          0, G_MAXUINT, GST_OMX_BASE_SRC_LOW_WATERMARK_DEFAULT,
+          G_PARAM_READWRITE));
+
   pushsrc_class->create = GST_DEBUG_FUNCPTR (gst_omx_base_src_create);
   base_src_class->set_caps = GST_DEBUG_FUNCPTR (gst_omx_base_src_set_caps);
   base_src_class->event = GST_DEBUG_FUNCPTR (gst_omx_base_src_event);
+  base_src_class->query = GST_DEBUG_FUNCPTR (gst_omx_base_src_query);
 
 }
 
@@ -254,6 +299,10 @@ gst_omx_base_src_finalize (GObject * object)
   g_list_free_full (this->pads, gst_object_unref);
   gst_omx_base_src_free_omx (this);
 
+  g_mutex_clear (&this->omx_mutex);
+
+  gst_omx_stats_clear (&this->stats);
+
   /* Chain up to the parent class */
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -280,6 +329,25 @@ gst_omx_base_src_set_property (GObject * object, guint prop_id,
       this->always_copy = g_value_get_boolean (value);
       GST_INFO_OBJECT (this, "Setting always_copy to %d", this->always_copy);
       break;
+    case PROP_GLOBAL_LOCK:
+      if (this->started) {
+        GST_WARNING_OBJECT (this, "Unable to change the lock while running");
+        break;
+      }
+      this->global_lock = g_value_get_boolean (value);
+      this->omx_lock = this->global_lock ? &_omx_mutex : &this->omx_mutex;
+      GST_INFO_OBJECT (this, "Setting global-lock to %d", this->global_lock);
+      break;
+    case PROP_STATS_INTERVAL:
+      this->stats.interval = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting stats-interval to %d",
+          this->stats.interval);
+      break;
+    case PROP_LOW_WATERMARK:
+      this->low_watermark = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting low-watermark to %d",
+          this->low_watermark);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -291,6 +359,7 @@ gst_omx_base_src_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
   GstOmxBaseSrc *this = GST_OMX_BASE_SRC (object);
+  GstStructure *structure;
 
   switch (prop_id) {
     case PROP_PEER_ALLOC:
@@ -302,6 +371,20 @@ gst_omx_base_src_get_property (GObject * object, guint prop_id,
     case PROP_ALWAYS_COPY:
       g_value_set_boolean (value, this->always_copy);
       break;
+    case PROP_GLOBAL_LOCK:
+      g_value_set_boolean (value, this->global_lock);
+      break;
+    case PROP_STATS:
+      structure = gst_omx_stats_get_structure (&this->stats);
+      g_list_foreach (this->pads, gst_omx_pad_append_stats, structure);
+      g_value_take_boxed (value, structure);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, this->stats.interval);
+      break;
+    case PROP_LOW_WATERMARK:
+      g_value_set_uint (value, this->low_watermark);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -527,10 +610,10 @@ gst_omx_base_src_stop (GstOmxBaseSrc * this)
       goto noflush;
   }
   GST_INFO_OBJECT (this, "Sending handle to Idle");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   error = OMX_SendCommand (this->handle, OMX_CommandStateSet, OMX_StateIdle,
       NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto statechange;
 
@@ -542,10 +625,10 @@ gst_omx_base_src_stop (GstOmxBaseSrc * this)
     goto statechange;
 
   GST_INFO_OBJECT (this, "Sending handle to Loaded");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   error = OMX_SendCommand (this->handle, OMX_CommandStateSet, OMX_StateLoaded,
       NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto statechange;
 
@@ -719,10 +802,10 @@ gst_omx_base_src_free_buffers (GstOmxBaseSrc * this, GstOmxPad * pad,
     buffers = pad->buffers->table;
 
     g_free (buffer->pAppPrivate);
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (this->omx_lock);
     error = OMX_FreeBuffer (this->handle, GST_OMX_PAD_PORT (pad)->nPortIndex,
         buffer);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (this->omx_lock);
     if (GST_OMX_FAIL (error))
       goto nofree;
   }
@@ -796,10 +879,10 @@ gst_omx_base_src_flush_ports (GstOmxBaseSrc * this, GstOmxPad * pad,
   if (GST_PAD_IS_SRC (pad))
     return error;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   GST_DEBUG_OBJECT (this, "Setting handle to flush");
   error = OMX_SendCommand (this->handle, OMX_CommandFlush, -1, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
 
   GST_DEBUG_OBJECT (this, "Waiting for port to flush");
   error = gst_omx_base_src_wait_for_condition (this,
@@ -928,6 +1011,7 @@ gst_omx_base_src_get_buffer (GstOmxBaseSrc * this, GstBuffer ** buffer)
   GstOmxBufferData *bufdata = NULL;
   gboolean i = FALSE;
   GstOmxBaseSrcClass *klass = GST_OMX_BASE_SRC_GET_CLASS (this);
+  GstMessage *message;
 
   omx_buf = gst_omx_buf_queue_pop_buffer (this->pending_buffers);
 
@@ -936,26 +1020,21 @@ gst_omx_base_src_get_buffer (GstOmxBaseSrc * this, GstBuffer ** buffer)
   }
 
   bufdata = (GstOmxBufferData *) omx_buf->pAppPrivate;
+  gst_omx_stats_frame_out (&this->stats, bufdata->stamp);
 
   GST_LOG_OBJECT (this, "Handling buffer: 0x%08x %" G_GUINT64_FORMAT,
       (guint) omx_buf->nFlags, (guint64) omx_buf->nTimeStamp);
 
   GST_LOG_OBJECT (this, "Handling output data");
 
-  if (this->always_copy) {
-    /* TODO: Add always_copy handler, copy the data in a
-       gstreamer buffer and return the omxbuffer to the buftab 
-       For now we do the same in both cases
-     */
-    *buffer = gst_buffer_new ();
-    if (!*buffer)
-      goto noalloc;
-
-  } else {
-    *buffer = gst_buffer_new ();
-    if (!*buffer)
-      goto noalloc;
-  }
+  /* TODO: Add always_copy handler, copy the data in a
+     gstreamer buffer and return the omxbuffer to the buftab 
+     For now we wrap the omxbuffer in both cases
+   */
+  *buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool,
+      GST_BASE_SRC_PAD (this), omx_buf, gst_omx_base_src_release_buffer);
+  if (!*buffer)
+    goto nocaps;
 
   if (klass->omx_create) {
     this->create_ret = klass->omx_create (this, omx_buf, buffer);
@@ -974,14 +1053,16 @@ gst_omx_base_src_get_buffer (GstOmxBaseSrc * this, GstBuffer ** buffer)
       GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (*buffer)),
       GST_TIME_ARGS (GST_BUFFER_DURATION (*buffer)));
 
+  message = gst_omx_stats_poll_message (&this->stats, GST_OBJECT (this));
+  if (message)
+    gst_element_post_message (GST_ELEMENT (this), message);
 
   return GST_FLOW_OK;
-noalloc:
-
+nocaps:
   {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
+    GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
+    gst_omx_base_src_release_buffer (omx_buf);
+    return GST_FLOW_NOT_NEGOTIATED;
   }
 timeout:
   {
@@ -1003,15 +1084,19 @@ static OMX_ERRORTYPE
 gst_omx_base_src_start (GstOmxBaseSrc * this, OMX_BUFFERHEADERTYPE * omxpeerbuf)
 {
   OMX_ERRORTYPE error = OMX_ErrorNone;
+  guint numbuffers = 0;
+  gint64 begin;
 
   if (this->started)
     goto alreadystarted;
 
+  begin = g_get_monotonic_time ();
+
   GST_INFO_OBJECT (this, "Sending handle to Idle");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   error = OMX_SendCommand (this->handle, OMX_CommandStateSet, OMX_StateIdle,
       NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto starthandle;
 
@@ -1022,6 +1107,17 @@ gst_omx_base_src_start (GstOmxBaseSrc * this, OMX_BUFFERHEADERTYPE * omxpeerbuf)
   if (GST_OMX_FAIL (error))
     goto noalloc;
 
+  error =
+      gst_omx_base_src_for_each_pad (this, gst_omx_base_src_count_buffers,
+      GST_PAD_SRC, &numbuffers);
+  if (GST_OMX_FAIL (error))
+    goto noalloc;
+
+  GST_INFO_OBJECT (this, "Sizing pending queue for %u buffers", numbuffers);
+  error = gst_omx_buf_queue_set_size (this->pending_buffers, numbuffers);
+  if (GST_OMX_FAIL (error))
+    goto noqueue;
+
   GST_INFO_OBJECT (this, "Waiting for handle to become Idle");
   error = gst_omx_base_src_wait_for_condition (this,
       gst_omx_base_src_condition_state, (gpointer) OMX_StateIdle,
@@ -1030,10 +1126,10 @@ gst_omx_base_src_start (GstOmxBaseSrc * this, OMX_BUFFERHEADERTYPE * omxpeerbuf)
     goto starthandle;
 
   GST_INFO_OBJECT (this, "Sending handle to Executing");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (this->omx_lock);
   error = OMX_SendCommand (this->handle, OMX_CommandStateSet,
       OMX_StateExecuting, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto starthandle;
 
@@ -1044,6 +1140,8 @@ gst_omx_base_src_start (GstOmxBaseSrc * this, OMX_BUFFERHEADERTYPE * omxpeerbuf)
   if (GST_OMX_FAIL (error))
     goto starthandle;
 
+  gst_omx_stats_reset (&this->stats);
+
   GST_INFO_OBJECT (this, "Pushing output buffers");
   error =
       gst_omx_base_src_for_each_pad (this, gst_omx_base_src_push_buffers,
@@ -1051,6 +1149,8 @@ gst_omx_base_src_start (GstOmxBaseSrc * this, OMX_BUFFERHEADERTYPE * omxpeerbuf)
   if (GST_OMX_FAIL (error))
     goto nopush;
 
+  gst_omx_stats_set_startup (&this->stats, g_get_monotonic_time () - begin);
+
   //this->started = TRUE;
 
   return error;
@@ -1070,6 +1170,12 @@ noalloc:
     GST_ERROR_OBJECT (this, "Unable to allocate resources for buffers");
     return error;
   }
+noqueue:
+  {
+    GST_ERROR_OBJECT (this, "Unable to size the pending buffers queue: %s",
+        gst_omx_error_to_str (error));
+    return error;
+  }
 nopush:
   {
     GST_ERROR_OBJECT (this, "Unable to push buffer into the output port");
@@ -1116,6 +1222,17 @@ nodownstream:
   }
 }
 
+static OMX_ERRORTYPE
+gst_omx_base_src_count_buffers (GstOmxBaseSrc * this, GstOmxPad * pad,
+    gpointer data)
+{
+  guint *numbuffers = (guint *) data;
+
+  *numbuffers += pad->port->nBufferCountActual;
+
+  return OMX_ErrorNone;
+}
+
 static OMX_ERRORTYPE
 gst_omx_base_src_alloc_buffers (GstOmxBaseSrc * this, GstOmxPad * pad,
     gpointer data)
@@ -1140,6 +1257,9 @@ gst_omx_base_src_alloc_buffers (GstOmxBaseSrc * this, GstOmxPad * pad,
   GST_DEBUG_OBJECT (this, "Allocating buffers for %s:%s",
       GST_DEBUG_PAD_NAME (GST_PAD (pad)));
 
+  gst_omx_buf_tab_set_low_watermark (pad->buffers, this->low_watermark,
+      gst_omx_pad_low_watermark, pad);
+
   for (i = 0; i < pad->port->nBufferCountActual; ++i) {
 
     /* First we try to ask for downstream OMX buffers */
@@ -1151,7 +1271,7 @@ gst_omx_base_src_alloc_buffers (GstOmxBaseSrc * this, GstOmxPad * pad,
       goto noalloc;
 
 
-    bufdata = (GstOmxBufferData *) g_malloc (sizeof (GstOmxBufferData));
+    bufdata = (GstOmxBufferData *) g_malloc0 (sizeof (GstOmxBufferData));
     bufdata->pad = pad;
     bufdata->buffer = NULL;
 
@@ -1165,10 +1285,10 @@ gst_omx_base_src_alloc_buffers (GstOmxBaseSrc * this, GstOmxPad * pad,
       GST_DEBUG_OBJECT (this, "Received buffer number %u:"
           "%p of size %d", bufdata->id, pbuffer, size);
 
-      g_mutex_lock (&_omx_mutex);
+      g_mutex_lock (this->omx_lock);
       error = OMX_UseBuffer (this->handle, &buffer,
           GST_OMX_PAD_PORT (pad)->nPortIndex, bufdata, size, pbuffer);
-      g_mutex_unlock (&_omx_mutex);
+      g_mutex_unlock (this->omx_lock);
       if (GST_OMX_FAIL (error))
         goto nouse;
       GST_DEBUG_OBJECT (this, "Saved buffer number %u:"
@@ -1178,10 +1298,10 @@ gst_omx_base_src_alloc_buffers (GstOmxBaseSrc * this, GstOmxPad * pad,
       maxsize = GST_OMX_PAD_PORT (pad)->nBufferSize > this->requested_size ?
           GST_OMX_PAD_PORT (pad)->nBufferSize : this->requested_size;
 
-      g_mutex_lock (&_omx_mutex);
+      g_mutex_lock (this->omx_lock);
       error = OMX_AllocateBuffer (this->handle, &buffer,
           GST_OMX_PAD_PORT (pad)->nPortIndex, bufdata, maxsize);
-      g_mutex_unlock (&_omx_mutex);
+      g_mutex_unlock (this->omx_lock);
       if (GST_OMX_FAIL (error))
         goto noalloc;
       GST_DEBUG_OBJECT (this, "Allocated buffer number %u: %p->%p", i, buffer,
@@ -1244,9 +1364,11 @@ gst_omx_base_src_push_buffers (GstOmxBaseSrc * this, GstOmxPad * pad,
     GST_DEBUG_OBJECT (this, "Pushing buffer number %u: %p of size %d", i,
         buffer, (int) buffer->nAllocLen);
 
-    g_mutex_lock (&_omx_mutex);
+    ((GstOmxBufferData *) buffer->pAppPrivate)->stamp =
+        g_get_monotonic_time ();
+    g_mutex_lock (this->omx_lock);
     error = this->component->FillThisBuffer (this->handle, buffer);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (this->omx_lock);
     if (GST_OMX_FAIL (error))
       goto nopush;
 
@@ -1280,6 +1402,7 @@ gst_omx_base_src_fill_callback (OMX_HANDLETYPE handle,
   GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
   OMX_ERRORTYPE error = OMX_ErrorNone;
   gboolean flushing;
+  gint64 now;
 
   GST_LOG_OBJECT (this, "Fill buffer callback for buffer %p->%p", outbuf,
       outbuf->pBuffer);
@@ -1307,7 +1430,18 @@ gst_omx_base_src_fill_callback (OMX_HANDLETYPE handle,
 
   gst_omx_buf_tab_use_buffer (bufdata->pad->buffers, outbuf);
 
+  /* Sources have no input, latency is how long the component kept the
+   * buffer */
+  now = g_get_monotonic_time ();
+  if (bufdata->stamp)
+    gst_omx_stats_add_sample (&this->stats, GST_OMX_STATS_LATENCY,
+        now - bufdata->stamp);
+  bufdata->stamp = now;
+  gst_omx_stats_frame_in (&this->stats, NULL, 0);
+
   error = gst_omx_buf_queue_push_buffer (this->pending_buffers, outbuf);
+  if (GST_OMX_FAIL (error))
+    gst_omx_stats_frame_dropped (&this->stats);
 
   return error;
 
@@ -1316,9 +1450,9 @@ illegal:
     GST_ERROR_OBJECT (this,
         "Double fill callback for buffer %p->%p, this should not happen",
         outbuf, outbuf->pBuffer);
-    /* g_mutex_lock (&_omx_mutex); */
+    /* g_mutex_lock (this->omx_lock); */
     /* error = this->component->FillThisBuffer (this->handle, outbuf); */
-    /* g_mutex_unlock (&_omx_mutex); */
+    /* g_mutex_unlock (this->omx_lock); */
     return error;
   }
 
@@ -1332,9 +1466,9 @@ flushing:
      {
      GST_LOG_OBJECT (this, "Dropping buffer, push error %s",
      gst_flow_get_name (this->fill_ret));
-     g_mutex_lock (&_omx_mutex);
+     g_mutex_lock (this->omx_lock);
      error = this->component->FillThisBuffer (this->handle, outbuf);
-     g_mutex_unlock (&_omx_mutex);
+     g_mutex_unlock (this->omx_lock);
      return error;
      } */
 }
@@ -1364,9 +1498,10 @@ gst_omx_base_src_release_buffer (gpointer data)
   if (flushing)
     goto flushing;
 
-  g_mutex_lock (&_omx_mutex);
+  bufdata->stamp = g_get_monotonic_time ();
+  g_mutex_lock (this->omx_lock);
   error = this->component->FillThisBuffer (this->handle, buffer);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (this->omx_lock);
   if (GST_OMX_FAIL (error))
     goto nofill;
 
@@ -1571,3 +1706,32 @@ noflush_eos:
       gst_omx_error_to_str (error));
   return FALSE;
 }
+
+/* Reports how long the component keeps a frame before handing it over,
+ * seeded with the delay seen on the first buffer until frames were
+ * measured */
+static gboolean
+gst_omx_base_src_query (GstBaseSrc * src, GstQuery * query)
+{
+  GstOmxBaseSrc *this = GST_OMX_BASE_SRC (src);
+  GstPad *pad = GST_BASE_SRC_PAD (src);
+  GstClockTime measured, min, max;
+
+  if (GST_QUERY_LATENCY != GST_QUERY_TYPE (query))
+    return GST_BASE_SRC_CLASS (parent_class)->query (src, query);
+
+  measured = gst_omx_stats_get_latency (&this->stats);
+  if (!GST_CLOCK_TIME_IS_VALID (measured) && this->started
+      && (GstClockTimeDiff) this->omx_delay > 0)
+    measured = this->omx_delay;
+
+  gst_omx_compute_latency (measured, GST_PAD_CAPS (pad),
+      GST_OMX_PAD_PORT (GST_OMX_PAD (pad))->nBufferCountActual, &min, &max);
+
+  GST_DEBUG_OBJECT (this, "Latency min %" GST_TIME_FORMAT " max %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (min), GST_TIME_ARGS (max));
+
+  gst_query_set_latency (query, gst_base_src_is_live (src), min, max);
+
+  return TRUE;
+}
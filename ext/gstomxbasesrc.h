@@ -55,6 +55,12 @@ struct _GstOmxBaseSrc
   OMX_CALLBACKTYPE *callbacks;
   GstOmxBufQueue *pending_buffers;
 
+  /* Serializes the calls into the component, points either to
+   * omx_mutex or to the process wide _omx_mutex */
+  GMutex *omx_lock;
+  GMutex omx_mutex;
+  gboolean global_lock;
+
   guint32 requested_size;
   guint32 field_offset;
 
@@ -71,6 +77,9 @@ struct _GstOmxBaseSrc
   GMutex waitmutex;
   GCond waitcond;
 
+  GstOmxStats stats;
+  guint low_watermark;
+
   GstFlowReturn create_ret;
 
   /*Sync related */
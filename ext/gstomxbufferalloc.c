@@ -137,7 +137,7 @@ gst_omx_buffer_alloc_class_init (GstOmxBufferAllocClass * klass)
     g_object_class_install_property (gobject_class, PROP_NUMBUFFERS,
                                      g_param_spec_uint ("numBuffers", "Number of buffers",
                                              "Number of buffers to be allocated by component",
-                                             1, 16, GST_OMX_BUFFERALLOC_NUMBUFFERS_DEFAULT,
+                                             1, GST_OMX_BUFFER_ID_MAX / 2, GST_OMX_BUFFERALLOC_NUMBUFFERS_DEFAULT,
                                              G_PARAM_READWRITE));
 
     GST_DEBUG_CATEGORY_INIT (gst_omxbufferalloc_debug, "omxbufferalloc",
@@ -301,7 +301,7 @@ void gst_omx_buffer_alloc_allocate_buffers (GstOmxBufferAlloc *this, GstOmxPad *
     this->heap = SharedRegion_getHeap(2);
     for (i = 0; i < this->num_buffers; i++)
     {
-        bufdata = (GstOmxBufferData *) g_malloc (sizeof (GstOmxBufferData));
+        bufdata = (GstOmxBufferData *) g_malloc0 (sizeof (GstOmxBufferData));
         bufdata->pad = pad;
         bufdata->buffer = NULL;
         bufdata->id = i;
@@ -0,0 +1,314 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gstomx.h"
+#include "gstomxbufpool.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_buf_pool_debug);
+#define GST_CAT_DEFAULT gst_omx_buf_pool_debug
+
+static gboolean gst_omx_buf_pool_debug_register = FALSE;
+
+#define GST_TYPE_OMX_POOL_BUFFER (gst_omx_pool_buffer_get_type ())
+
+typedef struct _GstOmxPoolBuffer GstOmxPoolBuffer;
+
+/* A GstBuffer that remembers the pool slot it belongs to */
+struct _GstOmxPoolBuffer
+{
+  GstBuffer buffer;
+
+  GstOmxBufPool *pool;
+  guint id;
+};
+
+static GstMiniObjectClass *gst_omx_pool_buffer_parent_class = NULL;
+
+static GType gst_omx_pool_buffer_get_type (void);
+static void gst_omx_buf_pool_unref (GstOmxBufPool * pool);
+
+/* Releases the OMX buffer and, unless the pool is closing, resurrects the
+ * wrapper into its slot. The caps are kept for the next push. */
+static void
+gst_omx_pool_buffer_finalize (GstOmxPoolBuffer * shell)
+{
+  GstBuffer *buffer = GST_BUFFER (shell);
+  GstOmxBufPool *pool = shell->pool;
+  GFreeFunc release = GST_BUFFER_FREE_FUNC (buffer);
+  guint8 *omxbuf = GST_BUFFER_MALLOCDATA (buffer);
+  gboolean recycled = FALSE;
+
+  GST_BUFFER_DATA (buffer) = NULL;
+  GST_BUFFER_SIZE (buffer) = 0;
+  GST_BUFFER_MALLOCDATA (buffer) = NULL;
+  GST_BUFFER_FREE_FUNC (buffer) = NULL;
+
+  /* Park the wrapper before releasing the OMX buffer, the component may
+   * fill it and we may push it again right away */
+  g_mutex_lock (&pool->poolmutex);
+  if (!pool->closing) {
+    gst_buffer_ref (buffer);
+    pool->busy[shell->id] = FALSE;
+    recycled = TRUE;
+  }
+  g_mutex_unlock (&pool->poolmutex);
+
+  if (release && omxbuf)
+    release (omxbuf);
+
+  if (recycled)
+    return;
+
+  GST_LOG ("Freeing wrapper %p of buffer id %u", shell, shell->id);
+
+  gst_omx_pool_buffer_parent_class->finalize (GST_MINI_OBJECT (shell));
+  gst_omx_buf_pool_unref (pool);
+}
+
+static void
+gst_omx_pool_buffer_class_init (gpointer g_class, gpointer class_data)
+{
+  GstMiniObjectClass *mini_object_class = GST_MINI_OBJECT_CLASS (g_class);
+
+  gst_omx_pool_buffer_parent_class = g_type_class_peek_parent (g_class);
+  mini_object_class->finalize =
+      (GstMiniObjectFinalizeFunction) gst_omx_pool_buffer_finalize;
+}
+
+static GType
+gst_omx_pool_buffer_get_type (void)
+{
+  static volatile gsize pool_buffer_type = 0;
+
+  if (g_once_init_enter (&pool_buffer_type)) {
+    static const GTypeInfo info = {
+      sizeof (GstBufferClass),
+      NULL,
+      NULL,
+      gst_omx_pool_buffer_class_init,
+      NULL,
+      NULL,
+      sizeof (GstOmxPoolBuffer),
+      0,
+      NULL,
+      NULL
+    };
+    GType type = g_type_register_static (GST_TYPE_BUFFER, "GstOmxPoolBuffer",
+        &info, 0);
+    g_once_init_leave (&pool_buffer_type, type);
+  }
+
+  return pool_buffer_type;
+}
+
+GstOmxBufPool *
+gst_omx_buf_pool_new ()
+{
+  GstOmxBufPool *pool = NULL;
+
+  if (!gst_omx_buf_pool_debug_register) {
+    /* debug category for fltering log messages */
+    GST_DEBUG_CATEGORY_INIT (gst_omx_buf_pool_debug, "omxbufpool", 0,
+        "OMX buffer wrapper pool");
+    gst_omx_buf_pool_debug_register = TRUE;
+  }
+
+  pool = g_malloc0 (sizeof (GstOmxBufPool));
+  if (!pool)
+    goto exit;
+
+  g_mutex_init (&pool->poolmutex);
+  pool->refcount = 1;
+  pool->closing = FALSE;
+  pool->shells = NULL;
+  pool->busy = NULL;
+  pool->numshells = 0;
+  pool->allocs = 0;
+
+exit:
+  return pool;
+}
+
+static void
+gst_omx_buf_pool_unref (GstOmxBufPool * pool)
+{
+  if (!g_atomic_int_dec_and_test (&pool->refcount))
+    return;
+
+  g_mutex_clear (&pool->poolmutex);
+  g_free (pool);
+}
+
+/* Drops the idle wrappers, the ones still downstream are freed instead of
+ * recycled when they come back */
+void
+gst_omx_buf_pool_free (GstOmxBufPool * pool)
+{
+  GSList *idle = NULL, *l;
+  guint i;
+
+  g_return_if_fail (pool);
+
+  g_mutex_lock (&pool->poolmutex);
+
+  pool->closing = TRUE;
+  for (i = 0; i < pool->numshells; i++)
+    if (pool->shells[i] && !pool->busy[i])
+      idle = g_slist_prepend (idle, pool->shells[i]);
+
+  g_free (pool->shells);
+  pool->shells = NULL;
+  g_free (pool->busy);
+  pool->busy = NULL;
+  pool->numshells = 0;
+
+  g_mutex_unlock (&pool->poolmutex);
+
+  /* Wait for the wrappers parked right now to leave their finalize,
+   * otherwise gst_mini_object_free would free them behind our back */
+  for (l = idle; l; l = l->next)
+    while (GST_MINI_OBJECT_REFCOUNT_VALUE (l->data) > 1)
+      g_thread_yield ();
+
+  g_slist_free_full (idle, (GDestroyNotify) gst_mini_object_unref);
+  gst_omx_buf_pool_unref (pool);
+}
+
+/* Slow path of get_buffer, with the pool mutex held. Creates the wrapper
+ * of a new id or, if the wrapper of the id is still downstream or in its
+ * finalize, a plain buffer */
+static GstBuffer *
+gst_omx_buf_pool_alloc (GstOmxBufPool * pool, guint id)
+{
+  GstOmxPoolBuffer *shell;
+  guint numshells;
+  guint i;
+
+  if (id >= pool->numshells) {
+    numshells = MAX (id + 1, pool->numshells * 2);
+    pool->shells = g_renew (GstBuffer *, pool->shells, numshells);
+    pool->busy = g_renew (gboolean, pool->busy, numshells);
+    for (i = pool->numshells; i < numshells; i++) {
+      pool->shells[i] = NULL;
+      pool->busy[i] = FALSE;
+    }
+    pool->numshells = numshells;
+  }
+
+  pool->allocs++;
+
+  if (pool->shells[id]) {
+    if (pool->busy[id])
+      GST_WARNING ("Wrapper of buffer id %u still in use", id);
+    else
+      GST_DEBUG ("Wrapper of buffer id %u still being parked", id);
+    return gst_buffer_new ();
+  }
+
+  GST_DEBUG ("Creating wrapper for buffer id %u", id);
+
+  shell = (GstOmxPoolBuffer *) gst_mini_object_new (GST_TYPE_OMX_POOL_BUFFER);
+  shell->pool = pool;
+  shell->id = id;
+  g_atomic_int_inc (&pool->refcount);
+
+  pool->shells[id] = GST_BUFFER (shell);
+  pool->busy[id] = TRUE;
+
+  return GST_BUFFER (shell);
+}
+
+/* Wraps a filled OMX buffer to be pushed through capspad. Returns NULL if
+ * capspad has no caps. Dropping the last reference calls release on the
+ * OMX buffer. */
+GstBuffer *
+gst_omx_buf_pool_get_buffer (GstOmxBufPool * pool, GstPad * capspad,
+    OMX_BUFFERHEADERTYPE * omxbuf, GFreeFunc release)
+{
+  GstOmxBufferData *bufdata;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  guint id;
+
+  g_return_val_if_fail (pool, NULL);
+  g_return_val_if_fail (omxbuf, NULL);
+
+  bufdata = (GstOmxBufferData *) omxbuf->pAppPrivate;
+  id = bufdata->id;
+  g_return_val_if_fail (id < GST_OMX_BUFFER_ID_MAX, NULL);
+
+  /* A wrapper parked by its finalize keeps the extra reference of
+   * gst_mini_object_free until the finalize returns, it can't be handed
+   * out before that reference is dropped */
+  g_mutex_lock (&pool->poolmutex);
+  if (G_LIKELY (id < pool->numshells && pool->shells[id]
+          && !pool->busy[id]
+          && 1 == GST_MINI_OBJECT_REFCOUNT_VALUE (pool->shells[id]))) {
+    buffer = pool->shells[id];
+    pool->busy[id] = TRUE;
+  } else {
+    buffer = gst_omx_buf_pool_alloc (pool, id);
+  }
+  g_mutex_unlock (&pool->poolmutex);
+
+  /* The caps only change on renegotiation, keep the ones we have */
+  GST_OBJECT_LOCK (capspad);
+  caps = GST_PAD_CAPS (capspad);
+  if (G_UNLIKELY (GST_BUFFER_CAPS (buffer) != caps))
+    gst_caps_replace (&GST_BUFFER_CAPS (buffer), caps);
+  GST_OBJECT_UNLOCK (capspad);
+
+  if (!caps)
+    goto nocaps;
+
+  GST_BUFFER_FLAGS (buffer) = 0;
+  GST_BUFFER_TIMESTAMP (buffer) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_OFFSET (buffer) = GST_BUFFER_OFFSET_NONE;
+  GST_BUFFER_OFFSET_END (buffer) = GST_BUFFER_OFFSET_NONE;
+
+  GST_BUFFER_DATA (buffer) = omxbuf->pBuffer;
+  GST_BUFFER_SIZE (buffer) = omxbuf->nFilledLen;
+  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) omxbuf;
+  GST_BUFFER_FREE_FUNC (buffer) = release;
+
+  return buffer;
+
+nocaps:
+  {
+    GST_DEBUG_OBJECT (capspad, "No negotiated caps to wrap buffer id %u", id);
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+}
+
+guint
+gst_omx_buf_pool_get_allocs (GstOmxBufPool * pool)
+{
+  guint allocs;
+
+  g_return_val_if_fail (pool, 0);
+
+  g_mutex_lock (&pool->poolmutex);
+  allocs = pool->allocs;
+  g_mutex_unlock (&pool->poolmutex);
+
+  return allocs;
+}
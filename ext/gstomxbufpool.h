@@ -0,0 +1,55 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_OMX_BUF_POOL_H__
+#define __GST_OMX_BUF_POOL_H__
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS typedef struct _GstOmxBufPool GstOmxBufPool;
+
+/* Recycles the GstBuffer wrappers pushed for the OMX buffers of a src
+ * port. There is one wrapper per buffer id, when downstream drops it the
+ * OMX buffer is released and the wrapper goes back to its slot instead of
+ * being freed, keeping its caps for the next push. */
+struct _GstOmxBufPool
+{
+  GMutex poolmutex;
+  volatile gint refcount;       /* The owner plus every live wrapper */
+  gboolean closing;
+
+  GstBuffer **shells;           /* Wrappers indexed by buffer id */
+  gboolean *busy;
+  guint numshells;
+
+  guint allocs;                 /* Wrappers and fallback buffers created */
+};
+
+GstOmxBufPool *gst_omx_buf_pool_new ();
+void gst_omx_buf_pool_free (GstOmxBufPool * pool);
+GstBuffer *gst_omx_buf_pool_get_buffer (GstOmxBufPool * pool,
+    GstPad * capspad, OMX_BUFFERHEADERTYPE * omxbuf, GFreeFunc release);
+guint gst_omx_buf_pool_get_allocs (GstOmxBufPool * pool);
+
+G_END_DECLS
+#endif /* __GST_OMX_BUF_POOL_H__ */
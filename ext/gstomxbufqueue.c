@@ -18,9 +18,18 @@
  * Boston, MA 02111-1307, USA.
  */
 
+
 #include "gstomx.h"
 #include "gstomxbufqueue.h"
 
+/* Enough for the biggest port buffer count, until set_size is called */
+#define GST_OMX_BUF_QUEUE_DEFAULT_SIZE 32
+
+static OMX_BUFFERHEADERTYPE *gst_omx_buf_queue_try_pop (GstOmxBufQueue *
+    bufqueue);
+static OMX_BUFFERHEADERTYPE *gst_omx_buf_queue_wait_pop (GstOmxBufQueue *
+    bufqueue, gboolean check_release);
+
 GstOmxBufQueue *
 gst_omx_buf_queue_new ()
 {
@@ -31,113 +40,168 @@ gst_omx_buf_queue_new ()
 
   g_mutex_init (&bufqueue->queuemutex);
   g_cond_init (&bufqueue->queuecond);
-  bufqueue->queue = g_queue_new ();
-  g_queue_init (bufqueue->queue);
+  bufqueue->size = GST_OMX_BUF_QUEUE_DEFAULT_SIZE;
+  bufqueue->ring = g_new0 (OMX_BUFFERHEADERTYPE *, bufqueue->size);
+  bufqueue->head = 0;
+  bufqueue->tail = 0;
+  bufqueue->waiting = FALSE;
   bufqueue->release = FALSE;
 
 exit:
   return bufqueue;
 }
 
-
+/* Resizes the ring to hold at least size buffers, typically the
+ * nBufferCountActual of the ports feeding it. The queue must be empty and
+ * neither the producer nor the consumer may be running. */
 OMX_ERRORTYPE
-gst_omx_buf_queue_push_buffer (GstOmxBufQueue * bufqueue,
-    OMX_BUFFERHEADERTYPE * buffer)
+gst_omx_buf_queue_set_size (GstOmxBufQueue * bufqueue, guint size)
 {
   OMX_ERRORTYPE error;
+  guint ringsize;
 
   g_return_val_if_fail (bufqueue, OMX_ErrorBadParameter);
-  g_return_val_if_fail (buffer, OMX_ErrorBadParameter);
+  g_return_val_if_fail (size, OMX_ErrorBadParameter);
 
   error = OMX_ErrorNone;
 
+  ringsize = 1;
+  while (ringsize < size)
+    ringsize <<= 1;
+
   g_mutex_lock (&bufqueue->queuemutex);
-  g_queue_push_tail (bufqueue->queue, (gpointer) buffer);
-  g_cond_signal (&bufqueue->queuecond);
+
+  if (bufqueue->head != bufqueue->tail)
+    goto notempty;
+
+  if (ringsize != bufqueue->size) {
+    g_free (bufqueue->ring);
+    bufqueue->ring = g_new0 (OMX_BUFFERHEADERTYPE *, ringsize);
+    bufqueue->size = ringsize;
+  }
+  g_atomic_int_set (&bufqueue->head, 0);
+  g_atomic_int_set (&bufqueue->tail, 0);
+
   g_mutex_unlock (&bufqueue->queuemutex);
 
   return error;
 
+notempty:
+  g_mutex_unlock (&bufqueue->queuemutex);
+  error = OMX_ErrorIncorrectStateOperation;
+  return error;
 }
 
 
-OMX_BUFFERHEADERTYPE *
-gst_omx_buf_queue_pop_buffer (GstOmxBufQueue * bufqueue)
+OMX_ERRORTYPE
+gst_omx_buf_queue_push_buffer (GstOmxBufQueue * bufqueue,
+    OMX_BUFFERHEADERTYPE * buffer)
 {
-  OMX_BUFFERHEADERTYPE *buffer = NULL;
-  guint64 endtime;
-  endtime = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+  OMX_ERRORTYPE error;
+  guint head, tail;
 
-  g_mutex_lock (&bufqueue->queuemutex);
-retry:
+  g_return_val_if_fail (bufqueue, OMX_ErrorBadParameter);
+  g_return_val_if_fail (buffer, OMX_ErrorBadParameter);
 
-  while (g_queue_is_empty (bufqueue->queue)) {
-    if (!g_cond_wait_until (&bufqueue->queuecond, &bufqueue->queuemutex,
-            endtime))
-      goto timeout;
-    else
-      goto retry;
-  }
+  error = OMX_ErrorNone;
 
-  buffer = (OMX_BUFFERHEADERTYPE *) g_queue_pop_head (bufqueue->queue);
+  tail = g_atomic_int_get (&bufqueue->tail);
+  head = g_atomic_int_get (&bufqueue->head);
+  if (tail - head >= bufqueue->size)
+    goto full;
 
-  g_mutex_unlock (&bufqueue->queuemutex);
+  bufqueue->ring[tail & (bufqueue->size - 1)] = buffer;
+  g_atomic_int_set (&bufqueue->tail, tail + 1);
 
-  return buffer;
+  /* Only take the lock if the consumer is sleeping on an empty ring */
+  if (g_atomic_int_get (&bufqueue->waiting)) {
+    g_mutex_lock (&bufqueue->queuemutex);
+    g_cond_signal (&bufqueue->queuecond);
+    g_mutex_unlock (&bufqueue->queuemutex);
+  }
 
-timeout:
-  g_mutex_unlock (&bufqueue->queuemutex);
-  return buffer;
+  return error;
 
+full:
+  error = OMX_ErrorInsufficientResources;
+  return error;
 }
 
-OMX_BUFFERHEADERTYPE *
-gst_omx_buf_queue_pop_buffer_no_wait (GstOmxBufQueue * bufqueue)
+static OMX_BUFFERHEADERTYPE *
+gst_omx_buf_queue_try_pop (GstOmxBufQueue * bufqueue)
 {
   OMX_BUFFERHEADERTYPE *buffer = NULL;
+  guint head, tail;
 
-  g_mutex_lock (&bufqueue->queuemutex);
+  head = g_atomic_int_get (&bufqueue->head);
+  tail = g_atomic_int_get (&bufqueue->tail);
+  if (head == tail)
+    return NULL;
 
-  if (g_queue_is_empty (bufqueue->queue)) {
-    buffer = NULL;
-  } else {
-    buffer = (OMX_BUFFERHEADERTYPE *) g_queue_pop_head (bufqueue->queue);
-  }
-  g_mutex_unlock (&bufqueue->queuemutex);
+  buffer = bufqueue->ring[head & (bufqueue->size - 1)];
+  g_atomic_int_set (&bufqueue->head, head + 1);
 
   return buffer;
 }
 
-
-
-OMX_BUFFERHEADERTYPE *
-gst_omx_buf_queue_pop_buffer_check_release (GstOmxBufQueue * bufqueue)
+static OMX_BUFFERHEADERTYPE *
+gst_omx_buf_queue_wait_pop (GstOmxBufQueue * bufqueue, gboolean check_release)
 {
   OMX_BUFFERHEADERTYPE *buffer = NULL;
   guint64 endtime;
+
+  buffer = gst_omx_buf_queue_try_pop (bufqueue);
+  if (buffer)
+    return buffer;
+
+  if (check_release && g_atomic_int_get (&bufqueue->release))
+    return buffer;
+
   endtime = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
 
   g_mutex_lock (&bufqueue->queuemutex);
-retry:
 
-  while (g_queue_is_empty (bufqueue->queue) && !bufqueue->release) {
+  /* Announce we are about to sleep before checking the ring again, the
+   * producer checks the flag after publishing a buffer */
+  g_atomic_int_set (&bufqueue->waiting, TRUE);
+
+  while (!(buffer = gst_omx_buf_queue_try_pop (bufqueue))) {
+    if (check_release && g_atomic_int_get (&bufqueue->release))
+      break;
     if (!g_cond_wait_until (&bufqueue->queuecond, &bufqueue->queuemutex,
             endtime))
-      goto timeout;
-    else
-      goto retry;
+      break;
   }
 
-  buffer = (OMX_BUFFERHEADERTYPE *) g_queue_pop_head (bufqueue->queue);
+  g_atomic_int_set (&bufqueue->waiting, FALSE);
 
   g_mutex_unlock (&bufqueue->queuemutex);
 
   return buffer;
+}
 
-timeout:
-  g_mutex_unlock (&bufqueue->queuemutex);
-  return buffer;
+OMX_BUFFERHEADERTYPE *
+gst_omx_buf_queue_pop_buffer (GstOmxBufQueue * bufqueue)
+{
+  g_return_val_if_fail (bufqueue, NULL);
 
+  return gst_omx_buf_queue_wait_pop (bufqueue, FALSE);
+}
+
+OMX_BUFFERHEADERTYPE *
+gst_omx_buf_queue_pop_buffer_no_wait (GstOmxBufQueue * bufqueue)
+{
+  g_return_val_if_fail (bufqueue, NULL);
+
+  return gst_omx_buf_queue_try_pop (bufqueue);
+}
+
+OMX_BUFFERHEADERTYPE *
+gst_omx_buf_queue_pop_buffer_check_release (GstOmxBufQueue * bufqueue)
+{
+  g_return_val_if_fail (bufqueue, NULL);
+
+  return gst_omx_buf_queue_wait_pop (bufqueue, TRUE);
 }
 
 
@@ -149,8 +213,8 @@ gst_omx_buf_queue_release (GstOmxBufQueue * bufqueue, gboolean release)
   g_return_val_if_fail (bufqueue, OMX_ErrorBadParameter);
 
   error = OMX_ErrorNone;
+  g_atomic_int_set (&bufqueue->release, release);
   g_mutex_lock (&bufqueue->queuemutex);
-  bufqueue->release = release;
   g_cond_signal (&bufqueue->queuecond);
   g_mutex_unlock (&bufqueue->queuemutex);
 
@@ -168,12 +232,13 @@ gst_omx_buf_queue_free (GstOmxBufQueue * bufqueue)
 
   error = OMX_ErrorNone;
   g_mutex_lock (&bufqueue->queuemutex);
-  g_queue_free (bufqueue->queue);
+  g_free (bufqueue->ring);
+  bufqueue->ring = NULL;
   g_mutex_unlock (&bufqueue->queuemutex);
   g_mutex_clear (&bufqueue->queuemutex);
   g_cond_clear (&bufqueue->queuecond);
 
   g_free (bufqueue);
-exit:
+
   return error;
 }
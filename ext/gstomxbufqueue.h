@@ -30,16 +30,23 @@
 
 typedef struct _GstOmxBufQueue GstOmxBufQueue;
 
+/* Single producer, single consumer ring. The producer (the OMX callback
+ * thread) only writes tail and the consumer only writes head, so neither
+ * needs the mutex unless the consumer has to sleep on an empty ring. */
 struct _GstOmxBufQueue
 {
-  GQueue *queue;
-  guint queueused;
+  OMX_BUFFERHEADERTYPE **ring;
+  guint size;                   /* Power of two */
+  volatile gint head;
+  volatile gint tail;
+  volatile gint waiting;
+  volatile gint release;
   GMutex queuemutex;
   GCond queuecond;
-  gboolean release;
 };
 
 GstOmxBufQueue *gst_omx_buf_queue_new ();
+OMX_ERRORTYPE gst_omx_buf_queue_set_size (GstOmxBufQueue *, guint);
 OMX_BUFFERHEADERTYPE *gst_omx_buf_queue_pop_buffer (GstOmxBufQueue *);
 OMX_BUFFERHEADERTYPE *gst_omx_buf_queue_pop_buffer_no_wait (GstOmxBufQueue *);
 OMX_ERRORTYPE gst_omx_buf_queue_push_buffer (GstOmxBufQueue *,
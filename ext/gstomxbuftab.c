@@ -19,6 +19,7 @@
  * Boston, MA 02111-1307, USA.
  */
 
+
 #include "gstomx.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_omx_buf_tab_debug);
@@ -29,25 +30,64 @@ static gboolean gst_omx_buf_tab_debug_register = FALSE;
 OMX_ERRORTYPE
 gst_omx_buf_tab_mark_buffer (GstOmxBufTab * buftab,
     OMX_BUFFERHEADERTYPE * buffer, gboolean busy);
-static gint gst_omx_buf_tab_compare (gconstpointer _node,
-    gconstpointer _buffer);
-
-static gint
-gst_omx_buf_tab_compare (gconstpointer _node, gconstpointer _buffer)
+static GstOmxBufTabNode *gst_omx_buf_tab_lookup (GstOmxBufTab * buftab,
+    OMX_BUFFERHEADERTYPE * buffer);
+static void gst_omx_buf_tab_push_free (GstOmxBufTab * buftab,
+    GstOmxBufTabNode * node, guint id);
+static void gst_omx_buf_tab_pop_free (GstOmxBufTab * buftab,
+    GstOmxBufTabNode * node);
+static void gst_omx_buf_tab_account (GstOmxBufTab * buftab);
+static gboolean gst_omx_buf_tab_set_busy (GstOmxBufTab * buftab,
+    GstOmxBufTabNode * node, gboolean busy);
+
+/* Must be called with the table mutex held */
+static GstOmxBufTabNode *
+gst_omx_buf_tab_lookup (GstOmxBufTab * buftab, OMX_BUFFERHEADERTYPE * buffer)
 {
-  GstOmxBufTabNode *node;
-  GstOmxBufferData *nodedata;
   GstOmxBufferData *bufferdata;
-  OMX_BUFFERHEADERTYPE *buffer;
 
-  node = (GstOmxBufTabNode *) _node;
-  buffer = (OMX_BUFFERHEADERTYPE *) _buffer;
-  nodedata = (GstOmxBufferData *) node->buffer->pAppPrivate;
   bufferdata = (GstOmxBufferData *) buffer->pAppPrivate;
 
-  GST_LOG ("ID of Buffer in buftab: %i , ID of External buffer %i ",
-      nodedata->id, bufferdata->id);
-  return nodedata->id - bufferdata->id;
+  GST_LOG ("Looking up external buffer with ID %i", bufferdata->id);
+
+  if (bufferdata->id >= buftab->numnodes)
+    return NULL;
+
+  return buftab->nodes[bufferdata->id];
+}
+
+/* Must be called with the table mutex held */
+static void
+gst_omx_buf_tab_push_free (GstOmxBufTab * buftab, GstOmxBufTabNode * node,
+    guint id)
+{
+  node->freepos = buftab->numfree;
+  buftab->freeids[buftab->numfree++] = id;
+}
+
+/* Must be called with the table mutex held, swaps the last free id into the
+ * position of the node so the stack stays dense */
+static void
+gst_omx_buf_tab_pop_free (GstOmxBufTab * buftab, GstOmxBufTabNode * node)
+{
+  guint lastid;
+
+  lastid = buftab->freeids[--buftab->numfree];
+  buftab->freeids[node->freepos] = lastid;
+  buftab->nodes[lastid]->freepos = node->freepos;
+}
+
+/* Must be called with the table mutex held, charges the time since the
+ * last change to the current occupancy */
+static void
+gst_omx_buf_tab_account (GstOmxBufTab * buftab)
+{
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+  if (buftab->occupancy && buftab->table)
+    buftab->occupancy[buftab->tabused] += now - buftab->laststamp;
+  buftab->laststamp = now;
 }
 
 OMX_ERRORTYPE
@@ -56,24 +96,20 @@ gst_omx_buf_tab_find_buffer (GstOmxBufTab * buftab,
     gboolean * busy)
 {
   OMX_ERRORTYPE error;
-  GList *toreturn;
   GstOmxBufTabNode *node;
 
   g_return_val_if_fail (buftab, OMX_ErrorBadParameter);
   g_return_val_if_fail (peerbuffer, OMX_ErrorBadParameter);
 
   error = OMX_ErrorNone;
-  toreturn = NULL;
   node = NULL;
 
   g_mutex_lock (&buftab->tabmutex);
   GST_LOG ("Finding buffer ...");
-  toreturn = g_list_find_custom (buftab->table, (gconstpointer) peerbuffer,
-      (GCompareFunc) gst_omx_buf_tab_compare);
-  if (!toreturn)
+  node = gst_omx_buf_tab_lookup (buftab, peerbuffer);
+  if (!node)
     goto notfound;
 
-  node = (GstOmxBufTabNode *) toreturn->data;
   *buffer = node->buffer;
   *busy = node->busy;
   GST_LOG (" Buffer found ...");
@@ -116,20 +152,50 @@ gst_omx_buf_tab_add_buffer (GstOmxBufTab * buftab,
 {
   OMX_ERRORTYPE error;
   GstOmxBufTabNode *node;
+  GstOmxBufferData *bufferdata;
+  guint id, numnodes, levels;
 
   g_return_val_if_fail (buftab, OMX_ErrorBadParameter);
   g_return_val_if_fail (buffer, OMX_ErrorBadParameter);
 
   error = OMX_ErrorNone;
+  bufferdata = (GstOmxBufferData *) buffer->pAppPrivate;
+  id = bufferdata->id;
 
   node = g_malloc0 (sizeof (GstOmxBufTabNode));
   if (!node)
     goto nomem;
 
+  if (id >= GST_OMX_BUFFER_ID_MAX)
+    goto badid;
+
   node->buffer = buffer;
 
   g_mutex_lock (&buftab->tabmutex);
 
+  /* Grow the index so the buffer id can be used to address it directly */
+  if (id >= buftab->numnodes) {
+    numnodes = MAX (id + 1, buftab->numnodes * 2);
+    buftab->nodes = g_renew (GstOmxBufTabNode *, buftab->nodes, numnodes);
+    memset (buftab->nodes + buftab->numnodes, 0,
+        (numnodes - buftab->numnodes) * sizeof (GstOmxBufTabNode *));
+    buftab->freeids = g_renew (guint, buftab->freeids, numnodes);
+    /* One occupancy level more than nodes, to account for 0 in use */
+    levels = buftab->occupancy ? buftab->numnodes + 1 : 0;
+    buftab->occupancy = g_renew (guint64, buftab->occupancy, numnodes + 1);
+    memset (buftab->occupancy + levels, 0,
+        (numnodes + 1 - levels) * sizeof (guint64));
+    buftab->numnodes = numnodes;
+  }
+
+  if (!buftab->table)
+    buftab->laststamp = g_get_monotonic_time ();
+
+  if (buftab->nodes[id])
+    goto duplicated;
+
+  buftab->nodes[id] = node;
+  gst_omx_buf_tab_push_free (buftab, node, id);
   buftab->table = g_list_prepend (buftab->table, (gpointer) node);
 
   g_mutex_unlock (&buftab->tabmutex);
@@ -139,6 +205,20 @@ gst_omx_buf_tab_add_buffer (GstOmxBufTab * buftab,
 nomem:
   error = OMX_ErrorInsufficientResources;
   return error;
+
+badid:
+  GST_ERROR ("Buffer ID %u is out of range, maximum is %u", id,
+      GST_OMX_BUFFER_ID_MAX - 1);
+  g_free (node);
+  error = OMX_ErrorBadParameter;
+  return error;
+
+duplicated:
+  GST_ERROR ("Buffer ID %u is already in the table", id);
+  g_mutex_unlock (&buftab->tabmutex);
+  g_free (node);
+  error = OMX_ErrorBadParameter;
+  return error;
 }
 
 OMX_ERRORTYPE
@@ -155,39 +235,75 @@ gst_omx_buf_tab_return_buffer (GstOmxBufTab * buftab,
   return gst_omx_buf_tab_mark_buffer (buftab, buffer, FALSE);
 }
 
+/* Must be called with the table mutex held. Returns TRUE when the change
+ * made the free buffers drop below the low watermark */
+static gboolean
+gst_omx_buf_tab_set_busy (GstOmxBufTab * buftab, GstOmxBufTabNode * node,
+    gboolean busy)
+{
+  GST_LOG ("Marking Buffer %p -> %p as %s ", node->buffer,
+      node->buffer->pBuffer, busy ? "Used" : "Free");
+  if (node->busy == busy)
+    return FALSE;
+
+  gst_omx_buf_tab_account (buftab);
+  node->busy = busy;
+  buftab->tabused += busy ? 1 : -1;
+  if (busy)
+    gst_omx_buf_tab_pop_free (buftab, node);
+  else
+    gst_omx_buf_tab_push_free (buftab, node,
+        ((GstOmxBufferData *) node->buffer->pAppPrivate)->id);
+
+  if (buftab->tabused > buftab->highwater)
+    buftab->highwater = buftab->tabused;
+
+  /* Notify once per crossing, re-arm when the port recovers */
+  if (buftab->numfree >= buftab->lowwater) {
+    buftab->lowhit = FALSE;
+  } else if (!buftab->lowhit) {
+    buftab->lowhit = TRUE;
+    buftab->lowhits++;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
 OMX_ERRORTYPE
 gst_omx_buf_tab_mark_buffer (GstOmxBufTab * buftab,
     OMX_BUFFERHEADERTYPE * buffer, gboolean busy)
 {
   OMX_ERRORTYPE error;
-  GList *toreturn;
   GstOmxBufTabNode *node;
+  GstOmxBufTabWatermarkFunc lowfunc = NULL;
+  gpointer lowdata = NULL;
+  guint numfree = 0;
 
   g_return_val_if_fail (buftab, OMX_ErrorBadParameter);
   g_return_val_if_fail (buffer, OMX_ErrorBadParameter);
 
   error = OMX_ErrorNone;
-  toreturn = NULL;
   node = NULL;
   GST_LOG ("Marking buffer ... ");
   g_mutex_lock (&buftab->tabmutex);
 
-  toreturn = g_list_find_custom (buftab->table, (gconstpointer) buffer,
-      (GCompareFunc) gst_omx_buf_tab_compare);
-  if (!toreturn)
+  node = gst_omx_buf_tab_lookup (buftab, buffer);
+  if (!node)
     goto notfound;
-  node = (GstOmxBufTabNode *) toreturn->data;
-  GST_LOG ("Marking Buffer %p -> %p as %s ", node->buffer,
-      node->buffer->pBuffer, busy ? "Used" : "Free");
-  if (node->busy != busy) {
-    node->busy = busy;
-    buftab->tabused += busy ? 1 : -1;
+  if (gst_omx_buf_tab_set_busy (buftab, node, busy)) {
+    lowfunc = buftab->lowfunc;
+    lowdata = buftab->lowdata;
+    numfree = buftab->numfree;
   }
   GST_LOG ("Buffer %p -> %p set as %s ", node->buffer, node->buffer->pBuffer,
       busy ? "Used" : "Free");
   g_cond_signal (&buftab->tabcond);
   g_mutex_unlock (&buftab->tabmutex);
 
+  if (lowfunc)
+    lowfunc (buftab, numfree, lowdata);
+
   return error;
 
 notfound:
@@ -196,12 +312,44 @@ notfound:
   return error;
 }
 
+/* Marks up to max free buffers as used under a single lock and copies them
+ * into buffers, returns how many were taken. Never waits for a free buffer */
+guint
+gst_omx_buf_tab_use_free_buffers (GstOmxBufTab * buftab,
+    OMX_BUFFERHEADERTYPE ** buffers, guint max)
+{
+  GstOmxBufTabNode *node;
+  GstOmxBufTabWatermarkFunc lowfunc = NULL;
+  gpointer lowdata = NULL;
+  guint i, count, numfree = 0;
+
+  g_return_val_if_fail (buftab, 0);
+  g_return_val_if_fail (buffers, 0);
+
+  g_mutex_lock (&buftab->tabmutex);
+  count = buftab->cancelled ? 0 : MIN (max, buftab->numfree);
+  for (i = 0; i < count; ++i) {
+    node = buftab->nodes[buftab->freeids[buftab->numfree - 1]];
+    buffers[i] = node->buffer;
+    if (gst_omx_buf_tab_set_busy (buftab, node, TRUE)) {
+      lowfunc = buftab->lowfunc;
+      lowdata = buftab->lowdata;
+      numfree = buftab->numfree;
+    }
+  }
+  g_mutex_unlock (&buftab->tabmutex);
+
+  if (lowfunc)
+    lowfunc (buftab, numfree, lowdata);
+
+  return count;
+}
+
 OMX_ERRORTYPE
 gst_omx_buf_tab_remove_buffer (GstOmxBufTab * buftab,
     OMX_BUFFERHEADERTYPE * buffer)
 {
   OMX_ERRORTYPE error;
-  GList *toremove;
   guint64 endtime;
   GstOmxBufTabNode *node;
 
@@ -209,24 +357,24 @@ gst_omx_buf_tab_remove_buffer (GstOmxBufTab * buftab,
   g_return_val_if_fail (buffer, OMX_ErrorBadParameter);
 
   error = OMX_ErrorNone;
-  toremove = NULL;
 
   g_mutex_lock (&buftab->tabmutex);
 
   endtime = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
 
-  toremove = g_list_find_custom (buftab->table, (gconstpointer) buffer,
-      (GCompareFunc) gst_omx_buf_tab_compare);
-  if (!toremove)
+  node = gst_omx_buf_tab_lookup (buftab, buffer);
+  if (!node)
     goto notfound;
-  node = (GstOmxBufTabNode *) toremove->data;
 
   while (node->busy)
     if (!g_cond_wait_until (&buftab->tabcond, &buftab->tabmutex, endtime))
       goto timeout;
 
-  buftab->table = g_list_remove (buftab->table, (gpointer) toremove->data);
-  g_free(node);
+  gst_omx_buf_tab_account (buftab);
+  gst_omx_buf_tab_pop_free (buftab, node);
+  buftab->nodes[((GstOmxBufferData *) node->buffer->pAppPrivate)->id] = NULL;
+  buftab->table = g_list_remove (buftab->table, (gpointer) node);
+  g_free (node);
   g_mutex_unlock (&buftab->tabmutex);
 
   return error;
@@ -247,48 +395,87 @@ gst_omx_buf_tab_get_free_buffer (GstOmxBufTab * buftab,
     OMX_BUFFERHEADERTYPE ** buffer)
 {
   OMX_ERRORTYPE error;
-  GList *table;
-  GstOmxBufTabNode *node;
   guint64 endtime;
+  gint64 start, waited;
 
   g_return_val_if_fail (buftab, OMX_ErrorBadParameter);
 
   error = OMX_ErrorNone;
-  table = buftab->table;
-  endtime = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+  start = g_get_monotonic_time ();
+  endtime = start + 5 * G_TIME_SPAN_SECOND;
 
   *buffer = NULL;
 
   g_mutex_lock (&buftab->tabmutex);
 
-retry:
-  table = buftab->table;
+  if (buftab->cancelled)
+    goto cancelled;
 
-  while (table) {
-    node = (GstOmxBufTabNode *) table->data;
-    if (!node->busy) {
-      *buffer = node->buffer;
-      break;
+  if (!buftab->numfree) {
+    buftab->waits++;
+    while (!buftab->numfree) {
+      if (!g_cond_wait_until (&buftab->tabcond, &buftab->tabmutex, endtime))
+        goto timeout;
+      if (buftab->cancelled)
+        goto cancelled;
     }
 
-    table = g_list_next (table);
+    waited = g_get_monotonic_time () - start;
+    buftab->waittime += waited;
+    buftab->maxwait = MAX (buftab->maxwait, waited);
   }
 
-  while (!*buffer) {
-    if (!g_cond_wait_until (&buftab->tabcond, &buftab->tabmutex, endtime))
-      goto timeout;
-    else
-      goto retry;
-  }
+  *buffer = buftab->nodes[buftab->freeids[buftab->numfree - 1]]->buffer;
 
   g_mutex_unlock (&buftab->tabmutex);
   return error;
 
 timeout:
+  waited = g_get_monotonic_time () - start;
+  buftab->timeouts++;
+  buftab->waittime += waited;
+  buftab->maxwait = MAX (buftab->maxwait, waited);
   g_mutex_unlock (&buftab->tabmutex);
   error = OMX_ErrorTimeout;
   return error;
 
+cancelled:
+  g_mutex_unlock (&buftab->tabmutex);
+  error = OMX_ErrorNotReady;
+  return error;
+}
+
+/* Makes the current and future waits for a free buffer fail with
+ * OMX_ErrorNotReady until called again with FALSE */
+void
+gst_omx_buf_tab_cancel (GstOmxBufTab * buftab, gboolean cancel)
+{
+  g_return_if_fail (buftab);
+
+  g_mutex_lock (&buftab->tabmutex);
+  buftab->cancelled = cancel;
+  g_cond_broadcast (&buftab->tabcond);
+  g_mutex_unlock (&buftab->tabmutex);
+}
+
+/* Copies up to max free buffers into buffers straight from the free id
+ * stack, returns how many were copied */
+guint
+gst_omx_buf_tab_get_free_buffers (GstOmxBufTab * buftab,
+    OMX_BUFFERHEADERTYPE ** buffers, guint max)
+{
+  guint i, count;
+
+  g_return_val_if_fail (buftab, 0);
+  g_return_val_if_fail (buffers, 0);
+
+  g_mutex_lock (&buftab->tabmutex);
+  count = MIN (max, buftab->numfree);
+  for (i = 0; i < count; ++i)
+    buffers[i] = buftab->nodes[buftab->freeids[i]]->buffer;
+  g_mutex_unlock (&buftab->tabmutex);
+
+  return count;
 }
 
 OMX_ERRORTYPE
@@ -337,6 +524,14 @@ gst_omx_buf_tab_free (GstOmxBufTab * buftab)
 
   g_list_free_full (buftab->table, (GDestroyNotify) g_free);
   buftab->table = NULL;
+  g_free (buftab->nodes);
+  buftab->nodes = NULL;
+  g_free (buftab->freeids);
+  buftab->freeids = NULL;
+  g_free (buftab->occupancy);
+  buftab->occupancy = NULL;
+  buftab->numnodes = 0;
+  buftab->numfree = 0;
 
   g_mutex_unlock (&buftab->tabmutex);
 
@@ -349,3 +544,67 @@ gst_omx_buf_tab_free (GstOmxBufTab * buftab)
 nowait:
   return error;
 }
+
+/* Warn through func when less than lowwater buffers are free, 0 disables
+ * the warning */
+void
+gst_omx_buf_tab_set_low_watermark (GstOmxBufTab * buftab, guint lowwater,
+    GstOmxBufTabWatermarkFunc func, gpointer data)
+{
+  g_return_if_fail (buftab);
+
+  g_mutex_lock (&buftab->tabmutex);
+  buftab->lowwater = lowwater;
+  buftab->lowhit = FALSE;
+  buftab->lowfunc = func;
+  buftab->lowdata = data;
+  g_mutex_unlock (&buftab->tabmutex);
+}
+
+/* Times are reported in nanoseconds, occupancy is an array with the time
+ * spent with 0, 1, 2... buffers in use */
+GstStructure *
+gst_omx_buf_tab_get_structure (GstOmxBufTab * buftab)
+{
+  GstStructure *structure;
+  GValue occupancy = { 0, };
+  GValue level = { 0, };
+  guint i, numbuffers;
+
+  g_return_val_if_fail (buftab, NULL);
+
+  g_value_init (&occupancy, GST_TYPE_ARRAY);
+  g_value_init (&level, G_TYPE_UINT64);
+
+  g_mutex_lock (&buftab->tabmutex);
+
+  gst_omx_buf_tab_account (buftab);
+  numbuffers = g_list_length (buftab->table);
+
+  if (buftab->occupancy) {
+    for (i = 0; i <= numbuffers && i <= buftab->numnodes; i++) {
+      g_value_set_uint64 (&level, buftab->occupancy[i] * GST_USECOND);
+      gst_value_array_append_value (&occupancy, &level);
+    }
+  }
+
+  structure = gst_structure_new ("GstOmxBufTab",
+      "buffers", G_TYPE_UINT, numbuffers,
+      "used", G_TYPE_UINT, buftab->tabused,
+      "high-water", G_TYPE_UINT, buftab->highwater,
+      "waits", G_TYPE_UINT, buftab->waits,
+      "timeouts", G_TYPE_UINT, buftab->timeouts,
+      "wait-time", G_TYPE_UINT64, (guint64) buftab->waittime * GST_USECOND,
+      "wait-max", G_TYPE_UINT64, (guint64) buftab->maxwait * GST_USECOND,
+      "low-watermark", G_TYPE_UINT, buftab->lowwater,
+      "low-watermark-hits", G_TYPE_UINT, buftab->lowhits, NULL);
+
+  g_mutex_unlock (&buftab->tabmutex);
+
+  gst_structure_set_value (structure, "occupancy", &occupancy);
+
+  g_value_unset (&level);
+  g_value_unset (&occupancy);
+
+  return structure;
+}
@@ -31,18 +31,49 @@
 G_BEGIN_DECLS typedef struct _GstOmxBufTab GstOmxBufTab;
 typedef struct _GstOmxBufTabNode GstOmxBufTabNode;
 
+/* Called without the table mutex when the free buffers drop below the low
+ * watermark */
+typedef void (*GstOmxBufTabWatermarkFunc) (GstOmxBufTab *, guint numfree,
+    gpointer);
+
 struct _GstOmxBufTab
 {
   GList *table;
   guint tabused;
   GMutex tabmutex;
   GCond tabcond;
+
+  /* Nodes indexed by buffer id and stack with the ids of the free nodes */
+  GstOmxBufTabNode **nodes;
+  guint numnodes;
+  guint *freeids;
+  guint numfree;
+
+  /* Set while flushing, makes waiters for a free buffer give up */
+  gboolean cancelled;
+
+  /* Occupancy diagnostics, times in microseconds. occupancy[n] is the
+   * time spent with n buffers in use */
+  guint highwater;
+  guint64 *occupancy;
+  gint64 laststamp;
+  guint waits;
+  guint timeouts;
+  gint64 waittime;
+  gint64 maxwait;
+
+  guint lowwater;
+  gboolean lowhit;
+  guint lowhits;
+  GstOmxBufTabWatermarkFunc lowfunc;
+  gpointer lowdata;
 };
 
 struct _GstOmxBufTabNode
 {
   OMX_BUFFERHEADERTYPE *buffer;
   gboolean busy;
+  guint freepos;                /* Position in the free stack, if not busy */
 };
 
 GstOmxBufTab *gst_omx_buf_tab_new ();
@@ -59,7 +90,15 @@ OMX_ERRORTYPE gst_omx_buf_tab_return_buffer (GstOmxBufTab *,
 OMX_ERRORTYPE gst_omx_buf_tab_remove_buffer (GstOmxBufTab *,
     OMX_BUFFERHEADERTYPE *);
 OMX_ERRORTYPE gst_omx_buf_tab_wait_free (GstOmxBufTab *);
+void gst_omx_buf_tab_cancel (GstOmxBufTab *, gboolean);
+guint gst_omx_buf_tab_get_free_buffers (GstOmxBufTab *,
+    OMX_BUFFERHEADERTYPE **, guint);
+guint gst_omx_buf_tab_use_free_buffers (GstOmxBufTab *,
+    OMX_BUFFERHEADERTYPE **, guint);
 OMX_ERRORTYPE gst_omx_buf_tab_free (GstOmxBufTab *);
+void gst_omx_buf_tab_set_low_watermark (GstOmxBufTab *, guint,
+    GstOmxBufTabWatermarkFunc, gpointer);
+GstStructure *gst_omx_buf_tab_get_structure (GstOmxBufTab *);
 
 G_END_DECLS
 #endif //__GST_OMX_BUF_TAB_H__
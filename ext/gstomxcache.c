@@ -0,0 +1,347 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gstomx.h"
+#include "gstomxcache.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_cache_debug);
+#define GST_CAT_DEFAULT gst_omx_cache_debug
+
+/* Microseconds a parked component gets to reach Loaded at exit */
+#define GST_OMX_CACHE_UNLOAD_TIMEOUT (5 * G_TIME_SPAN_SECOND)
+
+/* Parked entries, newest first */
+static GList *gst_omx_cache_entries = NULL;
+static GMutex gst_omx_cache_lock;
+static GOnce gst_omx_cache_once = G_ONCE_INIT;
+
+static void gst_omx_cache_shutdown (void);
+
+static gpointer
+gst_omx_cache_setup (gpointer data)
+{
+  GST_DEBUG_CATEGORY_INIT (gst_omx_cache_debug, "omxcache", 0,
+      "OMX component cache");
+
+  /* Plugins are never unloaded, the parked handles are freed on exit */
+  atexit (gst_omx_cache_shutdown);
+
+  return NULL;
+}
+
+/* The handle callbacks, they run the owner ones with the owner as
+ * application data. Nothing runs for a parked component */
+static OMX_ERRORTYPE
+gst_omx_cache_event (OMX_HANDLETYPE handle, OMX_PTR data,
+    OMX_EVENTTYPE event, OMX_U32 nevent1, OMX_U32 nevent2, OMX_PTR eventdata)
+{
+  GstOmxCacheEntry *entry = (GstOmxCacheEntry *) data;
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  g_rw_lock_reader_lock (&entry->lock);
+  if (entry->owner)
+    error = entry->callbacks.EventHandler (handle, entry->owner, event,
+        nevent1, nevent2, eventdata);
+  g_rw_lock_reader_unlock (&entry->lock);
+
+  return error;
+}
+
+static OMX_ERRORTYPE
+gst_omx_cache_empty (OMX_HANDLETYPE handle, OMX_PTR data,
+    OMX_BUFFERHEADERTYPE * buffer)
+{
+  GstOmxCacheEntry *entry = (GstOmxCacheEntry *) data;
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  g_rw_lock_reader_lock (&entry->lock);
+  if (entry->owner)
+    error = entry->callbacks.EmptyBufferDone (handle, entry->owner, buffer);
+  g_rw_lock_reader_unlock (&entry->lock);
+
+  return error;
+}
+
+static OMX_ERRORTYPE
+gst_omx_cache_fill (OMX_HANDLETYPE handle, OMX_PTR data,
+    OMX_BUFFERHEADERTYPE * buffer)
+{
+  GstOmxCacheEntry *entry = (GstOmxCacheEntry *) data;
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+
+  g_rw_lock_reader_lock (&entry->lock);
+  if (entry->owner)
+    error = entry->callbacks.FillBufferDone (handle, entry->owner, buffer);
+  g_rw_lock_reader_unlock (&entry->lock);
+
+  return error;
+}
+
+static OMX_CALLBACKTYPE gst_omx_cache_callbacks = {
+  gst_omx_cache_event,
+  gst_omx_cache_empty,
+  gst_omx_cache_fill
+};
+
+/* Hands an entry to a new owner, or none, once the callbacks running for
+ * the previous one are done */
+static void
+gst_omx_cache_set_owner (GstOmxCacheEntry * entry,
+    OMX_CALLBACKTYPE * callbacks, gpointer owner)
+{
+  g_rw_lock_writer_lock (&entry->lock);
+  if (callbacks)
+    entry->callbacks = *callbacks;
+  entry->owner = owner;
+  g_rw_lock_writer_unlock (&entry->lock);
+}
+
+static gint
+gst_omx_cache_compare_name (gconstpointer entry, gconstpointer name)
+{
+  return strcmp (((GstOmxCacheEntry *) entry)->name, (const gchar *) name);
+}
+
+/* Returns an entry for the component name owned by owner. A parked one is
+ * taken if there is any, cached tells whether it was, otherwise a new
+ * handle is created with callbacks. */
+GstOmxCacheEntry *
+gst_omx_cache_get (const gchar * name, OMX_CALLBACKTYPE * callbacks,
+    gpointer owner, gboolean * cached, OMX_ERRORTYPE * error)
+{
+  GstOmxCacheEntry *entry = NULL;
+  GList *l;
+
+  g_return_val_if_fail (name, NULL);
+  g_return_val_if_fail (callbacks, NULL);
+  g_return_val_if_fail (cached, NULL);
+  g_return_val_if_fail (error, NULL);
+
+  g_once (&gst_omx_cache_once, gst_omx_cache_setup, NULL);
+
+  *error = OMX_ErrorNone;
+  *cached = FALSE;
+
+  g_mutex_lock (&gst_omx_cache_lock);
+  l = g_list_find_custom (gst_omx_cache_entries, name,
+      gst_omx_cache_compare_name);
+  if (l) {
+    entry = l->data;
+    gst_omx_cache_entries = g_list_delete_link (gst_omx_cache_entries, l);
+  }
+  g_mutex_unlock (&gst_omx_cache_lock);
+
+  if (entry) {
+    GST_INFO ("Reusing %s %s component %p", entry->key ? "warm" : "cold",
+        name, entry->handle);
+    gst_omx_cache_set_owner (entry, callbacks, owner);
+    *cached = TRUE;
+    return entry;
+  }
+
+  return gst_omx_cache_new (name, callbacks, owner, error);
+}
+
+/* Returns a new entry owned by owner with a handle of its own, the parked
+ * ones are left alone. Used by elements that don't cache their component */
+GstOmxCacheEntry *
+gst_omx_cache_new (const gchar * name, OMX_CALLBACKTYPE * callbacks,
+    gpointer owner, OMX_ERRORTYPE * error)
+{
+  GstOmxCacheEntry *entry = NULL;
+
+  g_return_val_if_fail (name, NULL);
+  g_return_val_if_fail (callbacks, NULL);
+  g_return_val_if_fail (error, NULL);
+
+  g_once (&gst_omx_cache_once, gst_omx_cache_setup, NULL);
+
+  *error = OMX_ErrorNone;
+
+  entry = g_malloc0 (sizeof (GstOmxCacheEntry));
+  entry->name = g_strdup (name);
+  entry->callbacks = *callbacks;
+  g_rw_lock_init (&entry->lock);
+  entry->owner = owner;
+  entry->key = NULL;
+  entry->ports = NULL;
+
+  g_mutex_lock (&_omx_mutex);
+  *error = OMX_GetHandle (&entry->handle, (OMX_STRING) name, entry,
+      &gst_omx_cache_callbacks);
+  g_mutex_unlock (&_omx_mutex);
+  if ((*error != OMX_ErrorNone) || (!entry->handle))
+    goto nohandle;
+
+  return entry;
+
+nohandle:
+  {
+    GST_ERROR ("Unable to grab %s handle: %s", name,
+        gst_omx_error_to_str (*error));
+    if (OMX_ErrorNone == *error)
+      *error = OMX_ErrorUndefined;
+    g_rw_lock_clear (&entry->lock);
+    g_free (entry->name);
+    g_free (entry);
+    return NULL;
+  }
+}
+
+/* Parks an entry for the next element that asks for the same component.
+ * Returns FALSE if the cache is full, the caller keeps the entry then. */
+gboolean
+gst_omx_cache_put (GstOmxCacheEntry * entry)
+{
+  g_return_val_if_fail (entry, FALSE);
+
+  g_mutex_lock (&gst_omx_cache_lock);
+  if (g_list_length (gst_omx_cache_entries) >= GST_OMX_CACHE_MAX_ENTRIES) {
+    g_mutex_unlock (&gst_omx_cache_lock);
+    GST_INFO ("Cache full, not keeping %s component %p", entry->name,
+        entry->handle);
+    return FALSE;
+  }
+
+  gst_omx_cache_set_owner (entry, NULL, NULL);
+  gst_omx_cache_entries = g_list_prepend (gst_omx_cache_entries, entry);
+  g_mutex_unlock (&gst_omx_cache_lock);
+
+  GST_INFO ("Parked %s %s component %p", entry->key ? "warm" : "cold",
+      entry->name, entry->handle);
+
+  return TRUE;
+}
+
+/* Forgets the warm configuration, the buffers must have been freed or
+ * handed to the owner pads */
+void
+gst_omx_cache_clear_ports (GstOmxCacheEntry * entry)
+{
+  GstOmxCachePort *port;
+  GList *l;
+
+  g_return_if_fail (entry);
+
+  for (l = entry->ports; l; l = l->next) {
+    port = l->data;
+    g_list_free (port->buffers);
+    g_free (port);
+  }
+  g_list_free (entry->ports);
+  entry->ports = NULL;
+
+  g_free (entry->key);
+  entry->key = NULL;
+}
+
+/* Frees the handle of an entry that is not in the cache, the component
+ * must be Loaded */
+OMX_ERRORTYPE
+gst_omx_cache_free (GstOmxCacheEntry * entry)
+{
+  OMX_ERRORTYPE error;
+
+  g_return_val_if_fail (entry, OMX_ErrorBadParameter);
+
+  gst_omx_cache_clear_ports (entry);
+
+  g_mutex_lock (&_omx_mutex);
+  error = OMX_FreeHandle (entry->handle);
+  g_mutex_unlock (&_omx_mutex);
+
+  g_rw_lock_clear (&entry->lock);
+  g_free (entry->name);
+  g_free (entry);
+
+  return error;
+}
+
+/* Takes a parked warm entry back to Loaded, freeing the buffers it holds.
+ * No element gets the events of a parked component, so the state is
+ * polled */
+static OMX_ERRORTYPE
+gst_omx_cache_unload (GstOmxCacheEntry * entry)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OMX_STATETYPE state = OMX_StateInvalid;
+  GstOmxCachePort *cport;
+  OMX_BUFFERHEADERTYPE *buffer;
+  gint64 deadline;
+  GList *p, *b;
+
+  g_mutex_lock (&_omx_mutex);
+  error = OMX_SendCommand (entry->handle, OMX_CommandStateSet,
+      OMX_StateLoaded, NULL);
+  g_mutex_unlock (&_omx_mutex);
+  if (GST_OMX_FAIL (error))
+    return error;
+
+  for (p = entry->ports; p; p = p->next) {
+    cport = (GstOmxCachePort *) p->data;
+    for (b = cport->buffers; b; b = b->next) {
+      buffer = (OMX_BUFFERHEADERTYPE *) b->data;
+      g_free (buffer->pAppPrivate);
+      g_mutex_lock (&_omx_mutex);
+      error = OMX_FreeBuffer (entry->handle, cport->definition.nPortIndex,
+          buffer);
+      g_mutex_unlock (&_omx_mutex);
+      if (GST_OMX_FAIL (error))
+        return error;
+    }
+  }
+
+  deadline = g_get_monotonic_time () + GST_OMX_CACHE_UNLOAD_TIMEOUT;
+  while (TRUE) {
+    g_mutex_lock (&_omx_mutex);
+    error = OMX_GetState (entry->handle, &state);
+    g_mutex_unlock (&_omx_mutex);
+    if (GST_OMX_FAIL (error) || OMX_StateLoaded == state)
+      return error;
+    if (g_get_monotonic_time () >= deadline)
+      return OMX_ErrorTimeout;
+    g_usleep (1000);
+  }
+}
+
+/* atexit handler, frees every parked component */
+static void
+gst_omx_cache_shutdown (void)
+{
+  GstOmxCacheEntry *entry;
+  GList *entries, *l;
+
+  g_mutex_lock (&gst_omx_cache_lock);
+  entries = gst_omx_cache_entries;
+  gst_omx_cache_entries = NULL;
+  g_mutex_unlock (&gst_omx_cache_lock);
+
+  for (l = entries; l; l = l->next) {
+    entry = (GstOmxCacheEntry *) l->data;
+    /* Free the handle even if it didn't unload, the process is leaving */
+    if (entry->key)
+      gst_omx_cache_unload (entry);
+    gst_omx_cache_free (entry);
+  }
+  g_list_free (entries);
+}
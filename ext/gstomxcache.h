@@ -0,0 +1,69 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_OMX_CACHE_H__
+#define __GST_OMX_CACHE_H__
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+/* Components kept alive at most, the rest are freed when released */
+#define GST_OMX_CACHE_MAX_ENTRIES 8
+typedef struct _GstOmxCacheEntry GstOmxCacheEntry;
+typedef struct _GstOmxCachePort GstOmxCachePort;
+
+struct _GstOmxCachePort
+{
+  OMX_PARAM_PORTDEFINITIONTYPE definition;
+  GList *buffers;               /* OMX_BUFFERHEADERTYPE allocated for it */
+};
+
+/* A component handle. The handle application data points to the entry, so
+ * the callbacks reach whichever element owns it at the moment. The owner
+ * is only changed with the lock held for writing, the callbacks hold it
+ * for reading while the owner ones run. An entry
+ * is warm when it has a key: the component is Idle with the buffers of
+ * each port allocated for the configuration the key describes. */
+struct _GstOmxCacheEntry
+{
+  gchar *name;
+  OMX_HANDLETYPE handle;
+  OMX_CALLBACKTYPE callbacks;   /* the owner ones */
+  GRWLock lock;
+  gpointer owner;
+
+  gchar *key;
+  GList *ports;                 /* GstOmxCachePort, in the owner pad order */
+};
+
+GstOmxCacheEntry *gst_omx_cache_get (const gchar * name,
+    OMX_CALLBACKTYPE * callbacks, gpointer owner, gboolean * cached,
+    OMX_ERRORTYPE * error);
+GstOmxCacheEntry *gst_omx_cache_new (const gchar * name,
+    OMX_CALLBACKTYPE * callbacks, gpointer owner, OMX_ERRORTYPE * error);
+gboolean gst_omx_cache_put (GstOmxCacheEntry * entry);
+OMX_ERRORTYPE gst_omx_cache_free (GstOmxCacheEntry * entry);
+void gst_omx_cache_clear_ports (GstOmxCacheEntry * entry);
+
+G_END_DECLS
+#endif /* __GST_OMX_CACHE_H__ */
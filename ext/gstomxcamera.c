@@ -570,13 +570,13 @@ gst_omx_camera_init_pads (GstOmxBaseSrc * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = OMX_VFCC_OUTPUT_PORT_START_INDEX;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
 
   GST_DEBUG_OBJECT (this, "Memory type: %d", memory.eBufMemoryType);
 
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "output";
     goto noport;
@@ -617,11 +617,11 @@ gst_omx_camera_init_pads (GstOmxBaseSrc * base)
       port->nBufferSize);
 
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE_SRC (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "output";
     goto noport;
@@ -632,11 +632,11 @@ gst_omx_camera_init_pads (GstOmxBaseSrc * base)
   GST_OMX_INIT_STRUCT (&hw_port, OMX_PARAM_VFCC_HWPORT_ID);
   /* Set capture interface */
   hw_port.eHwPortId = this->interface;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE_SRC (this)->handle,
       OMX_TI_IndexParamVFCCHwPortID, &hw_port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "output";
     goto noport;
@@ -667,11 +667,11 @@ gst_omx_camera_init_pads (GstOmxBaseSrc * base)
       hw_port_param.nMaxWidth, hw_port_param.nMaxChnlsPerHwPort,
       hw_port_param.eScanType, hw_port_param.eInColorFormat);
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamVFCCHwPortProperties,
       &hw_port_param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   if (GST_OMX_FAIL (error)) {
     portname = "output";
@@ -685,10 +685,10 @@ gst_omx_camera_init_pads (GstOmxBaseSrc * base)
       1e9 * this->format.framerate_den / this->format.framerate_num;
 
   GST_INFO_OBJECT (this, "Enabling output port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SendCommand (base->handle, OMX_CommandPortEnable,
       OMX_VFCC_OUTPUT_PORT_START_INDEX, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   if (GST_OMX_FAIL (error))
     goto enablefailed;
@@ -776,11 +776,11 @@ gst_omx_camera_set_skip_frames (GstOmxCamera * this)
      it is a binary 30bit value where 1 means drop a frame and 0
      process the frame */
   skip_frames.frameSkipMask = skip;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   err =
       OMX_SetConfig (base->handle, OMX_TI_IndexConfigVFCCFrameSkip,
       &skip_frames);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   if (err != OMX_ErrorNone)
     GST_WARNING_OBJECT (this,
@@ -798,11 +798,6 @@ gst_omx_camera_create (GstOmxBaseSrc * base, OMX_BUFFERHEADERTYPE * omx_buf,
 
   GstOmxCamera *this = GST_OMX_CAMERA (base);
   GstOmxBufferData *bufdata = (GstOmxBufferData *) omx_buf->pAppPrivate;
-  GstCaps *caps = NULL;
-
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
 
   /*FIXME: Set the interlaced flag correctly */
 /*    i = (0 != (omx_buf->nFlags & OMX_TI_BUFFERFLAG_VIDEO_FRAME_TYPE_INTERLACE));
@@ -816,11 +811,9 @@ gst_omx_camera_create (GstOmxBaseSrc * base, OMX_BUFFERHEADERTYPE * omx_buf,
     }
     gst_pad_set_caps (this->srcpad, caps);
   }
-  */ GST_BUFFER_SIZE (*buffer) = this->format.size_padded;
-  GST_BUFFER_CAPS (*buffer) = caps;
-  GST_BUFFER_DATA (*buffer) = omx_buf->pBuffer;
-  GST_BUFFER_MALLOCDATA (*buffer) = (guint8 *) omx_buf;
-  GST_BUFFER_FREE_FUNC (*buffer) = gst_omx_base_src_release_buffer;
+  */
+  /* The base class wrapped omx_buf with the pad caps already */
+  GST_BUFFER_SIZE (*buffer) = this->format.size_padded;
 
   /* Make buffer fields GStreamer friendly */
   GST_BUFFER_TIMESTAMP (*buffer) =
@@ -838,10 +831,4 @@ gst_omx_camera_create (GstOmxBaseSrc * base, OMX_BUFFERHEADERTYPE * omx_buf,
   bufdata->buffer = *buffer;
 
   return GST_FLOW_OK;
-
-nocaps:
-  {
-    GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
-    return GST_FLOW_NOT_NEGOTIATED;
-  }
 }
@@ -0,0 +1,467 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include <gst/video/video.h>
+
+#if defined (__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "gstomxcopy.h"
+#include "gstomxutils.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_copy_debug);
+#define GST_CAT_DEFAULT gst_omx_copy_debug
+
+typedef struct _GstOmxCopyJoin GstOmxCopyJoin;
+typedef struct _GstOmxCopyBand GstOmxCopyBand;
+
+struct _GstOmxCopyJoin
+{
+  GMutex lock;
+  GCond cond;
+  guint pending;
+};
+
+/* A part of a frame copy, luma rows or bytes for flat copies */
+struct _GstOmxCopyBand
+{
+  GstOmxCopy *copy;
+  GstOmxCopyMode mode;
+  guint8 *dest;
+  const guint8 *src;
+  guint first;
+  guint last;
+  GstOmxCopyJoin *join;
+};
+
+static void gst_omx_copy_band_func (gpointer data, gpointer user_data);
+
+/* Interleaves n bytes of the U and V rows into a NV12 chroma row */
+typedef void (*GstOmxCopyInterleaveFunc) (guint8 * dest, const guint8 * u,
+    const guint8 * v, guint n);
+
+static void
+gst_omx_copy_interleave_c (guint8 * dest, const guint8 * u, const guint8 * v,
+    guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    dest[2 * i] = u[i];
+    dest[2 * i + 1] = v[i];
+  }
+}
+
+#if defined (__ARM_NEON__)
+static void
+gst_omx_copy_interleave_neon (guint8 * dest, const guint8 * u,
+    const guint8 * v, guint n)
+{
+  uint8x16x2_t uv;
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    uv.val[0] = vld1q_u8 (u + i);
+    uv.val[1] = vld1q_u8 (v + i);
+    vst2q_u8 (dest + 2 * i, uv);
+  }
+
+  gst_omx_copy_interleave_c (dest + 2 * i, u + i, v + i, n - i);
+}
+#elif defined (__SSE2__)
+static void
+gst_omx_copy_interleave_sse2 (guint8 * dest, const guint8 * u,
+    const guint8 * v, guint n)
+{
+  __m128i mu, mv;
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    mu = _mm_loadu_si128 ((const __m128i *) (u + i));
+    mv = _mm_loadu_si128 ((const __m128i *) (v + i));
+    _mm_storeu_si128 ((__m128i *) (dest + 2 * i), _mm_unpacklo_epi8 (mu, mv));
+    _mm_storeu_si128 ((__m128i *) (dest + 2 * i + 16),
+        _mm_unpackhi_epi8 (mu, mv));
+  }
+
+  gst_omx_copy_interleave_c (dest + 2 * i, u + i, v + i, n - i);
+}
+#endif
+
+static GstOmxCopyInterleaveFunc gst_omx_copy_interleave =
+    gst_omx_copy_interleave_c;
+
+/* Shared by every element in the process, grown to the biggest
+ * copy-threads in use */
+static GThreadPool *gst_omx_copy_pool = NULL;
+static GMutex gst_omx_copy_pool_lock;
+
+/* Picks the kernels supported by the CPU we are running on */
+static gpointer
+gst_omx_copy_setup (gpointer data)
+{
+  const gchar *kernel = "C";
+
+  GST_DEBUG_CATEGORY_INIT (gst_omx_copy_debug, "omxcopy", 0,
+      "OMX input buffer copies");
+
+#if defined (__ARM_NEON__)
+  if (gst_omx_cpu_has_neon ()) {
+    gst_omx_copy_interleave = gst_omx_copy_interleave_neon;
+    kernel = "NEON";
+  }
+#elif defined (__SSE2__)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse2")) {
+    gst_omx_copy_interleave = gst_omx_copy_interleave_sse2;
+    kernel = "SSE2";
+  }
+#endif
+
+  GST_INFO ("Using the %s copy kernels", kernel);
+
+  gst_omx_copy_pool = g_thread_pool_new (gst_omx_copy_band_func, NULL, 1,
+      FALSE, NULL);
+
+  return NULL;
+}
+
+/* Rows are copied with memcpy, which the libc already vectorizes */
+static void
+gst_omx_copy_plane (guint8 * dest, guint deststride, const guint8 * src,
+    guint srcstride, guint rowbytes, guint rows)
+{
+  guint i;
+
+  if (deststride == rowbytes && srcstride == rowbytes) {
+    memcpy (dest, src, rowbytes * rows);
+    return;
+  }
+
+  for (i = 0; i < rows; i++)
+    memcpy (dest + i * deststride, src + i * srcstride, rowbytes);
+}
+
+void
+gst_omx_copy_reset (GstOmxCopy * copy)
+{
+  static GOnce setup = G_ONCE_INIT;
+
+  g_return_if_fail (copy);
+
+  g_once (&setup, gst_omx_copy_setup, NULL);
+
+  memset (copy, 0, sizeof (GstOmxCopy));
+  copy->mode = GST_OMX_COPY_FLAT;
+}
+
+/* Computes the input layout from the caps, an optional rowstride field
+ * overrides the default GStreamer strides */
+static void
+gst_omx_copy_input_layout (GstOmxCopy * copy, GstVideoFormat format,
+    gint rowstride)
+{
+  guint i, chromaheight;
+
+  for (i = 0; i < 3; i++) {
+    copy->instride[i] =
+        gst_video_format_get_row_stride (format, i, copy->width);
+    copy->inoffset[i] =
+        gst_video_format_get_component_offset (format, i, copy->width,
+        copy->height);
+  }
+  copy->insize = gst_video_format_get_size (format, copy->width, copy->height);
+
+  if (rowstride <= 0)
+    return;
+
+  chromaheight = GST_ROUND_UP_2 (copy->height) / 2;
+
+  switch (format) {
+    case GST_VIDEO_FORMAT_NV12:
+      copy->instride[0] = copy->instride[1] = rowstride;
+      copy->inoffset[1] = rowstride * GST_ROUND_UP_2 (copy->height);
+      copy->insize = copy->inoffset[1] + rowstride * chromaheight;
+      break;
+    case GST_VIDEO_FORMAT_I420:
+      copy->instride[0] = rowstride;
+      copy->instride[1] = copy->instride[2] = rowstride / 2;
+      copy->inoffset[1] = rowstride * GST_ROUND_UP_2 (copy->height);
+      copy->inoffset[2] = copy->inoffset[1] + rowstride / 2 * chromaheight;
+      copy->insize = copy->inoffset[2] + rowstride / 2 * chromaheight;
+      break;
+    default:
+      copy->instride[0] = rowstride;
+      copy->insize = rowstride * copy->height;
+      break;
+  }
+}
+
+/* Chooses how buffers with the given caps are copied into the port. Ports
+ * or formats that are not understood keep the flat copy */
+gboolean
+gst_omx_copy_configure (GstOmxCopy * copy, GstCaps * caps,
+    OMX_PARAM_PORTDEFINITIONTYPE * port)
+{
+  const GstStructure *structure;
+  GstVideoFormat format;
+  guint32 fourcc;
+  gint width, height, rowstride;
+  guint stride, outheight;
+
+  g_return_val_if_fail (copy, FALSE);
+  g_return_val_if_fail (port, FALSE);
+
+  gst_omx_copy_reset (copy);
+  copy->configured = TRUE;
+
+  if (!caps || gst_caps_get_size (caps) < 1)
+    return FALSE;
+
+  /* Not every element fills the port domain, rely on the caps instead */
+  structure = gst_caps_get_structure (caps, 0);
+  if (!g_str_has_prefix (gst_structure_get_name (structure), "video/x-raw-yuv")
+      || !gst_structure_get_fourcc (structure, "format", &fourcc)
+      || !gst_structure_get_int (structure, "width", &width)
+      || !gst_structure_get_int (structure, "height", &height))
+    return TRUE;
+
+  /* Strided caps use rowstride, the video mixer a stride field */
+  rowstride = 0;
+  if (!gst_structure_get_int (structure, "rowstride", &rowstride)
+      && gst_structure_get_uint (structure, "stride", &stride))
+    rowstride = stride;
+
+  if (port->format.video.nStride <= 0
+      || port->format.video.nFrameHeight < height)
+    return TRUE;
+
+  format = gst_video_format_from_fourcc (fourcc);
+  copy->width = width;
+  copy->height = height;
+  copy->outstride = port->format.video.nStride;
+  outheight = port->format.video.nFrameHeight;
+
+  switch (port->format.video.eColorFormat) {
+    case OMX_COLOR_FormatYUV420SemiPlanar:
+      if (GST_VIDEO_FORMAT_NV12 == format)
+        copy->mode = GST_OMX_COPY_NV12;
+      else if (GST_VIDEO_FORMAT_I420 == format)
+        copy->mode = GST_OMX_COPY_I420_NV12;
+      copy->outoffset = copy->outstride * outheight;
+      copy->outsize = copy->outoffset + copy->outstride * outheight / 2;
+      break;
+    case OMX_COLOR_FormatYCbYCr:
+      if (GST_VIDEO_FORMAT_YUY2 == format)
+        copy->mode = GST_OMX_COPY_YUY2;
+      copy->outsize = copy->outstride * outheight;
+      break;
+    default:
+      break;
+  }
+
+  /* The port rows must fit the widest packed row */
+  if (GST_OMX_COPY_FLAT == copy->mode
+      || copy->outstride < GST_ROUND_UP_2 (copy->width) *
+      (GST_OMX_COPY_YUY2 == copy->mode ? 2 : 1)) {
+    copy->mode = GST_OMX_COPY_FLAT;
+    return TRUE;
+  }
+
+  gst_omx_copy_input_layout (copy, format, rowstride);
+
+  /* Same layout on both sides, nothing to repack */
+  if (GST_OMX_COPY_I420_NV12 != copy->mode
+      && copy->instride[0] == copy->outstride
+      && (GST_OMX_COPY_YUY2 == copy->mode
+          || (copy->instride[1] == copy->outstride
+              && copy->inoffset[1] == copy->outoffset)))
+    copy->mode = GST_OMX_COPY_FLAT;
+
+  GST_DEBUG ("Copying %" GST_FOURCC_FORMAT " %ux%u with mode %d, stride %u "
+      "into stride %u, chroma at %u", GST_FOURCC_ARGS (fourcc), copy->width,
+      copy->height, copy->mode, copy->instride[0], copy->outstride,
+      copy->outoffset);
+
+  return TRUE;
+}
+
+/* Copies the luma rows [first, last) of the frame and the chroma rows
+ * that go with them, first must be even */
+static void
+gst_omx_copy_rows (GstOmxCopy * copy, GstOmxCopyMode mode, guint8 * dest,
+    const guint8 * src, guint first, guint last)
+{
+  guint chromawidth, chromafirst, chromalast, i;
+
+  chromawidth = GST_ROUND_UP_2 (copy->width) / 2;
+  chromafirst = first / 2;
+  chromalast = GST_ROUND_UP_2 (last) / 2;
+
+  switch (mode) {
+    case GST_OMX_COPY_NV12:
+      gst_omx_copy_plane (dest + first * copy->outstride, copy->outstride,
+          src + copy->inoffset[0] + first * copy->instride[0],
+          copy->instride[0], copy->width, last - first);
+      gst_omx_copy_plane (dest + copy->outoffset +
+          chromafirst * copy->outstride, copy->outstride,
+          src + copy->inoffset[1] + chromafirst * copy->instride[1],
+          copy->instride[1], chromawidth * 2, chromalast - chromafirst);
+      break;
+    case GST_OMX_COPY_I420_NV12:
+      gst_omx_copy_plane (dest + first * copy->outstride, copy->outstride,
+          src + copy->inoffset[0] + first * copy->instride[0],
+          copy->instride[0], copy->width, last - first);
+      for (i = chromafirst; i < chromalast; i++)
+        gst_omx_copy_interleave (dest + copy->outoffset + i * copy->outstride,
+            src + copy->inoffset[1] + i * copy->instride[1],
+            src + copy->inoffset[2] + i * copy->instride[2], chromawidth);
+      break;
+    case GST_OMX_COPY_YUY2:
+      gst_omx_copy_plane (dest + first * copy->outstride, copy->outstride,
+          src + copy->inoffset[0] + first * copy->instride[0],
+          copy->instride[0], chromawidth * 4, last - first);
+      break;
+    default:
+      /* Flat copies are split in bytes */
+      memcpy (dest + first, src + first, last - first);
+      break;
+  }
+}
+
+static void
+gst_omx_copy_band_func (gpointer data, gpointer user_data)
+{
+  GstOmxCopyBand *band = (GstOmxCopyBand *) data;
+  GstOmxCopyJoin *join = band->join;
+
+  gst_omx_copy_rows (band->copy, band->mode, band->dest, band->src,
+      band->first, band->last);
+
+  g_mutex_lock (&join->lock);
+  if (!--join->pending)
+    g_cond_signal (&join->cond);
+  g_mutex_unlock (&join->lock);
+}
+
+/* Splits units (rows or bytes) in bands, the calling thread copies the
+ * first one and the pool the rest. Returns once every band is done */
+static void
+gst_omx_copy_split (GstOmxCopy * copy, GstOmxCopyMode mode, guint8 * dest,
+    const guint8 * src, guint units, guint threads)
+{
+  GstOmxCopyBand bands[GST_OMX_COPY_MAX_THREADS];
+  GstOmxCopyJoin join;
+  guint step, i;
+
+  /* Bands start at even rows so chroma rows are not shared */
+  step = GST_ROUND_UP_2 ((units + threads - 1) / threads);
+  threads = (units + step - 1) / step;
+
+  if (threads < 2 || !gst_omx_copy_pool) {
+    gst_omx_copy_rows (copy, mode, dest, src, 0, units);
+    return;
+  }
+
+  g_mutex_init (&join.lock);
+  g_cond_init (&join.cond);
+  join.pending = threads - 1;
+
+  g_mutex_lock (&gst_omx_copy_pool_lock);
+  if (g_thread_pool_get_max_threads (gst_omx_copy_pool) < (gint) threads - 1)
+    g_thread_pool_set_max_threads (gst_omx_copy_pool, threads - 1, NULL);
+  g_mutex_unlock (&gst_omx_copy_pool_lock);
+
+  for (i = 0; i < threads; i++) {
+    bands[i].copy = copy;
+    bands[i].mode = mode;
+    bands[i].dest = dest;
+    bands[i].src = src;
+    bands[i].first = i * step;
+    bands[i].last = MIN (units, (i + 1) * step);
+    bands[i].join = &join;
+    if (i)
+      g_thread_pool_push (gst_omx_copy_pool, &bands[i], NULL);
+  }
+
+  gst_omx_copy_rows (copy, mode, dest, src, bands[0].first, bands[0].last);
+
+  g_mutex_lock (&join.lock);
+  while (join.pending)
+    g_cond_wait (&join.cond, &join.lock);
+  g_mutex_unlock (&join.lock);
+
+  g_mutex_clear (&join.lock);
+  g_cond_clear (&join.cond);
+}
+
+/* Copies buf into the port buffer and returns the filled length. Frames
+ * bigger than GST_OMX_COPY_THREADS_MIN_SIZE are split across the given
+ * number of threads, including the calling one */
+guint
+gst_omx_copy_buffer (GstOmxCopy * copy, OMX_BUFFERHEADERTYPE * omxbuf,
+    GstBuffer * buf, guint threads)
+{
+  GstOmxCopyMode mode;
+  const guint8 *src;
+  guint8 *dest;
+  guint size;
+
+  g_return_val_if_fail (copy, 0);
+  g_return_val_if_fail (omxbuf, 0);
+  g_return_val_if_fail (buf, 0);
+
+  src = GST_BUFFER_DATA (buf);
+  dest = omxbuf->pBuffer;
+  size = GST_BUFFER_SIZE (buf);
+  threads = CLAMP (threads, 1, GST_OMX_COPY_MAX_THREADS);
+  mode = copy->mode;
+
+  if (GST_OMX_COPY_FLAT != mode
+      && (size < copy->insize || omxbuf->nAllocLen < copy->outsize)) {
+    GST_WARNING ("Buffer of %u bytes doesn't match the negotiated layout, "
+        "copying it as is", size);
+    mode = GST_OMX_COPY_FLAT;
+  }
+
+  if (GST_OMX_COPY_FLAT != mode) {
+    if (copy->outsize < GST_OMX_COPY_THREADS_MIN_SIZE)
+      threads = 1;
+    gst_omx_copy_split (copy, mode, dest, src, copy->height, threads);
+    return copy->outsize;
+  }
+
+  if (size > omxbuf->nAllocLen) {
+    GST_WARNING ("Truncating buffer of %u bytes to %u", size,
+        (guint) omxbuf->nAllocLen);
+    size = omxbuf->nAllocLen;
+  }
+
+  if (size < GST_OMX_COPY_THREADS_MIN_SIZE)
+    threads = 1;
+  gst_omx_copy_split (copy, mode, dest, src, size, threads);
+
+  return size;
+}
@@ -0,0 +1,71 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_OMX_COPY_H__
+#define __GST_OMX_COPY_H__
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+/* Upper limit for the copy-threads properties */
+#define GST_OMX_COPY_MAX_THREADS 8
+/* Frames smaller than this are always copied by the calling thread */
+#define GST_OMX_COPY_THREADS_MIN_SIZE (256 * 1024)
+typedef struct _GstOmxCopy GstOmxCopy;
+
+typedef enum
+{
+  GST_OMX_COPY_FLAT,            /* Plain memcpy, the layouts match or are unknown */
+  GST_OMX_COPY_NV12,            /* NV12 into a padded NV12 port */
+  GST_OMX_COPY_I420_NV12,       /* I420 into a padded NV12 port */
+  GST_OMX_COPY_YUY2             /* YUY2 into a padded YUY2 port */
+} GstOmxCopyMode;
+
+/* Describes how a non OMX buffer is written into an input port buffer.
+ * Strides and offsets are in bytes, the input planes are Y, U and V (or Y
+ * and UV for NV12) and the output planes Y and UV */
+struct _GstOmxCopy
+{
+  gboolean configured;
+  GstOmxCopyMode mode;
+
+  guint width;
+  guint height;
+
+  guint instride[3];
+  guint inoffset[3];
+  guint insize;
+
+  guint outstride;
+  guint outoffset;
+  guint outsize;
+};
+
+void gst_omx_copy_reset (GstOmxCopy * copy);
+gboolean gst_omx_copy_configure (GstOmxCopy * copy, GstCaps * caps,
+    OMX_PARAM_PORTDEFINITIONTYPE * port);
+guint gst_omx_copy_buffer (GstOmxCopy * copy, OMX_BUFFERHEADERTYPE * omxbuf,
+    GstBuffer * buf, guint threads);
+
+G_END_DECLS
+#endif /* __GST_OMX_COPY_H__ */
@@ -178,12 +178,13 @@ gst_omx_deiscaler_class_init (GstOmxDeiscalerClass * klass)
   g_object_class_install_property (gobject_class, PROP_RATE_DIV,
       g_param_spec_uint ("framerate-divisor", "Output frame rate divisor",
           "Output framerate = (2 * input_framerate) / framerate_divisor",
-          1, 60, GST_OMX_DEISCALER_RATE_DIV_DEFAULT, G_PARAM_READWRITE));
+          1, 60, GST_OMX_DEISCALER_RATE_DIV_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_CROP_AREA,
       g_param_spec_string ("crop-area", "Select the crop area",
           "Selects the crop area using the format <startX>,<startY>@"
           "<cropWidth>x<cropHeight>", GST_OMX_DEISCALER_CROP_AREA_DEFAULT,
-          G_PARAM_READWRITE));
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
 
   gstomxbase_class->parse_caps = GST_DEBUG_FUNCPTR (gst_omx_deiscaler_set_caps);
   gstomxbase_class->init_ports =
@@ -611,11 +612,11 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
 
   GST_OMX_INIT_STRUCT (&subsampling_factor, OMX_CONFIG_SUBSAMPLING_FACTOR);
   subsampling_factor.nSubSamplingFactor = this->framerate_divisor;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetConfig (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigSubSamplingFactor, &subsampling_factor);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noconfiguration;
 
@@ -623,10 +624,10 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = OMX_VFPC_INPUT_PORT_START_INDEX;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "input";
     goto noport;
@@ -638,10 +639,10 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
     GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
     memory.nPortIndex = OMX_VFPC_OUTPUT_PORT_START_INDEX + i;
     memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (base->omx_lock);
     error =
         OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (base->omx_lock);
     if (GST_OMX_FAIL (error)) {
       portname = "output";
       goto noport;
@@ -656,9 +657,9 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (port, OMX_PARAM_PORTDEFINITIONTYPE);
   port->nPortIndex = OMX_VFPC_INPUT_PORT_START_INDEX;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle, OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   port->nPortIndex = OMX_VFPC_INPUT_PORT_START_INDEX;
   port->format.video.nFrameWidth = this->in_format.width;       //OMX_VFPC_DEFAULT_INPUT_FRAME_WIDTH;
@@ -674,9 +675,9 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
   if (base->interlaced)
     port->nBufferCountActual *= 2;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (base->handle, OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "input";
     goto noport;
@@ -701,9 +702,9 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
     GST_OMX_INIT_STRUCT (port, OMX_PARAM_PORTDEFINITIONTYPE);
     port->nPortIndex = index;
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (base->omx_lock);
     OMX_GetParameter (base->handle, OMX_IndexParamPortDefinition, port);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (base->omx_lock);
 
     port->nPortIndex = index;
     port->format.video.nFrameWidth = out_format->width; //OMX_VFPC_DEFAULT_INPUT_FRAME_WIDTH;
@@ -724,9 +725,9 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
         port->format.video.nFrameHeight, port->format.video.nStride,
         port->format.video.eColorFormat, port->nBufferSize);
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (base->omx_lock);
     error = OMX_SetParameter (base->handle, OMX_IndexParamPortDefinition, port);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (base->omx_lock);
     if (GST_OMX_FAIL (error)) {
       portname = "output";
       goto noport;
@@ -737,11 +738,11 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
   GST_DEBUG_OBJECT (this, "Setting number of channels per handle");
   GST_OMX_INIT_STRUCT (&channels, OMX_PARAM_VFPC_NUMCHANNELPERHANDLE);
   channels.nNumChannelsPerHandle = 1;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexParamVFPCNumChPerHandle, &channels);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto nochannels;
 
@@ -761,19 +762,19 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
   enable.nChId = 0;
   enable.bAlgBypass = base->interlaced ? 0 : 1;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetConfig (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigAlgEnable, &enable);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling input port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable,
       OMX_VFPC_INPUT_PORT_START_INDEX, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for input port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -786,10 +787,10 @@ gst_omx_deiscaler_init_pads (GstOmxBase * base)
     GstPad *srcpad = l->data;
     GST_INFO_OBJECT (this, "Enabling output port %lu",
         (GST_OMX_PAD_PORT (GST_OMX_PAD (srcpad)))->nPortIndex);
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (base->omx_lock);
     OMX_SendCommand (base->handle, OMX_CommandPortEnable,
         (GST_OMX_PAD_PORT (GST_OMX_PAD (srcpad)))->nPortIndex, NULL);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (base->omx_lock);
 
     GST_INFO_OBJECT (this, "Waiting for output port to enable");
     error = gst_omx_base_wait_for_condition (base,
@@ -831,7 +832,6 @@ gst_omx_deiscaler_fill_callback (GstOmxBase * base,
   GstOmxDeiscaler *this = GST_OMX_DEISCALER (base);
   GstFlowReturn ret = GST_FLOW_OK;
   GstBuffer *buffer = NULL;
-  GstCaps *caps = NULL;
   GstOmxFormat *out_format;
   GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
   GstPad *srcpad = GST_PAD (bufdata->pad);
@@ -845,21 +845,14 @@ gst_omx_deiscaler_fill_callback (GstOmxBase * base,
     return GST_FLOW_OK;
   }
 
-  caps = gst_pad_get_negotiated_caps (srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, srcpad, outbuf,
+      gst_omx_base_release_buffer);
   if (!buffer)
-    goto noalloc;
+    goto nocaps;
 
   out_format = this->out_formats->data;
 
   GST_BUFFER_SIZE (buffer) = GST_OMX_PAD_PORT (bufdata->pad)->nBufferSize;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
   GST_BUFFER_TIMESTAMP (buffer) = outbuf->nTimeStamp;
   GST_BUFFER_DURATION (buffer) =
       1e9 * out_format->framerate_den / out_format->framerate_num;
@@ -873,12 +866,6 @@ gst_omx_deiscaler_fill_callback (GstOmxBase * base,
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
@@ -937,11 +924,11 @@ gst_omx_deiscaler_sink_dynamic_configuration (GstOmxDeiscaler * this,
       resolution.FrmStartX,
       resolution.FrmStartY, resolution.FrmCropWidth, resolution.FrmCropHeight);
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetConfig (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigVidChResolution, &resolution);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noresolution;
 
@@ -1013,11 +1000,11 @@ gst_omx_deiscaler_srcs_dynamic_configuration (GstOmxDeiscaler * this,
       resolution.FrmStartX,
       resolution.FrmStartY, resolution.FrmCropWidth, resolution.FrmCropHeight);
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetConfig (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigVidChResolution, &resolution);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noresolution;
 
@@ -73,6 +73,8 @@ static gboolean gst_omx_h264_dec_set_caps (GstPad * pad, GstCaps * caps);
 static OMX_ERRORTYPE gst_omx_h264_dec_init_pads (GstOmxBase * this);
 static GstFlowReturn gst_omx_h264_dec_fill_callback (GstOmxBase *,
     OMX_BUFFERHEADERTYPE *);
+static OMX_ERRORTYPE gst_omx_h264_dec_port_changed (GstOmxBase *,
+    GstOmxPad *);
 /* GObject vmethod implementations */
 
 /* initialize the omx's class */
@@ -100,6 +102,11 @@ gst_omx_h264_dec_class_init (GstOmxH264DecClass * klass)
   gstomxbase_class->omx_fill_buffer =
       GST_DEBUG_FUNCPTR (gst_omx_h264_dec_fill_callback);
   gstomxbase_class->init_ports = GST_DEBUG_FUNCPTR (gst_omx_h264_dec_init_pads);
+  /* Only the port definitions are set, the same works on disabled ports */
+  gstomxbase_class->update_ports =
+      GST_DEBUG_FUNCPTR (gst_omx_h264_dec_init_pads);
+  gstomxbase_class->port_changed =
+      GST_DEBUG_FUNCPTR (gst_omx_h264_dec_port_changed);
 
   gstomxbase_class->handle_name = "OMX.TI.DUCATI.VIDDEC";
 
@@ -258,10 +265,10 @@ gst_omx_h264_dec_init_pads (GstOmxBase * base)
       this->format.framerate_den) << 16;
   port->format.video.eCompressionFormat = OMX_VIDEO_CodingAVC;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "input";
     goto noport;
@@ -284,11 +291,11 @@ gst_omx_h264_dec_init_pads (GstOmxBase * base)
       this->format.framerate_den) << 16;
   port->format.video.eColorFormat = OMX_COLOR_FormatYUV420SemiPlanar;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "output";
     goto noport;
@@ -305,6 +312,62 @@ noport:
   }
 }
 
+/* The decoder reports the real stream geometry with PortSettingsChanged
+ * on the output port, the output format and caps follow it */
+static OMX_ERRORTYPE
+gst_omx_h264_dec_port_changed (GstOmxBase * base, GstOmxPad * pad)
+{
+  GstOmxH264Dec *this = GST_OMX_H264_DEC (base);
+  OMX_PARAM_PORTDEFINITIONTYPE *port = GST_OMX_PAD_PORT (pad);
+  GstCaps *caps = NULL;
+
+  if (GST_PAD (pad) != this->srcpad)
+    return OMX_ErrorNone;
+
+  this->format.width = port->format.video.nFrameWidth;
+  this->format.height = port->format.video.nFrameHeight;
+  this->format.width_padded = port->format.video.nStride;
+  this->format.height_padded = GST_OMX_ALIGN (this->format.height, 16);
+  this->format.size_padded = port->nBufferSize;
+  this->format.size = gst_video_format_get_size (this->format.format,
+      this->format.width, this->format.height);
+
+  GST_INFO_OBJECT (this, "Output format changed to %ux%u, stride %u, "
+      "%u bytes", this->format.width, this->format.height,
+      this->format.width_padded, this->format.size_padded);
+
+  caps = gst_pad_get_negotiated_caps (this->srcpad);
+  if (!caps)
+    goto nocaps;
+
+  caps = gst_caps_make_writable (caps);
+  gst_caps_set_simple (caps,
+      "width", G_TYPE_INT, this->format.width,
+      "height", G_TYPE_INT, this->format.height,
+      "stride", G_TYPE_INT, this->format.width_padded, (char *) NULL);
+
+  GST_DEBUG_OBJECT (this, "Output caps: %" GST_PTR_FORMAT, caps);
+
+  if (!gst_pad_set_caps (this->srcpad, caps))
+    goto nosetcaps;
+
+  gst_caps_unref (caps);
+
+  return OMX_ErrorNone;
+
+nocaps:
+  {
+    GST_ERROR_OBJECT (this, "The src pad has no caps to update");
+    return OMX_ErrorUndefined;
+  }
+nosetcaps:
+  {
+    GST_ERROR_OBJECT (this, "Src pad didn't accept the new caps");
+    gst_caps_unref (caps);
+    return OMX_ErrorUndefined;
+  }
+}
+
 static GstFlowReturn
 gst_omx_h264_dec_fill_callback (GstOmxBase * base,
     OMX_BUFFERHEADERTYPE * outbuf)
@@ -319,31 +382,30 @@ gst_omx_h264_dec_fill_callback (GstOmxBase * base,
 
   GST_LOG_OBJECT (this, "H264 Fill buffer callback");
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
-  if (!buffer)
-    goto noalloc;
-
+  /* Renegotiate before wrapping, the buffer takes the pad caps */
   i = (0 != (outbuf->nFlags & OMX_TI_BUFFERFLAG_VIDEO_FRAME_TYPE_INTERLACE));
   if (i != this->format.interlaced) {
+    caps = gst_pad_get_negotiated_caps (this->srcpad);
+    if (!caps)
+      goto nocaps;
+
     this->format.interlaced = i;
-    caps = gst_caps_copy (GST_PAD_CAPS (this->srcpad));
+    caps = gst_caps_make_writable (caps);
     structure = gst_caps_get_structure (caps, 0);
     if (structure) {
       gst_structure_set (structure,
           "interlaced", G_TYPE_BOOLEAN, this->format.interlaced, (char *) NULL);
     }
     gst_pad_set_caps (this->srcpad, caps);
+    gst_caps_unref (caps);
   }
 
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
+  if (!buffer)
+    goto nocaps;
+
   GST_BUFFER_SIZE (buffer) = this->format.size_padded;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
 
   /* Make buffer fields GStreamer friendly */
   GST_BUFFER_TIMESTAMP (buffer) = outbuf->nTimeStamp;
@@ -366,12 +428,6 @@ gst_omx_h264_dec_fill_callback (GstOmxBase * base,
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
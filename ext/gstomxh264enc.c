@@ -43,7 +43,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_omx_h264_enc_debug);
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV_STRIDED ("NV12", "[ 0, max ]") ";")
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV_STRIDED ("{ NV12, I420 }",
+            "[ 0, max ]") ";")
     );
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
@@ -224,25 +225,28 @@ gst_omx_h264_enc_class_init (GstOmxH264EncClass * klass)
   g_object_class_install_property (gobject_class, PROP_BITRATE,
       g_param_spec_uint ("bitrate", "Encoding bitrate",
           "Sets the encoder bitrate",
-          0, 4294967295, GST_OMX_H264_ENC_BITRATE_DEFAULT, G_PARAM_READWRITE));
+          0, 4294967295, GST_OMX_H264_ENC_BITRATE_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_BYTESTREAM,
       g_param_spec_boolean ("bytestream", "Bytestream",
           "Sets the encoder bytestream",
-          GST_OMX_H264_ENC_BYTESTREAM_DEFAULT, G_PARAM_READWRITE));
+          GST_OMX_H264_ENC_BYTESTREAM_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_PROFILE,
       g_param_spec_enum ("profile", "Encoding H264 profile",
           "Sets the H264 profile",
           GST_TYPE_OMX_VIDEO_AVCPROFILETYPE, GST_OMX_H264_ENC_PROFILE_DEFAULT,
-          G_PARAM_READWRITE));
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_LEVEL,
       g_param_spec_enum ("level", "Encoding H264 level",
           "Sets the H264 level",
           GST_TYPE_OMX_VIDEO_AVCLEVELTYPE, GST_OMX_H264_ENC_LEVEL_DEFAULT,
-          G_PARAM_READWRITE));
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_IPERIOD,
       g_param_spec_uint ("i_period", "I frames periodicity",
           "Specifies periodicity of I frames",
-          0, 2147483647, GST_OMX_H264_ENC_IPERIOD_DEFAULT, G_PARAM_READWRITE));
+          0, 2147483647, GST_OMX_H264_ENC_IPERIOD_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_IDRPERIOD,
       g_param_spec_uint ("force_idr_period", "IDR frames periodicity",
           "Specifies periodicity of IDR frames",
@@ -256,12 +260,13 @@ gst_omx_h264_enc_class_init (GstOmxH264EncClass * klass)
       g_param_spec_enum ("encodingPreset", "Encoding preset",
           "Specifies which encoding preset to use",
           GST_TYPE_OMX_VIDEO_ENCODE_PRESETTYPE, GST_OMX_H264_ENC_PRESET_DEFAULT,
-          G_PARAM_READWRITE));
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
   g_object_class_install_property (gobject_class, PROP_RATE_CTRL,
       g_param_spec_enum ("rateControlPreset", "Encoding rate control preset",
           "Specifies what rate control preset to use",
           GST_TYPE_OMX_VIDEO_RATECONTROL_PRESETTYPE,
-          GST_OMX_H264_ENC_RATE_CTRL_DEFAULT, G_PARAM_READWRITE));
+          GST_OMX_H264_ENC_RATE_CTRL_DEFAULT,
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
 
   gstomxbase_class->parse_caps = GST_DEBUG_FUNCPTR (gst_omx_h264_enc_set_caps);
   gstomxbase_class->omx_fill_buffer =
@@ -537,18 +542,18 @@ gst_omx_h264_enc_init_pads (GstOmxBase * base)
 
   GST_OMX_INIT_STRUCT (&param, OMX_VIDEO_PARAM_PROFILELEVELTYPE);
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle,
       (OMX_INDEXTYPE) OMX_IndexParamVideoProfileLevelCurrent, &param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   param.eProfile = this->profile;
   param.eLevel = this->level;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamVideoProfileLevelCurrent, &param);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   if (error == OMX_ErrorUnsupportedIndex) {
     GST_WARNING_OBJECT (this,
@@ -560,10 +565,10 @@ gst_omx_h264_enc_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = 0;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "input";
     goto noport;
@@ -573,10 +578,10 @@ gst_omx_h264_enc_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = 1;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "output";
     goto noport;
@@ -603,10 +608,10 @@ gst_omx_h264_enc_init_pads (GstOmxBase * base)
   port->nBufferSize =           //this->format.size;
       (port->format.video.nStride * port->format.video.nFrameHeight) * 1.5;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "input";
     goto noport;
@@ -640,11 +645,11 @@ gst_omx_h264_enc_init_pads (GstOmxBase * base)
   port->format.video.nBitrate = this->bitrate;
   port->format.video.eCompressionFormat = OMX_VIDEO_CodingAVC;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   if (error != OMX_ErrorNone) {
     portname = "output";
@@ -661,9 +666,9 @@ gst_omx_h264_enc_init_pads (GstOmxBase * base)
 
 
   GST_INFO_OBJECT (this, "Enabling input port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable, 0, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for input port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -673,9 +678,9 @@ gst_omx_h264_enc_init_pads (GstOmxBase * base)
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling output port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable, 1, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for output port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -718,7 +723,6 @@ gst_omx_h264_enc_fill_callback (GstOmxBase * base,
   GstOmxH264Enc *this = GST_OMX_H264_ENC (base);
   GstFlowReturn ret = GST_FLOW_OK;
   GstBuffer *buffer = NULL;
-  GstCaps *caps = NULL;
   GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
 
   GST_LOG_OBJECT (this, "H264 Encoder Fill buffer callback");
@@ -757,19 +761,10 @@ gst_omx_h264_enc_fill_callback (GstOmxBase * base,
     }
   }
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
   if (!buffer)
-    goto noalloc;
-
-  GST_BUFFER_SIZE (buffer) = outbuf->nFilledLen;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
+    goto nocaps;
 
   /* Make buffer fields GStreamer friendly */
   GST_BUFFER_TIMESTAMP (buffer) = outbuf->nTimeStamp;
@@ -792,12 +787,6 @@ gst_omx_h264_enc_fill_callback (GstOmxBase * base,
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
@@ -837,9 +826,9 @@ gst_omx_h264_enc_static_parameters (GstOmxH264Enc * this,
     GST_DEBUG_OBJECT (base->handle,
         "setting 'OMX.TI.VideoEncode.Config.NALFormat' to %ld", nal_format);
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (base->omx_lock);
     error = OMX_SetParameter (base->handle, index, &nal_format);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (base->omx_lock);
     if (GST_OMX_FAIL (error))
       goto noNalFormat;
   } else
@@ -850,21 +839,21 @@ gst_omx_h264_enc_static_parameters (GstOmxH264Enc * this,
   GST_OMX_INIT_STRUCT (&AVCParams, OMX_VIDEO_PARAM_AVCTYPE);
   AVCParams.nPortIndex = OMX_DirOutput;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle, (OMX_INDEXTYPE) OMX_IndexParamVideoAvc,
       &AVCParams);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   AVCParams.eProfile = this->profile;
   AVCParams.eLevel = this->level;
   AVCParams.nPFrames = this->i_period - 1;
   AVCParams.nBFrames = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle,
       (OMX_INDEXTYPE) OMX_IndexParamVideoAvc, &AVCParams);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noAVCParams;
 
@@ -872,19 +861,19 @@ gst_omx_h264_enc_static_parameters (GstOmxH264Enc * this,
   GST_OMX_INIT_STRUCT (&EncoderPreset, OMX_VIDEO_PARAM_ENCODER_PRESETTYPE);
   EncoderPreset.nPortIndex = 1;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexParamVideoEncoderPreset, &EncoderPreset);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   EncoderPreset.eEncodingModePreset = this->encodingPreset;
   EncoderPreset.eRateControlPreset = this->rateControlPreset;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexParamVideoEncoderPreset, &EncoderPreset);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto nopreset;
 
@@ -897,10 +886,10 @@ gst_omx_h264_enc_static_parameters (GstOmxH264Enc * this,
 
     tStaticParam.nPortIndex = 1;
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (base->omx_lock);
     OMX_GetParameter (base->handle,
         (OMX_INDEXTYPE) OMX_TI_IndexParamVideoStaticParams, &tStaticParam);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (base->omx_lock);
 
     /* for interlace, base profile can not be used */
 
@@ -928,11 +917,11 @@ gst_omx_h264_enc_static_parameters (GstOmxH264Enc * this,
     tStaticParam.videoStaticParams.h264EncStaticParams.
         intraCodingParams.lumaIntra8x8Enable = 0x1f;
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (base->omx_lock);
     error =
         OMX_SetParameter (base->handle,
         (OMX_INDEXTYPE) OMX_TI_IndexParamVideoStaticParams, &tStaticParam);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (base->omx_lock);
     if (GST_OMX_FAIL (error))
       goto nointerlaced;
 
@@ -102,6 +102,9 @@ gst_omx_jpeg_dec_class_init (GstOmxJpegDecClass * klass)
       GST_DEBUG_FUNCPTR (gst_omx_jpeg_dec_fill_callback);
   gstomxbase_class->init_ports =
       GST_DEBUG_FUNCPTR (gst_omx_jpeg_dec_init_pads);
+  /* Only the port definitions are set, the same works on disabled ports */
+  gstomxbase_class->update_ports =
+      GST_DEBUG_FUNCPTR (gst_omx_jpeg_dec_init_pads);
 
   gstomxbase_class->handle_name = "OMX.TI.DUCATI.VIDDEC";
 
@@ -258,10 +261,10 @@ gst_omx_jpeg_dec_init_pads (GstOmxBase * base)
       this->format.framerate_den) << 16;
   port->format.video.eCompressionFormat = OMX_VIDEO_CodingMJPEG;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "input";
     goto noport;
@@ -284,11 +287,11 @@ gst_omx_jpeg_dec_init_pads (GstOmxBase * base)
       ((guint) ((gdouble) this->format.framerate_num) /
       this->format.framerate_den) << 16;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "output";
     goto noport;
@@ -312,26 +315,18 @@ gst_omx_jpeg_dec_fill_callback (GstOmxBase * base,
   GstOmxJpegDec *this = GST_OMX_JPEG_DEC (base);
   GstFlowReturn ret = GST_FLOW_OK;
   GstBuffer *buffer = NULL;
-  GstCaps *caps = NULL;
   GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
   GstStructure *structure = NULL;
   gboolean i = FALSE;
 
   GST_LOG_OBJECT (this, "JPEG Fill buffer callback");
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
   if (!buffer)
-    goto noalloc;
+    goto nocaps;
 
   GST_BUFFER_SIZE (buffer) = this->format.size_padded;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
 
   /* Make buffer fields GStreamer friendly */
   GST_BUFFER_SIZE (buffer) = this->format.size;
@@ -349,12 +344,6 @@ gst_omx_jpeg_dec_fill_callback (GstOmxBase * base,
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
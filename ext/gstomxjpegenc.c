@@ -44,7 +44,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_omx_jpeg_enc_debug);
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV_STRIDED ("NV12", "[ 0, max ]") ";")
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV_STRIDED ("{ NV12, I420 }",
+            "[ 0, max ]") ";")
     );
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
@@ -113,7 +114,8 @@ gst_omx_jpeg_enc_class_init (GstOmxJpegEncClass * klass)
   g_object_class_install_property (gobject_class, PROP_QUALITY,
         g_param_spec_uint ("quality", "MJPEG/JPEG quality",
             "MJPEG/JPEG quality (integer 0:min 100:max)",
-            0, 100, GST_OMX_JPEG_ENC_QUALITY_DEFAULT, G_PARAM_READWRITE));
+            0, 100, GST_OMX_JPEG_ENC_QUALITY_DEFAULT,
+            G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
 
   gstomxbase_class->parse_caps = GST_DEBUG_FUNCPTR (gst_omx_jpeg_enc_set_caps);
   gstomxbase_class->omx_fill_buffer =
@@ -299,10 +301,10 @@ gst_omx_jpeg_enc_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = 0;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "input";
     goto noport;
@@ -312,10 +314,10 @@ gst_omx_jpeg_enc_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = 1;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "output";
     goto noport;
@@ -342,10 +344,10 @@ gst_omx_jpeg_enc_init_pads (GstOmxBase * base)
   port->nBufferSize =           //this->format.size;
       (port->format.video.nStride * port->format.video.nFrameHeight) * 1.5;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "input";
     goto noport;
@@ -379,11 +381,11 @@ gst_omx_jpeg_enc_init_pads (GstOmxBase * base)
   port->format.video.nBitrate = 500000;	//TODO: testing value only
   port->format.video.eCompressionFormat = OMX_VIDEO_CodingMJPEG;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   if (error != OMX_ErrorNone) {
     portname = "output";
@@ -400,9 +402,9 @@ gst_omx_jpeg_enc_init_pads (GstOmxBase * base)
 
 
   GST_INFO_OBJECT (this, "Enabling input port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable, 0, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for input port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -412,9 +414,9 @@ gst_omx_jpeg_enc_init_pads (GstOmxBase * base)
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling output port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable, 1, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for output port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -435,10 +437,10 @@ gst_omx_jpeg_enc_init_pads (GstOmxBase * base)
                        
   tQualityFactor.nPortIndex = 1;
   
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle,
       (OMX_INDEXTYPE) OMX_IndexParamQFactor, &tQualityFactor);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Got QFactor %d",
                        (gint)tQualityFactor.nQFactor);
@@ -448,14 +450,14 @@ gst_omx_jpeg_enc_init_pads (GstOmxBase * base)
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamQFactor, &tQualityFactor);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   /* Testing correct quality setting */
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_GetParameter (base->handle,
       (OMX_INDEXTYPE) OMX_IndexParamQFactor, &tQualityFactor);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Exit setup QFactor %d",
                        (gint)tQualityFactor.nQFactor);
@@ -492,7 +494,6 @@ gst_omx_jpeg_enc_fill_callback (GstOmxBase * base,
   GstOmxJpegEnc *this = GST_OMX_JPEG_ENC (base);
   GstFlowReturn ret = GST_FLOW_OK;
   GstBuffer *buffer = NULL;
-  GstCaps *caps = NULL;
   GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
 
   GST_INFO_OBJECT (this, "JPEG Encoder Fill buffer callback");
@@ -501,19 +502,10 @@ gst_omx_jpeg_enc_fill_callback (GstOmxBase * base,
                 outbuf, outbuf->nAllocLen, outbuf->nFilledLen, outbuf->nFlags,
                 outbuf->nOffset, outbuf->nTimeStamp);
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
   if (!buffer)
-    goto noalloc;
-
-  GST_BUFFER_SIZE (buffer) = outbuf->nFilledLen;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
+    goto nocaps;
 
   /* Make buffer fields GStreamer friendly */
   GST_BUFFER_TIMESTAMP (buffer) = outbuf->nTimeStamp;
@@ -536,12 +528,6 @@ gst_omx_jpeg_enc_fill_callback (GstOmxBase * base,
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
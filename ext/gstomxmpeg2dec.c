@@ -104,6 +104,9 @@ gst_omx_mpeg2_dec_class_init (GstOmxMpeg2DecClass * klass)
       GST_DEBUG_FUNCPTR (gst_omx_mpeg2_dec_fill_callback);
   gstomxbase_class->init_ports =
       GST_DEBUG_FUNCPTR (gst_omx_mpeg2_dec_init_pads);
+  /* Only the port definitions are set, the same works on disabled ports */
+  gstomxbase_class->update_ports =
+      GST_DEBUG_FUNCPTR (gst_omx_mpeg2_dec_init_pads);
 
   gstomxbase_class->handle_name = "OMX.TI.DUCATI.VIDDEC";
 
@@ -406,10 +409,10 @@ gst_omx_mpeg2_dec_init_pads (GstOmxBase * base)
       this->format.framerate_den) << 16;
   port->format.video.eCompressionFormat = OMX_VIDEO_CodingMPEG2;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "input";
     goto noport;
@@ -431,11 +434,11 @@ gst_omx_mpeg2_dec_init_pads (GstOmxBase * base)
       ((guint) ((gdouble) this->format.framerate_num) /
       this->format.framerate_den) << 16;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (GST_OMX_BASE (this)->handle,
       OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (error != OMX_ErrorNone) {
     portname = "output";
     goto noport;
@@ -466,31 +469,30 @@ gst_omx_mpeg2_dec_fill_callback (GstOmxBase * base,
 
   GST_LOG_OBJECT (this, "MPEG2 Fill buffer callback");
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
-  if (!buffer)
-    goto noalloc;
-
+  /* Renegotiate before wrapping, the buffer takes the pad caps */
   i = (0 != (outbuf->nFlags & OMX_TI_BUFFERFLAG_VIDEO_FRAME_TYPE_INTERLACE));
   if (i != this->format.interlaced) {
+    caps = gst_pad_get_negotiated_caps (this->srcpad);
+    if (!caps)
+      goto nocaps;
+
     this->format.interlaced = i;
-    caps = gst_caps_copy (GST_PAD_CAPS (this->srcpad));
+    caps = gst_caps_make_writable (caps);
     structure = gst_caps_get_structure (caps, 0);
     if (structure) {
       gst_structure_set (structure,
           "interlaced", G_TYPE_BOOLEAN, this->format.interlaced, (char *) NULL);
     }
     gst_pad_set_caps (this->srcpad, caps);
+    gst_caps_unref (caps);
   }
 
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
+  if (!buffer)
+    goto nocaps;
+
   GST_BUFFER_SIZE (buffer) = this->format.size_padded;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
 
   /* Make buffer fields GStreamer friendly */
   GST_BUFFER_SIZE (buffer) = this->format.size;
@@ -508,12 +510,6 @@ gst_omx_mpeg2_dec_fill_callback (GstOmxBase * base,
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
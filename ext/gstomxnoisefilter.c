@@ -324,10 +324,10 @@ gst_omx_noise_filter_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = OMX_VFPC_INPUT_PORT_START_INDEX;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "input";
     goto noport;
@@ -337,10 +337,10 @@ gst_omx_noise_filter_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = OMX_VFPC_OUTPUT_PORT_START_INDEX;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "output";
     goto noport;
@@ -362,9 +362,9 @@ gst_omx_noise_filter_init_pads (GstOmxBase * base)
   port->nBufferAlignment = 0;
   port->bBuffersContiguous = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (base->handle, OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "input";
     goto noport;
@@ -383,9 +383,9 @@ gst_omx_noise_filter_init_pads (GstOmxBase * base)
   port->format.video.eColorFormat = OMX_COLOR_FormatYUV420SemiPlanar;
   port->nBufferSize = this->out_format.size_padded;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (base->handle, OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "output";
     goto noport;
@@ -407,19 +407,19 @@ gst_omx_noise_filter_init_pads (GstOmxBase * base)
   enable.nChId = 0;
   enable.bAlgBypass = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetConfig (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigAlgEnable, &enable);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling input port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable,
       OMX_VFPC_INPUT_PORT_START_INDEX, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for input port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -429,10 +429,10 @@ gst_omx_noise_filter_init_pads (GstOmxBase * base)
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling output port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable,
       OMX_VFPC_OUTPUT_PORT_START_INDEX, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for output port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -469,23 +469,16 @@ gst_omx_noise_filter_fill_callback (GstOmxBase * base,
   GstOmxNoiseFilter *this = GST_OMX_NOISE_FILTER (base);
   GstFlowReturn ret = GST_FLOW_OK;
   GstBuffer *buffer = NULL;
-  GstCaps *caps = NULL;
+  GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
 
   GST_LOG_OBJECT (this, "Scaler fill buffer callback");
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
   if (!buffer)
-    goto noalloc;
+    goto nocaps;
 
   GST_BUFFER_SIZE (buffer) = this->out_format.size_padded;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
   GST_BUFFER_TIMESTAMP (buffer) = outbuf->nTimeStamp;
   GST_BUFFER_DURATION (buffer) =
       1e9 * this->out_format.framerate_den / this->out_format.framerate_num;
@@ -499,12 +492,6 @@ gst_omx_noise_filter_fill_callback (GstOmxBase * base,
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
@@ -545,11 +532,11 @@ gst_omx_noise_filter_dynamic_configuration (GstOmxNoiseFilter * this,
   resolution.eDir = port->eDir;
   resolution.nChId = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetConfig (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigVidChResolution, &resolution);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noresolution;
 
@@ -29,8 +29,22 @@ GST_DEBUG_CATEGORY_STATIC (gst_omx_pad_debug);
 G_DEFINE_TYPE (GstOmxPad, gst_omx_pad, GST_TYPE_PAD);
 #define parent_class gst_omx_pad_parent_class
 
+enum
+{
+  PROP_0,
+  PROP_MIN_BUFFERS,
+  PROP_MAX_BUFFERS
+};
+
+#define GST_OMX_PAD_MIN_BUFFERS_DEFAULT   0
+#define GST_OMX_PAD_MAX_BUFFERS_DEFAULT   0
+
 /* VTable */
 static void gst_omx_pad_finalize (GObject * object);
+static void gst_omx_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_omx_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 static GObject *gst_omx_pad_constructor (GType gtype, guint n_properties,
     GObjectConstructParam * properties);
 static void gst_omx_init_port_default (OMX_PARAM_PORTDEFINITIONTYPE *,
@@ -53,6 +67,21 @@ gst_omx_pad_class_init (GstOmxPadClass * klass)
   /* Need a custom finalize function to free mapping */
   gobject_class->finalize = gst_omx_pad_finalize;
   gobject_class->constructor = gst_omx_pad_constructor;
+  gobject_class->set_property = gst_omx_pad_set_property;
+  gobject_class->get_property = gst_omx_pad_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_MIN_BUFFERS,
+      g_param_spec_uint ("min-buffers", "Minimum buffers",
+          "Buffers allocated for the port when starting "
+          "(0 : element input/output-buffers)",
+          0, GST_OMX_BUFFER_ID_MAX, GST_OMX_PAD_MIN_BUFFERS_DEFAULT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_MAX_BUFFERS,
+      g_param_spec_uint ("max-buffers", "Maximum buffers",
+          "Buffers a sink port may grow to when it runs out of free buffers "
+          "(0 : never grow)",
+          0, GST_OMX_BUFFER_ID_MAX, GST_OMX_PAD_MAX_BUFFERS_DEFAULT,
+          G_PARAM_READWRITE));
 
   GST_DEBUG_CATEGORY_INIT (gst_omx_pad_debug, "omxpad", 0, "GstOmxPad");
 }
@@ -74,6 +103,7 @@ gst_omx_pad_init (GstOmxPad * this)
   GST_INFO_OBJECT (this, "Initializing %s", GST_OBJECT_NAME (this));
 
   this->buffers = gst_omx_buf_tab_new ();
+  this->pool = gst_omx_buf_pool_new ();
 
   this->port = (OMX_PARAM_PORTDEFINITIONTYPE *)
       TIMM_OSAL_Malloc (sizeof (OMX_PARAM_PORTDEFINITIONTYPE), TIMM_OSAL_TRUE,
@@ -84,6 +114,18 @@ gst_omx_pad_init (GstOmxPad * this)
 
   this->enabled = FALSE;
   this->flushing = FALSE;
+  this->reconfiguring = FALSE;
+  this->settings_changed = FALSE;
+
+  this->queue = NULL;
+  this->pushtask = NULL;
+  this->queued = 0;
+
+  this->min_buffers = GST_OMX_PAD_MIN_BUFFERS_DEFAULT;
+  this->max_buffers = GST_OMX_PAD_MAX_BUFFERS_DEFAULT;
+  this->chained = 0;
+  this->lastwaits = 0;
+  gst_omx_copy_reset (&this->copy);
 
   gst_omx_init_port_default (this->port,
       gst_pad_get_direction (GST_PAD (this)));
@@ -99,6 +141,12 @@ gst_omx_pad_finalize (GObject * object)
   GST_INFO_OBJECT (this, "Freeing pad %s", GST_OBJECT_NAME (this));
 
   gst_omx_buf_tab_free (this->buffers);
+  gst_omx_buf_pool_free (this->pool);
+
+  if (this->pushtask)
+    gst_object_unref (this->pushtask);
+  if (this->queue)
+    gst_omx_buf_queue_free (this->queue);
 
   TIMM_OSAL_Free (this->port);
 
@@ -106,6 +154,87 @@ gst_omx_pad_finalize (GObject * object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_omx_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstOmxPad *this = GST_OMX_PAD (object);
+
+  switch (prop_id) {
+    case PROP_MIN_BUFFERS:
+      this->min_buffers = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting min-buffers to %d", this->min_buffers);
+      break;
+    case PROP_MAX_BUFFERS:
+      this->max_buffers = g_value_get_uint (value);
+      GST_INFO_OBJECT (this, "Setting max-buffers to %d", this->max_buffers);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_omx_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstOmxPad *this = GST_OMX_PAD (object);
+
+  switch (prop_id) {
+    case PROP_MIN_BUFFERS:
+      g_value_set_uint (value, this->min_buffers);
+      break;
+    case PROP_MAX_BUFFERS:
+      g_value_set_uint (value, this->max_buffers);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* GstOmxBufTabWatermarkFunc for the pad buffers, data is the pad */
+void
+gst_omx_pad_low_watermark (GstOmxBufTab * buftab, guint numfree,
+    gpointer data)
+{
+  GstOmxPad *this = GST_OMX_PAD (data);
+  GstElement *element;
+
+  GST_WARNING_OBJECT (this, "Only %u buffers free", numfree);
+
+  /* Internal pads, like the extra mixer ports, have no parent */
+  element = gst_pad_get_parent_element (GST_PAD (this));
+  if (!element)
+    return;
+
+  GST_ELEMENT_WARNING (element, RESOURCE, BUSY,
+      ("Running low on buffers"),
+      ("Only %u of %u buffers free on %s:%s, consider raising the number of "
+          "buffers", numfree, (guint) this->port->nBufferCountActual,
+          GST_DEBUG_PAD_NAME (this)));
+
+  gst_object_unref (element);
+}
+
+/* GFunc to append the buffer table statistics of each pad of a list to a
+ * structure, under a field named after the pad. The GstBuffer allocations
+ * of the pushed buffers go in buffer-allocs */
+void
+gst_omx_pad_append_stats (gpointer pad, gpointer structure)
+{
+  GstOmxPad *this = GST_OMX_PAD (pad);
+  GstStructure *padstats;
+
+  padstats = gst_omx_buf_tab_get_structure (this->buffers);
+  gst_structure_set (padstats, "buffer-allocs", G_TYPE_UINT,
+      gst_omx_buf_pool_get_allocs (this->pool), NULL);
+  gst_structure_set ((GstStructure *) structure, GST_OBJECT_NAME (this),
+      GST_TYPE_STRUCTURE, padstats, NULL);
+  gst_structure_free (padstats);
+}
+
 static void
 gst_omx_init_port_default (OMX_PARAM_PORTDEFINITIONTYPE * port,
     GstPadDirection direction)
@@ -23,6 +23,9 @@
 #include <gst/gst.h>
 //#include "gstomx.h"
 #include "gstomxbuftab.h"
+#include "gstomxbufqueue.h"
+#include "gstomxcopy.h"
+#include "gstomxbufpool.h"
 
 G_BEGIN_DECLS
 #define TYPE_GST_OMX_PAD (gst_omx_pad_get_type ())
@@ -43,6 +46,30 @@ struct _GstOmxPad
 
   gboolean enabled;
   gboolean flushing;
+
+  /* Set while the port is cycled for new settings, the buffers coming
+   * back are not recycled */
+  gboolean reconfiguring;
+  volatile gint settings_changed;       /* PortSettingsChanged pending */
+
+  /* Buffer count limits, 0 keeps the element defaults. Sink ports start
+   * with min_buffers and may grow up to max_buffers when starving */
+  guint min_buffers;
+  guint max_buffers;
+  guint chained;
+  guint lastwaits;
+
+  /* Layout used to copy non OMX buffers into a sink port */
+  GstOmxCopy copy;
+
+  /* Wrappers for the buffers pushed out of a src port */
+  GstOmxBufPool *pool;
+
+  /* Output task, only used by src pads when pushing from a task */
+  GstOmxBufQueue *queue;
+  GstTask *pushtask;
+  GStaticRecMutex taskmutex;
+  volatile gint queued;         /* Buffers in the queue or being pushed */
 };
 
 struct _GstOmxPadClass
@@ -52,6 +79,9 @@ struct _GstOmxPadClass
 
 GstOmxPad *gst_omx_pad_new_from_template (GstPadTemplate * templ,
     const gchar * name);
+void gst_omx_pad_low_watermark (GstOmxBufTab * buftab, guint numfree,
+    gpointer data);
+void gst_omx_pad_append_stats (gpointer pad, gpointer structure);
 
 GType gst_omx_pad_get_type (void);
 
@@ -51,7 +51,15 @@
 
 #include <gst/gst.h>
 #include <string.h>
+
+#if defined (__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "gstomxrrparser.h"
+#include "gstomxutils.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_rrparser_debug);
 #define GST_CAT_DEFAULT gst_rrparser_debug
@@ -66,8 +74,23 @@ enum
 {
   PROP_0,
   SINGLE_NALU,
+  STREAMING,
 };
 
+/* A NAL unit of the access unit being assembled, without start code */
+typedef struct
+{
+  gint offset;
+  gint size;
+} GstRRParserNal;
+
+/* Timestamp of the input buffer that starts at offset */
+typedef struct
+{
+  gint offset;
+  GstClockTime timestamp;
+} GstRRParserStamp;
+
 /*
  * The capabilities of the inputs and outputs.
  */
@@ -100,6 +123,90 @@ static void gst_rrparser_get_property (GObject * object, guint prop_id,
 
 static gboolean gst_rrparser_set_caps (GstPad * pad, GstCaps * caps);
 static GstFlowReturn gst_rrparser_chain (GstPad * pad, GstBuffer * buf);
+static void gst_rrparser_finalize (GObject * object);
+static GstStateChangeReturn gst_rrparser_change_state (GstElement * element,
+    GstStateChange transition);
+static void gst_rrparser_reset_stream (GstRRParser * rrparser);
+static GstFlowReturn gst_rrparser_drain_stream (GstRRParser * rrparser);
+static GstFlowReturn gst_rrparser_chain_stream (GstRRParser * rrparser,
+    GstBuffer * buf);
+
+/* Returns the position of the first start code of length bytes, 00 00 01
+ * or 00 00 00 01, beginning in [from, end), or end if there is none. data
+ * must be readable up to end + length - 1 */
+typedef gint (*GstRRParserScanFunc) (const guchar * data, gint from, gint end,
+    gint length);
+
+/* A byte above 1 rules out every start code covering it, so the scan
+ * mostly advances a whole start code at a time */
+static gint
+gst_rrparser_find_start_code_c (const guchar * data, gint from, gint end,
+    gint length)
+{
+  gint i = from, last = length - 1;
+
+  while (i < end) {
+    if (data[i + last] > 1) {
+      i += length;
+    } else if (data[i + last] == 0) {
+      i++;
+    } else {
+      if (data[i] == 0 && data[i + 1] == 0 && (3 == length || data[i + 2] == 0))
+        return i;
+      i += length;
+    }
+  }
+
+  return end;
+}
+
+/* Every start code begins with a zero byte, blocks of 16 bytes without
+ * one are skipped and the rest go through the C scan */
+#if defined (__ARM_NEON__)
+static gint
+gst_rrparser_find_start_code_neon (const guchar * data, gint from, gint end,
+    gint length)
+{
+  uint8x16_t zero = vdupq_n_u8 (0);
+  uint64x2_t zeros;
+  gint i, found;
+
+  for (i = from; i + 16 <= end; i += 16) {
+    zeros = vreinterpretq_u64_u8 (vceqq_u8 (vld1q_u8 (data + i), zero));
+    if (!(vgetq_lane_u64 (zeros, 0) | vgetq_lane_u64 (zeros, 1)))
+      continue;
+
+    found = gst_rrparser_find_start_code_c (data, i, i + 16, length);
+    if (found < i + 16)
+      return found;
+  }
+
+  return gst_rrparser_find_start_code_c (data, i, end, length);
+}
+#elif defined (__SSE2__)
+static gint
+gst_rrparser_find_start_code_sse2 (const guchar * data, gint from, gint end,
+    gint length)
+{
+  __m128i zero = _mm_setzero_si128 ();
+  gint i, found;
+
+  for (i = from; i + 16 <= end; i += 16) {
+    if (!_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *)
+                    (data + i)), zero)))
+      continue;
+
+    found = gst_rrparser_find_start_code_c (data, i, i + 16, length);
+    if (found < i + 16)
+      return found;
+  }
+
+  return gst_rrparser_find_start_code_c (data, i, end, length);
+}
+#endif
+
+static GstRRParserScanFunc gst_rrparser_find_start_code =
+    gst_rrparser_find_start_code_c;
 
 
 static void
@@ -130,13 +237,36 @@ gst_rrparser_class_init (GstRRParserClass * klass)
 
   gobject_class->set_property = gst_rrparser_set_property;
   gobject_class->get_property = gst_rrparser_get_property;
+  gobject_class->finalize = gst_rrparser_finalize;
+
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_rrparser_change_state);
 
   g_object_class_install_property (gobject_class, SINGLE_NALU,
       g_param_spec_boolean ("singleNalu", "SingleNalu", "Buffers are single Nal units",
           FALSE, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, STREAMING,
+      g_param_spec_boolean ("streaming", "Streaming",
+          "Assemble access units from input split anywhere, with 3 or 4 byte "
+          "start codes. Adds the latency of one access unit",
+          FALSE, G_PARAM_READWRITE));
     /* debug category for filtering log messages */
   GST_DEBUG_CATEGORY_INIT (gst_rrparser_debug, "rr_h264parser",
       0, "RidgeRun's H264 parser");
+
+  /* Pick the start code scan supported by the CPU we are running on */
+#if defined (__ARM_NEON__)
+  if (gst_omx_cpu_has_neon ()) {
+    gst_rrparser_find_start_code = gst_rrparser_find_start_code_neon;
+    GST_INFO ("Using the NEON start code scan");
+  }
+#elif defined (__SSE2__)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse2")) {
+    gst_rrparser_find_start_code = gst_rrparser_find_start_code_sse2;
+    GST_INFO ("Using the SSE2 start code scan");
+  }
+#endif
 }
 
 static gboolean gst_rrparser_sink_event(GstPad *pad, GstEvent *event)
@@ -149,6 +279,12 @@ static gboolean gst_rrparser_sink_event(GstPad *pad, GstEvent *event)
 
     switch (GST_EVENT_TYPE(event)) {
 		case GST_EVENT_EOS:
+			if (rrparser->streaming)
+				gst_rrparser_drain_stream(rrparser);
+			ret = gst_pad_push_event(rrparser->src_pad, event);
+			break;
+		case GST_EVENT_FLUSH_STOP:
+			gst_rrparser_reset_stream(rrparser);
 			ret = gst_pad_push_event(rrparser->src_pad, event);
 			break;
 		default:
@@ -166,6 +302,12 @@ gst_rrparser_init (GstRRParser * rrparser,
   rrparser->SPS_PPS_end = -1;
   rrparser->PPS_start = -1;
   rrparser->single_Nalu = FALSE;
+  rrparser->streaming = FALSE;
+
+  rrparser->pending = g_byte_array_new ();
+  rrparser->nals = g_array_new (FALSE, FALSE, sizeof (GstRRParserNal));
+  rrparser->stamps = g_array_new (FALSE, FALSE, sizeof (GstRRParserStamp));
+  gst_rrparser_reset_stream (rrparser);
 
   rrparser->sink_pad = gst_pad_new_from_static_template (&sink_factory, "sink");
   gst_pad_set_setcaps_function (rrparser->sink_pad,
@@ -193,6 +335,9 @@ gst_rrparser_set_property (GObject * object, guint prop_id,
     case SINGLE_NALU:
       rrparser->single_Nalu = g_value_get_boolean(value);
       break;
+    case STREAMING:
+      rrparser->streaming = g_value_get_boolean(value);
+      break;
     default:
       break;
   }
@@ -209,6 +354,9 @@ gst_rrparser_get_property (GObject * object, guint prop_id,
 	case SINGLE_NALU:
 	  g_value_set_boolean(value, rrparser->single_Nalu);
       break;
+    case STREAMING:
+      g_value_set_boolean(value, rrparser->streaming);
+      break;
     default:
       break;
   }
@@ -337,7 +485,7 @@ GstBuffer*
 gst_rrparser_fetch_nal(GstBuffer *buffer, gint type)
 {
 
-	gint i;
+	gint i, end;
     guchar *data = GST_BUFFER_DATA(buffer);
     GstBuffer *nal_buffer;
     gint nal_idx = 0;
@@ -347,22 +495,21 @@ gst_rrparser_fetch_nal(GstBuffer *buffer, gint type)
     gint done = 0;
 
     GST_DEBUG("Fetching NAL, type %d", type);
-    for (i = 0; i < GST_BUFFER_SIZE(buffer) - 5; i++) {
-        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 0
-            && data[i + 3] == 1) {
-            if (found == 1) {
-                nal_len = i - nal_idx;
-                done = 1;
-                break;
-            }
+    end = (gint) GST_BUFFER_SIZE(buffer) - 5;
+    for (i = gst_rrparser_find_start_code(data, 0, end, 4); i < end;
+         i = gst_rrparser_find_start_code(data, i + 1, end, 4)) {
+        if (found == 1) {
+            nal_len = i - nal_idx;
+            done = 1;
+            break;
+        }
 
-            nal_type = (data[i + 4]) & 0x1f;
-            if (nal_type == type)
-            {
-                found = 1;
-                nal_idx = i + 4;
-                i += 4;
-            }
+        nal_type = (data[i + 4]) & 0x1f;
+        if (nal_type == type)
+        {
+            found = 1;
+            nal_idx = i + 4;
+            i += 4;
         }
     }
 
@@ -384,27 +531,25 @@ gst_rrparser_fetch_nal(GstBuffer *buffer, gint type)
 }
 
 
-/* This function creates the buffer with the SPS and PPS information */
-GstBuffer*
-gst_rrparser_generate_codec_data(GstRRParser *rrparser, GstBuffer *buffer) {
+/* This function creates the avcC buffer out of the SPS and PPS, either
+ * may be missing */
+static GstBuffer*
+gst_rrparser_build_codec_data(GstBuffer *sps, GstBuffer *pps) {
 
 	GstBuffer *avcc = NULL;
     guchar *avcc_data = NULL;
     gint avcc_len = 7;  // Default 7 bytes w/o SPS, PPS data
     gint i;
 
-    GstBuffer *sps = NULL;
     guchar *sps_data = NULL;
     gint num_sps=0;
 
-    GstBuffer *pps = NULL;
     gint num_pps=0;
 
     guchar profile;
     guchar compatibly;
     guchar level;
 
-    sps = gst_rrparser_fetch_nal(buffer, 7); // 7 = SPS
     if (sps){
         num_sps = 1;
         avcc_len += GST_BUFFER_SIZE(sps) + 2;
@@ -423,16 +568,11 @@ gst_rrparser_generate_codec_data(GstRRParser *rrparser, GstBuffer *buffer) {
         compatibly  = 0;
         level       = 8192;   // Default Level: 4.2
     }
-    pps = gst_rrparser_fetch_nal(buffer, 8); // 8 = PPS
     if (pps){
         num_pps = 1;
         avcc_len += GST_BUFFER_SIZE(pps) + 2;
     }
 
-	/* Since we already know the position of the SPS and PPS we save these values */
-	rrparser->SPS_PPS_end = NAL_LENGTH + GST_BUFFER_SIZE(sps) + NAL_LENGTH + GST_BUFFER_SIZE(pps);
-	rrparser->PPS_start = NAL_LENGTH + GST_BUFFER_SIZE(sps) + NAL_LENGTH;
-
     avcc = gst_buffer_new_and_alloc(avcc_len);
     avcc_data = GST_BUFFER_DATA(avcc);
     avcc_data[0] = 1;               // [0] 1 byte - version
@@ -461,12 +601,50 @@ gst_rrparser_generate_codec_data(GstRRParser *rrparser, GstBuffer *buffer) {
     return avcc;
 }
 
+/* This function creates the buffer with the SPS and PPS information */
+GstBuffer*
+gst_rrparser_generate_codec_data(GstRRParser *rrparser, GstBuffer *buffer) {
+
+    GstBuffer *avcc = NULL;
+    GstBuffer *sps = NULL;
+    GstBuffer *pps = NULL;
+
+    sps = gst_rrparser_fetch_nal(buffer, 7); // 7 = SPS
+    pps = gst_rrparser_fetch_nal(buffer, 8); // 8 = PPS
+
+	/* Since we already know the position of the SPS and PPS we save these values */
+	rrparser->SPS_PPS_end = NAL_LENGTH + GST_BUFFER_SIZE(sps) + NAL_LENGTH + GST_BUFFER_SIZE(pps);
+	rrparser->PPS_start = NAL_LENGTH + GST_BUFFER_SIZE(sps) + NAL_LENGTH;
+
+    avcc = gst_rrparser_build_codec_data(sps, pps);
+
+    if (sps)
+        gst_buffer_unref(sps);
+    if (pps)
+        gst_buffer_unref(pps);
+
+    return avcc;
+}
+
+/* This function sets the given codec data in the src_pad caps */
+static void
+gst_rrparser_update_codec_data(GstRRParser *rrparser, GstBuffer *codec_data){
+
+  GstCaps *src_caps;
+
+  src_caps = gst_caps_make_writable(gst_caps_ref(GST_PAD_CAPS(rrparser->src_pad)));
+  gst_caps_set_simple (src_caps, "codec_data", GST_TYPE_BUFFER, codec_data, (char *)NULL);
+  if (!gst_pad_set_caps (rrparser->src_pad, src_caps)) {
+	  GST_WARNING_OBJECT (rrparser, "Src caps can't be updated");
+  }
+  gst_caps_unref (src_caps);
+}
+
 /* This function sets the codec data (SPS and PPS) in the src_pad caps */
 gboolean
 gst_rrparser_set_codec_data(GstRRParser *rrparser, GstBuffer *buf){
 
   GstBuffer *codec_data;
-  GstCaps *src_caps;
 
   GST_DEBUG("Entry gst_rrparser_set_codec_data");
 
@@ -474,11 +652,7 @@ gst_rrparser_set_codec_data(GstRRParser *rrparser, GstBuffer *buf){
   codec_data = gst_rrparser_generate_codec_data(rrparser, buf);
 
   /* Update the caps with the codec data */
-  src_caps = gst_caps_make_writable(gst_caps_ref(GST_PAD_CAPS(rrparser->src_pad)));
-  gst_caps_set_simple (src_caps, "codec_data", GST_TYPE_BUFFER, codec_data, (char *)NULL);
-  if (!gst_pad_set_caps (rrparser->src_pad, src_caps)) {
-	  GST_WARNING_OBJECT (rrparser, "Src caps can't be updated");
-  }
+  gst_rrparser_update_codec_data(rrparser, codec_data);
 
   gst_buffer_unref (codec_data);
 
@@ -500,9 +674,8 @@ gst_rrparser_to_packetized(GstRRParser *rrparser, GstBuffer *out_buffer) {
 
 	dest = GST_BUFFER_DATA(out_buffer);
 
-	for (i = 0; i < size - 4; i++) {
-        if (dest[i] == 0 && dest[i + 1] == 0 &&
-            dest[i+2] == 0 && dest[i + 3] == 1) {
+	for (i = gst_rrparser_find_start_code(dest, 0, size - 4, 4); i < size - 4;
+	     i = gst_rrparser_find_start_code(dest, i + 1, size - 4, 4)) {
 
 			if(rrparser->single_Nalu){
 				test_sps_type = (dest[i + NAL_LENGTH]) & 0x1f;
@@ -555,7 +728,6 @@ gst_rrparser_to_packetized(GstRRParser *rrparser, GstBuffer *out_buffer) {
 
 	            nal_type = (dest[i + 4]) & 0x1f;
 	        }
-		}
 
 	}
 
@@ -586,6 +758,9 @@ gst_rrparser_chain (GstPad *pad, GstBuffer *buf)
   GstFlowReturn ret;
   GST_DEBUG("Entry gst_rrparser_chain");
 
+  if (rrparser->streaming)
+    return gst_rrparser_chain_stream (rrparser, buf);
+
   /* Obtain and set codec data */
   if(!rrparser->set_codec_data) {
 	if(!gst_rrparser_set_codec_data(rrparser, buf)) {
@@ -608,3 +783,277 @@ gst_rrparser_chain (GstPad *pad, GstBuffer *buf)
   return ret;
 
 }
+
+static void
+gst_rrparser_finalize (GObject * object)
+{
+  GstRRParser *rrparser = GST_RRPARSER (object);
+
+  g_byte_array_free (rrparser->pending, TRUE);
+  g_array_free (rrparser->nals, TRUE);
+  g_array_free (rrparser->stamps, TRUE);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* A restarted pipeline may carry a different stream, so the codec data is
+ * generated again from its first access unit */
+static GstStateChangeReturn
+gst_rrparser_change_state (GstElement * element, GstStateChange transition)
+{
+  GstRRParser *rrparser = GST_RRPARSER (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (GST_STATE_CHANGE_FAILURE == ret)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_rrparser_reset_stream (rrparser);
+      rrparser->set_codec_data = FALSE;
+      rrparser->SPS_PPS_end = -1;
+      rrparser->PPS_start = -1;
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+/* Drops everything gathered, the next access unit starts from scratch */
+static void
+gst_rrparser_reset_stream (GstRRParser * rrparser)
+{
+  g_byte_array_set_size (rrparser->pending, 0);
+  g_array_set_size (rrparser->nals, 0);
+  g_array_set_size (rrparser->stamps, 0);
+  rrparser->scanpos = 0;
+  rrparser->nalstart = -1;
+  rrparser->au_timestamp = GST_CLOCK_TIME_NONE;
+  rrparser->au_vcl = FALSE;
+  rrparser->au_idr = FALSE;
+}
+
+/* Takes the timestamp of the input buffer the byte at offset came in, each
+ * timestamp is given to a single access unit */
+static GstClockTime
+gst_rrparser_take_timestamp (GstRRParser * rrparser, gint offset)
+{
+  GstRRParserStamp *stamp;
+  GstClockTime timestamp;
+  gint i;
+
+  for (i = rrparser->stamps->len - 1; i >= 0; i--) {
+    stamp = &g_array_index (rrparser->stamps, GstRRParserStamp, i);
+    if (stamp->offset <= offset) {
+      timestamp = stamp->timestamp;
+      stamp->timestamp = GST_CLOCK_TIME_NONE;
+      return timestamp;
+    }
+  }
+
+  return GST_CLOCK_TIME_NONE;
+}
+
+/* Forgets the first size bytes of the pending data */
+static void
+gst_rrparser_flush_stream (GstRRParser * rrparser, gint size)
+{
+  GstRRParserStamp *stamp;
+  guint i, first = 0;
+
+  g_byte_array_remove_range (rrparser->pending, 0, size);
+  rrparser->scanpos -= size;
+  if (rrparser->nalstart >= 0)
+    rrparser->nalstart -= size;
+
+  /* Keep the stamp of the buffer the remaining data starts in */
+  for (i = 0; i < rrparser->stamps->len; i++)
+    if (g_array_index (rrparser->stamps, GstRRParserStamp, i).offset <= size)
+      first = i;
+  g_array_remove_range (rrparser->stamps, 0, first);
+
+  for (i = 0; i < rrparser->stamps->len; i++) {
+    stamp = &g_array_index (rrparser->stamps, GstRRParserStamp, i);
+    stamp->offset = MAX (stamp->offset - size, 0);
+  }
+}
+
+/* Closes the NAL being read where the next start code begins, the zero
+ * bytes trailing it belong to no NAL */
+static void
+gst_rrparser_end_nal (GstRRParser * rrparser, gint end)
+{
+  const guint8 *data = rrparser->pending->data;
+  GstRRParserNal nal;
+
+  if (rrparser->nalstart < 0)
+    return;
+
+  while (end > rrparser->nalstart && 0 == data[end - 1])
+    end--;
+
+  nal.offset = rrparser->nalstart;
+  nal.size = end - rrparser->nalstart;
+  if (nal.size > 0)
+    g_array_append_val (rrparser->nals, nal);
+  rrparser->nalstart = -1;
+}
+
+/* Pushes the assembled access unit in avc format, each NAL preceded by its
+ * length. The codec data is taken from the first one with SPS and PPS */
+static GstFlowReturn
+gst_rrparser_push_au (GstRRParser * rrparser)
+{
+  const guint8 *data = rrparser->pending->data;
+  GstBuffer *sps = NULL, *pps = NULL, *codec_data, *au;
+  GstRRParserNal *nal;
+  guint8 *dest;
+  guint i, size = 0;
+  gint type;
+
+  if (!rrparser->nals->len)
+    return GST_FLOW_OK;
+
+  for (i = 0; i < rrparser->nals->len; i++) {
+    nal = &g_array_index (rrparser->nals, GstRRParserNal, i);
+    size += NAL_LENGTH + nal->size;
+
+    if (rrparser->set_codec_data)
+      continue;
+    type = data[nal->offset] & 0x1f;
+    if (7 == type && !sps) {
+      sps = gst_buffer_new_and_alloc (nal->size);
+      memcpy (GST_BUFFER_DATA (sps), data + nal->offset, nal->size);
+    } else if (8 == type && !pps) {
+      pps = gst_buffer_new_and_alloc (nal->size);
+      memcpy (GST_BUFFER_DATA (pps), data + nal->offset, nal->size);
+    }
+  }
+
+  if (!rrparser->set_codec_data) {
+    if (!sps || !pps)
+      goto nocodecdata;
+
+    codec_data = gst_rrparser_build_codec_data (sps, pps);
+    gst_rrparser_update_codec_data (rrparser, codec_data);
+    gst_buffer_unref (codec_data);
+    gst_buffer_unref (sps);
+    gst_buffer_unref (pps);
+    rrparser->set_codec_data = TRUE;
+  }
+
+  au = gst_buffer_new_and_alloc (size);
+  dest = GST_BUFFER_DATA (au);
+  for (i = 0; i < rrparser->nals->len; i++) {
+    nal = &g_array_index (rrparser->nals, GstRRParserNal, i);
+    GST_WRITE_UINT32_BE (dest, nal->size);
+    memcpy (dest + NAL_LENGTH, data + nal->offset, nal->size);
+    dest += NAL_LENGTH + nal->size;
+  }
+
+  GST_BUFFER_TIMESTAMP (au) = rrparser->au_timestamp;
+  if (!rrparser->au_idr)
+    GST_BUFFER_FLAG_SET (au, GST_BUFFER_FLAG_DELTA_UNIT);
+  gst_buffer_set_caps (au, GST_PAD_CAPS (rrparser->src_pad));
+
+  GST_LOG_OBJECT (rrparser, "Pushing access unit of %u NALs, %u bytes at %"
+      GST_TIME_FORMAT, rrparser->nals->len, size,
+      GST_TIME_ARGS (rrparser->au_timestamp));
+
+  g_array_set_size (rrparser->nals, 0);
+  rrparser->au_vcl = FALSE;
+  rrparser->au_idr = FALSE;
+
+  return gst_pad_push (rrparser->src_pad, au);
+
+nocodecdata:
+  {
+    GST_DEBUG_OBJECT (rrparser, "Dropping access unit before SPS and PPS");
+    if (sps)
+      gst_buffer_unref (sps);
+    if (pps)
+      gst_buffer_unref (pps);
+    g_array_set_size (rrparser->nals, 0);
+    rrparser->au_vcl = FALSE;
+    rrparser->au_idr = FALSE;
+    return GST_FLOW_OK;
+  }
+}
+
+/* Gathers the input and pushes every access unit once the first NAL of the
+ * next one shows up. The scan resumes where the previous call stopped */
+static GstFlowReturn
+gst_rrparser_chain_stream (GstRRParser * rrparser, GstBuffer * buf)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstRRParserStamp stamp;
+  const guint8 *data;
+  gint pos, code, end, type;
+
+  /* A partial access unit can't be completed after a gap */
+  if (GST_BUFFER_IS_DISCONT (buf))
+    gst_rrparser_reset_stream (rrparser);
+
+  if (GST_BUFFER_TIMESTAMP_IS_VALID (buf)) {
+    stamp.offset = rrparser->pending->len;
+    stamp.timestamp = GST_BUFFER_TIMESTAMP (buf);
+    g_array_append_val (rrparser->stamps, stamp);
+  }
+  g_byte_array_append (rrparser->pending, GST_BUFFER_DATA (buf),
+      GST_BUFFER_SIZE (buf));
+  gst_buffer_unref (buf);
+
+  while (GST_FLOW_OK == ret) {
+    /* The NAL header and the byte after it tell where an access unit
+     * ends, start codes too close to the end wait for more data */
+    data = rrparser->pending->data;
+    end = (gint) rrparser->pending->len - 4;
+    pos = gst_rrparser_find_start_code (data, rrparser->scanpos, end, 3);
+    if (pos >= end) {
+      rrparser->scanpos = MAX (rrparser->scanpos, end);
+      break;
+    }
+
+    code = (pos > 0 && 0 == data[pos - 1]) ? pos - 1 : pos;
+    type = data[pos + 3] & 0x1f;
+    gst_rrparser_end_nal (rrparser, code);
+
+    /* AUD, SEI, SPS, PPS and the first slice of another picture start a
+     * new access unit */
+    if (rrparser->au_vcl && ((type >= 6 && type <= 9)
+            || (type >= 14 && type <= 18)
+            || ((1 == type || 5 == type) && (data[pos + 4] & 0x80)))) {
+      ret = gst_rrparser_push_au (rrparser);
+      gst_rrparser_flush_stream (rrparser, code);
+      pos -= code;
+    }
+
+    if (!rrparser->nals->len)
+      rrparser->au_timestamp = gst_rrparser_take_timestamp (rrparser, pos);
+    if (1 == type || 5 == type)
+      rrparser->au_vcl = TRUE;
+    if (5 == type)
+      rrparser->au_idr = TRUE;
+
+    rrparser->nalstart = pos + 3;
+    rrparser->scanpos = pos + 3;
+  }
+
+  return ret;
+}
+
+/* Pushes the last access unit, nothing will come after it */
+static GstFlowReturn
+gst_rrparser_drain_stream (GstRRParser * rrparser)
+{
+  GstFlowReturn ret;
+
+  gst_rrparser_end_nal (rrparser, rrparser->pending->len);
+  ret = gst_rrparser_push_au (rrparser);
+  gst_rrparser_reset_stream (rrparser);
+
+  return ret;
+}
@@ -79,6 +79,18 @@ struct _GstRRParser
   gboolean set_codec_data;
   gboolean single_Nalu;
 
+  /* Access unit assembly, see the streaming property. Offsets are
+   * relative to the start of pending, bytes before scanpos were already
+   * looked at */
+  gboolean streaming;
+  GByteArray *pending;
+  gint scanpos;
+  gint nalstart;
+  GArray *nals;
+  GArray *stamps;
+  GstClockTime au_timestamp;
+  gboolean au_vcl;
+  gboolean au_idr;
 };
 
 struct _GstRRParserClass
@@ -118,7 +118,7 @@ gst_omx_scaler_class_init (GstOmxScalerClass * klass)
       g_param_spec_string ("crop-area", "Select the crop area",
           "Selects the crop area using the format <startX>,<startY>@"
           "<cropWidth>x<cropHeight>", GST_OMX_DEISCALER_CROP_AREA_DEFAULT,
-          G_PARAM_READWRITE));
+          G_PARAM_READWRITE | GST_OMX_PARAM_PORT));
 
   gstomxbase_class->parse_caps = GST_DEBUG_FUNCPTR (gst_omx_scaler_set_caps);
   gstomxbase_class->init_ports = GST_DEBUG_FUNCPTR (gst_omx_scaler_init_pads);
@@ -402,10 +402,10 @@ gst_omx_scaler_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = OMX_VFPC_INPUT_PORT_START_INDEX;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "input";
     goto noport;
@@ -415,10 +415,10 @@ gst_omx_scaler_init_pads (GstOmxBase * base)
   GST_OMX_INIT_STRUCT (&memory, OMX_PARAM_BUFFER_MEMORYTYPE);
   memory.nPortIndex = OMX_VFPC_OUTPUT_PORT_START_INDEX;
   memory.eBufMemoryType = OMX_BUFFER_MEMORY_DEFAULT;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle, OMX_TI_IndexParamBuffMemType, &memory);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "output";
     goto noport;
@@ -438,9 +438,9 @@ gst_omx_scaler_init_pads (GstOmxBase * base)
 
   port->nBufferSize = this->in_format.size_padded;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (base->handle, OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "input";
     goto noport;
@@ -459,9 +459,9 @@ gst_omx_scaler_init_pads (GstOmxBase * base)
   port->format.video.eColorFormat = OMX_COLOR_FormatYCbYCr;
   port->nBufferSize = this->out_format.size_padded;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error = OMX_SetParameter (base->handle, OMX_IndexParamPortDefinition, port);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error)) {
     portname = "output";
     goto noport;
@@ -470,11 +470,11 @@ gst_omx_scaler_init_pads (GstOmxBase * base)
   GST_DEBUG_OBJECT (this, "Setting channels per handle");
   GST_OMX_INIT_STRUCT (&channels, OMX_PARAM_VFPC_NUMCHANNELPERHANDLE);
   channels.nNumChannelsPerHandle = 1;
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetParameter (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexParamVFPCNumChPerHandle, &channels);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto nochannels;
 
@@ -494,19 +494,19 @@ gst_omx_scaler_init_pads (GstOmxBase * base)
   enable.nChId = 0;
   enable.bAlgBypass = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetConfig (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigAlgEnable, &enable);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling input port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable,
       OMX_VFPC_INPUT_PORT_START_INDEX, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for input port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -516,10 +516,10 @@ gst_omx_scaler_init_pads (GstOmxBase * base)
     goto noenable;
 
   GST_INFO_OBJECT (this, "Enabling output port");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   OMX_SendCommand (base->handle, OMX_CommandPortEnable,
       OMX_VFPC_OUTPUT_PORT_START_INDEX, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
 
   GST_INFO_OBJECT (this, "Waiting for output port to enable");
   error = gst_omx_base_wait_for_condition (base,
@@ -559,23 +559,16 @@ gst_omx_scaler_fill_callback (GstOmxBase * base, OMX_BUFFERHEADERTYPE * outbuf)
   GstOmxScaler *this = GST_OMX_SCALER (base);
   GstFlowReturn ret = GST_FLOW_OK;
   GstBuffer *buffer = NULL;
-  GstCaps *caps = NULL;
+  GstOmxBufferData *bufdata = (GstOmxBufferData *) outbuf->pAppPrivate;
 
   GST_LOG_OBJECT (this, "Scaler fill buffer callback");
 
-  caps = gst_pad_get_negotiated_caps (this->srcpad);
-  if (!caps)
-    goto nocaps;
-
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, this->srcpad,
+      outbuf, gst_omx_base_release_buffer);
   if (!buffer)
-    goto noalloc;
+    goto nocaps;
 
   GST_BUFFER_SIZE (buffer) = this->out_format.size_padded;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = outbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) outbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_base_release_buffer;
   GST_BUFFER_TIMESTAMP (buffer) = outbuf->nTimeStamp;
   GST_BUFFER_DURATION (buffer) =
       1e9 * this->out_format.framerate_den / this->out_format.framerate_num;
@@ -588,12 +581,6 @@ gst_omx_scaler_fill_callback (GstOmxBase * base, OMX_BUFFERHEADERTYPE * outbuf)
 
   return ret;
 
-noalloc:
-  {
-    GST_ELEMENT_ERROR (GST_ELEMENT (this), CORE, PAD,
-        ("Unable to allocate buffer to push"), (NULL));
-    return GST_FLOW_ERROR;
-  }
 nocaps:
   {
     GST_ERROR_OBJECT (this, "Unable to provide the requested caps");
@@ -637,11 +624,11 @@ gst_omx_scaler_dynamic_configuration (GstOmxScaler * this,
   resolution.eDir = port->eDir;
   resolution.nChId = 0;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (base->omx_lock);
   error =
       OMX_SetConfig (base->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigVidChResolution, &resolution);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (base->omx_lock);
   if (GST_OMX_FAIL (error))
     goto noresolution;
 
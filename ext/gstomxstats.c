@@ -0,0 +1,324 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gstomxstats.h"
+
+static const gchar *gst_omx_stats_names[GST_OMX_STATS_NUM] = {
+  "latency",
+  "input-wait",
+  "output-wait"
+};
+
+void
+gst_omx_stats_init (GstOmxStats * stats)
+{
+  g_return_if_fail (stats);
+
+  g_mutex_init (&stats->lock);
+  stats->interval = 0;
+  stats->startup = 0;
+  gst_omx_stats_reset (stats);
+}
+
+void
+gst_omx_stats_clear (GstOmxStats * stats)
+{
+  g_return_if_fail (stats);
+
+  g_mutex_clear (&stats->lock);
+}
+
+void
+gst_omx_stats_reset (GstOmxStats * stats)
+{
+  guint i;
+
+  g_return_if_fail (stats);
+
+  g_mutex_lock (&stats->lock);
+
+  stats->frames_in = 0;
+  stats->frames_out = 0;
+  stats->frames_dropped = 0;
+  stats->frames_late = 0;
+  for (i = 0; i < GST_OMX_STATS_NUM; i++)
+    stats->windows[i].count = 0;
+  for (i = 0; i < GST_OMX_STATS_MARKS; i++)
+    stats->marktime[i] = 0;
+  stats->nextmark = 0;
+  stats->lastpost = g_get_monotonic_time ();
+
+  g_mutex_unlock (&stats->lock);
+}
+
+static void
+gst_omx_stats_add_sample_unlocked (GstOmxStats * stats,
+    GstOmxStatsSample sample, gint64 elapsed)
+{
+  GstOmxStatsWindow *window = &stats->windows[sample];
+
+  window->samples[window->count % GST_OMX_STATS_WINDOW] = MAX (elapsed, 0);
+  window->count++;
+}
+
+/* Elapsed times are in microseconds, from g_get_monotonic_time () */
+void
+gst_omx_stats_add_sample (GstOmxStats * stats, GstOmxStatsSample sample,
+    gint64 elapsed)
+{
+  g_return_if_fail (stats);
+  g_return_if_fail (sample < GST_OMX_STATS_NUM);
+
+  g_mutex_lock (&stats->lock);
+  gst_omx_stats_add_sample_unlocked (stats, sample, elapsed);
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Called right before EmptyThisBuffer, entry is the time the buffer
+ * reached the element (0 if unknown). Src elements have no input buffer
+ * and only count the frame. */
+void
+gst_omx_stats_frame_in (GstOmxStats * stats, OMX_BUFFERHEADERTYPE * buffer,
+    gint64 entry)
+{
+  gint64 now;
+  guint mark;
+
+  g_return_if_fail (stats);
+
+  now = g_get_monotonic_time ();
+
+  g_mutex_lock (&stats->lock);
+
+  stats->frames_in++;
+  if (entry)
+    gst_omx_stats_add_sample_unlocked (stats, GST_OMX_STATS_INPUT_WAIT,
+        now - entry);
+
+  if (buffer) {
+    mark = stats->nextmark++ % GST_OMX_STATS_MARKS;
+    stats->marktimestamp[mark] = buffer->nTimeStamp;
+    stats->marktime[mark] = now;
+  }
+
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Called from FillBufferDone, the components keep the input timestamp so
+ * it is used to find when the frame went in */
+void
+gst_omx_stats_frame_filled (GstOmxStats * stats,
+    OMX_BUFFERHEADERTYPE * buffer, gint64 now)
+{
+  guint i, mark;
+
+  g_return_if_fail (stats);
+  g_return_if_fail (buffer);
+
+  g_mutex_lock (&stats->lock);
+
+  /* Newest first */
+  for (i = 1; i <= GST_OMX_STATS_MARKS; i++) {
+    mark = (stats->nextmark - i) % GST_OMX_STATS_MARKS;
+    if (stats->marktime[mark]
+        && stats->marktimestamp[mark] == buffer->nTimeStamp) {
+      gst_omx_stats_add_sample_unlocked (stats, GST_OMX_STATS_LATENCY,
+          now - stats->marktime[mark]);
+      stats->marktime[mark] = 0;
+      break;
+    }
+  }
+
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Called right before pushing, filled is the FillBufferDone time */
+void
+gst_omx_stats_frame_out (GstOmxStats * stats, gint64 filled)
+{
+  g_return_if_fail (stats);
+
+  g_mutex_lock (&stats->lock);
+
+  stats->frames_out++;
+  if (filled)
+    gst_omx_stats_add_sample_unlocked (stats, GST_OMX_STATS_OUTPUT_WAIT,
+        g_get_monotonic_time () - filled);
+
+  g_mutex_unlock (&stats->lock);
+}
+
+void
+gst_omx_stats_frame_dropped (GstOmxStats * stats)
+{
+  g_return_if_fail (stats);
+
+  g_mutex_lock (&stats->lock);
+  stats->frames_dropped++;
+  g_mutex_unlock (&stats->lock);
+}
+
+void
+gst_omx_stats_frame_late (GstOmxStats * stats)
+{
+  g_return_if_fail (stats);
+
+  g_mutex_lock (&stats->lock);
+  stats->frames_late++;
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Called once the component reached Executing, elapsed is the time since
+ * the bring-up began. Unlike the frame statistics it survives resets. */
+void
+gst_omx_stats_set_startup (GstOmxStats * stats, gint64 elapsed)
+{
+  g_return_if_fail (stats);
+
+  g_mutex_lock (&stats->lock);
+  stats->startup = MAX (elapsed, 0);
+  g_mutex_unlock (&stats->lock);
+}
+
+static int
+gst_omx_stats_compare (const void *a, const void *b)
+{
+  gint64 sa = *(const gint64 *) a;
+  gint64 sb = *(const gint64 *) b;
+
+  return (sa > sb) - (sa < sb);
+}
+
+/* The 99th percentile of the EmptyThisBuffer to FillBufferDone delay,
+ * GST_CLOCK_TIME_NONE until a frame went through */
+GstClockTime
+gst_omx_stats_get_latency (GstOmxStats * stats)
+{
+  GstOmxStatsWindow *window;
+  gint64 sorted[GST_OMX_STATS_WINDOW];
+  GstClockTime latency = GST_CLOCK_TIME_NONE;
+  guint n;
+
+  g_return_val_if_fail (stats, GST_CLOCK_TIME_NONE);
+
+  g_mutex_lock (&stats->lock);
+  window = &stats->windows[GST_OMX_STATS_LATENCY];
+  n = MIN (window->count, GST_OMX_STATS_WINDOW);
+  if (n) {
+    memcpy (sorted, window->samples, n * sizeof (gint64));
+    qsort (sorted, n, sizeof (gint64), gst_omx_stats_compare);
+    latency = sorted[(n * 99 + 99) / 100 - 1] * GST_USECOND;
+  }
+  g_mutex_unlock (&stats->lock);
+
+  return latency;
+}
+
+static void
+gst_omx_stats_set_window (GstOmxStats * stats, GstStructure * structure,
+    GstOmxStatsSample sample)
+{
+  GstOmxStatsWindow *window = &stats->windows[sample];
+  gint64 sorted[GST_OMX_STATS_WINDOW];
+  gint64 sum = 0;
+  guint64 min = 0, avg = 0, p99 = 0;
+  gchar *minname, *avgname, *p99name;
+  guint n, i;
+
+  n = MIN (window->count, GST_OMX_STATS_WINDOW);
+  if (n) {
+    memcpy (sorted, window->samples, n * sizeof (gint64));
+    qsort (sorted, n, sizeof (gint64), gst_omx_stats_compare);
+    for (i = 0; i < n; i++)
+      sum += sorted[i];
+
+    min = sorted[0] * GST_USECOND;
+    avg = sum / n * GST_USECOND;
+    p99 = sorted[(n * 99 + 99) / 100 - 1] * GST_USECOND;
+  }
+
+  minname = g_strdup_printf ("%s-min", gst_omx_stats_names[sample]);
+  avgname = g_strdup_printf ("%s-avg", gst_omx_stats_names[sample]);
+  p99name = g_strdup_printf ("%s-p99", gst_omx_stats_names[sample]);
+
+  gst_structure_set (structure,
+      minname, G_TYPE_UINT64, min,
+      avgname, G_TYPE_UINT64, avg, p99name, G_TYPE_UINT64, p99, NULL);
+
+  g_free (minname);
+  g_free (avgname);
+  g_free (p99name);
+}
+
+/* Times are reported in nanoseconds, like any other GstClockTime */
+GstStructure *
+gst_omx_stats_get_structure (GstOmxStats * stats)
+{
+  GstStructure *structure;
+  guint i;
+
+  g_return_val_if_fail (stats, NULL);
+
+  structure = gst_structure_empty_new ("GstOmxStats");
+
+  g_mutex_lock (&stats->lock);
+
+  gst_structure_set (structure,
+      "frames-in", G_TYPE_UINT64, stats->frames_in,
+      "frames-out", G_TYPE_UINT64, stats->frames_out,
+      "frames-dropped", G_TYPE_UINT64, stats->frames_dropped,
+      "frames-late", G_TYPE_UINT64, stats->frames_late,
+      "startup-time", G_TYPE_UINT64, stats->startup * GST_USECOND, NULL);
+
+  for (i = 0; i < GST_OMX_STATS_NUM; i++)
+    gst_omx_stats_set_window (stats, structure, i);
+
+  g_mutex_unlock (&stats->lock);
+
+  return structure;
+}
+
+/* Returns an element message with the current statistics if the interval
+ * elapsed since the last one, NULL otherwise */
+GstMessage *
+gst_omx_stats_poll_message (GstOmxStats * stats, GstObject * src)
+{
+  gint64 now;
+
+  g_return_val_if_fail (stats, NULL);
+
+  if (!stats->interval)
+    return NULL;
+
+  now = g_get_monotonic_time ();
+
+  g_mutex_lock (&stats->lock);
+  if (now - stats->lastpost < (gint64) stats->interval * 1000) {
+    g_mutex_unlock (&stats->lock);
+    return NULL;
+  }
+  stats->lastpost = now;
+  g_mutex_unlock (&stats->lock);
+
+  return gst_message_new_element (src, gst_omx_stats_get_structure (stats));
+}
@@ -0,0 +1,92 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_OMX_STATS_H__
+#define __GST_OMX_STATS_H__
+
+#include <OMX_Core.h>
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+/* Samples kept per measurement, min/avg/p99 are computed over them */
+#define GST_OMX_STATS_WINDOW 128
+/* EmptyThisBuffer calls remembered to match them with their output */
+#define GST_OMX_STATS_MARKS 32
+typedef struct _GstOmxStats GstOmxStats;
+typedef struct _GstOmxStatsWindow GstOmxStatsWindow;
+
+typedef enum
+{
+  GST_OMX_STATS_LATENCY,        /* EmptyThisBuffer to FillBufferDone */
+  GST_OMX_STATS_INPUT_WAIT,     /* Chain entry to EmptyThisBuffer */
+  GST_OMX_STATS_OUTPUT_WAIT,    /* FillBufferDone to gst_pad_push */
+  GST_OMX_STATS_NUM
+} GstOmxStatsSample;
+
+struct _GstOmxStatsWindow
+{
+  gint64 samples[GST_OMX_STATS_WINDOW];
+  guint count;
+};
+
+struct _GstOmxStats
+{
+  GMutex lock;
+
+  guint64 frames_in;
+  guint64 frames_out;
+  guint64 frames_dropped;
+  guint64 frames_late;          /* Dropped on input because of QoS */
+  GstOmxStatsWindow windows[GST_OMX_STATS_NUM];
+
+  OMX_TICKS marktimestamp[GST_OMX_STATS_MARKS];
+  gint64 marktime[GST_OMX_STATS_MARKS];
+  guint nextmark;
+
+  /* Microseconds the last bring-up took, kept across resets */
+  gint64 startup;
+
+  /* Milliseconds between element messages, 0 disables them */
+  guint interval;
+  gint64 lastpost;
+};
+
+void gst_omx_stats_init (GstOmxStats * stats);
+void gst_omx_stats_clear (GstOmxStats * stats);
+void gst_omx_stats_reset (GstOmxStats * stats);
+
+void gst_omx_stats_add_sample (GstOmxStats * stats, GstOmxStatsSample sample,
+    gint64 elapsed);
+void gst_omx_stats_frame_in (GstOmxStats * stats,
+    OMX_BUFFERHEADERTYPE * buffer, gint64 entry);
+void gst_omx_stats_frame_filled (GstOmxStats * stats,
+    OMX_BUFFERHEADERTYPE * buffer, gint64 now);
+void gst_omx_stats_frame_out (GstOmxStats * stats, gint64 filled);
+void gst_omx_stats_frame_dropped (GstOmxStats * stats);
+void gst_omx_stats_frame_late (GstOmxStats * stats);
+void gst_omx_stats_set_startup (GstOmxStats * stats, gint64 elapsed);
+GstClockTime gst_omx_stats_get_latency (GstOmxStats * stats);
+
+GstStructure *gst_omx_stats_get_structure (GstOmxStats * stats);
+GstMessage *gst_omx_stats_poll_message (GstOmxStats * stats, GstObject * src);
+
+G_END_DECLS
+#endif /* __GST_OMX_STATS_H__ */
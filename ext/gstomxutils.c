@@ -18,6 +18,8 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#include <string.h>
+
 #include "gstomxutils.h"
 
 /**
@@ -50,3 +52,63 @@ gst_omx_convert_format_to_omx (GstVideoFormat format)
   return omx_format;
 
 }
+
+/**
+ * gst_omx_compute_latency:
+ * @measured: delay measured on the component, or GST_CLOCK_TIME_NONE
+ * @caps: caps of the output, the frame duration is taken from them
+ * @buffers: number of buffers of the output port
+ * @min: the minimum latency of the element
+ * @max: the maximum latency of the element
+ *
+ * Before anything was measured the component is assumed to take one
+ * frame. On top of that, every output buffer may hold a frame while
+ * downstream catches up.
+ */
+void
+gst_omx_compute_latency (GstClockTime measured, GstCaps * caps,
+    guint buffers, GstClockTime * min, GstClockTime * max)
+{
+  GstStructure *structure;
+  GstClockTime duration = 0;
+  gint num = 0, den = 1;
+
+  if (caps && gst_caps_get_size (caps)) {
+    structure = gst_caps_get_structure (caps, 0);
+    if (gst_structure_get_fraction (structure, "framerate", &num, &den)
+        && num > 0)
+      duration = gst_util_uint64_scale_int (GST_SECOND, den, num);
+  }
+
+  *min = GST_CLOCK_TIME_IS_VALID (measured) ? measured : duration;
+  *max = *min + buffers * duration;
+}
+
+/**
+ * gst_omx_cpu_has_neon:
+ *
+ * getauxval needs a newer libc than some target toolchains ship, the
+ * kernel lists the same hwcaps in /proc/cpuinfo.
+ *
+ * Returns: TRUE if the CPU we are running on has NEON
+ */
+gboolean
+gst_omx_cpu_has_neon (void)
+{
+  gchar *cpuinfo = NULL;
+  gchar **lines, **line;
+  gboolean neon = FALSE;
+
+  if (!g_file_get_contents ("/proc/cpuinfo", &cpuinfo, NULL, NULL))
+    return FALSE;
+
+  lines = g_strsplit (cpuinfo, "\n", 0);
+  for (line = lines; *line; line++)
+    if (g_str_has_prefix (*line, "Features") && strstr (*line, " neon"))
+      neon = TRUE;
+
+  g_strfreev (lines);
+  g_free (cpuinfo);
+
+  return neon;
+}
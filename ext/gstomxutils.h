@@ -29,5 +29,8 @@
 
 G_BEGIN_DECLS
     OMX_COLOR_FORMATTYPE gst_omx_convert_format_to_omx (GstVideoFormat format);
+void gst_omx_compute_latency (GstClockTime measured, GstCaps * caps,
+    guint buffers, GstClockTime * min, GstClockTime * max);
+gboolean gst_omx_cpu_has_neon (void);
 G_END_DECLS
 #endif // __GST_OMX_UTILS_H__
@@ -40,6 +40,7 @@
 
 #include "timm_osal_interfaces.h"
 #include "gstomxvideomixer.h"
+#include "gstomxutils.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_omx_video_mixer_debug);
 #define GST_CAT_DEFAULT gst_omx_video_mixer_debug
@@ -288,12 +289,20 @@ enum
   PROP_NUM_OUTPUT_BUFFERS,
   PROP_NUM_INPUT_BUFFERS,
   PROP_UPDATE_SETTINGS,
+  PROP_GLOBAL_LOCK,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
+  PROP_LOW_WATERMARK,
+  PROP_COPY_THREADS,
 };
 
 #define OMX_VIDEO_MIXER_HANDLE_NAME   "OMX.TI.VPSSM3.VFPC.INDTXSCWB"
 #define DEFAULT_VIDEO_MIXER_NUM_INPUT_BUFFERS    8
 #define DEFAULT_VIDEO_MIXER_NUM_OUTPUT_BUFFERS   8
 #define DEFAULT_VIDEO_MIXER_UPDATE_SETTINGS      FALSE
+#define DEFAULT_VIDEO_MIXER_STATS_INTERVAL       0
+#define DEFAULT_VIDEO_MIXER_LOW_WATERMARK        0
+#define DEFAULT_VIDEO_MIXER_COPY_THREADS         1
 
 static void _do_init (GType object_type);
 GST_BOILERPLATE_FULL (GstOmxVideoMixer, gst_omx_video_mixer, GstElement,
@@ -310,6 +319,7 @@ static GstPad *gst_omx_video_mixer_request_new_pad (GstElement * element,
 static void gst_omx_video_mixer_release_pad (GstElement * element,
     GstPad * pad);
 static gboolean gst_omx_video_mixer_sink_setcaps (GstPad * pad, GstCaps * caps);
+static gboolean gst_omx_video_mixer_src_query (GstPad * pad, GstQuery * query);
 
 static GstStateChangeReturn gst_omx_video_mixer_change_state (GstElement *
     element, GstStateChange transition);
@@ -427,6 +437,39 @@ gst_omx_video_mixer_class_init (GstOmxVideoMixerClass * klass)
           "Indicate if the mixer should update its channels settings",
           DEFAULT_VIDEO_MIXER_UPDATE_SETTINGS, G_PARAM_WRITABLE));
 
+  g_object_class_install_property (gobject_class, PROP_GLOBAL_LOCK,
+      g_param_spec_boolean ("global-lock", "Global lock",
+          "Serialize the calls to the component with the process wide lock, "
+          "for components that are not reentrant",
+          GST_OMX_GLOBAL_LOCK_DEFAULT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Frame counters, startup time and latency, input wait and output "
+          "wait min/avg/p99 in nanoseconds over the last frames",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Statistics interval",
+          "Milliseconds between element messages with the statistics "
+          "(0 : no messages)",
+          0, G_MAXUINT, DEFAULT_VIDEO_MIXER_STATS_INTERVAL,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_LOW_WATERMARK,
+      g_param_spec_uint ("low-watermark", "Low watermark",
+          "Post a warning when less than this many buffers of a port are "
+          "free (0 : disabled)",
+          0, G_MAXUINT, DEFAULT_VIDEO_MIXER_LOW_WATERMARK,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_COPY_THREADS,
+      g_param_spec_uint ("copy-threads", "Copy threads",
+          "Threads used to copy large non OMX input buffers, including the "
+          "streaming thread",
+          1, GST_OMX_COPY_MAX_THREADS, DEFAULT_VIDEO_MIXER_COPY_THREADS,
+          G_PARAM_READWRITE));
+
   /* Register the pad class */
   (void) (GST_TYPE_OMX_VIDEO_MIXER_PAD);
 
@@ -450,6 +493,8 @@ gst_omx_video_mixer_init (GstOmxVideoMixer * mixer,
   mixer->srcpad =
       GST_PAD (gst_omx_pad_new_from_template (gst_static_pad_template_get
           (&src_template), "src"));
+  gst_pad_set_query_function (mixer->srcpad,
+      GST_DEBUG_FUNCPTR (gst_omx_video_mixer_src_query));
   gst_element_add_pad (GST_ELEMENT (mixer), mixer->srcpad);
 
   GST_INFO_OBJECT (mixer, "Initializing %s", GST_OBJECT_NAME (mixer));
@@ -468,6 +513,15 @@ gst_omx_video_mixer_init (GstOmxVideoMixer * mixer,
   g_mutex_init (&mixer->waitmutex);
   g_cond_init (&mixer->waitcond);
 
+  mixer->global_lock = GST_OMX_GLOBAL_LOCK_DEFAULT;
+  g_mutex_init (&mixer->omx_mutex);
+  mixer->omx_lock = mixer->global_lock ? &_omx_mutex : &mixer->omx_mutex;
+
+  gst_omx_stats_init (&mixer->stats);
+  mixer->stats.interval = DEFAULT_VIDEO_MIXER_STATS_INTERVAL;
+  mixer->low_watermark = DEFAULT_VIDEO_MIXER_LOW_WATERMARK;
+  mixer->copy_threads = DEFAULT_VIDEO_MIXER_COPY_THREADS;
+
   mixer->collect = gst_collect_pads2_new ();
   gst_collect_pads2_set_function (mixer->collect, (GstCollectPads2Function)
       GST_DEBUG_FUNCPTR (gst_omx_video_mixer_collected), mixer);
@@ -501,6 +555,31 @@ gst_omx_video_mixer_set_property (GObject * object, guint prop_id,
       if (GST_OMX_FAIL (error))
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
+    case PROP_GLOBAL_LOCK:
+      if (mixer->started) {
+        GST_WARNING_OBJECT (mixer, "Unable to change the lock while running");
+        break;
+      }
+      mixer->global_lock = g_value_get_boolean (value);
+      mixer->omx_lock =
+          mixer->global_lock ? &_omx_mutex : &mixer->omx_mutex;
+      GST_INFO_OBJECT (mixer, "Setting global-lock to %d", mixer->global_lock);
+      break;
+    case PROP_STATS_INTERVAL:
+      mixer->stats.interval = g_value_get_uint (value);
+      GST_INFO_OBJECT (mixer, "Setting stats-interval to %d",
+          mixer->stats.interval);
+      break;
+    case PROP_LOW_WATERMARK:
+      mixer->low_watermark = g_value_get_uint (value);
+      GST_INFO_OBJECT (mixer, "Setting low-watermark to %d",
+          mixer->low_watermark);
+      break;
+    case PROP_COPY_THREADS:
+      mixer->copy_threads = g_value_get_uint (value);
+      GST_INFO_OBJECT (mixer, "Setting copy-threads to %d",
+          mixer->copy_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -512,6 +591,7 @@ gst_omx_video_mixer_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
   GstOmxVideoMixer *mixer = GST_OMX_VIDEO_MIXER (object);
+  GstStructure *structure;
 
   switch (prop_id) {
     case PROP_NUM_INPUT_BUFFERS:
@@ -520,6 +600,24 @@ gst_omx_video_mixer_get_property (GObject * object, guint prop_id,
     case PROP_NUM_OUTPUT_BUFFERS:
       g_value_set_uint (value, mixer->output_buffers);
       break;
+    case PROP_GLOBAL_LOCK:
+      g_value_set_boolean (value, mixer->global_lock);
+      break;
+    case PROP_STATS:
+      structure = gst_omx_stats_get_structure (&mixer->stats);
+      g_list_foreach (mixer->sinkpads, gst_omx_pad_append_stats, structure);
+      g_list_foreach (mixer->srcpads, gst_omx_pad_append_stats, structure);
+      g_value_take_boxed (value, structure);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, mixer->stats.interval);
+      break;
+    case PROP_LOW_WATERMARK:
+      g_value_set_uint (value, mixer->low_watermark);
+      break;
+    case PROP_COPY_THREADS:
+      g_value_set_uint (value, mixer->copy_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -533,6 +631,9 @@ gst_omx_video_mixer_finalize (GObject * object)
 
   g_mutex_clear (&mixer->waitmutex);
   g_cond_clear (&mixer->waitcond);
+  g_mutex_clear (&mixer->omx_mutex);
+
+  gst_omx_stats_clear (&mixer->stats);
 
   gst_object_unref (mixer->collect);
 
@@ -672,6 +773,53 @@ task_failed:
   }
 }
 
+/* The output waits for the slowest input: the latency is the largest
+ * upstream minimum plus the delay measured on the component */
+static gboolean
+gst_omx_video_mixer_src_query (GstPad * pad, GstQuery * query)
+{
+  GstOmxVideoMixer *mixer = GST_OMX_VIDEO_MIXER (GST_OBJECT_PARENT (pad));
+  GstClockTime min = 0, max = GST_CLOCK_TIME_NONE;
+  GstClockTime peermin, peermax, ownmin, ownmax;
+  gboolean live = FALSE, peerlive;
+  GstQuery *peerquery;
+  GList *l;
+
+  if (GST_QUERY_LATENCY != GST_QUERY_TYPE (query))
+    return gst_pad_query_default (pad, query);
+
+  peerquery = gst_query_new_latency ();
+  for (l = mixer->sinkpads; l; l = l->next) {
+    if (!gst_pad_peer_query (GST_PAD (l->data), peerquery))
+      continue;
+
+    gst_query_parse_latency (peerquery, &peerlive, &peermin, &peermax);
+    if (!peerlive)
+      continue;
+
+    live = TRUE;
+    min = MAX (min, peermin);
+    if (GST_CLOCK_TIME_IS_VALID (peermax))
+      max = GST_CLOCK_TIME_IS_VALID (max) ? MIN (max, peermax) : peermax;
+  }
+  gst_query_unref (peerquery);
+
+  gst_omx_compute_latency (gst_omx_stats_get_latency (&mixer->stats),
+      GST_PAD_CAPS (pad),
+      GST_OMX_PAD_PORT (GST_OMX_PAD (pad))->nBufferCountActual, &ownmin,
+      &ownmax);
+
+  GST_DEBUG_OBJECT (mixer, "Own latency min %" GST_TIME_FORMAT " max %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (ownmin), GST_TIME_ARGS (ownmax));
+
+  min += ownmin;
+  if (GST_CLOCK_TIME_IS_VALID (max))
+    max += ownmax;
+  gst_query_set_latency (query, live, min, max);
+
+  return TRUE;
+}
+
 static gboolean
 gst_omx_video_mixer_sink_setcaps (GstPad * pad, GstCaps * caps)
 {
@@ -691,6 +839,7 @@ gst_omx_video_mixer_sink_setcaps (GstPad * pad, GstCaps * caps)
 
   omxpad->width = width;
   omxpad->height = height;
+  gst_omx_copy_reset (&GST_OMX_PAD (pad)->copy);
 
   s = gst_caps_get_structure (caps, 0);
   if (!gst_structure_get_uint (s, "stride", &omxpad->stride))
@@ -809,7 +958,7 @@ gst_omx_video_mixer_init_outbuf_check (GstOmxVideoMixer * mixer)
 {
   OMX_BUFFERHEADERTYPE *omxbuf;
   GstOmxPad *omxpad;
-  GList *bufferlist, *b, *l;
+  GList *b, *l;
   guint numbufs, numports;
   guint i, j;
 
@@ -825,20 +974,47 @@ gst_omx_video_mixer_init_outbuf_check (GstOmxVideoMixer * mixer)
   mixer->out_ptr_list = g_malloc (numbufs * sizeof (OMX_BUFFERHEADERTYPE *));
   for (i = 0; i < numbufs; i++) {
     mixer->out_ptr_list[i] =
-        g_malloc (numports * sizeof (OMX_BUFFERHEADERTYPE *));
+        g_malloc0 (numports * sizeof (OMX_BUFFERHEADERTYPE *));
   }
 
-  /* Initialize matrix with pointers to the omx output buffers */
+  /* Initialize matrix with pointers to the omx output buffers, every port
+   * must provide exactly one buffer for each id */
   for (l = mixer->srcpads, j = 0; l; l = l->next, j++) {
     omxpad = l->data;
-    bufferlist = g_list_last (omxpad->buffers->table);
-    for (b = bufferlist, i = 0; i < numbufs; i++, b = g_list_previous (b)) {
+    if (j >= numports)
+      goto badport;
+
+    for (b = omxpad->buffers->table; b; b = b->next) {
       omxbuf = ((GstOmxBufTabNode *) b->data)->buffer;
+      i = ((GstOmxBufferData *) omxbuf->pAppPrivate)->id;
+      if (i >= numbufs || mixer->out_ptr_list[i][j])
+        goto badid;
       mixer->out_ptr_list[i][j] = omxbuf;
     }
   }
 
+  for (i = 0; i < numbufs; i++)
+    for (j = 0; j < numports; j++)
+      if (!mixer->out_ptr_list[i][j])
+        goto missing;
+
   return TRUE;
+
+badport:
+  {
+    GST_ERROR_OBJECT (mixer, "More output ports than input ports");
+    return FALSE;
+  }
+badid:
+  {
+    GST_ERROR_OBJECT (omxpad, "Invalid or duplicated output buffer id %u", i);
+    return FALSE;
+  }
+missing:
+  {
+    GST_ERROR_OBJECT (mixer, "Output port %u has no buffer with id %u", j, i);
+    return FALSE;
+  }
 }
 
 static gboolean
@@ -880,6 +1056,7 @@ gst_omx_video_mixer_collected (GstCollectPads2 * pads, GstOmxVideoMixer * mixer)
   GstBuffer *buffer;
   GSList *l;
   gboolean eos = TRUE;
+  gint64 entry;
 
   if (!mixer->started) {
 
@@ -892,7 +1069,10 @@ gst_omx_video_mixer_collected (GstCollectPads2 * pads, GstOmxVideoMixer * mixer)
     if (GST_OMX_FAIL (gst_omx_video_mixer_start (mixer)))
       goto start_failed;
 
-    gst_omx_video_mixer_init_outbuf_check (mixer);
+    gst_omx_stats_reset (&mixer->stats);
+
+    if (!gst_omx_video_mixer_init_outbuf_check (mixer))
+      goto start_failed;
 
     if (!gst_omx_video_mixer_start_push_task (mixer))
       goto task_failed;
@@ -914,6 +1094,8 @@ gst_omx_video_mixer_collected (GstCollectPads2 * pads, GstOmxVideoMixer * mixer)
     if (!buffer)
       continue;
 
+    entry = g_get_monotonic_time ();
+
     eos = FALSE;
     omxpad = GST_OMX_PAD (data->pad);
 
@@ -953,10 +1135,12 @@ gst_omx_video_mixer_collected (GstCollectPads2 * pads, GstOmxVideoMixer * mixer)
         goto free_buffer_failed;
       gst_omx_buf_tab_use_buffer (omxpad->buffers, omxbuf);
       GST_LOG_OBJECT (omxpad, "Received buffer %p, copying data", omxbuf);
-      memcpy (omxbuf->pBuffer, GST_BUFFER_DATA (buffer),
-          GST_BUFFER_SIZE (buffer));
+      if (!omxpad->copy.configured)
+        gst_omx_copy_configure (&omxpad->copy, GST_PAD_CAPS (data->pad),
+            GST_OMX_PAD_PORT (omxpad));
 
-      omxbuf->nFilledLen = GST_BUFFER_SIZE (buffer);
+      omxbuf->nFilledLen = gst_omx_copy_buffer (&omxpad->copy, omxbuf,
+          buffer, mixer->copy_threads);
       omxbuf->nOffset = 0;
     }
     omxbuf->nTimeStamp = GST_BUFFER_TIMESTAMP (buffer);
@@ -966,9 +1150,10 @@ gst_omx_video_mixer_collected (GstCollectPads2 * pads, GstOmxVideoMixer * mixer)
 
     GST_LOG_OBJECT (omxpad, "Emptying buffer %d %p %p->%p", bufdata->id,
         bufdata, omxbuf, omxbuf->pBuffer);
-    g_mutex_lock (&_omx_mutex);
+    gst_omx_stats_frame_in (&mixer->stats, omxbuf, entry);
+    g_mutex_lock (mixer->omx_lock);
     error = mixer->component->EmptyThisBuffer (mixer->handle, omxbuf);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error)) {
       goto empty_error;
     }
@@ -1204,6 +1389,9 @@ gst_omx_video_mixer_fill_callback (OMX_HANDLETYPE handle,
   GST_LOG_OBJECT (bufdata->pad, "Fill buffer callback for buffer %d: %p->%p",
       bufdata->id, outbuf, outbuf->pBuffer);
 
+  if (G_UNLIKELY (bufdata->id >= mixer->output_buffers))
+    goto badid;
+
   /* Find buffer and mark it as busy */
   gst_omx_buf_tab_find_buffer (bufdata->pad->buffers, outbuf, &omxbuf, &busy);
   if (busy)
@@ -1211,6 +1399,9 @@ gst_omx_video_mixer_fill_callback (OMX_HANDLETYPE handle,
 
   gst_omx_buf_tab_use_buffer (bufdata->pad->buffers, outbuf);
 
+  bufdata->stamp = g_get_monotonic_time ();
+  gst_omx_stats_frame_filled (&mixer->stats, outbuf, bufdata->stamp);
+
   /* Increase buffer count to the bufdata->id index */
   mixer->out_count[bufdata->id]++;
 
@@ -1236,6 +1427,12 @@ illegal:
         outbuf, outbuf->pBuffer);
     return error;
   }
+badid:
+  {
+    GST_ERROR_OBJECT (mixer, "Fill callback for unknown buffer id %u",
+        bufdata->id);
+    return OMX_ErrorBadParameter;
+  }
 
 }
 
@@ -1248,7 +1445,7 @@ gst_omx_video_mixer_empty_callback (OMX_HANDLETYPE handle,
   GstOmxBufferData *bufdata = (GstOmxBufferData *) buffer->pAppPrivate;
   GstBuffer *gstbuf = bufdata->buffer;
   GstOmxPad *pad = bufdata->pad;
-  guint8 id = bufdata->id;
+  guint id = bufdata->id;
   OMX_ERRORTYPE error = OMX_ErrorNone;
 
   GST_LOG_OBJECT (mixer, "Empty buffer callback for buffer %d %p->%p->%p", id,
@@ -1365,9 +1562,9 @@ gst_omx_video_mixer_enable_ports (GstOmxVideoMixer * mixer)
   for (l = mixer->sinkpads, i = 0; l; l = l->next, i++) {
     omxpad = GST_OMX_PAD (l->data);
     index = OMX_VFPC_INPUT_PORT_START_INDEX + i;
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     OMX_SendCommand (mixer->handle, OMX_CommandPortEnable, index, NULL);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
 
     GST_DEBUG_OBJECT (mixer, "Waiting for input port %d to enable", index);
     error = gst_omx_video_mixer_wait_for_condition (mixer,
@@ -1381,9 +1578,9 @@ gst_omx_video_mixer_enable_ports (GstOmxVideoMixer * mixer)
 
     omxpad = GST_OMX_PAD (l->data);
     index = OMX_VFPC_OUTPUT_PORT_START_INDEX + i;
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     OMX_SendCommand (mixer->handle, OMX_CommandPortEnable, index, NULL);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
 
     GST_DEBUG_OBJECT (mixer, "Waiting for output port %d to enable", index);
     error = gst_omx_video_mixer_wait_for_condition (mixer,
@@ -1421,10 +1618,10 @@ gst_omx_video_mixer_init_port_memory (GstOmxVideoMixer * mixer)
     GST_DEBUG_OBJECT (omxpad, "Initializing sink pad memory for port %lu",
         memory.nPortIndex);
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     error =
         OMX_SetParameter (mixer->handle, OMX_TI_IndexParamBuffMemType, &memory);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error)) {
       goto memory_failed;
     }
@@ -1439,10 +1636,10 @@ gst_omx_video_mixer_init_port_memory (GstOmxVideoMixer * mixer)
     GST_DEBUG_OBJECT (omxpad, "Initializing src pad memory for port %lu",
         memory.nPortIndex);
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     error =
         OMX_SetParameter (mixer->handle, OMX_TI_IndexParamBuffMemType, &memory);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error)) {
       goto memory_failed;
     }
@@ -1489,11 +1686,11 @@ gst_omx_video_mixer_dynamic_configuration (GstOmxVideoMixer * mixer,
   resolution.nPortIndex = OMX_VFPC_INPUT_PORT_START_INDEX + id;
   resolution.nChId = id;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (mixer->omx_lock);
   error =
       OMX_SetConfig (mixer->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigVidChResolution, &resolution);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (mixer->omx_lock);
   if (GST_OMX_FAIL (error))
     goto chresolution_failed;
 
@@ -1514,11 +1711,11 @@ gst_omx_video_mixer_dynamic_configuration (GstOmxVideoMixer * mixer,
   resolution.nPortIndex = OMX_VFPC_OUTPUT_PORT_START_INDEX + id;
   resolution.nChId = id;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (mixer->omx_lock);
   error =
       OMX_SetConfig (mixer->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexConfigVidChResolution, &resolution);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (mixer->omx_lock);
   if (GST_OMX_FAIL (error))
     goto chresolution_failed;
 
@@ -1604,10 +1801,10 @@ gst_omx_video_mixer_init_ports (GstOmxVideoMixer * mixer)
     port->nBufferAlignment = 0;
     port->bBuffersContiguous = 0;
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     error =
         OMX_SetParameter (mixer->handle, OMX_IndexParamPortDefinition, port);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error)) {
       portname = "input";
       goto port_failed;
@@ -1633,10 +1830,10 @@ gst_omx_video_mixer_init_ports (GstOmxVideoMixer * mixer)
     port->nBufferAlignment = 0;
     port->bBuffersContiguous = 0;
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     error =
         OMX_SetParameter (mixer->handle, OMX_IndexParamPortDefinition, port);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error)) {
       portname = "output";
       goto port_failed;
@@ -1653,11 +1850,11 @@ gst_omx_video_mixer_init_ports (GstOmxVideoMixer * mixer)
   GST_OMX_INIT_STRUCT (&channels, OMX_PARAM_VFPC_NUMCHANNELPERHANDLE);
   channels.nNumChannelsPerHandle = mixer->sinkpad_count;
 
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (mixer->omx_lock);
   error =
       OMX_SetParameter (mixer->handle,
       (OMX_INDEXTYPE) OMX_TI_IndexParamVFPCNumChPerHandle, &channels);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (mixer->omx_lock);
   if (GST_OMX_FAIL (error))
     goto channels_failed;
 
@@ -1678,11 +1875,11 @@ gst_omx_video_mixer_init_ports (GstOmxVideoMixer * mixer)
     enable.nChId = i;
     enable.bAlgBypass = OMX_FALSE;
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     error =
         OMX_SetConfig (mixer->handle,
         (OMX_INDEXTYPE) OMX_TI_IndexConfigAlgEnable, &enable);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error))
       goto alg_enable_failed;
 
@@ -1769,8 +1966,11 @@ gst_omx_video_mixer_alloc_buffers (GstOmxVideoMixer * mixer, GstOmxPad * pad,
       goto out;
   }
 
+  gst_omx_buf_tab_set_low_watermark (pad->buffers, mixer->low_watermark,
+      gst_omx_pad_low_watermark, pad);
+
   for (i = 0; i < pad->port->nBufferCountActual; ++i) {
-    bufdata = (GstOmxBufferData *) g_malloc (sizeof (GstOmxBufferData));
+    bufdata = (GstOmxBufferData *) g_malloc0 (sizeof (GstOmxBufferData));
     bufdata->pad = pad;
     bufdata->buffer = NULL;
     bufdata->id = i;
@@ -1779,10 +1979,10 @@ gst_omx_video_mixer_alloc_buffers (GstOmxVideoMixer * mixer, GstOmxPad * pad,
     if (!data) {
       size = GST_OMX_PAD_PORT (pad)->nBufferSize;
 
-      g_mutex_lock (&_omx_mutex);
+      g_mutex_lock (mixer->omx_lock);
       error = OMX_AllocateBuffer (mixer->handle, &buffer,
           GST_OMX_PAD_PORT (pad)->nPortIndex, bufdata, size);
-      g_mutex_unlock (&_omx_mutex);
+      g_mutex_unlock (mixer->omx_lock);
       if (GST_OMX_FAIL (error))
         goto noalloc;
 
@@ -1807,10 +2007,10 @@ gst_omx_video_mixer_alloc_buffers (GstOmxVideoMixer * mixer, GstOmxPad * pad,
       size = omxpeerbuffer->nAllocLen;
       pbuffer = omxpeerbuffer->pBuffer;
 
-      g_mutex_lock (&_omx_mutex);
+      g_mutex_lock (mixer->omx_lock);
       error = OMX_UseBuffer (mixer->handle, &buffer,
           GST_OMX_PAD_PORT (pad)->nPortIndex, bufdata, size, pbuffer);
-      g_mutex_unlock (&_omx_mutex);
+      g_mutex_unlock (mixer->omx_lock);
       if (GST_OMX_FAIL (error))
         goto nouse;
       GST_DEBUG_OBJECT (pad, "Use buffer number %u:"
@@ -1892,10 +2092,10 @@ gst_omx_video_mixer_free_buffers (GstOmxVideoMixer * mixer, GstOmxPad * pad,
     buffers = pad->buffers->table;
 
     g_free (buffer->pAppPrivate);
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     error = OMX_FreeBuffer (mixer->handle, GST_OMX_PAD_PORT (pad)->nPortIndex,
         buffer);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error))
       goto free_failed;
   }
@@ -1936,15 +2136,18 @@ gst_omx_video_mixer_start (GstOmxVideoMixer * mixer)
   GSList *l;
   GstCollectData2 *data;
   GstBuffer *buffer;
+  gint64 begin;
 
   if (mixer->started)
     goto already_started;
 
+  begin = g_get_monotonic_time ();
+
   GST_INFO_OBJECT (mixer, "Sending handle to Idle");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (mixer->omx_lock);
   error = OMX_SendCommand (mixer->handle, OMX_CommandStateSet, OMX_StateIdle,
       NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (mixer->omx_lock);
   if (GST_OMX_FAIL (error))
     goto idle_failed;
 
@@ -1964,6 +2167,12 @@ gst_omx_video_mixer_start (GstOmxVideoMixer * mixer)
   if (GST_OMX_FAIL (error))
     goto alloc_failed;
 
+  /* Only complete mosaics reach the queue, one per src port buffer */
+  error = gst_omx_buf_queue_set_size (mixer->queue_buffers,
+      omxpad->port->nBufferCountActual);
+  if (GST_OMX_FAIL (error))
+    goto queue_failed;
+
   GST_INFO_OBJECT (mixer, "Allocating buffers for sink ports");
   for (l = mixer->collect->data; l; l = l->next) {
     OMX_BUFFERHEADERTYPE *omxpeerbuf = NULL;
@@ -1998,10 +2207,10 @@ gst_omx_video_mixer_start (GstOmxVideoMixer * mixer)
     goto idle_failed;
 
   GST_INFO_OBJECT (mixer, "Sending handle to Executing");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (mixer->omx_lock);
   error = OMX_SendCommand (mixer->handle, OMX_CommandStateSet,
       OMX_StateExecuting, NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (mixer->omx_lock);
   if (GST_OMX_FAIL (error))
     goto exec_failed;
 
@@ -2019,6 +2228,8 @@ gst_omx_video_mixer_start (GstOmxVideoMixer * mixer)
   if (GST_OMX_FAIL (error))
     goto push_failed;
 
+  gst_omx_stats_set_startup (&mixer->stats, g_get_monotonic_time () - begin);
+
   mixer->started = TRUE;
 
   return error;
@@ -2038,6 +2249,12 @@ alloc_failed:
     GST_ERROR_OBJECT (mixer, "Unable to allocate resources for buffers");
     return error;
   }
+queue_failed:
+  {
+    GST_ERROR_OBJECT (mixer, "Unable to size the output buffers queue: %s",
+        gst_omx_error_to_str (error));
+    return error;
+  }
 exec_failed:
   {
     GST_ERROR_OBJECT (mixer, "Unable to set component to Executing");
@@ -2060,10 +2277,10 @@ gst_omx_video_mixer_stop (GstOmxVideoMixer * mixer)
     goto already_stopped;
 
   GST_INFO_OBJECT (mixer, "Sending handle to Idle");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (mixer->omx_lock);
   error = OMX_SendCommand (mixer->handle, OMX_CommandStateSet, OMX_StateIdle,
       NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (mixer->omx_lock);
   if (GST_OMX_FAIL (error))
     goto idle_failed;
 
@@ -2075,10 +2292,10 @@ gst_omx_video_mixer_stop (GstOmxVideoMixer * mixer)
     goto idle_failed;
 
   GST_INFO_OBJECT (mixer, "Sending handle to Loaded");
-  g_mutex_lock (&_omx_mutex);
+  g_mutex_lock (mixer->omx_lock);
   error = OMX_SendCommand (mixer->handle, OMX_CommandStateSet, OMX_StateLoaded,
       NULL);
-  g_mutex_unlock (&_omx_mutex);
+  g_mutex_unlock (mixer->omx_lock);
   if (GST_OMX_FAIL (error))
     goto loaded_failed;
 
@@ -2150,9 +2367,9 @@ gst_omx_video_mixer_push_buffers (GstOmxVideoMixer * mixer, GstOmxPad * pad,
     GST_DEBUG_OBJECT (pad, "Pushing buffer number %u: %p of size %d", i,
         buffer, (int) buffer->nAllocLen);
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     error = mixer->component->FillThisBuffer (mixer->handle, buffer);
-    g_mutex_unlock (&_omx_mutex);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error))
       goto push_failed;
 
@@ -2379,11 +2596,11 @@ gst_omx_video_mixer_release_buffer (gpointer data)
     if (GST_OMX_FAIL (error))
       goto buftab_failed;
 
-    g_mutex_lock (&_omx_mutex);
+    g_mutex_lock (mixer->omx_lock);
     error = mixer->component->FillThisBuffer (mixer->handle, omxbuf);
+    g_mutex_unlock (mixer->omx_lock);
     if (GST_OMX_FAIL (error))
       goto fill_failed;
-    g_mutex_unlock (&_omx_mutex);
   }
 
   return;
@@ -2409,7 +2626,7 @@ gst_omx_video_mixer_out_push_loop (void *data)
   GstOmxBufferData *bufdata = NULL;
   GstFlowReturn ret = GST_FLOW_OK;
   GstBuffer *buffer = NULL;
-  GstCaps *caps = NULL;
+  GstMessage *message;
 
   gboolean closing;
 
@@ -2423,10 +2640,6 @@ gst_omx_video_mixer_out_push_loop (void *data)
     goto discard;
   }
 
-  caps = gst_pad_get_negotiated_caps (mixer->srcpad);
-  if (!caps)
-    goto no_caps;
-
   /* Obtain processed buffer */
   omxbuf = gst_omx_buf_queue_pop_buffer_check_release (mixer->queue_buffers);
   if (!omxbuf) {
@@ -2435,16 +2648,13 @@ gst_omx_video_mixer_out_push_loop (void *data)
   bufdata = (GstOmxBufferData *) omxbuf->pAppPrivate;
 
   /* Prepare gstreamer buffer */
-  buffer = gst_buffer_new ();
+  buffer = gst_omx_buf_pool_get_buffer (bufdata->pad->pool, mixer->srcpad,
+      omxbuf, gst_omx_video_mixer_release_buffer);
   if (!buffer)
-    goto alloc_failed;
+    goto no_caps;
 
   GST_BUFFER_SIZE (buffer) =
       GST_OMX_PAD_PORT (GST_OMX_PAD (mixer->srcpad))->nBufferSize;
-  GST_BUFFER_CAPS (buffer) = caps;
-  GST_BUFFER_DATA (buffer) = omxbuf->pBuffer;
-  GST_BUFFER_MALLOCDATA (buffer) = (guint8 *) omxbuf;
-  GST_BUFFER_FREE_FUNC (buffer) = gst_omx_video_mixer_release_buffer;
 
   GST_BUFFER_TIMESTAMP (buffer) = omxbuf->nTimeStamp;
   GST_BUFFER_FLAG_SET (buffer, GST_OMX_BUFFER_FLAG);
@@ -2452,10 +2662,15 @@ gst_omx_video_mixer_out_push_loop (void *data)
 
   GST_LOG_OBJECT (mixer, "Pushing buffer %d %p->%p to %s:%s", bufdata->id,
       omxbuf, omxbuf->pBuffer, GST_DEBUG_PAD_NAME (mixer->srcpad));
+  gst_omx_stats_frame_out (&mixer->stats, bufdata->stamp);
   mixer->push_ret = gst_pad_push (mixer->srcpad, buffer);
   if (GST_FLOW_OK != ret)
     goto push_failed;
 
+  message = gst_omx_stats_poll_message (&mixer->stats, GST_OBJECT (mixer));
+  if (message)
+    gst_element_post_message (GST_ELEMENT (mixer), message);
+
   return;
 
 discard:
@@ -2465,7 +2680,9 @@ discard:
   }
 no_caps:
   {
-    GST_ERROR_OBJECT (mixer, "Unable get caps from pad");
+    GST_ERROR_OBJECT (mixer, "Unable get caps from pad, drop omx buffer");
+    gst_omx_stats_frame_dropped (&mixer->stats);
+    gst_omx_video_mixer_release_buffer (omxbuf);
     mixer->push_ret = GST_FLOW_NOT_NEGOTIATED;
     return;
   }
@@ -2475,13 +2692,6 @@ timeout:
     mixer->push_ret = GST_FLOW_ERROR;
     return;
   }
-alloc_failed:
-  {
-    GST_ERROR_OBJECT (mixer,
-        "Unable to allocate gstreamer buffer, drop omx buffer");
-    gst_omx_video_mixer_release_buffer (omxbuf);
-    return;
-  }
 
 push_failed:
   {
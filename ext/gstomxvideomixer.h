@@ -79,9 +79,19 @@ struct _GstOmxVideoMixer
   guint *out_count;
   OMX_BUFFERHEADERTYPE ***out_ptr_list;
 
+  /* Serializes the calls into the component, points either to
+   * omx_mutex or to the process wide _omx_mutex */
+  GMutex *omx_lock;
+  GMutex omx_mutex;
+  gboolean global_lock;
+
   /* Conditions */
   GMutex waitmutex;
   GCond waitcond;
+
+  GstOmxStats stats;
+  guint low_watermark;
+  guint copy_threads;
 };
 
 struct _GstOmxVideoMixerClass
@@ -0,0 +1,1047 @@
+/*
+ * OMX mock core
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* A software component that behaves like the TI ones as far as the plugin
+ * can tell: it follows the OMX state machine, accepts any parameter and
+ * moves buffers from its input to its output ports from a worker thread.
+ * Every callback is issued from the worker, without holding the component
+ * lock, just like the real cores do from their IPC threads. */
+
+#include <string.h>
+
+#include <OMX_TI_Common.h>
+#include <OMX_TI_Index.h>
+#include <OMX_TI_Video.h>
+#include <omx_vfpc.h>
+
+#include "omxmockcomponent.h"
+
+#define OMX_MOCK_DEFAULT_WIDTH    1920
+#define OMX_MOCK_DEFAULT_HEIGHT   1080
+#define OMX_MOCK_DEFAULT_BUFFERS  4
+#define OMX_MOCK_MAX_PORTS        16
+
+typedef struct _OmxMockBuffer OmxMockBuffer;
+typedef struct _OmxMockPort OmxMockPort;
+typedef struct _OmxMockCommand OmxMockCommand;
+typedef struct _OmxMockAction OmxMockAction;
+typedef struct _OmxMockComponent OmxMockComponent;
+
+struct _OmxMockBuffer
+{
+  OMX_BUFFERHEADERTYPE header;  /* Must be first */
+  gboolean owned;               /* pBuffer was allocated by the component */
+  gboolean shadow;              /* Copy of an input already returned */
+  gint64 arrival;
+};
+
+typedef enum
+{
+  OMX_MOCK_PORT_STABLE,
+  OMX_MOCK_PORT_ENABLING,
+  OMX_MOCK_PORT_DISABLING
+} OmxMockPortTransition;
+
+struct _OmxMockPort
+{
+  OMX_PARAM_PORTDEFINITIONTYPE def;
+  GQueue pending;               /* Buffers the component currently owns */
+  guint allocated;
+  OmxMockPortTransition transition;
+};
+
+struct _OmxMockCommand
+{
+  OMX_COMMANDTYPE cmd;
+  OMX_U32 param;
+};
+
+typedef enum
+{
+  OMX_MOCK_ACTION_EVENT,
+  OMX_MOCK_ACTION_EMPTY_DONE,
+  OMX_MOCK_ACTION_FILL_DONE
+} OmxMockActionType;
+
+/* A callback to issue once the component lock is released */
+struct _OmxMockAction
+{
+  OmxMockActionType type;
+  OMX_BUFFERHEADERTYPE *buffer;
+  OMX_BUFFERHEADERTYPE *source; /* Payload to copy into a filled buffer */
+  OMX_EVENTTYPE event;
+  OMX_U32 data1;
+  OMX_U32 data2;
+};
+
+struct _OmxMockComponent
+{
+  OMX_COMPONENTTYPE *handle;
+  gchar *name;
+  OmxMockKind kind;
+  OmxMockConfig config;
+
+  OMX_CALLBACKTYPE callbacks;
+  OMX_PTR appdata;
+
+  OMX_STATETYPE state;
+  OMX_STATETYPE target;
+  GList *ports;                 /* Sorted by port index */
+  GHashTable *params;           /* Last value set for any other index */
+  gint64 next_capture;
+
+  GQueue commands;
+  GQueue actions;
+
+  GMutex lock;
+  GCond cond;
+  GThread *worker;
+  gboolean quit;
+};
+
+#define OMX_MOCK_COMPONENT(handle) \
+  ((OmxMockComponent *) ((OMX_COMPONENTTYPE *) (handle))->pComponentPrivate)
+
+static void
+omx_mock_init_header (OMX_PTR structure, OMX_U32 size)
+{
+  OMX_VERSIONTYPE *version;
+
+  memset (structure, 0, size);
+  *(OMX_U32 *) structure = size;
+  version = (OMX_VERSIONTYPE *) ((OMX_U8 *) structure + sizeof (OMX_U32));
+  version->s.nVersionMajor = 1;
+  version->s.nVersionMinor = 1;
+}
+
+static void
+omx_mock_buffer_free (OmxMockBuffer * buffer)
+{
+  if (buffer->owned)
+    g_free (buffer->header.pBuffer);
+  g_free (buffer);
+}
+
+static gboolean
+omx_mock_component_is_output (OmxMockComponent * this, OMX_U32 index)
+{
+  switch (this->kind) {
+    case OMX_MOCK_KIND_VFPC:
+      return index >= OMX_VFPC_OUTPUT_PORT_START_INDEX;
+    case OMX_MOCK_KIND_CAPTURE:
+      return TRUE;
+    default:
+      return index > 0;
+  }
+}
+
+static gint
+omx_mock_port_compare (gconstpointer a, gconstpointer b)
+{
+  const OmxMockPort *pa = a;
+  const OmxMockPort *pb = b;
+
+  return (gint) pa->def.nPortIndex - (gint) pb->def.nPortIndex;
+}
+
+/* Ports are created the first time the client refers to them, the TI
+ * components expose many more ports than a given element uses */
+static OmxMockPort *
+omx_mock_component_get_port (OmxMockComponent * this, OMX_U32 index)
+{
+  OMX_VIDEO_PORTDEFINITIONTYPE *video;
+  OmxMockPort *port;
+  GList *l;
+
+  for (l = this->ports; l; l = l->next) {
+    port = l->data;
+    if (port->def.nPortIndex == index)
+      return port;
+  }
+
+  port = g_new0 (OmxMockPort, 1);
+  g_queue_init (&port->pending);
+  port->transition = OMX_MOCK_PORT_STABLE;
+
+  omx_mock_init_header (&port->def, sizeof (port->def));
+  port->def.nPortIndex = index;
+  port->def.eDir =
+      omx_mock_component_is_output (this, index) ? OMX_DirOutput : OMX_DirInput;
+  port->def.nBufferCountActual = OMX_MOCK_DEFAULT_BUFFERS;
+  port->def.nBufferCountMin = 1;
+  port->def.bEnabled = OMX_TRUE;
+  port->def.bPopulated = OMX_FALSE;
+  port->def.eDomain = OMX_PortDomainVideo;
+
+  video = &port->def.format.video;
+  video->nFrameWidth = OMX_MOCK_DEFAULT_WIDTH;
+  video->nFrameHeight = OMX_MOCK_DEFAULT_HEIGHT;
+  video->nStride = OMX_MOCK_DEFAULT_WIDTH;
+  video->nSliceHeight = OMX_MOCK_DEFAULT_HEIGHT;
+  video->eColorFormat = OMX_COLOR_FormatYUV420SemiPlanar;
+  port->def.nBufferSize = video->nStride * video->nSliceHeight * 3 / 2;
+
+  this->ports = g_list_insert_sorted (this->ports, port, omx_mock_port_compare);
+
+  return port;
+}
+
+static void
+omx_mock_component_push_action (OmxMockComponent * this,
+    OmxMockActionType type, OMX_BUFFERHEADERTYPE * buffer,
+    OMX_BUFFERHEADERTYPE * source, OMX_EVENTTYPE event, OMX_U32 data1,
+    OMX_U32 data2)
+{
+  OmxMockAction *action = g_new0 (OmxMockAction, 1);
+
+  action->type = type;
+  action->buffer = buffer;
+  action->source = source;
+  action->event = event;
+  action->data1 = data1;
+  action->data2 = data2;
+
+  g_queue_push_tail (&this->actions, action);
+}
+
+static void
+omx_mock_component_push_event (OmxMockComponent * this, OMX_EVENTTYPE event,
+    OMX_U32 data1, OMX_U32 data2)
+{
+  omx_mock_component_push_action (this, OMX_MOCK_ACTION_EVENT, NULL, NULL,
+      event, data1, data2);
+}
+
+/* Hands every buffer the port holds back to the client, unprocessed */
+static void
+omx_mock_component_return_buffers (OmxMockComponent * this,
+    OmxMockPort * port)
+{
+  OMX_BUFFERHEADERTYPE *buffer;
+
+  while ((buffer = g_queue_pop_head (&port->pending))) {
+    if (OMX_DirOutput == port->def.eDir) {
+      buffer->nFilledLen = 0;
+      omx_mock_component_push_action (this, OMX_MOCK_ACTION_FILL_DONE,
+          buffer, NULL, 0, 0, 0);
+    } else {
+      omx_mock_component_push_action (this, OMX_MOCK_ACTION_EMPTY_DONE,
+          buffer, NULL, 0, 0, 0);
+    }
+  }
+}
+
+static gboolean
+omx_mock_component_valid_transition (OMX_STATETYPE from, OMX_STATETYPE to)
+{
+  if (OMX_StateInvalid == to)
+    return TRUE;
+
+  switch (from) {
+    case OMX_StateLoaded:
+      return OMX_StateIdle == to;
+    case OMX_StateIdle:
+      return OMX_StateLoaded == to || OMX_StateExecuting == to
+          || OMX_StatePause == to;
+    case OMX_StateExecuting:
+      return OMX_StateIdle == to || OMX_StatePause == to;
+    case OMX_StatePause:
+      return OMX_StateIdle == to || OMX_StateExecuting == to;
+    default:
+      return FALSE;
+  }
+}
+
+static void
+omx_mock_component_run_command (OmxMockComponent * this,
+    OmxMockCommand * command)
+{
+  OmxMockPort *port;
+  GList *l;
+
+  switch (command->cmd) {
+    case OMX_CommandStateSet:
+      if (command->param == this->state) {
+        omx_mock_component_push_event (this, OMX_EventError,
+            OMX_ErrorSameState, 0);
+        break;
+      }
+      if (!omx_mock_component_valid_transition (this->state, command->param)) {
+        omx_mock_component_push_event (this, OMX_EventError,
+            OMX_ErrorIncorrectStateTransition, 0);
+        break;
+      }
+      this->target = command->param;
+      if (OMX_StateIdle == this->target || OMX_StateInvalid == this->target)
+        for (l = this->ports; l; l = l->next)
+          omx_mock_component_return_buffers (this, l->data);
+      if (OMX_StateExecuting == this->target)
+        this->next_capture = 0;
+      break;
+    case OMX_CommandFlush:
+      for (l = this->ports; l; l = l->next) {
+        port = l->data;
+        if (OMX_ALL != command->param && port->def.nPortIndex != command->param)
+          continue;
+        omx_mock_component_return_buffers (this, port);
+        omx_mock_component_push_event (this, OMX_EventCmdComplete,
+            OMX_CommandFlush, port->def.nPortIndex);
+      }
+      break;
+    case OMX_CommandPortDisable:
+    case OMX_CommandPortEnable:
+      if (OMX_ALL != command->param)
+        omx_mock_component_get_port (this, command->param);
+      for (l = this->ports; l; l = l->next) {
+        port = l->data;
+        if (OMX_ALL != command->param && port->def.nPortIndex != command->param)
+          continue;
+        if (OMX_CommandPortDisable == command->cmd) {
+          omx_mock_component_return_buffers (this, port);
+          port->def.bEnabled = OMX_FALSE;
+          port->transition = OMX_MOCK_PORT_DISABLING;
+        } else {
+          port->def.bEnabled = OMX_TRUE;
+          port->transition = OMX_MOCK_PORT_ENABLING;
+        }
+      }
+      break;
+    default:
+      omx_mock_component_push_event (this, OMX_EventError,
+          OMX_ErrorNotImplemented, 0);
+      break;
+  }
+}
+
+/* Completes the pending state and port transitions whose conditions are
+ * met, Loaded<->Idle and port enabling wait on buffer allocation */
+static void
+omx_mock_component_check_transitions (OmxMockComponent * this)
+{
+  OmxMockPort *port;
+  gboolean ready = TRUE;
+  GList *l;
+
+  for (l = this->ports; l; l = l->next) {
+    port = l->data;
+
+    switch (port->transition) {
+      case OMX_MOCK_PORT_ENABLING:
+        if (OMX_StateLoaded != this->state && !port->def.bPopulated)
+          break;
+        port->transition = OMX_MOCK_PORT_STABLE;
+        omx_mock_component_push_event (this, OMX_EventCmdComplete,
+            OMX_CommandPortEnable, port->def.nPortIndex);
+        break;
+      case OMX_MOCK_PORT_DISABLING:
+        if (port->allocated)
+          break;
+        port->transition = OMX_MOCK_PORT_STABLE;
+        omx_mock_component_push_event (this, OMX_EventCmdComplete,
+            OMX_CommandPortDisable, port->def.nPortIndex);
+        break;
+      default:
+        break;
+    }
+
+    if (OMX_StateLoaded == this->state && OMX_StateIdle == this->target
+        && port->def.bEnabled && !port->def.bPopulated)
+      ready = FALSE;
+    if (OMX_StateIdle == this->state && OMX_StateLoaded == this->target
+        && port->allocated)
+      ready = FALSE;
+  }
+
+  if (this->target == this->state || !ready)
+    return;
+
+  this->state = this->target;
+  omx_mock_component_push_event (this, OMX_EventCmdComplete,
+      OMX_CommandStateSet, this->state);
+}
+
+/* Consumes one buffer from every input and fills one buffer on every
+ * output, as many times as buffers are available. Returns when the next
+ * buffer will be ready, or G_MAXINT64 if it depends on the client */
+static gint64
+omx_mock_component_process_group (OmxMockComponent * this,
+    OmxMockPort ** ins, guint nin, OmxMockPort ** outs, guint nout)
+{
+  OmxMockBuffer *inbuf;
+  OMX_BUFFERHEADERTYPE *outbuf;
+  OMX_BUFFERHEADERTYPE *source;
+  gint64 ready;
+  guint i;
+
+  while (TRUE) {
+    for (i = 0; i < nin; i++)
+      if (g_queue_is_empty (&ins[i]->pending))
+        return G_MAXINT64;
+    for (i = 0; i < nout; i++)
+      if (g_queue_is_empty (&outs[i]->pending))
+        return G_MAXINT64;
+
+    inbuf = g_queue_peek_head (&ins[0]->pending);
+    ready = inbuf->arrival + this->config.latency;
+    if (g_get_monotonic_time () < ready)
+      return ready;
+
+    source = &inbuf->header;
+    for (i = 0; i < nout; i++) {
+      outbuf = g_queue_pop_head (&outs[i]->pending);
+      outbuf->nOffset = 0;
+      outbuf->nFilledLen = MIN (source->nFilledLen, outbuf->nAllocLen);
+      outbuf->nTimeStamp = source->nTimeStamp;
+      outbuf->nTickCount = source->nTickCount;
+      outbuf->nFlags = source->nFlags;
+      omx_mock_component_push_action (this, OMX_MOCK_ACTION_FILL_DONE,
+          outbuf, this->config.copy ? source : NULL, 0, 0, 0);
+
+      if (outbuf->nFlags & OMX_BUFFERFLAG_EOS)
+        omx_mock_component_push_event (this, OMX_EventBufferFlag,
+            outs[i]->def.nPortIndex, outbuf->nFlags);
+    }
+
+    /* Inputs go back after the outputs were copied from them */
+    for (i = 0; i < nin; i++)
+      omx_mock_component_push_action (this, OMX_MOCK_ACTION_EMPTY_DONE,
+          g_queue_pop_head (&ins[i]->pending), NULL, 0, 0, 0);
+  }
+}
+
+/* Capture components fill their outputs at the configured frame rate,
+ * frames are dropped if the client does not return buffers in time */
+static gint64
+omx_mock_component_capture (OmxMockComponent * this, OmxMockPort ** outs,
+    guint nout)
+{
+  OMX_BUFFERHEADERTYPE *outbuf;
+  gint64 period, now;
+  guint i;
+
+  period = G_USEC_PER_SEC / MAX (this->config.framerate, 1);
+  now = g_get_monotonic_time ();
+
+  if (!this->next_capture)
+    this->next_capture = now + period;
+  if (now < this->next_capture)
+    return this->next_capture;
+
+  for (i = 0; i < nout; i++) {
+    outbuf = g_queue_pop_head (&outs[i]->pending);
+    if (!outbuf)
+      continue;
+    outbuf->nOffset = 0;
+    outbuf->nFilledLen = MIN (outs[i]->def.nBufferSize, outbuf->nAllocLen);
+    outbuf->nTimeStamp = now;
+    outbuf->nFlags = OMX_BUFFERFLAG_ENDOFFRAME;
+    omx_mock_component_push_action (this, OMX_MOCK_ACTION_FILL_DONE,
+        outbuf, NULL, 0, 0, 0);
+  }
+
+  /* Do not burst after a stall */
+  this->next_capture += period;
+  if (this->next_capture <= now)
+    this->next_capture = now + period;
+
+  return this->next_capture;
+}
+
+/* Pairs the enabled inputs with the enabled outputs: one to one when the
+ * counts match (codecs, scaler, mixer channels), otherwise every input
+ * feeds every output (the dual output deinterlacer) */
+static gint64
+omx_mock_component_process (OmxMockComponent * this)
+{
+  OmxMockPort *ins[OMX_MOCK_MAX_PORTS];
+  OmxMockPort *outs[OMX_MOCK_MAX_PORTS];
+  OmxMockPort *port;
+  guint nin = 0, nout = 0, i;
+  gint64 deadline, next;
+  GList *l;
+
+  for (l = this->ports; l; l = l->next) {
+    port = l->data;
+    if (!port->def.bEnabled || OMX_MOCK_PORT_STABLE != port->transition)
+      continue;
+    if (OMX_DirInput == port->def.eDir && nin < G_N_ELEMENTS (ins))
+      ins[nin++] = port;
+    else if (OMX_DirOutput == port->def.eDir && nout < G_N_ELEMENTS (outs))
+      outs[nout++] = port;
+  }
+
+  if (!nout)
+    return G_MAXINT64;
+
+  if (!nin)
+    return omx_mock_component_capture (this, outs, nout);
+
+  if (nin != nout)
+    return omx_mock_component_process_group (this, ins, nin, outs, nout);
+
+  deadline = G_MAXINT64;
+  for (i = 0; i < nin; i++) {
+    next = omx_mock_component_process_group (this, &ins[i], 1, &outs[i], 1);
+    deadline = MIN (deadline, next);
+  }
+
+  return deadline;
+}
+
+static void
+omx_mock_component_run_actions (OmxMockComponent * this)
+{
+  OmxMockAction *action;
+  GQueue actions;
+
+  actions = this->actions;
+  g_queue_init (&this->actions);
+
+  g_mutex_unlock (&this->lock);
+
+  while ((action = g_queue_pop_head (&actions))) {
+    switch (action->type) {
+      case OMX_MOCK_ACTION_EVENT:
+        if (this->callbacks.EventHandler)
+          this->callbacks.EventHandler (this->handle, this->appdata,
+              action->event, action->data1, action->data2, NULL);
+        break;
+      case OMX_MOCK_ACTION_EMPTY_DONE:
+        /* The client got the original back when it was queued */
+        if (((OmxMockBuffer *) action->buffer)->shadow)
+          omx_mock_buffer_free ((OmxMockBuffer *) action->buffer);
+        else if (this->callbacks.EmptyBufferDone)
+          this->callbacks.EmptyBufferDone (this->handle, this->appdata,
+              action->buffer);
+        break;
+      case OMX_MOCK_ACTION_FILL_DONE:
+        if (action->source)
+          memcpy (action->buffer->pBuffer,
+              action->source->pBuffer + action->source->nOffset,
+              action->buffer->nFilledLen);
+        if (this->callbacks.FillBufferDone)
+          this->callbacks.FillBufferDone (this->handle, this->appdata,
+              action->buffer);
+        break;
+    }
+    g_free (action);
+  }
+
+  g_mutex_lock (&this->lock);
+}
+
+static gpointer
+omx_mock_component_worker (gpointer data)
+{
+  OmxMockComponent *this = data;
+  OmxMockCommand *command;
+  gint64 deadline;
+
+  g_mutex_lock (&this->lock);
+
+  while (!this->quit) {
+    while ((command = g_queue_pop_head (&this->commands))) {
+      omx_mock_component_run_command (this, command);
+      g_free (command);
+    }
+
+    omx_mock_component_check_transitions (this);
+
+    deadline = G_MAXINT64;
+    if (OMX_StateExecuting == this->state)
+      deadline = omx_mock_component_process (this);
+
+    if (!g_queue_is_empty (&this->actions)) {
+      omx_mock_component_run_actions (this);
+      continue;
+    }
+
+    if (!g_queue_is_empty (&this->commands))
+      continue;
+
+    if (G_MAXINT64 == deadline)
+      g_cond_wait (&this->cond, &this->lock);
+    else
+      g_cond_wait_until (&this->cond, &this->lock, deadline);
+  }
+
+  g_mutex_unlock (&this->lock);
+
+  return NULL;
+}
+
+/* OMX_COMPONENTTYPE implementation */
+
+static OMX_ERRORTYPE
+omx_mock_component_get_version (OMX_HANDLETYPE handle, OMX_STRING name,
+    OMX_VERSIONTYPE * version, OMX_VERSIONTYPE * spec, OMX_UUIDTYPE * uuid)
+{
+  OmxMockComponent *this = OMX_MOCK_COMPONENT (handle);
+
+  g_strlcpy (name, this->name, OMX_MAX_STRINGNAME_SIZE);
+  *version = this->handle->nVersion;
+  *spec = this->handle->nVersion;
+  memset (uuid, 0, sizeof (OMX_UUIDTYPE));
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_send_command (OMX_HANDLETYPE handle, OMX_COMMANDTYPE cmd,
+    OMX_U32 param, OMX_PTR data)
+{
+  OmxMockComponent *this = OMX_MOCK_COMPONENT (handle);
+  OmxMockCommand *command;
+
+  switch (cmd) {
+    case OMX_CommandStateSet:
+    case OMX_CommandFlush:
+    case OMX_CommandPortDisable:
+    case OMX_CommandPortEnable:
+      break;
+    default:
+      return OMX_ErrorNotImplemented;
+  }
+
+  command = g_new0 (OmxMockCommand, 1);
+  command->cmd = cmd;
+  command->param = param;
+
+  g_mutex_lock (&this->lock);
+  g_queue_push_tail (&this->commands, command);
+  g_cond_signal (&this->cond);
+  g_mutex_unlock (&this->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_get_parameter (OMX_HANDLETYPE handle, OMX_INDEXTYPE index,
+    OMX_PTR structure)
+{
+  OmxMockComponent *this = OMX_MOCK_COMPONENT (handle);
+  OMX_PARAM_PORTDEFINITIONTYPE *def = structure;
+  OmxMockPort *port;
+  OMX_PTR stored;
+
+  if (!structure)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&this->lock);
+
+  if (OMX_IndexParamPortDefinition == index) {
+    port = omx_mock_component_get_port (this, def->nPortIndex);
+    memcpy (def, &port->def, MIN (def->nSize, port->def.nSize));
+  } else {
+    /* Unknown indexes keep the caller defaults until they are set */
+    stored = g_hash_table_lookup (this->params, GUINT_TO_POINTER (index));
+    if (stored)
+      memcpy (structure, stored,
+          MIN (*(OMX_U32 *) structure, *(OMX_U32 *) stored));
+  }
+
+  g_mutex_unlock (&this->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_set_parameter (OMX_HANDLETYPE handle, OMX_INDEXTYPE index,
+    OMX_PTR structure)
+{
+  OmxMockComponent *this = OMX_MOCK_COMPONENT (handle);
+  OMX_PARAM_PORTDEFINITIONTYPE *def = structure;
+  OmxMockPort *port;
+  OMX_BOOL enabled, populated;
+
+  if (!structure)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&this->lock);
+
+  if (OMX_IndexParamPortDefinition == index) {
+    port = omx_mock_component_get_port (this, def->nPortIndex);
+    enabled = port->def.bEnabled;
+    populated = port->def.bPopulated;
+    memcpy (&port->def, def, MIN (def->nSize, port->def.nSize));
+    port->def.bEnabled = enabled;
+    port->def.bPopulated = populated;
+  } else {
+    g_hash_table_insert (this->params, GUINT_TO_POINTER (index),
+        g_memdup (structure, *(OMX_U32 *) structure));
+  }
+
+  g_mutex_unlock (&this->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_get_extension_index (OMX_HANDLETYPE handle,
+    OMX_STRING name, OMX_INDEXTYPE * index)
+{
+  return OMX_ErrorUnsupportedIndex;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_get_state (OMX_HANDLETYPE handle, OMX_STATETYPE * state)
+{
+  OmxMockComponent *this = OMX_MOCK_COMPONENT (handle);
+
+  g_mutex_lock (&this->lock);
+  *state = this->state;
+  g_mutex_unlock (&this->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_tunnel_request (OMX_HANDLETYPE handle, OMX_U32 port,
+    OMX_HANDLETYPE peer, OMX_U32 peerport, OMX_TUNNELSETUPTYPE * setup)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_new_buffer (OmxMockComponent * this,
+    OMX_BUFFERHEADERTYPE ** header, OMX_U32 index, OMX_PTR appdata,
+    OMX_U32 size, OMX_U8 * data)
+{
+  OmxMockBuffer *buffer;
+  OmxMockPort *port;
+
+  if (!header || !size)
+    return OMX_ErrorBadParameter;
+
+  buffer = g_new0 (OmxMockBuffer, 1);
+  omx_mock_init_header (&buffer->header, sizeof (OMX_BUFFERHEADERTYPE));
+
+  buffer->owned = !data;
+  buffer->header.pBuffer = data ? data : g_malloc (size);
+  buffer->header.nAllocLen = size;
+  buffer->header.pAppPrivate = appdata;
+
+  g_mutex_lock (&this->lock);
+
+  port = omx_mock_component_get_port (this, index);
+  if (OMX_DirInput == port->def.eDir)
+    buffer->header.nInputPortIndex = index;
+  else
+    buffer->header.nOutputPortIndex = index;
+
+  port->allocated++;
+  if (port->allocated >= port->def.nBufferCountActual)
+    port->def.bPopulated = OMX_TRUE;
+  g_cond_signal (&this->cond);
+
+  g_mutex_unlock (&this->lock);
+
+  *header = &buffer->header;
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_use_buffer (OMX_HANDLETYPE handle,
+    OMX_BUFFERHEADERTYPE ** header, OMX_U32 port, OMX_PTR appdata,
+    OMX_U32 size, OMX_U8 * data)
+{
+  if (!data)
+    return OMX_ErrorBadParameter;
+
+  return omx_mock_component_new_buffer (OMX_MOCK_COMPONENT (handle), header,
+      port, appdata, size, data);
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_allocate_buffer (OMX_HANDLETYPE handle,
+    OMX_BUFFERHEADERTYPE ** header, OMX_U32 port, OMX_PTR appdata,
+    OMX_U32 size)
+{
+  return omx_mock_component_new_buffer (OMX_MOCK_COMPONENT (handle), header,
+      port, appdata, size, NULL);
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_free_buffer (OMX_HANDLETYPE handle, OMX_U32 index,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  OmxMockComponent *this = OMX_MOCK_COMPONENT (handle);
+  OmxMockBuffer *buffer = (OmxMockBuffer *) header;
+  OmxMockPort *port;
+
+  if (!header)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&this->lock);
+
+  port = omx_mock_component_get_port (this, index);
+  g_queue_remove (&port->pending, header);
+  if (port->allocated)
+    port->allocated--;
+  port->def.bPopulated = OMX_FALSE;
+  g_cond_signal (&this->cond);
+
+  g_mutex_unlock (&this->lock);
+
+  omx_mock_buffer_free (buffer);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_queue_buffer (OmxMockComponent * this, OMX_U32 index,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  OMX_ERRORTYPE error = OMX_ErrorNone;
+  OmxMockBuffer *buffer = (OmxMockBuffer *) header;
+  OmxMockPort *port;
+
+  if (!header)
+    return OMX_ErrorBadParameter;
+
+  /* Outside the component lock, the worker keeps running meanwhile */
+  if (this->config.call_latency)
+    g_usleep (this->config.call_latency);
+
+  g_mutex_lock (&this->lock);
+
+  if (OMX_StateIdle != this->state && OMX_StateExecuting != this->state
+      && OMX_StatePause != this->state) {
+    error = OMX_ErrorIncorrectStateOperation;
+    goto out;
+  }
+
+  port = omx_mock_component_get_port (this, index);
+  if (!port->def.bEnabled) {
+    error = OMX_ErrorIncorrectStateOperation;
+    goto out;
+  }
+
+  buffer->arrival = g_get_monotonic_time ();
+  g_queue_push_tail (&port->pending, header);
+  g_cond_signal (&this->cond);
+
+out:
+  g_mutex_unlock (&this->lock);
+
+  return error;
+}
+
+/* Queues a copy of the input and returns the original right away, from
+ * the thread calling EmptyThisBuffer. Some cores complete small inputs
+ * like this, so the client must cope with EmptyBufferDone arriving before
+ * EmptyThisBuffer returns */
+static OMX_ERRORTYPE
+omx_mock_component_empty_sync (OmxMockComponent * this,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  OMX_ERRORTYPE error;
+  OmxMockBuffer *shadow;
+
+  shadow = g_new0 (OmxMockBuffer, 1);
+  shadow->header = *header;
+  shadow->header.pBuffer =
+      g_memdup (header->pBuffer + header->nOffset, header->nFilledLen);
+  shadow->header.nOffset = 0;
+  shadow->header.nAllocLen = header->nFilledLen;
+  shadow->owned = TRUE;
+  shadow->shadow = TRUE;
+
+  error = omx_mock_component_queue_buffer (this, header->nInputPortIndex,
+      &shadow->header);
+  if (OMX_ErrorNone != error) {
+    omx_mock_buffer_free (shadow);
+    return error;
+  }
+
+  if (this->callbacks.EmptyBufferDone)
+    this->callbacks.EmptyBufferDone (this->handle, this->appdata, header);
+
+  return error;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_empty_this_buffer (OMX_HANDLETYPE handle,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  OmxMockComponent *this = OMX_MOCK_COMPONENT (handle);
+
+  if (header && this->config.sync_empty)
+    return omx_mock_component_empty_sync (this, header);
+
+  return omx_mock_component_queue_buffer (this,
+      header ? header->nInputPortIndex : 0, header);
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_fill_this_buffer (OMX_HANDLETYPE handle,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  return omx_mock_component_queue_buffer (OMX_MOCK_COMPONENT (handle),
+      header ? header->nOutputPortIndex : 0, header);
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_set_callbacks (OMX_HANDLETYPE handle,
+    OMX_CALLBACKTYPE * callbacks, OMX_PTR appdata)
+{
+  OmxMockComponent *this = OMX_MOCK_COMPONENT (handle);
+
+  if (!callbacks)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&this->lock);
+  this->callbacks = *callbacks;
+  this->appdata = appdata;
+  g_mutex_unlock (&this->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_deinit (OMX_HANDLETYPE handle)
+{
+  /* Everything is released by omx_mock_component_free */
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_use_egl_image (OMX_HANDLETYPE handle,
+    OMX_BUFFERHEADERTYPE ** header, OMX_U32 port, OMX_PTR appdata,
+    void *image)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+static OMX_ERRORTYPE
+omx_mock_component_role_enum (OMX_HANDLETYPE handle, OMX_U8 * role,
+    OMX_U32 index)
+{
+  return OMX_ErrorNoMore;
+}
+
+OMX_ERRORTYPE
+omx_mock_component_new (OMX_HANDLETYPE * handle, const gchar * name,
+    OmxMockKind kind, const OmxMockConfig * config, OMX_PTR appdata,
+    OMX_CALLBACKTYPE * callbacks)
+{
+  OmxMockComponent *this;
+  OMX_COMPONENTTYPE *component;
+
+  if (!handle || !name || !config || !callbacks)
+    return OMX_ErrorBadParameter;
+
+  this = g_new0 (OmxMockComponent, 1);
+  this->name = g_strdup (name);
+  this->kind = kind;
+  this->config = *config;
+  this->callbacks = *callbacks;
+  this->appdata = appdata;
+  this->state = OMX_StateLoaded;
+  this->target = OMX_StateLoaded;
+  this->params = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      g_free);
+  g_queue_init (&this->commands);
+  g_queue_init (&this->actions);
+  g_mutex_init (&this->lock);
+  g_cond_init (&this->cond);
+
+  component = g_new0 (OMX_COMPONENTTYPE, 1);
+  omx_mock_init_header (component, sizeof (OMX_COMPONENTTYPE));
+  component->pComponentPrivate = this;
+  component->pApplicationPrivate = appdata;
+  component->GetComponentVersion = omx_mock_component_get_version;
+  component->SendCommand = omx_mock_component_send_command;
+  component->GetParameter = omx_mock_component_get_parameter;
+  component->SetParameter = omx_mock_component_set_parameter;
+  /* Configs are stored the same way parameters are */
+  component->GetConfig = omx_mock_component_get_parameter;
+  component->SetConfig = omx_mock_component_set_parameter;
+  component->GetExtensionIndex = omx_mock_component_get_extension_index;
+  component->GetState = omx_mock_component_get_state;
+  component->ComponentTunnelRequest = omx_mock_component_tunnel_request;
+  component->UseBuffer = omx_mock_component_use_buffer;
+  component->AllocateBuffer = omx_mock_component_allocate_buffer;
+  component->FreeBuffer = omx_mock_component_free_buffer;
+  component->EmptyThisBuffer = omx_mock_component_empty_this_buffer;
+  component->FillThisBuffer = omx_mock_component_fill_this_buffer;
+  component->SetCallbacks = omx_mock_component_set_callbacks;
+  component->ComponentDeInit = omx_mock_component_deinit;
+  component->UseEGLImage = omx_mock_component_use_egl_image;
+  component->ComponentRoleEnum = omx_mock_component_role_enum;
+  this->handle = component;
+
+  this->worker = g_thread_new (name, omx_mock_component_worker, this);
+
+  *handle = component;
+
+  return OMX_ErrorNone;
+}
+
+static void
+omx_mock_port_free (gpointer data)
+{
+  OmxMockPort *port = data;
+  OmxMockBuffer *buffer;
+
+  while ((buffer = g_queue_pop_head (&port->pending)))
+    if (buffer->shadow)
+      omx_mock_buffer_free (buffer);
+  g_free (port);
+}
+
+OMX_ERRORTYPE
+omx_mock_component_free (OMX_HANDLETYPE handle)
+{
+  OmxMockComponent *this;
+  OmxMockAction *action;
+
+  if (!handle)
+    return OMX_ErrorBadParameter;
+
+  this = OMX_MOCK_COMPONENT (handle);
+
+  g_mutex_lock (&this->lock);
+  this->quit = TRUE;
+  g_cond_signal (&this->cond);
+  g_mutex_unlock (&this->lock);
+
+  g_thread_join (this->worker);
+
+  g_list_free_full (this->ports, omx_mock_port_free);
+  g_hash_table_destroy (this->params);
+  while (!g_queue_is_empty (&this->commands))
+    g_free (g_queue_pop_head (&this->commands));
+  while ((action = g_queue_pop_head (&this->actions))) {
+    if (OMX_MOCK_ACTION_EMPTY_DONE == action->type
+        && ((OmxMockBuffer *) action->buffer)->shadow)
+      omx_mock_buffer_free ((OmxMockBuffer *) action->buffer);
+    g_free (action);
+  }
+  g_mutex_clear (&this->lock);
+  g_cond_clear (&this->cond);
+
+  g_free (this->name);
+  g_free (this->handle);
+  g_free (this);
+
+  return OMX_ErrorNone;
+}
@@ -0,0 +1,56 @@
+/*
+ * OMX mock core
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __OMX_MOCK_COMPONENT_H__
+#define __OMX_MOCK_COMPONENT_H__
+
+#include <glib.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+G_BEGIN_DECLS
+/* How the component moves data from its input to its output ports */
+typedef enum
+{
+  OMX_MOCK_KIND_CODEC,          /* DUCATI and DSP encoders/decoders */
+  OMX_MOCK_KIND_VFPC,           /* Scaler, deinterlacer, noise filter, mixer */
+  OMX_MOCK_KIND_CAPTURE         /* VFCC, no input ports */
+} OmxMockKind;
+
+typedef struct _OmxMockConfig OmxMockConfig;
+
+/* Tunables read from the environment by OMX_Init, see omxmockcore.c */
+struct _OmxMockConfig
+{
+  gint64 latency;               /* Microseconds from input to output */
+  gint64 call_latency;          /* Microseconds spent in every buffer call */
+  guint framerate;              /* Capture components only */
+  gboolean copy;                /* memcpy the payload or only its size */
+  gboolean sync_empty;          /* EmptyBufferDone before EmptyThisBuffer returns */
+};
+
+OMX_ERRORTYPE omx_mock_component_new (OMX_HANDLETYPE * handle,
+    const gchar * name, OmxMockKind kind, const OmxMockConfig * config,
+    OMX_PTR appdata, OMX_CALLBACKTYPE * callbacks);
+OMX_ERRORTYPE omx_mock_component_free (OMX_HANDLETYPE handle);
+
+G_END_DECLS
+#endif /* __OMX_MOCK_COMPONENT_H__ */
@@ -0,0 +1,207 @@
+/*
+ * OMX mock core
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Stand-in for the TI libOMX_Core, selected with
+ * ./configure --with-omx-core=mock, so the plugin can be run and profiled
+ * on a regular Linux box. The components are tuned from the environment:
+ *
+ *   OMX_MOCK_LATENCY             Microseconds from input to output (0)
+ *   OMX_MOCK_<KIND>_LATENCY      Same, for ENCODER, DECODER, VFPC or CAPTURE
+ *   OMX_MOCK_CALL_LATENCY        Microseconds EmptyThisBuffer and
+ *                                FillThisBuffer take to return, like the
+ *                                IPC round trip to the remote cores (0)
+ *   OMX_MOCK_FRAMERATE           Frames per second of the capture (30)
+ *   OMX_MOCK_COPY                Copy the payload to the output (1)
+ *   OMX_MOCK_SYNC_EMPTY          Return input buffers from within
+ *                                EmptyThisBuffer, before it returns (0)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <OMX_Core.h>
+
+#include "timm_osal_interfaces.h"
+
+#include "omxmockcomponent.h"
+
+typedef struct _OmxMockEntry OmxMockEntry;
+
+struct _OmxMockEntry
+{
+  const gchar *name;
+  OmxMockKind kind;
+  const gchar *label;
+};
+
+/* Names are matched by prefix, so every VFPC variant is covered */
+static const OmxMockEntry omx_mock_components[] = {
+  {"OMX.TI.DUCATI.VIDENC", OMX_MOCK_KIND_CODEC, "ENCODER"},
+  {"OMX.TI.DUCATI.VIDDEC", OMX_MOCK_KIND_CODEC, "DECODER"},
+  {"OMX.TI.DSP.AUDENC", OMX_MOCK_KIND_CODEC, "ENCODER"},
+  {"OMX.TI.DSP.AUDDEC", OMX_MOCK_KIND_CODEC, "DECODER"},
+  {"OMX.TI.VPSSM3.VFPC.", OMX_MOCK_KIND_VFPC, "VFPC"},
+  {"OMX.TI.VPSSM3.VFCC", OMX_MOCK_KIND_CAPTURE, "CAPTURE"},
+};
+
+static gint omx_mock_refcount = 0;
+
+static gint64
+omx_mock_getenv (const gchar * name, gint64 fallback)
+{
+  const gchar *value = g_getenv (name);
+
+  if (!value || !*value)
+    return fallback;
+
+  return g_ascii_strtoll (value, NULL, 10);
+}
+
+static void
+omx_mock_get_config (const OmxMockEntry * entry, OmxMockConfig * config)
+{
+  gchar *name;
+
+  name = g_strdup_printf ("OMX_MOCK_%s_LATENCY", entry->label);
+  config->latency =
+      omx_mock_getenv (name, omx_mock_getenv ("OMX_MOCK_LATENCY", 0));
+  g_free (name);
+
+  config->call_latency = omx_mock_getenv ("OMX_MOCK_CALL_LATENCY", 0);
+  config->framerate = omx_mock_getenv ("OMX_MOCK_FRAMERATE", 30);
+  config->copy = omx_mock_getenv ("OMX_MOCK_COPY", 1) != 0;
+  config->sync_empty = omx_mock_getenv ("OMX_MOCK_SYNC_EMPTY", 0) != 0;
+}
+
+static const OmxMockEntry *
+omx_mock_find (const gchar * name)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (omx_mock_components); i++)
+    if (g_str_has_prefix (name, omx_mock_components[i].name))
+      return &omx_mock_components[i];
+
+  return NULL;
+}
+
+OMX_ERRORTYPE OMX_APIENTRY
+OMX_Init (void)
+{
+  g_atomic_int_inc (&omx_mock_refcount);
+
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_APIENTRY
+OMX_Deinit (void)
+{
+  if (g_atomic_int_get (&omx_mock_refcount) <= 0)
+    return OMX_ErrorNotReady;
+
+  g_atomic_int_add (&omx_mock_refcount, -1);
+
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_APIENTRY
+OMX_ComponentNameEnum (OMX_STRING name, OMX_U32 length, OMX_U32 index)
+{
+  if (!name)
+    return OMX_ErrorBadParameter;
+
+  if (index >= G_N_ELEMENTS (omx_mock_components))
+    return OMX_ErrorNoMore;
+
+  g_strlcpy (name, omx_mock_components[index].name, length);
+
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_APIENTRY
+OMX_GetHandle (OMX_HANDLETYPE * handle, OMX_STRING name, OMX_PTR appdata,
+    OMX_CALLBACKTYPE * callbacks)
+{
+  const OmxMockEntry *entry;
+  OmxMockConfig config;
+
+  if (!handle || !name || !callbacks)
+    return OMX_ErrorBadParameter;
+
+  if (g_atomic_int_get (&omx_mock_refcount) <= 0)
+    return OMX_ErrorNotReady;
+
+  entry = omx_mock_find (name);
+  if (!entry)
+    return OMX_ErrorComponentNotFound;
+
+  omx_mock_get_config (entry, &config);
+
+  return omx_mock_component_new (handle, name, entry->kind, &config, appdata,
+      callbacks);
+}
+
+OMX_ERRORTYPE OMX_APIENTRY
+OMX_FreeHandle (OMX_HANDLETYPE handle)
+{
+  return omx_mock_component_free (handle);
+}
+
+OMX_ERRORTYPE OMX_APIENTRY
+OMX_SetupTunnel (OMX_HANDLETYPE output, OMX_U32 outport,
+    OMX_HANDLETYPE input, OMX_U32 inport)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+OMX_ERRORTYPE
+OMX_GetComponentsOfRole (OMX_STRING role, OMX_U32 * num, OMX_U8 ** names)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+OMX_ERRORTYPE
+OMX_GetRolesOfComponent (OMX_STRING name, OMX_U32 * num, OMX_U8 ** roles)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+/* The plugin allocates its port definitions through the TI OSAL */
+
+TIMM_OSAL_PTR
+TIMM_OSAL_Malloc (TIMM_OSAL_U32 size, TIMM_OSAL_BOOL contiguous,
+    TIMM_OSAL_U32 alignment, TIMMOSAL_MEM_SEGMENTID segment)
+{
+  void *data = NULL;
+
+  if (alignment < sizeof (void *))
+    alignment = sizeof (void *);
+
+  if (posix_memalign (&data, alignment, size))
+    return NULL;
+
+  return data;
+}
+
+void
+TIMM_OSAL_Free (TIMM_OSAL_PTR data)
+{
+  free (data);
+}
@@ -0,0 +1,169 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Input port memory against throughput: an encoder runs with fixed sink
+ * buffer counts and with an adaptive count that starts low and grows up
+ * to max-buffers. Run against the mock OMX core, OMX_MOCK_LATENCY sets
+ * the time the component spends on each frame:
+ *
+ *   OMX_MOCK_LATENCY=5000 ./omxbuffers [buffers]
+ *
+ * The adaptive run should reach the throughput of the large fixed counts
+ * while holding fewer buffers */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#define OMXBUFFERS_BUFFERS 1000
+#define OMXBUFFERS_WIDTH 320
+#define OMXBUFFERS_HEIGHT 240
+/* NV12, the input port buffers hold a frame each */
+#define OMXBUFFERS_FRAME_SIZE (OMXBUFFERS_WIDTH * OMXBUFFERS_HEIGHT * 3 / 2)
+
+/* fakesrc allocates its own buffers, so the input goes through the copy
+ * path, the one that grows the port */
+#define OMXBUFFERS_PIPELINE \
+  "fakesrc num-buffers=%d sizetype=fixed sizemax=%d filltype=zero ! " \
+  "video/x-raw-yuv,format=(fourcc)NV12,width=%d,height=%d," \
+  "framerate=30/1 ! omx_h264enc name=enc ! fakesink sync=false"
+
+typedef struct _OmxBuffersRun OmxBuffersRun;
+
+struct _OmxBuffersRun
+{
+  guint min;
+  guint max;
+};
+
+/* Fixed counts first, then the adaptive ones */
+static const OmxBuffersRun omxbuffers_runs[] = {
+  {2, 0},
+  {4, 0},
+  {8, 0},
+  {16, 0},
+  {2, 8},
+  {2, 16},
+};
+
+/* Returns the buffers the encoder sink port holds at the end */
+static guint
+omxbuffers_count (GstElement * enc)
+{
+  const GstStructure *padstats;
+  GstStructure *stats = NULL;
+  guint buffers = 0;
+
+  g_object_get (enc, "stats", &stats, NULL);
+  if (!stats)
+    return 0;
+
+  padstats = gst_value_get_structure (gst_structure_get_value (stats,
+          "sink"));
+  if (padstats)
+    gst_structure_get_uint (padstats, "buffers", &buffers);
+  gst_structure_free (stats);
+
+  return buffers;
+}
+
+/* Returns the frames per second of a run, or a negative value if it
+ * failed. buffers is set to the sink buffers in use at the end */
+static gdouble
+omxbuffers_measure (const OmxBuffersRun * run, gint frames, guint * buffers)
+{
+  GstElement *pipeline, *enc;
+  GstClockTime start, elapsed;
+  GstMessage *msg;
+  GstPad *sinkpad;
+  GstBus *bus;
+  gchar *description;
+  gdouble fps = -1;
+
+  description = g_strdup_printf (OMXBUFFERS_PIPELINE, frames,
+      OMXBUFFERS_FRAME_SIZE, OMXBUFFERS_WIDTH, OMXBUFFERS_HEIGHT);
+  pipeline = gst_parse_launch (description, NULL);
+  g_free (description);
+  if (!pipeline)
+    return fps;
+
+  enc = gst_bin_get_by_name (GST_BIN (pipeline), "enc");
+  sinkpad = gst_element_get_static_pad (enc, "sink");
+  g_object_set (sinkpad, "min-buffers", run->min, "max-buffers", run->max,
+      NULL);
+  gst_object_unref (sinkpad);
+
+  bus = gst_element_get_bus (pipeline);
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (bus, 120 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = gst_util_get_timestamp () - start;
+
+  if (msg && GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS) {
+    fps = (gdouble) frames * GST_SECOND / elapsed;
+    *buffers = omxbuffers_count (enc);
+  }
+  if (msg)
+    gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (enc);
+  gst_object_unref (pipeline);
+
+  return fps;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint frames = OMXBUFFERS_BUFFERS;
+  guint i, buffers = 0;
+  gdouble fps;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    frames = MAX (atoi (argv[1]), 1);
+
+  g_print ("%d %dx%d frames\n", frames, OMXBUFFERS_WIDTH, OMXBUFFERS_HEIGHT);
+  g_print ("min  max  buffers  memory KiB      fps\n");
+
+  for (i = 0; i < G_N_ELEMENTS (omxbuffers_runs); i++) {
+    fps = omxbuffers_measure (&omxbuffers_runs[i], frames, &buffers);
+    if (fps < 0) {
+      g_printerr ("Run with min-buffers=%u max-buffers=%u failed\n",
+          omxbuffers_runs[i].min, omxbuffers_runs[i].max);
+      return EXIT_FAILURE;
+    }
+
+    g_print ("%3u  %3u  %7u  %10u  %7.1f\n", omxbuffers_runs[i].min,
+        omxbuffers_runs[i].max, buffers,
+        buffers * OMXBUFFERS_FRAME_SIZE / 1024, fps);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* GstOmxBufTab cost per buffer round trip: threads take a free buffer,
+ * look it up and give it back, the way the chain and the callbacks do,
+ * for tables of increasing size:
+ *
+ *   ./omxbuftab [threads] [round trips per thread]
+ *
+ * With the id index the time per round trip stays flat as the table
+ * grows */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include "gstomx.h"
+
+#define OMXBUFTAB_THREADS 4
+#define OMXBUFTAB_ROUNDS 1000000
+#define OMXBUFTAB_MAX_BUFFERS 256
+
+typedef struct _OmxBufTabWorker OmxBufTabWorker;
+
+struct _OmxBufTabWorker
+{
+  GstOmxBufTab *buftab;
+  GThread *thread;
+  gint rounds;
+  gboolean failed;
+};
+
+static gpointer
+omxbuftab_run (gpointer data)
+{
+  OmxBufTabWorker *worker = data;
+  OMX_BUFFERHEADERTYPE *buffer, *found;
+  gboolean busy;
+  gint i;
+
+  for (i = 0; i < worker->rounds; i++) {
+    /* Workers hold one buffer at most, there is always a free one */
+    if (!gst_omx_buf_tab_use_free_buffers (worker->buftab, &buffer, 1))
+      goto failed;
+
+    if (GST_OMX_FAIL (gst_omx_buf_tab_find_buffer (worker->buftab, buffer,
+                &found, &busy)) || !busy)
+      goto failed;
+
+    if (GST_OMX_FAIL (gst_omx_buf_tab_return_buffer (worker->buftab,
+                buffer)))
+      goto failed;
+  }
+
+  return NULL;
+
+failed:
+  {
+    worker->failed = TRUE;
+    return NULL;
+  }
+}
+
+/* Returns the nanoseconds per round trip with count buffers in the table,
+ * or a negative value on failure */
+static gdouble
+omxbuftab_measure (guint count, gint threads, gint rounds)
+{
+  OMX_BUFFERHEADERTYPE *headers;
+  GstOmxBufferData *bufdata;
+  OmxBufTabWorker *workers;
+  GstOmxBufTab *buftab;
+  GstClockTime start, elapsed;
+  gdouble ns = 0;
+  guint i;
+
+  buftab = gst_omx_buf_tab_new ();
+  headers = g_new0 (OMX_BUFFERHEADERTYPE, count);
+  bufdata = g_new0 (GstOmxBufferData, count);
+  workers = g_new0 (OmxBufTabWorker, threads);
+
+  for (i = 0; i < count; i++) {
+    bufdata[i].id = i;
+    headers[i].pAppPrivate = &bufdata[i];
+    if (GST_OMX_FAIL (gst_omx_buf_tab_add_buffer (buftab, &headers[i])))
+      ns = -1;
+  }
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < threads && ns >= 0; i++) {
+    workers[i].buftab = buftab;
+    workers[i].rounds = rounds;
+    workers[i].thread = g_thread_new ("omxbuftab", omxbuftab_run,
+        &workers[i]);
+  }
+
+  for (i = 0; i < threads && workers[i].thread; i++) {
+    g_thread_join (workers[i].thread);
+    if (workers[i].failed)
+      ns = -1;
+  }
+  elapsed = gst_util_get_timestamp () - start;
+
+  if (ns >= 0)
+    ns = (gdouble) elapsed / ((gdouble) rounds * threads);
+
+  gst_omx_buf_tab_free (buftab);
+  g_free (workers);
+  g_free (bufdata);
+  g_free (headers);
+
+  return ns;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint threads = OMXBUFTAB_THREADS;
+  gint rounds = OMXBUFTAB_ROUNDS;
+  gdouble ns;
+  guint count;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    threads = MAX (atoi (argv[1]), 1);
+  if (argc > 2)
+    rounds = MAX (atoi (argv[2]), 1);
+
+  g_print ("%d threads, %d round trips per thread\n", threads, rounds);
+  g_print ("buffers  ns/round trip  Mtrips/s\n");
+
+  for (count = threads; count <= OMXBUFTAB_MAX_BUFFERS; count *= 2) {
+    ns = omxbuftab_measure (count, threads, rounds);
+    if (ns < 0) {
+      g_printerr ("Run with %u buffers failed\n", count);
+      return EXIT_FAILURE;
+    }
+
+    g_print ("%7u  %13.1f  %8.2f\n", count, ns, 1000 / ns);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* OMX call lock contention: the throughput of each of 1, 2, 4... encoders
+ * running at once. Run against the mock OMX core, OMX_MOCK_CALL_LATENCY
+ * sets how long every buffer call holds the lock:
+ *
+ *   OMX_MOCK_CALL_LATENCY=200 ./omxcontention [max instances] [buffers]
+ *
+ * With per-instance locks the throughput of each stays flat as instances
+ * are added, builds with --enable-global-omx-lock share a single lock */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#define OMXCONTENTION_INSTANCES 8
+#define OMXCONTENTION_BUFFERS 1000
+
+#define OMXCONTENTION_PIPELINE \
+  "videotestsrc num-buffers=%d ! video/x-raw-yuv,format=(fourcc)NV12," \
+  "width=320,height=240,framerate=30/1 ! omx_h264enc ! fakesink sync=false"
+
+typedef struct _OmxContentionInstance OmxContentionInstance;
+
+struct _OmxContentionInstance
+{
+  GstElement *pipeline;
+  GThread *thread;
+  gint buffers;
+  GstClockTime elapsed;
+  gboolean failed;
+};
+
+/* Runs one pipeline to EOS, from its own thread so every instance gets
+ * its own end time */
+static gpointer
+omxcontention_run (gpointer data)
+{
+  OmxContentionInstance *instance = data;
+  GstClockTime start;
+  GstMessage *msg;
+  GstBus *bus;
+
+  bus = gst_element_get_bus (instance->pipeline);
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (instance->pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (bus, 120 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  instance->elapsed = gst_util_get_timestamp () - start;
+
+  instance->failed = !msg || GST_MESSAGE_TYPE (msg) != GST_MESSAGE_EOS;
+  if (msg)
+    gst_message_unref (msg);
+
+  gst_element_set_state (instance->pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+
+  return NULL;
+}
+
+/* Returns the average frames per second of each instance, or a negative
+ * value if any of them failed */
+static gdouble
+omxcontention_measure (gint count, gint buffers)
+{
+  OmxContentionInstance *instances;
+  gchar *description;
+  gdouble fps = 0;
+  gint i;
+
+  instances = g_new0 (OmxContentionInstance, count);
+  description = g_strdup_printf (OMXCONTENTION_PIPELINE, buffers);
+
+  for (i = 0; i < count; i++) {
+    instances[i].buffers = buffers;
+    instances[i].pipeline = gst_parse_launch (description, NULL);
+    if (!instances[i].pipeline)
+      fps = -1;
+  }
+
+  /* Started together so they contend for the whole run */
+  for (i = 0; i < count && fps >= 0; i++)
+    instances[i].thread = g_thread_new ("omxcontention", omxcontention_run,
+        &instances[i]);
+
+  for (i = 0; i < count && instances[i].thread; i++) {
+    g_thread_join (instances[i].thread);
+    if (instances[i].failed)
+      fps = -1;
+    else if (fps >= 0)
+      fps += (gdouble) buffers * GST_SECOND / instances[i].elapsed / count;
+  }
+
+  for (i = 0; i < count; i++)
+    if (instances[i].pipeline)
+      gst_object_unref (instances[i].pipeline);
+  g_free (description);
+  g_free (instances);
+
+  return fps;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint count, instances = OMXCONTENTION_INSTANCES;
+  gint buffers = OMXCONTENTION_BUFFERS;
+  gdouble fps, single = 0;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    instances = MAX (atoi (argv[1]), 1);
+  if (argc > 2)
+    buffers = MAX (atoi (argv[2]), 1);
+
+#ifdef GST_OMX_GLOBAL_LOCK
+  g_print ("Global OMX lock, %d buffers per instance\n", buffers);
+#else
+  g_print ("Per-instance OMX lock, %d buffers per instance\n", buffers);
+#endif
+  g_print ("instances  fps/instance  scaling\n");
+
+  for (count = 1; count <= instances; count *= 2) {
+    fps = omxcontention_measure (count, buffers);
+    if (fps < 0) {
+      g_printerr ("Run with %d instances failed\n", count);
+      return EXIT_FAILURE;
+    }
+    if (1 == count)
+      single = fps;
+
+    g_print ("%9d  %12.1f  %7.2f\n", count, fps, fps / single);
+  }
+
+  return EXIT_SUCCESS;
+}
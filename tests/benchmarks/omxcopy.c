@@ -0,0 +1,168 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Input copies into padded NV12 ports against a plain memcpy of the same
+ * frame, at 720p and 1080p. NV12 input is copied row by row, I420 input
+ * goes through the SIMD chroma interleave where the CPU has one. Then the
+ * 1080p copies are split across 1 to max threads, as copy-threads does:
+ *
+ *   GST_DEBUG=omxcopy:4 ./omxcopy [frames] [max threads]
+ *
+ * The debug output tells which kernels were picked */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+
+#include "gstomx.h"
+#include "gstomxcopy.h"
+
+#define OMXCOPY_FRAMES 500
+/* Stride alignment of the TI video ports */
+#define OMXCOPY_STRIDE_ALIGN 128
+
+typedef struct _OmxCopySize OmxCopySize;
+
+struct _OmxCopySize
+{
+  const gchar *name;
+  gint width;
+  gint height;
+};
+
+static const OmxCopySize omxcopy_sizes[] = {
+  {"720p", 1280, 720},
+  {"1080p", 1920, 1080},
+};
+
+static const gchar *omxcopy_formats[] = { "NV12", "I420" };
+
+/* Returns the nanoseconds per frame of the copy into a port of the given
+ * frame size, or of a memcpy of the input when memcpy_only is set */
+static gdouble
+omxcopy_measure (const OmxCopySize * size, const gchar * format,
+    gint frames, guint threads, gboolean memcpy_only)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE port;
+  OMX_BUFFERHEADERTYPE omxbuf;
+  GstClockTime start, elapsed;
+  GstOmxCopy copy;
+  GstBuffer *buf;
+  GstCaps *caps;
+  guint8 *dest;
+  gint i;
+
+  GST_OMX_INIT_STRUCT (&port, OMX_PARAM_PORTDEFINITIONTYPE);
+  port.format.video.nFrameWidth = size->width;
+  port.format.video.nFrameHeight = GST_OMX_ALIGN (size->height, 16);
+  port.format.video.nStride = GST_OMX_ALIGN (size->width,
+      OMXCOPY_STRIDE_ALIGN);
+  port.format.video.eColorFormat = OMX_COLOR_FormatYUV420SemiPlanar;
+  port.nBufferSize = port.format.video.nStride *
+      port.format.video.nFrameHeight * 3 / 2;
+
+  caps = gst_caps_new_simple ("video/x-raw-yuv",
+      "format", GST_TYPE_FOURCC, GST_STR_FOURCC (format),
+      "width", G_TYPE_INT, size->width,
+      "height", G_TYPE_INT, size->height, NULL);
+
+  gst_omx_copy_reset (&copy);
+  gst_omx_copy_configure (&copy, caps, &port);
+  gst_caps_unref (caps);
+
+  buf = gst_buffer_new_and_alloc (size->width * size->height * 3 / 2);
+  memset (GST_BUFFER_DATA (buf), 0x80, GST_BUFFER_SIZE (buf));
+  dest = g_malloc (port.nBufferSize);
+
+  memset (&omxbuf, 0, sizeof (omxbuf));
+  omxbuf.pBuffer = dest;
+  omxbuf.nAllocLen = port.nBufferSize;
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < frames; i++) {
+    if (memcpy_only)
+      memcpy (dest, GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf));
+    else
+      gst_omx_copy_buffer (&copy, &omxbuf, buf, threads);
+  }
+  elapsed = gst_util_get_timestamp () - start;
+
+  g_free (dest);
+  gst_buffer_unref (buf);
+
+  return (gdouble) elapsed / frames;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint frames = OMXCOPY_FRAMES;
+  guint maxthreads = GST_OMX_COPY_MAX_THREADS;
+  const OmxCopySize *large;
+  gdouble ns, base, single;
+  guint i, j, threads;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    frames = MAX (atoi (argv[1]), 1);
+  if (argc > 2)
+    maxthreads = CLAMP (atoi (argv[2]), 1, GST_OMX_COPY_MAX_THREADS);
+
+  g_print ("%d frames, single thread\n", frames);
+  g_print ("size   format  ms/frame  memcpy ms  vs memcpy\n");
+
+  for (i = 0; i < G_N_ELEMENTS (omxcopy_sizes); i++) {
+    base = omxcopy_measure (&omxcopy_sizes[i], "NV12", frames, 1, TRUE);
+
+    for (j = 0; j < G_N_ELEMENTS (omxcopy_formats); j++) {
+      ns = omxcopy_measure (&omxcopy_sizes[i], omxcopy_formats[j], frames,
+          1, FALSE);
+
+      g_print ("%-5s  %-6s  %8.3f  %9.3f  %9.2f\n", omxcopy_sizes[i].name,
+          omxcopy_formats[j], ns / GST_MSECOND, base / GST_MSECOND,
+          ns / base);
+    }
+  }
+
+  large = &omxcopy_sizes[G_N_ELEMENTS (omxcopy_sizes) - 1];
+  g_print ("\n%s copies split across threads\n", large->name);
+  g_print ("format  threads  ms/frame  speedup\n");
+
+  for (j = 0; j < G_N_ELEMENTS (omxcopy_formats); j++) {
+    single = 0;
+    for (threads = 1; threads <= maxthreads; threads++) {
+      ns = omxcopy_measure (large, omxcopy_formats[j], frames, threads,
+          FALSE);
+      if (1 == threads)
+        single = ns;
+
+      g_print ("%-6s  %7u  %8.3f  %7.2f\n", omxcopy_formats[j], threads,
+          ns / GST_MSECOND, single / ns);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
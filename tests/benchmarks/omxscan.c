@@ -0,0 +1,251 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* rr_h264parser throughput in MB/s over a corpus of H.264 byte-streams,
+ * the parser assembles access units from input split every blocksize
+ * bytes:
+ *
+ *   ./omxscan [blocksize] [file.h264...]
+ *
+ * Without files a stream shaped like encoder output is generated, a big
+ * IDR frame every second and small P frames in between. Streams dumped
+ * from omx_h264enc on the target make a better corpus. GST_DEBUG=
+ * rr_h264parser:4 tells which start code scan was picked */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#define OMXSCAN_BLOCKSIZE 4096
+#define OMXSCAN_FRAMES 900
+#define OMXSCAN_GOP 30
+#define OMXSCAN_IDR_SIZE 60000
+#define OMXSCAN_P_SIZE 6000
+/* Each stream is parsed this many times, the best run is kept */
+#define OMXSCAN_RUNS 3
+
+#define OMXSCAN_PIPELINE \
+  "filesrc location=\"%s\" blocksize=%d ! video/x-h264," \
+  "stream-format=byte-stream,width=1280,height=720,framerate=30/1 ! " \
+  "rr_h264parser streaming=true ! fakesink sync=false"
+
+static const guint8 omxscan_startcode[] = { 0x00, 0x00, 0x00, 0x01 };
+
+/* Appends a parameter set NAL as is */
+static void
+omxscan_append_ps (GByteArray * stream, const guint8 * nal, guint size)
+{
+  g_byte_array_append (stream, omxscan_startcode, sizeof (omxscan_startcode));
+  g_byte_array_append (stream, nal, size);
+}
+
+/* Appends a slice NAL with size random payload bytes, escaped so no start
+ * code shows up inside. first starts the slice header */
+static void
+omxscan_append_slice (GByteArray * stream, guint8 header, guint8 first,
+    guint size, GRand * rand)
+{
+  guint8 byte;
+  guint i, zeros = 0;
+
+  g_byte_array_append (stream, omxscan_startcode, sizeof (omxscan_startcode));
+  g_byte_array_append (stream, &header, 1);
+  g_byte_array_append (stream, &first, 1);
+
+  for (i = 0; i < size; i++) {
+    /* Encoded slices hold plenty of zero bytes */
+    byte = g_rand_int_range (rand, 0, 8) ?
+        g_rand_int_range (rand, 0, 256) : 0;
+    if (zeros >= 2 && byte <= 3) {
+      g_byte_array_append (stream, (const guint8 *) "\003", 1);
+      zeros = 0;
+    }
+    g_byte_array_append (stream, &byte, 1);
+    zeros = byte ? 0 : zeros + 1;
+  }
+
+  /* A NAL never ends with a zero byte */
+  byte = 0x80;
+  g_byte_array_append (stream, &byte, 1);
+}
+
+/* Writes the generated stream to a temporary file and returns its name */
+static gchar *
+omxscan_generate (void)
+{
+  static const guint8 sps[] = { 0x67, 0x42, 0x00, 0x1f, 0xe9, 0x02, 0x80,
+    0x2d, 0xc8
+  };
+  static const guint8 pps[] = { 0x68, 0xce, 0x38, 0x80 };
+  GByteArray *stream;
+  GError *error = NULL;
+  gchar *filename = NULL;
+  GRand *rand;
+  gint fd, i;
+
+  stream = g_byte_array_new ();
+  rand = g_rand_new_with_seed (0);
+
+  for (i = 0; i < OMXSCAN_FRAMES; i++) {
+    if (0 == i % OMXSCAN_GOP) {
+      omxscan_append_ps (stream, sps, sizeof (sps));
+      omxscan_append_ps (stream, pps, sizeof (pps));
+      omxscan_append_slice (stream, 0x65, 0x88, OMXSCAN_IDR_SIZE, rand);
+    } else {
+      omxscan_append_slice (stream, 0x41, 0x9a, OMXSCAN_P_SIZE, rand);
+    }
+  }
+
+  fd = g_file_open_tmp ("omxscan-XXXXXX.h264", &filename, &error);
+  if (fd < 0) {
+    g_printerr ("Unable to create the stream: %s\n", error->message);
+    g_error_free (error);
+  } else {
+    if (write (fd, stream->data, stream->len) != (gssize) stream->len) {
+      g_printerr ("Unable to write the stream\n");
+      g_unlink (filename);
+      g_free (filename);
+      filename = NULL;
+    }
+    close (fd);
+  }
+
+  g_rand_free (rand);
+  g_byte_array_free (stream, TRUE);
+
+  return filename;
+}
+
+/* Returns the best MB/s of parsing a file, or a negative value if the
+ * pipeline failed */
+static gdouble
+omxscan_measure (const gchar * filename, gint blocksize, gsize size)
+{
+  GstElement *pipeline;
+  GstClockTime start, elapsed, best = GST_CLOCK_TIME_NONE;
+  GstMessage *msg;
+  GstBus *bus;
+  gchar *description;
+  gboolean eos;
+  gint i;
+
+  description = g_strdup_printf (OMXSCAN_PIPELINE, filename, blocksize);
+
+  for (i = 0; i < OMXSCAN_RUNS; i++) {
+    pipeline = gst_parse_launch (description, NULL);
+    if (!pipeline)
+      break;
+    bus = gst_element_get_bus (pipeline);
+
+    start = gst_util_get_timestamp ();
+    gst_element_set_state (pipeline, GST_STATE_PLAYING);
+    msg = gst_bus_timed_pop_filtered (bus, 120 * GST_SECOND,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    elapsed = gst_util_get_timestamp () - start;
+
+    eos = msg && GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS;
+    if (msg)
+      gst_message_unref (msg);
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (bus);
+    gst_object_unref (pipeline);
+
+    if (!eos)
+      break;
+    if (!GST_CLOCK_TIME_IS_VALID (best) || elapsed < best)
+      best = elapsed;
+  }
+
+  g_free (description);
+
+  if (i < OMXSCAN_RUNS)
+    return -1;
+
+  return (gdouble) size / (1024 * 1024) * GST_SECOND / best;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint blocksize = OMXSCAN_BLOCKSIZE;
+  gchar *generated = NULL;
+  gchar **files;
+  guint64 total = 0;
+  gdouble mbs, seconds = 0;
+  GStatBuf st;
+  gint i, count;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    blocksize = MAX (atoi (argv[1]), 1);
+
+  if (argc > 2) {
+    files = argv + 2;
+    count = argc - 2;
+  } else {
+    generated = omxscan_generate ();
+    if (!generated)
+      return EXIT_FAILURE;
+    files = &generated;
+    count = 1;
+  }
+
+  g_print ("Blocks of %d bytes\n", blocksize);
+  g_print ("    size KiB      MB/s  stream\n");
+
+  for (i = 0; i < count; i++) {
+    if (g_stat (files[i], &st) < 0 || !st.st_size) {
+      g_printerr ("Unable to read %s\n", files[i]);
+      continue;
+    }
+
+    mbs = omxscan_measure (files[i], blocksize, st.st_size);
+    if (mbs < 0) {
+      g_printerr ("Parsing %s failed\n", files[i]);
+      continue;
+    }
+
+    total += st.st_size;
+    seconds += (gdouble) st.st_size / (1024 * 1024) / mbs;
+    g_print ("%12" G_GUINT64_FORMAT "  %8.1f  %s\n",
+        (guint64) st.st_size / 1024, mbs, files[i]);
+  }
+
+  if (generated) {
+    g_unlink (generated);
+    g_free (generated);
+  }
+
+  if (!total)
+    return EXIT_FAILURE;
+
+  g_print ("%12" G_GUINT64_FORMAT "  %8.1f  total\n", total / 1024,
+      (gdouble) total / (1024 * 1024) / seconds);
+
+  return EXIT_SUCCESS;
+}
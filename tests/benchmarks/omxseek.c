@@ -0,0 +1,115 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Seek latency: the time from a flushing seek to the pipeline prerolled
+ * again, with frames in flight in the component. Run against the mock OMX
+ * core, OMX_MOCK_LATENCY sets how long frames stay in it:
+ *
+ *   OMX_MOCK_LATENCY=33000 ./omxseek [seeks]
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#define OMXSEEK_SEEKS 100
+
+#define OMXSEEK_PIPELINE \
+  "videotestsrc ! video/x-raw-yuv,format=(fourcc)NV12,width=320," \
+  "height=240,framerate=30/1 ! omx_h264enc ! fakesink sync=false"
+
+/* Returns FALSE on error or timeout */
+static gboolean
+omxseek_wait (GstBus * bus, GstMessageType type)
+{
+  GstMessage *msg;
+  gboolean ret;
+
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+      type | GST_MESSAGE_ERROR);
+  if (!msg)
+    return FALSE;
+
+  ret = GST_MESSAGE_TYPE (msg) == type;
+  gst_message_unref (msg);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstClockTime start, elapsed, total = 0, min = GST_CLOCK_TIME_NONE, max = 0;
+  gint i, seeks = OMXSEEK_SEEKS;
+  int ret = EXIT_FAILURE;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    seeks = MAX (atoi (argv[1]), 1);
+
+  pipeline = gst_parse_launch (OMXSEEK_PIPELINE, NULL);
+  if (!pipeline) {
+    g_printerr ("Unable to build the pipeline\n");
+    return ret;
+  }
+  bus = gst_element_get_bus (pipeline);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  if (!omxseek_wait (bus, GST_MESSAGE_ASYNC_DONE)) {
+    g_printerr ("Pipeline didn't start\n");
+    goto out;
+  }
+
+  for (i = 0; i < seeks; i++) {
+    /* Let the component fill up again */
+    g_usleep (20 * G_TIME_SPAN_MILLISECOND);
+
+    start = gst_util_get_timestamp ();
+    if (!gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+            GST_SEEK_FLAG_FLUSH, (i % 10) * GST_SECOND)) {
+      g_printerr ("Seek %d failed\n", i);
+      goto out;
+    }
+    if (!omxseek_wait (bus, GST_MESSAGE_ASYNC_DONE)) {
+      g_printerr ("Seek %d didn't complete\n", i);
+      goto out;
+    }
+    elapsed = gst_util_get_timestamp () - start;
+
+    total += elapsed;
+    min = MIN (min, elapsed);
+    max = MAX (max, elapsed);
+  }
+
+  g_print ("%d seeks: min %" GST_TIME_FORMAT " avg %" GST_TIME_FORMAT
+      " max %" GST_TIME_FORMAT "\n", seeks, GST_TIME_ARGS (min),
+      GST_TIME_ARGS (total / seeks), GST_TIME_ARGS (max));
+  ret = EXIT_SUCCESS;
+
+out:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  return ret;
+}
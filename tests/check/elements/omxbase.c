@@ -0,0 +1,165 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* GstOmxBase against the mock OMX core. The mock is tuned through the
+ * environment, see omxmock/omxmockcore.c */
+
+#include <gst/check/gstcheck.h>
+
+#define OMXBASE_BUFFERS 500
+#define OMXBASE_CHANNELS 4
+
+#define OMXBASE_PIPELINE \
+  "videotestsrc num-buffers=%d ! video/x-raw-yuv,format=(fourcc)NV12," \
+  "width=320,height=240,framerate=30/1 ! omx_h264enc ! " \
+  "fakesink name=sink signal-handoffs=true"
+
+typedef struct _OmxBaseChannel OmxBaseChannel;
+
+struct _OmxBaseChannel
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  gint outputs;
+};
+
+static void
+omxbase_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer data)
+{
+  g_atomic_int_inc ((gint *) data);
+}
+
+static void
+omxbase_channel_start (OmxBaseChannel * channel, gint buffers)
+{
+  GstElement *sink;
+  gchar *description;
+
+  description = g_strdup_printf (OMXBASE_PIPELINE, buffers);
+  channel->pipeline = gst_parse_launch (description, NULL);
+  g_free (description);
+  fail_unless (channel->pipeline != NULL, "Unable to build the pipeline");
+
+  channel->outputs = 0;
+  sink = gst_bin_get_by_name (GST_BIN (channel->pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (omxbase_handoff),
+      &channel->outputs);
+  gst_object_unref (sink);
+
+  channel->bus = gst_element_get_bus (channel->pipeline);
+  fail_if (GST_STATE_CHANGE_FAILURE ==
+      gst_element_set_state (channel->pipeline, GST_STATE_PLAYING));
+}
+
+/* Waits for the end of the stream, any error fails the test */
+static void
+omxbase_channel_finish (OmxBaseChannel * channel, gint buffers)
+{
+  GstMessage *msg;
+  GError *err = NULL;
+  gchar *debug = NULL;
+
+  msg = gst_bus_timed_pop_filtered (channel->bus, 60 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "Timed out waiting for EOS");
+
+  if (GST_MESSAGE_ERROR == GST_MESSAGE_TYPE (msg)) {
+    gst_message_parse_error (msg, &err, &debug);
+    fail ("Error from %s: %s (%s)", GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)),
+        err->message, GST_STR_NULL (debug));
+  }
+  gst_message_unref (msg);
+
+  /* The frames in flight at EOS are flushed */
+  fail_unless (channel->outputs > 0, "No output");
+  fail_unless (channel->outputs <= buffers, "%d outputs from %d inputs",
+      channel->outputs, buffers);
+
+  fail_if (GST_STATE_CHANGE_FAILURE ==
+      gst_element_set_state (channel->pipeline, GST_STATE_NULL));
+  gst_object_unref (channel->bus);
+  gst_object_unref (channel->pipeline);
+}
+
+/* EmptyBufferDone arrives from inside EmptyThisBuffer, before the chain
+ * function gets to do anything else with the buffer */
+GST_START_TEST (test_sync_empty)
+{
+  OmxBaseChannel channel;
+
+  g_setenv ("OMX_MOCK_SYNC_EMPTY", "1", TRUE);
+
+  omxbase_channel_start (&channel, OMXBASE_BUFFERS);
+  omxbase_channel_finish (&channel, OMXBASE_BUFFERS);
+
+  g_unsetenv ("OMX_MOCK_SYNC_EMPTY");
+}
+
+GST_END_TEST;
+
+/* Same, with several components emptying at once */
+GST_START_TEST (test_sync_empty_channels)
+{
+  OmxBaseChannel channels[OMXBASE_CHANNELS];
+  gint i;
+
+  g_setenv ("OMX_MOCK_SYNC_EMPTY", "1", TRUE);
+
+  for (i = 0; i < OMXBASE_CHANNELS; i++)
+    omxbase_channel_start (&channels[i], OMXBASE_BUFFERS);
+  for (i = 0; i < OMXBASE_CHANNELS; i++)
+    omxbase_channel_finish (&channels[i], OMXBASE_BUFFERS);
+
+  g_unsetenv ("OMX_MOCK_SYNC_EMPTY");
+}
+
+GST_END_TEST;
+
+/* The usual case, EmptyBufferDone comes later from the component thread */
+GST_START_TEST (test_async_empty)
+{
+  OmxBaseChannel channel;
+
+  g_setenv ("OMX_MOCK_LATENCY", "1000", TRUE);
+
+  omxbase_channel_start (&channel, OMXBASE_BUFFERS);
+  omxbase_channel_finish (&channel, OMXBASE_BUFFERS);
+
+  g_unsetenv ("OMX_MOCK_LATENCY");
+}
+
+GST_END_TEST;
+
+static Suite *
+omxbase_suite (void)
+{
+  Suite *s = suite_create ("omxbase");
+  TCase *tc_chain = tcase_create ("empty");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_sync_empty);
+  tcase_add_test (tc_chain, test_sync_empty_channels);
+  tcase_add_test (tc_chain, test_async_empty);
+
+  return s;
+}
+
+GST_CHECK_MAIN (omxbase);
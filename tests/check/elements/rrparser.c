@@ -0,0 +1,426 @@
+/*
+ * GStreamer
+ * Copyright (C) 2016 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* rr_h264parser in streaming mode. The same byte-stream is pushed split at
+ * many offsets, the access units that come out must not depend on where
+ * the input buffers end */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+
+#define RRPARSER_AUS 4
+/* Input buffer i is stamped i milliseconds */
+#define RRPARSER_STAMP(i) ((i) * GST_MSECOND)
+
+#define RRPARSER_CAPS \
+  "video/x-h264,stream-format=(string)byte-stream,width=(int)320," \
+  "height=(int)240,framerate=(fraction)30/1"
+
+static GstStaticPadTemplate rrparser_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-h264, stream-format = (string) byte-stream"));
+
+static GstStaticPadTemplate rrparser_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-h264, stream-format = (string) avc"));
+
+static const guint8 rrparser_sps[] = { 0x67, 0x42, 0x00, 0x1f, 0xe9, 0x02,
+  0x80, 0x2d, 0xc8
+};
+
+static const guint8 rrparser_pps[] = { 0x68, 0xce, 0x38, 0x80 };
+
+/* avcC out of the SPS and PPS above, 4 byte NAL lengths */
+static const guint8 rrparser_codec_data[] = { 0x01, 0x42, 0x00, 0x1f, 0xff,
+  0xe1, 0x00, 0x09, 0x67, 0x42, 0x00, 0x1f, 0xe9, 0x02, 0x80, 0x2d, 0xc8,
+  0x01, 0x00, 0x04, 0x68, 0xce, 0x38, 0x80
+};
+
+typedef struct _RRParserStream RRParserStream;
+
+/* The byte-stream along with the access units expected out of it */
+struct _RRParserStream
+{
+  GByteArray *data;
+  GByteArray *aus[RRPARSER_AUS];
+  /* Where the 00 00 01 of the first start code of each access unit is */
+  guint starts[RRPARSER_AUS];
+  gboolean delta[RRPARSER_AUS];
+};
+
+static GstPad *mysrcpad, *mysinkpad;
+
+/* Appends a NAL behind a start code of 3 or 4 bytes, and to the access
+ * unit behind its length */
+static void
+rrparser_append_nal (RRParserStream * stream, gint au, gboolean longcode,
+    const guint8 * nal, guint size)
+{
+  static const guint8 startcode[] = { 0x00, 0x00, 0x00, 0x01 };
+  guint8 length[4];
+
+  if (!stream->aus[au]) {
+    stream->aus[au] = g_byte_array_new ();
+    stream->starts[au] = stream->data->len + (longcode ? 1 : 0);
+  }
+
+  if (longcode)
+    g_byte_array_append (stream->data, startcode, 4);
+  else
+    g_byte_array_append (stream->data, startcode + 1, 3);
+  g_byte_array_append (stream->data, nal, size);
+
+  GST_WRITE_UINT32_BE (length, size);
+  g_byte_array_append (stream->aus[au], length, 4);
+  g_byte_array_append (stream->aus[au], nal, size);
+}
+
+/* Appends a slice of size bytes starting with the NAL header and the first
+ * byte of the slice header. The payload holds an emulation prevention
+ * sequence, which must not be taken for a start code */
+static void
+rrparser_append_slice (RRParserStream * stream, gint au, gboolean longcode,
+    guint8 header, guint8 first, guint size)
+{
+  guint8 *nal;
+  guint i;
+
+  nal = g_malloc (size);
+  nal[0] = header;
+  nal[1] = first;
+  for (i = 2; i < size; i++)
+    nal[i] = (i * 7) % 255 + 1;
+  nal[size / 2] = 0x00;
+  nal[size / 2 + 1] = 0x00;
+  nal[size / 2 + 2] = 0x03;
+  nal[size / 2 + 3] = 0x01;
+
+  rrparser_append_nal (stream, au, longcode, nal, size);
+  g_free (nal);
+}
+
+/* An IDR picture with its parameter sets, two P pictures, the second one
+ * in two slices, and another IDR picture with parameter sets again. Start
+ * codes of 3 and 4 bytes are mixed */
+static void
+rrparser_stream_init (RRParserStream * stream)
+{
+  memset (stream, 0, sizeof (RRParserStream));
+  stream->data = g_byte_array_new ();
+
+  rrparser_append_nal (stream, 0, TRUE, rrparser_sps, sizeof (rrparser_sps));
+  rrparser_append_nal (stream, 0, TRUE, rrparser_pps, sizeof (rrparser_pps));
+  rrparser_append_slice (stream, 0, FALSE, 0x65, 0x88, 60);
+
+  rrparser_append_slice (stream, 1, TRUE, 0x41, 0x9a, 40);
+  stream->delta[1] = TRUE;
+
+  /* The second slice doesn't start at macroblock 0 */
+  rrparser_append_slice (stream, 2, FALSE, 0x41, 0x9a, 30);
+  rrparser_append_slice (stream, 2, FALSE, 0x41, 0x1a, 30);
+  stream->delta[2] = TRUE;
+
+  rrparser_append_nal (stream, 3, FALSE, rrparser_sps, sizeof (rrparser_sps));
+  rrparser_append_nal (stream, 3, TRUE, rrparser_pps, sizeof (rrparser_pps));
+  rrparser_append_slice (stream, 3, TRUE, 0x65, 0x88, 50);
+}
+
+static void
+rrparser_stream_clear (RRParserStream * stream)
+{
+  gint i;
+
+  for (i = 0; i < RRPARSER_AUS; i++)
+    g_byte_array_free (stream->aus[i], TRUE);
+  g_byte_array_free (stream->data, TRUE);
+}
+
+static GstElement *
+rrparser_setup (void)
+{
+  GstElement *rrparser;
+
+  rrparser = gst_check_setup_element ("rr_h264parser");
+  g_object_set (rrparser, "streaming", TRUE, NULL);
+  mysrcpad = gst_check_setup_src_pad (rrparser, &rrparser_src_template,
+      NULL);
+  mysinkpad = gst_check_setup_sink_pad (rrparser, &rrparser_sink_template,
+      NULL);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (rrparser, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS, "could not set to playing");
+
+  return rrparser;
+}
+
+static void
+rrparser_cleanup (GstElement * rrparser)
+{
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (rrparser);
+  gst_check_teardown_sink_pad (rrparser);
+  gst_check_teardown_element (rrparser);
+}
+
+/* Pushes bytes [from, to) of the stream as input buffer index */
+static void
+rrparser_push (RRParserStream * stream, guint from, guint to, gint index,
+    gboolean discont)
+{
+  GstBuffer *buf;
+  GstCaps *caps;
+
+  buf = gst_buffer_new_and_alloc (to - from);
+  memcpy (GST_BUFFER_DATA (buf), stream->data->data + from, to - from);
+  GST_BUFFER_TIMESTAMP (buf) = RRPARSER_STAMP (index);
+  if (discont)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+
+  caps = gst_caps_from_string (RRPARSER_CAPS);
+  gst_buffer_set_caps (buf, caps);
+  gst_caps_unref (caps);
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad, buf), GST_FLOW_OK);
+}
+
+/* Checks the output buffer against access unit au, expected to start in
+ * input buffer index. Each input timestamp goes to one access unit only */
+static void
+rrparser_check_au (RRParserStream * stream, GstBuffer * buf, gint au,
+    gint index, gint previous)
+{
+  const GValue *value;
+  GstBuffer *codec_data;
+  GstStructure *s;
+
+  fail_unless_equals_int (GST_BUFFER_SIZE (buf), stream->aus[au]->len);
+  fail_unless (0 == memcmp (GST_BUFFER_DATA (buf), stream->aus[au]->data,
+          stream->aus[au]->len), "Access unit %d differs", au);
+
+  fail_unless (!GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT) ==
+      !stream->delta[au], "Access unit %d has the wrong delta flag", au);
+
+  if (index == previous)
+    fail_if (GST_BUFFER_TIMESTAMP_IS_VALID (buf),
+        "Access unit %d took a timestamp already given", au);
+  else
+    fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (buf),
+        RRPARSER_STAMP (index));
+
+  fail_unless (GST_BUFFER_CAPS (buf) != NULL);
+  s = gst_caps_get_structure (GST_BUFFER_CAPS (buf), 0);
+  fail_unless (gst_structure_has_name (s, "video/x-h264"));
+  fail_unless_equals_string (gst_structure_get_string (s, "stream-format"),
+      "avc");
+  value = gst_structure_get_value (s, "codec_data");
+  fail_unless (value != NULL, "No codec_data");
+  codec_data = gst_value_get_buffer (value);
+  fail_unless_equals_int (GST_BUFFER_SIZE (codec_data),
+      sizeof (rrparser_codec_data));
+  fail_unless (0 == memcmp (GST_BUFFER_DATA (codec_data),
+          rrparser_codec_data, sizeof (rrparser_codec_data)));
+}
+
+/* Pushes the whole stream in buffers ending at splits, then EOS, and
+ * checks every access unit came out once and whole */
+static void
+rrparser_run (const guint * splits, gint count)
+{
+  RRParserStream stream;
+  GstElement *rrparser;
+  GList *l;
+  gint first[RRPARSER_AUS];
+  guint from = 0, to;
+  gint i, au, previous;
+
+  rrparser_stream_init (&stream);
+  rrparser = rrparser_setup ();
+
+  for (i = 0; i <= count; i++) {
+    to = i < count ? MIN (splits[i], stream.data->len) : stream.data->len;
+    if (to <= from)
+      continue;
+
+    for (au = 0; au < RRPARSER_AUS; au++)
+      if (stream.starts[au] >= from && stream.starts[au] < to)
+        first[au] = i;
+
+    rrparser_push (&stream, from, to, i, FALSE);
+    from = to;
+  }
+
+  /* The last access unit is only known to be complete at EOS */
+  fail_unless_equals_int (g_list_length (buffers), RRPARSER_AUS - 1);
+  gst_pad_push_event (mysrcpad, gst_event_new_eos ());
+  fail_unless_equals_int (g_list_length (buffers), RRPARSER_AUS);
+
+  previous = -1;
+  for (l = buffers, au = 0; l; l = l->next, au++) {
+    rrparser_check_au (&stream, GST_BUFFER (l->data), au, first[au],
+        previous);
+    previous = first[au];
+  }
+
+  rrparser_cleanup (rrparser);
+  rrparser_stream_clear (&stream);
+}
+
+/* Runs the stream in buffers of size bytes */
+static void
+rrparser_run_blocks (guint size)
+{
+  guint splits[1024];
+  gint count;
+
+  for (count = 0; count < G_N_ELEMENTS (splits); count++)
+    splits[count] = (count + 1) * size;
+  rrparser_run (splits, count);
+}
+
+GST_START_TEST (test_whole_stream)
+{
+  rrparser_run (NULL, 0);
+}
+
+GST_END_TEST;
+
+/* Every start code lands split in some of these */
+GST_START_TEST (test_small_blocks)
+{
+  guint size;
+
+  for (size = 1; size <= 8; size++)
+    rrparser_run_blocks (size);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_odd_blocks)
+{
+  rrparser_run_blocks (13);
+  rrparser_run_blocks (61);
+  rrparser_run_blocks (100);
+}
+
+GST_END_TEST;
+
+/* Each start code split after each of its bytes, and right before the
+ * byte telling whether a slice starts a picture */
+GST_START_TEST (test_split_start_codes)
+{
+  RRParserStream stream;
+  guint splits[RRPARSER_AUS];
+  gint au, offset;
+
+  rrparser_stream_init (&stream);
+
+  for (offset = -1; offset <= 4; offset++) {
+    for (au = 0; au < RRPARSER_AUS; au++)
+      splits[au] = MAX ((gint) stream.starts[au] + offset, 1);
+    rrparser_run (splits, RRPARSER_AUS);
+  }
+
+  rrparser_stream_clear (&stream);
+}
+
+GST_END_TEST;
+
+/* The access unit cut by a discontinuity is dropped, the ones before and
+ * after it come out untouched */
+GST_START_TEST (test_discont)
+{
+  RRParserStream stream;
+  GstElement *rrparser;
+  guint cut;
+
+  rrparser_stream_init (&stream);
+  rrparser = rrparser_setup ();
+
+  /* Up to the middle of the second access unit */
+  cut = stream.starts[1] + stream.aus[1]->len / 2;
+  rrparser_push (&stream, 0, cut, 0, FALSE);
+  fail_unless_equals_int (g_list_length (buffers), 1);
+
+  /* The rest of it went missing */
+  rrparser_push (&stream, stream.starts[2] - 1, stream.data->len, 1, TRUE);
+  fail_unless_equals_int (g_list_length (buffers), 2);
+  gst_pad_push_event (mysrcpad, gst_event_new_eos ());
+  fail_unless_equals_int (g_list_length (buffers), 3);
+
+  rrparser_check_au (&stream, GST_BUFFER (buffers->data), 0, 0, -1);
+  rrparser_check_au (&stream, GST_BUFFER (buffers->next->data), 2, 1, 0);
+  rrparser_check_au (&stream, GST_BUFFER (buffers->next->next->data), 3, 1,
+      1);
+
+  rrparser_cleanup (rrparser);
+  rrparser_stream_clear (&stream);
+}
+
+GST_END_TEST;
+
+/* Access units before the first SPS and PPS are dropped, the one drained
+ * at EOS too */
+GST_START_TEST (test_eos_without_parameter_sets)
+{
+  RRParserStream stream;
+  GstElement *rrparser;
+
+  rrparser_stream_init (&stream);
+  rrparser = rrparser_setup ();
+
+  rrparser_push (&stream, stream.starts[1] - 1, stream.starts[3], 0, FALSE);
+  gst_pad_push_event (mysrcpad, gst_event_new_eos ());
+  fail_unless_equals_int (g_list_length (buffers), 0);
+
+  rrparser_cleanup (rrparser);
+  rrparser_stream_clear (&stream);
+}
+
+GST_END_TEST;
+
+static Suite *
+rrparser_suite (void)
+{
+  Suite *s = suite_create ("rrparser");
+  TCase *tc_chain = tcase_create ("streaming");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_whole_stream);
+  tcase_add_test (tc_chain, test_small_blocks);
+  tcase_add_test (tc_chain, test_odd_blocks);
+  tcase_add_test (tc_chain, test_split_start_codes);
+  tcase_add_test (tc_chain, test_discont);
+  tcase_add_test (tc_chain, test_eos_without_parameter_sets);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rrparser);